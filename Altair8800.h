@@ -58,9 +58,9 @@
 #define INT_2SIO4       0x00000400
 #define INT_DEVICE      0x00ffffff
 
-extern word status_wait;
-extern word status_inte;
-extern bool have_ps2;
+extern MACHINE_STATE word status_wait;
+extern MACHINE_STATE word status_inte;
+extern MACHINE_STATE bool have_ps2;
 
 byte altair_in(byte addr);
 void altair_out(byte addr, byte val);
@@ -70,6 +70,7 @@ bool altair_interrupt_active(uint32_t i);
 void altair_interrupt_enable();
 void altair_interrupt_disable();
 bool altair_interrupt_enabled();
+bool altair_interrupt_pending();
 bool altair_isreset();
 void altair_wait_step();
 void altair_set_outputs(uint16_t a, byte v);
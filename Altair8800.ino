@@ -43,22 +43,22 @@
 #define BIT(n) (1<<(n))
 #define b2s numsys_byte2string
 
-uint16_t cswitch = 0;
-uint16_t dswitch = 0;
+MACHINE_STATE uint16_t cswitch = 0;
+MACHINE_STATE uint16_t dswitch = 0;
 
-static uint16_t p_regPC = 0xFFFF;
+static MACHINE_STATE uint16_t p_regPC = 0xFFFF;
 
-volatile uint32_t altair_interrupts_buf = 0;
-volatile uint32_t altair_interrupts     = 0;
-volatile byte     altair_vi_level_cur   = 0;
-volatile byte     altair_vi_level       = 0;
-volatile bool     altair_interrupts_enabled = false;
-static   bool     altair_rtc_available  = false;
-static   bool     altair_rtc_running    = false;
-volatile bool     sticky_slow           = false;
+MACHINE_STATE volatile uint32_t altair_interrupts_buf = 0;
+MACHINE_STATE volatile uint32_t altair_interrupts     = 0;
+MACHINE_STATE volatile byte     altair_vi_level_cur   = 0;
+MACHINE_STATE volatile byte     altair_vi_level       = 0;
+MACHINE_STATE volatile bool     altair_interrupts_enabled = false;
+static MACHINE_STATE bool       altair_rtc_available  = false;
+static MACHINE_STATE bool       altair_rtc_running    = false;
+MACHINE_STATE volatile bool     sticky_slow           = false;
 
-word status_wait = false;
-bool have_ps2    = false;
+MACHINE_STATE word status_wait = false;
+MACHINE_STATE bool have_ps2    = false;
 
 void print_panel_serial(bool force = false);
 void print_dbg_info();
@@ -69,8 +69,8 @@ void empty_input_buffer();
 void rtc_setup();
 
 #if USE_THROTTLE>0
-uint32_t  throttle_micros = 0;
-uint16_t  throttle_delay  = 0;
+MACHINE_STATE uint32_t  throttle_micros = 0;
+MACHINE_STATE uint16_t  throttle_delay  = 0;
 
 #define THROTTLE_TIMER_PERIOD 25000
 void update_throttle()
@@ -1059,6 +1059,97 @@ void read_inputs_serial()
     }
   else if( data == 'Y' )
     mem_print_layout();
+#ifdef PROFILE_HAS_COUNTERS
+  else if( data == 'O' )
+    {
+      char c;
+      Serial.print(F("\r\nProfiler is "));
+      Serial.print(profile_counters_enabled() ? F("on") : F("off"));
+      Serial.print(F(": (e)nable/(d)isable/(c)lear"));
+#if USE_PROFILING_PC>0
+      Serial.print(F("/(r)eport/(w)rite histogram"));
+#endif
+#if USE_PROFILING_CALLS>0
+      Serial.print(F("/(s)ymbols/(f)olded stacks"));
+#endif
+#if USE_PROFILING_IO>0
+      Serial.print(F("/(i)/o ports"));
+#endif
+#if USE_PROFILING_INTERRUPTS>0
+      Serial.print(F("/interrupt (l)atency"));
+#endif
+#if USE_PROFILING_COVERAGE>0
+      Serial.print(F("/co(v)erage"));
+#endif
+#if USE_PROFILING_TRACE>0
+      Serial.print(F("/(t)race"));
+#endif
+#if USE_PROFILING_HOST>0
+      Serial.print(F("/(h)ost time"));
+#endif
+      Serial.print(F("? "));
+      do { c=serial_read(); } while(c!='e' && c!='d' && c!='c' && c!='r' && c!='w' && c!='s' && c!='f' && c!='i' && c!='l' && c!='v' && c!='t' && c!='h' && c!=27);
+      if( c!=27 ) Serial.print(c);
+      Serial.println();
+
+      if( c=='e' || c=='d' )
+        profile_counters_enable(c=='e');
+      else if( c=='c' )
+        profile_counters_reset();
+#if USE_PROFILING_PC>0
+      else if( c=='r' )
+        profile_pc_print(20);
+      else if( c=='w' )
+        {
+          Serial.print(profile_pc_write("PROFILE.DAT") ? F("Histogram written to ") : F("Unable to write "));
+          Serial.println(F("PROFILE.DAT"));
+        }
+#endif
+#if USE_PROFILING_CALLS>0
+      else if( c=='s' )
+        {
+          Serial.print(disassembler_load_symbols("PROFILE.SYM") ? F("Loaded symbols from ") : F("Unable to read "));
+          Serial.println(F("PROFILE.SYM"));
+        }
+      else if( c=='f' )
+        {
+          Serial.print(profile_calls_write("PROFILE.FLD") ? F("Folded stacks written to ") : F("Unable to write "));
+          Serial.println(F("PROFILE.FLD"));
+        }
+#endif
+#if USE_PROFILING_IO>0
+      else if( c=='i' )
+        io_profile_print();
+#endif
+#if USE_PROFILING_INTERRUPTS>0
+      else if( c=='l' )
+        profile_interrupts_print();
+#endif
+#if USE_PROFILING_COVERAGE>0
+      else if( c=='v' )
+        {
+          profile_coverage_print();
+          Serial.print(profile_coverage_write("PROFILE.COV") ? F("Coverage written to ") : F("Unable to write "));
+          Serial.println(F("PROFILE.COV"));
+        }
+#endif
+#if USE_PROFILING_TRACE>0
+      else if( c=='t' )
+        {
+          Serial.print(profile_trace_write("PROFILE.TRC") ? F("Trace written to ") : F("Unable to write "));
+          Serial.println(F("PROFILE.TRC"));
+        }
+#endif
+#if USE_PROFILING_HOST>0
+      else if( c=='h' )
+        profile_host_print(NULL);
+#endif
+
+      Serial.println();
+      p_regPC = ~regPC;
+      print_dbg_info();
+    }
+#endif
   else if( data == 'C' )
     {
       cswitch = BIT(SW_STOP) | BIT(SW_AUX1UP);
@@ -1117,7 +1208,7 @@ void read_inputs_serial()
 void print_panel_serial(bool force)
 {
   byte dbus;
-  static uint16_t p_dswitch = 0, p_cswitch = 0, p_abus = 0xffff, p_dbus = 0xffff, p_status = 0xffff;
+  static MACHINE_STATE uint16_t p_dswitch = 0, p_cswitch = 0, p_abus = 0xffff, p_dbus = 0xffff, p_status = 0xffff;
   uint16_t status, abus;
 
   if( !config_serial_panel_enabled() )
@@ -1269,6 +1360,10 @@ void switch_interrupt_handler()
       host_clr_status_led_MEMR();
       host_clr_status_led_WO();
       host_set_status_led_WAIT();
+
+      // simulation is idle now => write cached disk changes to image files
+      drive_sync();
+
       if( !config_serial_debug_enabled() ) 
         {}
       else if( config_serial_panel_enabled() )
@@ -1394,6 +1489,14 @@ bool altair_interrupt_enabled()
 }
 
 
+bool altair_interrupt_pending()
+{
+  // true if the simulation loop will handle an interrupt (device or
+  // switch) before executing the next instruction
+  return altair_interrupts!=0;
+}
+
+
 void altair_interrupt_disable()
 {
   host_clr_status_led_INTE();
@@ -1407,9 +1510,15 @@ void altair_interrupt(uint32_t i, bool set)
   if( i & INT_DEVICE )
     {
       if( set )
-        altair_interrupts_buf |=  (i & INT_DEVICE);
+        {
+          PROFILE_INTERRUPT_RAISE(i & INT_DEVICE, altair_interrupts_buf);
+          altair_interrupts_buf |=  (i & INT_DEVICE);
+        }
       else
-        altair_interrupts_buf &= ~(i & INT_DEVICE);
+        {
+          PROFILE_INTERRUPT_CLEAR(i & INT_DEVICE, altair_interrupts_buf);
+          altair_interrupts_buf &= ~(i & INT_DEVICE);
+        }
 
       if( !altair_interrupts_enabled ) 
         altair_interrupts &= ~INT_DEVICE;
@@ -1441,6 +1550,12 @@ static byte altair_interrupt_handler()
   host_set_status_led_INT();
   host_clr_status_led_MEMR();
 
+  // the interrupt is acknowledged for all asserted lines (or the lines
+  // of the highest priority level if VI enabled)
+  PROFILE_INTERRUPT_ACK((altair_interrupts & INT_VECTOR) ? 
+                        (altair_interrupts_buf & config_interrupt_vi_mask[altair_vi_level]) : 
+                        (altair_interrupts_buf & config_interrupt_mask));
+
   // Determine the opcode to put on the data bus (if VI enabled).
   // Must do this before calling altair_interrupt_disable, otherwise
   // the INT_VECTOR flag is cleared already
@@ -1455,6 +1570,9 @@ static byte altair_interrupt_handler()
 
   // disable interrupts now
   altair_interrupt_disable();
+  PROFILE_CALLS_INTERRUPT();
+  PROFILE_TRACE_INTERRUPT();
+  PROFILE_COUNT_METRIC(interrupts);
 
   if( host_read_status_led_WAIT() )
     {
@@ -1545,8 +1663,8 @@ byte altair_read_sense_switches(byte port)
 #if STANDALONE>0
   data = dswitch / 256;
 #else
-  static unsigned long debounceTimeout = 0;
-  static byte debounceVal = 0;
+  static MACHINE_STATE unsigned long debounceTimeout = 0;
+  static MACHINE_STATE byte debounceVal = 0;
   if( millis()>debounceTimeout )
     {
       data = host_read_sense_switches();
@@ -1731,10 +1849,15 @@ void setup()
   host_set_status_led_WAIT();
   reset(false);
 
+#ifdef HOST_HAS_BATCH_MODE
+  // load/start programs according to command line (may leave WAIT mode)
+  host_batch_setup();
+#endif
+
   if( config_serial_panel_enabled() ) Serial.print(F("\033[2J\033[14B\r\n"));
 
   uint16_t a = mem_get_rom_autostart_address();
-  if( a!=0xFFFF )
+  if( a!=0xFFFF && host_read_status_led_WAIT() )
     {
       regPC = a;
       host_clr_status_led_WAIT();
@@ -1768,6 +1891,7 @@ void loop()
         throttle_delay = (uint16_t) (config_throttle() * HOST_PERFORMANCE_FACTOR);
 #endif
 
+      PROFILE_HOST_BEGIN(PROF_HOST_LOOP);
       while( true )
         {
           // put PC on address bus LEDs
@@ -1799,14 +1923,16 @@ void loop()
           else
             {
               // no interrupt => read opcode, put it on data bus LEDs and advance PC
+              PROFILE_COUNT_PC(regPC);
+              PROFILE_COVER_EXEC(regPC);
 
 #if USE_REAL_MREAD_TIMING>0
               host_set_status_led_M1();
-              opcode = MEM_READ(regPC);
+              opcode = MEM_FETCH(regPC);
 #else
               host_set_status_leds_READMEM_M1();
               host_set_addr_leds(regPC);
-              opcode = MREAD(regPC);
+              opcode = MFETCH(regPC);
               host_set_data_leds(opcode);
 #endif
               regPC++;
@@ -1819,6 +1945,9 @@ void loop()
 
           // take a CPU step
           PROFILE_COUNT_OPCODE(opcode);
+          PROFILE_COUNT_INSTRUCTION();
+          PROFILE_COUNT_CALLS(opcode);
+          PROFILE_TRACE(opcode);
           CPU_EXEC(opcode);
 
           // check for breakpoint hit
@@ -1831,10 +1960,17 @@ void loop()
 #endif
         }
 
+      PROFILE_HOST_END();
+
 #if USE_THROTTLE>0
       timer_stop(TIMER_THROTTLE);
 #endif
 
+#ifdef HOST_HAS_BATCH_MODE
+      // in batch mode the simulator exits when the CPU stops
+      host_batch_cpu_stopped();
+#endif
+
       // flush any characters stuck in the serial buffer 
       // (so we don't accidentally execute commands after stopping)
       if( config_serial_input_enabled() ) empty_input_buffer();
@@ -1858,7 +1994,7 @@ void loop()
   if( altair_interrupts & INT_DEVICE )
     { opcode = altair_interrupt_handler(); }
   else
-    { opcode = MEM_READ(regPC); regPC++; }
+    { PROFILE_COUNT_PC(regPC); PROFILE_COVER_EXEC(regPC); opcode = MEM_FETCH(regPC); regPC++; }
 
 #if USE_Z80!=0
   // when emulating Z80 we need to increment the R register at each instruction fetch
@@ -1869,6 +2005,9 @@ void loop()
   if( !(cswitch & BIT(SW_RESET)) ) 
     {
       PROFILE_COUNT_OPCODE(opcode);
+      PROFILE_COUNT_INSTRUCTION();
+      PROFILE_COUNT_CALLS(opcode);
+      PROFILE_TRACE(opcode);
       CPU_EXEC(opcode);
       
       // if the PC has not changed (e.g. jump to the same address) then modify p_regPC 
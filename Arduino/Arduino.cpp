@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <string>
 #include <iostream>
+#include <atomic>
 #include <sys/timeb.h>
 using namespace std;
 
@@ -98,6 +99,8 @@ int EnableANSI()
 #include <ncurses.h>
 #include <termios.h>
 #include <unistd.h>
+#include <sys/time.h>
+#include <pthread.h>
 
 #define _getch   getch
 #define _ungetch ungetch
@@ -145,7 +148,17 @@ unsigned long millis()
 
 unsigned long micros()
 {
-  return millis()*1000;
+#ifdef _WIN32
+  static LARGE_INTEGER freq = {0};
+  LARGE_INTEGER cnt;
+  if( freq.QuadPart==0 ) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&cnt);
+  return (unsigned long) ((cnt.QuadPart / freq.QuadPart) * 1000000 + ((cnt.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (unsigned long) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
 }
 
 
@@ -162,23 +175,68 @@ void delay(unsigned long i)
 static bool kbhit_prev_result = false;
 static unsigned long kbhit_next_check = 0;
 
-void SerialClass::flush() { cout << std::flush; }
-char SerialClass::peek() { if( _kbhit() ) { char c =  _getch(); _ungetch(c); return c; } else return 0; }
+// in batch mode ("-b" command line option) the console is not a terminal:
+// output goes unmodified to stdout and input is handled in host_pc.cpp
+bool g_batch = false;
+
+// Console output is collected in a buffer (with newline and backspace
+// translation already applied) and written out when the buffer is full or
+// flush() is called. host_pc.cpp flushes shortly after output stops and
+// whenever the simulator waits for console input. Only the simulation
+// thread of machine 0 writes to the console.
+static char   console_buf[4096];
+static size_t console_len = 0;
+
+void SerialClass::flush() 
+{
+  if( console_len>0 ) { cout.write(console_buf, console_len); console_len = 0; }
+  cout << std::flush; 
+}
+
+static void console_flush_at_exit() { Serial.flush(); }
+
+char SerialClass::peek() { if( !g_batch && _kbhit() ) { char c =  _getch(); _ungetch(c); return c; } else return 0; }
 int  SerialClass::availableForWrite() { return 1; }
-int  SerialClass::available() { return _kbhit(); }
 
-#ifdef _WIN32
-size_t SerialClass::write(uint8_t c) { cout << (c==127 ? string("\b \b") : string(1,(char) c)) << std::flush; return 1; }
-#else
-size_t SerialClass::write(uint8_t c) { cout << (c=='\n' ? "\r\n" : (c==127 ? "\b \b" : string(1,c))) << std::flush; return 1; }
+// also called by the input thread (host_pc.cpp) so must not touch the
+// output buffer, which belongs to the simulation thread
+int  SerialClass::available() { return g_batch ? 0 : _kbhit(); }
+
+size_t SerialClass::write(const uint8_t *buf, size_t size)
+{
+  for(size_t i=0; i<size; i++)
+    {
+      // leave room for the longest translation ("\b \b")
+      if( console_len+3 > sizeof(console_buf) ) flush();
+
+      uint8_t c = buf[i];
+      if( g_batch )
+        console_buf[console_len++] = c;
+#ifndef _WIN32
+      else if( c=='\n' )
+        { console_buf[console_len++] = '\r'; console_buf[console_len++] = '\n'; }
 #endif
+      else if( c==127 )
+        { memcpy(console_buf+console_len, "\b \b", 3); console_len += 3; }
+      else
+        console_buf[console_len++] = c;
+    }
+
+  return size;
+}
+
+
+size_t SerialClass::write(uint8_t c) 
+{
+  return write(&c, 1);
+}
 
 
 char SerialClass::read()
 {
   kbhit_prev_result = false;
   kbhit_next_check  = 0;
-  if( _kbhit() )
+  if( !g_batch && _kbhit() )
     {
 #ifdef _WIN32
       return _getch();
@@ -196,29 +254,154 @@ char SerialClass::read()
 int    g_argc;
 char **g_argv;
 
+// number of simulated machines and number of machine running in this thread
+int g_num_machines = 1;
+MACHINE_STATE int g_machine = 0;
+
 void setup();
 void loop();
+
+
+struct MachineEntry
+{
+  std::atomic<uint32_t> requests;
+  std::atomic<bool>     exit_done;
+};
+
+static struct MachineEntry *machines = NULL;
+static void (*machine_exit_handler)() = NULL;
+static std::atomic<bool> machine_exiting(false);
+
+
+void machine_set_exit_handler(void (*f)())
+{
+  // the same handler is used by all machines
+  machine_exit_handler = f;
+}
+
+
+void machine_request(int machine, uint32_t req)
+{
+  if( machine>=0 && machine<g_num_machines )
+    machines[machine].requests |= req;
+}
+
+
+static void machine_run_exit_handler()
+{
+  if( !machines[g_machine].exit_done )
+    {
+      if( machine_exit_handler ) machine_exit_handler();
+      machines[g_machine].exit_done = true;
+    }
+}
+
+
+static void machine_halt()
+{
+  // wait for the process to terminate
+  while( true ) delay(1000);
+}
+
+
+void machine_poll()
+{
+  if( machines[g_machine].requests.load(std::memory_order_relaxed) & MACHINE_REQ_EXIT )
+    {
+      machine_run_exit_handler();
+      machine_halt();
+    }
+}
+
+
+void machine_exit(int status)
+{
+  machine_run_exit_handler();
+
+  // if another machine is already terminating the process then just wait
+  if( machine_exiting.exchange(true) ) machine_halt();
+
+  for(int i=0; i<g_num_machines; i++)
+    if( i!=g_machine )
+      machine_request(i, MACHINE_REQ_EXIT);
+
+  unsigned long t = millis();
+  for(int i=0; i<g_num_machines; i++)
+    while( !machines[i].exit_done && millis()-t < 2000 )
+      delay(1);
+
+  exit(status);
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI machine_thread(void *data)
+#else
+static void *machine_thread(void *data)
+#endif
+{
+  g_machine = (int) (intptr_t) data;
+  setup();
+  while(1) loop();
+  return 0;
+}
+
+
 int main(int argc, char **argv)
 {
   g_argc = argc;
   g_argv = argv;
 
+  // "-n N" runs N independent machines, each within its own thread.
+  // Machine 0 uses the console, all others are only reachable via
+  // their serial client ports (see host_pc.cpp)
+  for(int i=1; i<argc; i++)
+    if( strcmp(argv[i], "-n")==0 && i+1<argc )
+      {
+        g_num_machines = atoi(argv[i+1]);
+        if( g_num_machines<1 ) g_num_machines = 1;
+      }
+    else if( strcmp(argv[i], "-b")==0 )
+      g_batch = true;
+
+  // no terminal handling in batch mode
+  if( !g_batch )
+    {
 #ifdef _WIN32
 #ifndef __MINGW32__
-  // enable ANSI mode in Windows
-  EnableANSI();
+      // enable ANSI mode in Windows
+      EnableANSI();
+#endif
+#else
+      // initialize ncurses library
+      initscr();
+      scrollok(stdscr, TRUE);
+      nodelay(stdscr, TRUE);
+      cbreak();
+      noecho();
+      getch();
+      atexit(ncurses_exit);
 #endif
+    }
+
+  machines = new MachineEntry[g_num_machines];
+  for(int i=0; i<g_num_machines; i++)
+    { machines[i].requests = 0; machines[i].exit_done = false; }
+
+  // registered after ncurses_exit so buffered output is written before
+  // the terminal is restored
+  atexit(console_flush_at_exit);
+
+  for(int i=1; i<g_num_machines; i++)
+    {
+#ifdef _WIN32
+      DWORD id;
+      CreateThread(0, 0, machine_thread, (void *) (intptr_t) i, 0, &id);
 #else
-  // initialize ncurses library
-  initscr();
-  scrollok(stdscr, TRUE);
-  nodelay(stdscr, TRUE);
-  cbreak();
-  noecho();
-  getch();
-  atexit(ncurses_exit);
+      pthread_t id;
+      pthread_create(&id, NULL, machine_thread, (void *) (intptr_t) i);
 #endif
+    }
 
-  setup();
-  while(1) loop();
+  machine_thread((void *) 0);
 }
@@ -37,6 +37,37 @@
 #undef CPU_AND
 #undef CPU_OR
 
+// All simulator state is thread-local so several independent machines
+// can run in one process (see "-n" command line option in Arduino.cpp).
+// Only plain data may be declared with MACHINE_STATE.
+// This deliberately avoids passing a machine context structure through
+// the CPU cores and devices: the code is shared with the Arduino hosts,
+// where MACHINE_STATE is empty and globals are accessed directly.
+// The price is that every thread of the process (including the serial
+// I/O and metrics threads) gets its own copy of the state, including
+// the 64k of emulated memory, and that a machine's state can only be
+// reached from that machine's own thread (see machine_request below).
+#ifdef _MSC_VER
+#define MACHINE_STATE __declspec(thread)
+#else
+#define MACHINE_STATE __thread
+#endif
+
+// Machine registry. Since a machine's state is only accessible from its
+// own thread, other threads post requests which the machine carries out
+// the next time it calls machine_poll() (host_check_interrupts does).
+#define MACHINE_REQ_EXIT 0x01  // run the exit handler, then halt the thread
+
+extern int g_num_machines;
+extern MACHINE_STATE int g_machine;
+void machine_set_exit_handler(void (*f)());
+void machine_request(int machine, uint32_t req);
+void machine_poll();
+
+// runs the exit handler of all machines (each within its own thread,
+// waiting at most 2 seconds for them) and then terminates the process
+void machine_exit(int status);
+
 unsigned long millis();
 unsigned long micros();
 void delay(unsigned long n);
@@ -49,13 +80,14 @@ class SerialClass : Stream
  public:
 
   size_t write(uint8_t c);
+  size_t write(const uint8_t *buf, size_t size);
   char read();
   int  available();
   int  availableForWrite();
   char peek();
   void flush();
 
-  using Print::write; // pull in write(str) and write(buf, size) from Print
+  using Print::write; // pull in write(str) from Print
 
   void begin(int i)     {}
   void setTimeout(int t) {}
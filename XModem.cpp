@@ -17,8 +17,10 @@
 // Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
 // -----------------------------------------------------------------------------
 
+#include <Arduino.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "XModem.h"
 #ifdef UTEST
@@ -28,12 +30,48 @@ const unsigned char XModem::NACK = 21;
 const unsigned char XModem::ACK =  6;
 
 const unsigned char XModem::SOH =  1;
+const unsigned char XModem::STX =  2;
 const unsigned char XModem::EOT =  4;
 const unsigned char XModem::CAN =  0x18;
 
 const int XModem::receiveDelay=7000;
 const int XModem::rcvRetryLimit = 10;
 
+//CRC-16/CCITT (polynomial 0x1021), one table lookup per byte
+static const unsigned short crc16_table[256] PROGMEM = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
 
 
 
@@ -42,18 +80,24 @@ XModem::XModem(int (*recvChar)(int msDelay),
 {
 	this->sendData = sendData;
 	this->recvChar = recvChar;
+	this->recvData = NULL;
 	this->dataHandler = NULL;
 	
 }
 XModem::XModem(int (*recvChar)(int msDelay),
                void (*sendData)(const char *data, int len),
-               bool (*dataHandler)(unsigned long number, char *buffer, int len))
+               int (*dataHandler)(unsigned long offset, char *buffer, int len))
 {
 	this->sendData = sendData;
 	this->recvChar = recvChar;
+	this->recvData = NULL;
 	this->dataHandler = dataHandler;
 	
 }
+void XModem::setBulkReceive(int (*recvData)(char *buffer, int len, int msDelay))
+{
+	this->recvData = recvData;
+}
 
 bool XModem::dataAvail(int delay)
 {
@@ -88,7 +132,7 @@ bool XModem::receiveFrameNo()
 		(unsigned char)this->dataRead(XModem::receiveDelay);
 	this->repeatedBlock = false;
 	//check for repeated block
-	if (invnum == (255-num) && num == this->blockNo-1) {
+	if (invnum == (255-num) && num == (unsigned char)(this->blockNo-1)) {
 		this->repeatedBlock = true;
 		return true;	
 	}
@@ -98,25 +142,34 @@ bool XModem::receiveFrameNo()
 	else
 		return true;
 }
-bool XModem::receiveData()
+bool XModem::receiveData(int len)
 {
-	for(int i = 0; i < 128; i++) {
-		int byte = this->dataRead(XModem::receiveDelay);
-		if(byte != -1)
-			this->buffer[i] = (unsigned char)byte;
-		else
-			return false;
+	int i = 0;
+	while (i < len) {
+		if (this->recvData != NULL && this->byte == -1) {
+			//read as much of the frame as is available at once
+			int n = this->recvData(this->buffer+i, len-i, XModem::receiveDelay);
+			if (n <= 0)
+				return false;
+			i += n;
+		} else {
+			int byte = this->dataRead(XModem::receiveDelay);
+			if(byte != -1)
+				this->buffer[i++] = (unsigned char)byte;
+			else
+				return false;
+		}
 	}
 	return true;	
 }
-bool XModem::checkCrc()
+bool XModem::checkCrc(int len)
 {
 	unsigned short frame_crc = ((unsigned char)this->
 				dataRead(XModem::receiveDelay)) << 8;
 	
 	frame_crc |= (unsigned char)this->dataRead(XModem::receiveDelay);
 	//now calculate crc on data
-	unsigned short crc = this->crc16_ccitt(this->buffer, 128);
+	unsigned short crc = this->crc16_ccitt(this->buffer, len);
 	
 	if(frame_crc != crc)
 		return false;
@@ -124,15 +177,12 @@ bool XModem::checkCrc()
 		return true;
 	
 }
-bool XModem::checkChkSum()
+bool XModem::checkChkSum(int len)
 {
 	unsigned char frame_chksum = (unsigned char)this->
 						dataRead(XModem::receiveDelay);
 	//calculate chksum
-	unsigned char chksum = 0;
-	for(int i = 0; i< 128; i++) {
-		chksum += this->buffer[i];
-	}
+	unsigned char chksum = this->generateChkSum(this->buffer, len);
 	if(frame_chksum == chksum)
 		return true;
 	else
@@ -148,14 +198,18 @@ bool XModem::sendNack()
 		return false;
 	
 }
-bool XModem::receiveFrames(transfer_t transfer)
+bool XModem::receiveFrames(transfer_t transfer, bool ymodem)
 {
 	this->blockNo = 1;
-	this->blockNoExt = 1;
+	this->offset = 0;
 	this->retries = 0;
 	while (1) {
-		char cmd = this->dataRead(1000);
+		int cmd = this->dataRead(1000);
+		int len = 128;
 		switch(cmd){
+			case XModem::STX:
+				//XMODEM-1K frame
+				len = 1024;
 			case XModem::SOH:
 				if (!this->receiveFrameNo()) {
 					if (this->sendNack())
@@ -163,7 +217,7 @@ bool XModem::receiveFrames(transfer_t transfer)
 					else
 						return false;
 				}
-				if (!this->receiveData()) {	
+				if (!this->receiveData(len)) {	
 					if (this->sendNack())
 						break;
 					else
@@ -171,14 +225,14 @@ bool XModem::receiveFrames(transfer_t transfer)
 					
 				};
 				if (transfer == Crc) {
-					if (!this->checkCrc()) {
+					if (!this->checkCrc(len)) {
 						if (this->sendNack())
 							break;
 						else
 							return false;
 					}
 				} else {
-					if(!this->checkChkSum()) {
+					if(!this->checkChkSum(len)) {
 						if (this->sendNack())
 							break;
 						else
@@ -187,21 +241,32 @@ bool XModem::receiveFrames(transfer_t transfer)
 				}
 				//callback
 				if(this->dataHandler != NULL && 
-				   this->repeatedBlock == false)
-					if(!this->dataHandler(this->blockNoExt, 
-							  this->buffer, 128)) {
+				   this->repeatedBlock == false) {
+					//YMODEM: do not store the padding after the end of the file
+					int n = len;
+					if (ymodem && this->fileSize != 0xFFFFFFFF)
+						n = this->offset >= this->fileSize ? 0 :
+							(int) min((unsigned long) len, this->fileSize - this->offset);
+					if(n > 0 && this->dataHandler(this->offset, this->buffer, n) != n)
 						return false;
-					}
+				}
 				//ack
 				this->dataWrite(XModem::ACK);
 				if(this->repeatedBlock == false)
 				{
 					this->blockNo++;
-					this->blockNoExt++;
+					this->offset += len;
 				}
                                 this->retries = 0;
 				break;
 			case XModem::EOT:
+				//YMODEM: the first EOT is answered with NACK, 
+				//the sender then repeats it
+				if (ymodem) {
+					this->dataWrite(XModem::NACK);
+					if (this->dataRead(XModem::receiveDelay) != XModem::EOT)
+						return false;
+				}
 				this->dataWrite(XModem::ACK);
 				return true;
 			case XModem::CAN:
@@ -217,6 +282,12 @@ bool XModem::receiveFrames(transfer_t transfer)
 				this->dataWrite(XModem::CAN);
 				this->dataWrite(XModem::CAN);
 				return false;
+			case -1:
+				//timeout - request the frame again
+				if (this->sendNack())
+					break;
+				else
+					return false;
 			default:
 				//something wrong
 				this->dataWrite(XModem::CAN);
@@ -231,6 +302,7 @@ void XModem::init()
 {
 	//set preread byte  	
 	this->byte = -1;
+	this->fileSize = 0xFFFFFFFF;
 }
 bool XModem::receive()
 {
@@ -240,29 +312,83 @@ bool XModem::receive()
 	{
 		this->dataWrite('C');	
 		if (this->dataAvail(1000)) 
-			return receiveFrames(Crc);
+			return receiveFrames(Crc, false);
 	
 	}
 	for (int i =0; i <  128; i++)
 	{
 		this->dataWrite(XModem::NACK);	
 		if (this->dataAvail(1000)) 
-			return receiveFrames(ChkSum);
+			return receiveFrames(ChkSum, false);
 	}
   return false;
 }
-unsigned short XModem::crc16_ccitt(char *buf, int size)
+bool XModem::receiveBatch(bool (*fileHandler)(char *name, unsigned long *size))
 {
-	unsigned short crc = 0;
-	while (--size >= 0) {
-		int i;
-		crc ^= (unsigned short) *buf++ << 8;
-		for (i = 0; i < 8; i++)
-			if (crc & 0x8000)
-				crc = crc << 1 ^ 0x1021;
-			else
-				crc <<= 1;
+	this->init();
+	
+	while (1) {
+		//request the header (block 0) of the next file
+		int i, len = 128;
+		for (i = 0; i < 128; i++) {
+			this->dataWrite('C');
+			if (this->dataAvail(1000))
+				break;
+		}
+		if (i == 128)
+			return false;
+
+		this->blockNo = 0;
+		this->retries = 0;
+		while (1) {
+			int cmd = this->dataRead(1000);
+			len = cmd == XModem::STX ? 1024 : 128;
+			if (cmd == XModem::CAN)
+				return false;
+			if ((cmd == XModem::SOH || cmd == XModem::STX) && 
+			    this->receiveFrameNo() && this->receiveData(len) && this->checkCrc(len))
+				break;
+			if (!this->sendNack())
+				return false;
+		}
+
+		//header: file name, NUL, file size (decimal) and optional further fields.
+		//An empty file name ends the batch.
+		char *name = this->buffer;
+		name[len] = 0;
+		if (name[0] == 0) {
+			this->dataWrite(XModem::ACK);
+			return true;
+		}
+
+		unsigned long size = 0xFFFFFFFF;
+		char *p = name + strlen(name) + 1;
+		if (p < this->buffer+len && *p >= '0' && *p <= '9')
+			size = strtoul(p, NULL, 10);
+		if (!fileHandler(name, &size)) {
+			this->dataWrite(XModem::CAN);
+			this->dataWrite(XModem::CAN);
+			this->dataWrite(XModem::CAN);
+			return false;
+		}
+		this->dataWrite(XModem::ACK);
+
+		//request the file data
+		this->fileSize = size;
+		for (i = 0; i < XModem::rcvRetryLimit; i++) {
+			this->dataWrite('C');
+			if (this->dataAvail(XModem::receiveDelay))
+				break;
+		}
+		if (i == XModem::rcvRetryLimit || !this->receiveFrames(Crc, true))
+			return false;
 	}
+}
+unsigned short XModem::crc16_ccitt(const char *buf, int size)
+{
+	unsigned short crc = 0;
+	while (--size >= 0)
+		crc = (crc << 8) ^ pgm_read_word(&crc16_table[((crc >> 8) ^ (unsigned char) *buf++) & 0xff]);
 	return crc;
 }
 unsigned char XModem::generateChkSum(const char *buf, int len)
@@ -276,34 +402,69 @@ unsigned char XModem::generateChkSum(const char *buf, int len)
 	
 }
 
-bool XModem::transmitFrames(transfer_t transfer)
+bool XModem::transmitFrame(int cmd, int len, transfer_t transfer)
+{
+	//SOH or STX
+	buffer[0] = cmd;
+	//frame number
+	buffer[1] = this->blockNo;
+	//inv frame number
+	buffer[2] = (unsigned char)(255-(this->blockNo));
+	//(data is already in buffer starting at byte 3)
+	//checksum or crc
+	int n = 3+len;
+	if (transfer == ChkSum) {
+		buffer[n++] = this->generateChkSum(buffer+3, len);
+	} else {
+		unsigned short crc;
+		crc = this->crc16_ccitt(this->buffer+3, len);
+		buffer[n++] = (unsigned char)(crc >> 8);
+		buffer[n++] = (unsigned char)(crc);
+	}
+
+	for (this->retries = 0; this->retries < XModem::rcvRetryLimit; this->retries++)
+	{
+		this->sendData(buffer, n);
+
+		//wait ACK (next frame), NACK (resend) or CAN
+		int ret = this->dataRead(XModem::receiveDelay);
+		if (ret == XModem::ACK)
+			return true;
+		else if (ret == XModem::CAN)
+			return false;
+	}
+	return false;
+}
+bool XModem::transmitFrames(transfer_t transfer, bool use1k)
 {
 	this->blockNo = 1;
-	this->blockNoExt = 1;
+	this->offset = 0;
 	// use this only in unit tetsing
 	//memset(this->buffer, 'A', 128);
 	while(1)
 	{
 		//get data
+		int len = -1;
 		if (this->dataHandler != NULL)
+			len = this->dataHandler(this->offset, this->buffer+3, use1k ? 1024 : 128);
+
+		if (len == 0)
 		{
-			if( false == 
-			    this->dataHandler(this->blockNoExt, this->buffer+3, 
-			    128))
+			//end of transfer (YMODEM receivers answer 
+			//the first EOT with NACK)
+			for (this->retries = 0; this->retries < XModem::rcvRetryLimit; this->retries++)
 			{
-				//end of transfer
 				this->dataWrite(XModem::EOT);
 				//wait ACK
-				if (this->dataRead(XModem::receiveDelay) == 
-					XModem::ACK)
+				int ret = this->dataRead(XModem::receiveDelay);
+				if (ret == XModem::ACK)
 					return true;
-				else
+				else if (ret != XModem::NACK)
 					return false;
-
-			}			
-			
+			}
+			return false;
 		}
-		else
+		else if (len < 0)
 		{
 			//cancel transfer - send CAN twice
 			this->dataWrite(XModem::CAN);
@@ -315,44 +476,33 @@ bool XModem::transmitFrames(transfer_t transfer)
 			else
 				return false;
 		}
-		//SOH
-                buffer[0] = XModem::SOH;
-		//frame number
-		buffer[1] = this->blockNo;
-		//inv frame number
-		buffer[2] = (unsigned char)(255-(this->blockNo));
-		//(data is already in buffer starting at byte 3)
-		//checksum or crc
-		if (transfer == ChkSum) {
-                  buffer[3+128] = this->generateChkSum(buffer+3, 128);
-                  this->sendData(buffer, 3+128+1);
-		} else {
-                  unsigned short crc;
-                  crc = this->crc16_ccitt(this->buffer+3, 128);
-                  buffer[3+128+0] = (unsigned char)(crc >> 8);
-                  buffer[3+128+1] = (unsigned char)(crc);;
-                  this->sendData(buffer, 3+128+2);
-		}
 
-		//TO DO - wait NACK or CAN or ACK
-		int ret = this->dataRead(XModem::receiveDelay);
-		switch(ret)
-		{
-			case XModem::ACK: //data is ok - go to next chunk
-				this->blockNo++;
-				this->blockNoExt++;
-				continue;
-			case XModem::NACK: //resend data
-				continue;
-			case XModem::CAN: //abort transmision
-				return false;
+		//use a 128 byte frame if the rest fits and fill the rest
+		//of the frame with EOF (ASCII 26) characters
+		int frame = len > 128 ? 1024 : 128;
+		memset(this->buffer+3+len, 26, frame-len);
+		if (!this->transmitFrame(frame == 1024 ? XModem::STX : XModem::SOH, frame, transfer))
+			return false;
 
-		}
-	
+		this->blockNo++;
+		this->offset += len;
 	}
 	return false;
 }
-bool XModem::transmit()
+bool XModem::waitFor(unsigned char symbol)
+{
+	//give the receiver a while to get ready
+	for (int retry = 0; retry < 256; retry++)
+	{
+		int sym = this->dataRead(1000);
+		if (sym == symbol)
+			return true;
+		else if (sym == XModem::CAN)
+			return false;
+	}
+	return false;
+}
+bool XModem::transmit(bool use1k)
 {
 	int retry = 0;
 	int sym;
@@ -365,11 +515,42 @@ bool XModem::transmit()
 		{
 			sym = this->dataRead(1); //data is here - no delay
 			if(sym == 'C')	
-				return this->transmitFrames(Crc);
+				return this->transmitFrames(Crc, use1k);
 			if(sym == XModem::NACK)
-				return this->transmitFrames(ChkSum);
+				return this->transmitFrames(ChkSum, false);
 		}
 		retry++;
 	}	
 	return false;
 }
+bool XModem::transmitBatch(bool (*fileHandler)(char *name, unsigned long *size))
+{
+	this->init();
+
+	//receiver requests each header with 'C'
+	while (this->waitFor('C'))
+	{
+		char name[65];
+		unsigned long size = 0;
+		bool more = fileHandler(name, &size);
+
+		//header: file name, NUL and file size (decimal),
+		//an empty header ends the batch
+		memset(this->buffer+3, 0, 128);
+		if (more) {
+			name[64] = 0;
+			strcpy(this->buffer+3, name);
+			sprintf(this->buffer+3+strlen(name)+1, "%lu", size);
+		}
+		this->blockNo = 0;
+		if (!this->transmitFrame(XModem::SOH, 128, Crc))
+			return false;
+		if (!more)
+			return true;
+
+		//receiver requests the data with 'C'
+		if (!this->waitFor('C') || !this->transmitFrames(Crc, true))
+			return false;
+	}
+	return false;
+}
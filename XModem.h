@@ -33,46 +33,67 @@ class XModem {
 		int byte;
 		//expected block number
 		unsigned char blockNo;
-		//extended block number, send to dataHandler()
-		unsigned long blockNoExt;
+		//offset of the current block's data within the file
+		unsigned long offset;
+		//YMODEM: file size from header (0xFFFFFFFF if unknown)
+		unsigned long fileSize;
 		//retry counter for NACK
 		int retries;
-		//buffer
-		char buffer[133];
+		//buffer (header, 1024 bytes of data, crc)
+		char buffer[3+1024+2];
 		//repeated block flag
 		bool repeatedBlock;
 
 		int  (*recvChar)(int);
+		int  (*recvData)(char *buffer, int len, int msDelay);
                 void (*sendData)(const char *data, int len);
-		bool (*dataHandler)(unsigned long number, char *buffer, int len);
-		unsigned short crc16_ccitt(char *buf, int size);
+		int  (*dataHandler)(unsigned long offset, char *buffer, int len);
+		unsigned short crc16_ccitt(const char *buf, int size);
 		bool dataAvail(int delay);
 		int dataRead(int delay);
 		void dataWrite(char symbol);
 		bool receiveFrameNo(void);
-		bool receiveData(void);
-		bool checkCrc(void);
-		bool checkChkSum(void);
-		bool receiveFrames(transfer_t transfer);
+		bool receiveData(int len);
+		bool checkCrc(int len);
+		bool checkChkSum(int len);
+		bool receiveFrames(transfer_t transfer, bool ymodem);
 		bool sendNack(void);
 		void init(void);
 		
-		bool transmitFrames(transfer_t);
+		bool transmitFrame(int cmd, int len, transfer_t transfer);
+		bool transmitFrames(transfer_t, bool use1k);
+		bool waitFor(unsigned char symbol);
 		unsigned char generateChkSum(const char *buffer, int len);
 		
 	public:
 		static const unsigned char NACK;
 		static const unsigned char ACK;
 		static const unsigned char SOH;
+		static const unsigned char STX;
 		static const unsigned char EOT;
 		static const unsigned char CAN;
 	
+		// dataHandler is called with the offset of the data within the
+		// file. It returns the number of bytes read into (transmit) or
+		// written from (receive) the buffer, 0 at the end of the file
+		// and -1 on errors.
 		XModem(int (*recvChar)(int), void (*sendData)(const char *data, int len));
 		XModem(int (*recvChar)(int), void (*sendData)(const char *data, int len), 
-  			        bool (*dataHandler)(unsigned long, char*, int));
+  			        int (*dataHandler)(unsigned long, char*, int));
+
+		// optional: receive up to len bytes, waiting at most msDelay
+		// milliseconds for the first one (used for the frame data)
+		void setBulkReceive(int (*recvData)(char *buffer, int len, int msDelay));
+
+		// XMODEM, receiving accepts 128 and 1024 (XMODEM-1K) byte frames
 		bool receive();
-		bool transmit();
-		
-	
+		bool transmit(bool use1k = false);
 		
+		// YMODEM batch. fileHandler is called for each file: when receiving
+		// with name and size from the header (to open the file), when
+		// transmitting to open the next file and fill in its name (at most
+		// 64 characters) and size. It returns false to cancel (receiving)
+		// or if there are no more files (transmitting).
+		bool receiveBatch(bool (*fileHandler)(char *name, unsigned long *size));
+		bool transmitBatch(bool (*fileHandler)(char *name, unsigned long *size));
 };
@@ -21,11 +21,12 @@
 #include "numsys.h"
 #include "Altair8800.h"
 #include "cpucore.h"
+#include "profile.h"
 
 #if MAX_BREAKPOINTS > 0
 
-byte numBreakpoints = 0;
-uint16_t breakpoints[MAX_BREAKPOINTS];
+MACHINE_STATE byte numBreakpoints = 0;
+MACHINE_STATE uint16_t breakpoints[MAX_BREAKPOINTS];
 
 void break_check_do(uint16_t addr)
 {
@@ -36,6 +37,9 @@ void break_check_do(uint16_t addr)
         Serial.print(F("\n\n--- Reached breakpoint at "));
         numsys_print_word(addr);
         Serial.print(F(" ---\n\n"));
+#if USE_PROFILING_TRACE>0
+        profile_trace_breakpoint();
+#endif
         altair_interrupt(INT_SW_STOP);
       }
 }
@@ -54,6 +58,16 @@ void breakpoint_remove_last()
 }
 
 
+bool breakpoint_in_range(uint16_t addr, uint16_t len)
+{
+  for(byte b=0; b<numBreakpoints; b++)
+    if( (uint16_t) (breakpoints[b]-addr) < len )
+      return true;
+
+  return false;
+}
+
+
 void breakpoint_print()
 {
   for(byte b=0; b<numBreakpoints; b++)
@@ -12,7 +12,7 @@
 #if MAX_BREAKPOINTS > 0
 
 #include <Arduino.h>
-extern byte numBreakpoints;
+extern MACHINE_STATE byte numBreakpoints;
 void break_check_do(uint16_t addr);
 inline void breakpoint_check(uint16_t addr) { if( numBreakpoints>0 ) break_check_do(addr); }
 
@@ -20,12 +20,16 @@ void breakpoint_add(uint16_t addr);
 void breakpoint_remove_last();
 void breakpoint_print();
 
+// returns true if a breakpoint is set within addr...addr+len-1
+bool breakpoint_in_range(uint16_t addr, uint16_t len);
+
 #else
 
 #define breakpoint_check(addr) 0
 #define breakpoint_add(addr) while(0);
 #define breakpoint_remove_last() while(0);
 #define breakpoint_print() while(0);
+#define breakpoint_in_range(addr, len) false
 
 #endif
 
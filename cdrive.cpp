@@ -28,6 +28,7 @@
 #include "mem.h"
 #include "prog_tools.h"
 #include "io.h"
+#include "profile.h"
 
 #if NUM_CDRIVES == 0
 
@@ -52,7 +53,7 @@ byte cdrive_get_switches() { return 0; }
 
 #else
 
-byte cdrive_switches = (CDRIVE_SWITCH_AUTOBOOT | CDRIVE_SWITCH_ROM_DISABLE_AFTER_BOOT);
+MACHINE_STATE byte cdrive_switches = (CDRIVE_SWITCH_AUTOBOOT | CDRIVE_SWITCH_ROM_DISABLE_AFTER_BOOT);
 void cdrive_set_switches(byte switches) { cdrive_switches = switches; }
 byte cdrive_get_switches() { return cdrive_switches; }
 
@@ -97,20 +98,20 @@ static byte cdrive_get_type_id(bool maxi, bool DS, bool DD)
 }
 
 
-static byte cdrive_get_type_id(HOST_FILESYS_FILE_TYPE file, uint32_t image_file_size)
+static byte cdrive_get_type_id(byte file, uint32_t file_size)
 {
   char id[6];
 
   // attempt to identify the disk type by its type id (6 bytes starting at pos 0x0078)
-  if( host_filesys_file_seek(file, 0x78) )
-    if( host_filesys_file_read(file, 6, id)==6 )
+  if( image_file_seek(file, 0x78) )
+    if( image_file_read(file, 6, id)==6 )
       for(byte i=0; i<8; i++)
         if( strncmp(id, drive_types[i].id, 6)==0 )
           return i;
 
   // otherwise attempt to identify by file size
   for(byte i=0; i<8; i++)
-    if( image_file_size==cdrive_get_image_size(i) )
+    if( file_size==cdrive_get_image_size(i) )
       return i;
 
   // default to 8" SS SD
@@ -151,14 +152,14 @@ static byte cdrive_get_type_id(HOST_FILESYS_FILE_TYPE file, uint32_t image_file_
 #define MOTOR_TIME (8000000*2)
 
 
-static byte drive_selected = 0xff;
-static byte drive_mounted_disk[NUM_CDRIVES], drive_mounted_disk_type[NUM_CDRIVES];
-static byte drive_track, drive_sector, drive_data, drive_status, drive_flags, drive_config_flags, drive_cmd;
-static HOST_FILESYS_FILE_TYPE drive_file[NUM_CDRIVES];
-static byte drive_buffer[512];
-static uint8_t drive_current_head, drive_current_track[NUM_CDRIVES], drive_current_sector;
-static uint16_t drive_current_byte;
-static uint32_t drive_drq_timeout, drive_motor_timeout, drive_eoj_timeout;
+static MACHINE_STATE byte drive_selected = 0xff;
+static MACHINE_STATE byte drive_mounted_disk[NUM_CDRIVES], drive_mounted_disk_type[NUM_CDRIVES];
+static MACHINE_STATE byte drive_track, drive_sector, drive_data, drive_status, drive_flags, drive_config_flags, drive_cmd;
+static MACHINE_STATE byte drive_file[NUM_CDRIVES];
+static MACHINE_STATE byte drive_buffer[512];
+static MACHINE_STATE uint8_t drive_current_head, drive_current_track[NUM_CDRIVES], drive_current_sector;
+static MACHINE_STATE uint16_t drive_current_byte;
+static MACHINE_STATE uint32_t drive_drq_timeout, drive_motor_timeout, drive_eoj_timeout;
 
 
 #define DRIVE_SECTOR_LENGTH    (drive_current_track[drive_selected]==0&&drive_current_head==0 ? drive_types[drive_mounted_disk_type[drive_selected]&0xFE].sector_length : drive_types[drive_mounted_disk_type[drive_selected]].sector_length)
@@ -216,9 +217,10 @@ static void cdrive_flush()
   if( drive_current_byte>0 )
     {
       //printf("writing disk file: %04X\n", cdrive_get_file_pos());
-      host_filesys_file_seek(drive_file[drive_selected], cdrive_get_file_pos());
-      host_filesys_file_write(drive_file[drive_selected], drive_current_byte, drive_buffer);
-      host_filesys_file_flush(drive_file[drive_selected]);
+      image_file_seek(drive_file[drive_selected], cdrive_get_file_pos());
+      image_file_write(drive_file[drive_selected], drive_current_byte, drive_buffer);
+      image_file_flush(drive_file[drive_selected]);
+      PROFILE_COUNT_DISK_WRITE(PROF_DISK_CROMEMCO, drive_selected);
     }
 }
 
@@ -235,7 +237,7 @@ bool cdrive_unmount(byte drive_num)
     {
       drive_mounted_disk[drive_num] = 0;
       drive_mounted_disk_type[drive_num] = 0xff;
-      host_filesys_file_close(drive_file[drive_num]);
+      image_file_close(drive_file[drive_num]);
       cdrive_register_ports();
     }
 
@@ -268,12 +270,10 @@ bool cdrive_mount(byte drive_num, byte image_num)
       if( drive_mounted_disk[drive_num]>0 ) cdrive_unmount(drive_num);
       if( image_num>0 )
         {
-          char filename[13];
-          image_get_filename(IMAGE_CROMEMCO, image_num, filename, 13, false);
-
+          // sectors are 128 bytes (track 0) or multiples of that
           drive_mounted_disk[drive_num] = image_num;
-          drive_file[drive_num] = host_filesys_file_open(filename, true);
-          drive_mounted_disk_type[drive_num] = cdrive_get_type_id(drive_file[drive_num], host_filesys_file_size(filename));
+          drive_file[drive_num] = image_file_open(IMAGE_CROMEMCO, image_num, 128);
+          drive_mounted_disk_type[drive_num] = cdrive_get_type_id(drive_file[drive_num], image_file_size(drive_file[drive_num]));
 
           //printf("mounted disk in drive %i is type = %i: %s\n", drive_num, drive_mounted_disk_type[drive_num], drive_types[drive_mounted_disk_type[drive_num]].id);
           cdrive_register_ports();
@@ -388,9 +388,10 @@ byte cdrive_in(byte port)
                          drive_current_sector++;
 
                          //printf("reading disk file: %04X\n", cdrive_get_file_pos());
-                         host_filesys_file_seek(drive_file[drive_selected], cdrive_get_file_pos());
-                         uint32_t n = host_filesys_file_read(drive_file[drive_selected], DRIVE_SECTOR_LENGTH, drive_buffer);
+                         image_file_seek(drive_file[drive_selected], cdrive_get_file_pos());
+                         uint32_t n = image_file_read(drive_file[drive_selected], DRIVE_SECTOR_LENGTH, drive_buffer);
                          if( n<DRIVE_SECTOR_LENGTH ) memset(drive_buffer+n, 0, DRIVE_SECTOR_LENGTH-n);
+                         PROFILE_COUNT_DISK_READ(PROF_DISK_CROMEMCO, drive_selected);
                          drive_current_byte = 0;
                          drive_motor_timeout = timer_get_cycles() + MOTOR_TIME;
                        }
@@ -443,7 +444,7 @@ byte cdrive_in(byte port)
          // D1: AUTOWAIT TIMEOUT
          // D0: EOJ (end-of-job)
 
-         static byte prev = 0;
+         static MACHINE_STATE byte prev = 0;
          data = drive_flags & 0x81;
          if( (cdrive_switches & CDRIVE_SWITCH_AUTOBOOT)==0 )     data |= 0x40;
          if( (cdrive_switches & CDRIVE_SWITCH_INHIBIT_INIT)==0 ) data |= 0x10;
@@ -639,9 +640,10 @@ void cdrive_out(byte port, byte data)
                 
                 //printf("%04x: %i:READ RECORD%s %i/%i/%i\n", regPC-1, drive_selected, data & 0x10 ? "s" : "", drive_current_head, drive_current_track[drive_selected], drive_current_sector);
                 //printf("reading disk file: %04X\n", cdrive_get_file_pos());
-                host_filesys_file_seek(drive_file[drive_selected], cdrive_get_file_pos());
-                uint32_t n = host_filesys_file_read(drive_file[drive_selected], DRIVE_SECTOR_LENGTH, drive_buffer);
+                image_file_seek(drive_file[drive_selected], cdrive_get_file_pos());
+                uint32_t n = image_file_read(drive_file[drive_selected], DRIVE_SECTOR_LENGTH, drive_buffer);
                 if( n<DRIVE_SECTOR_LENGTH ) memset(drive_buffer+n, 0, DRIVE_SECTOR_LENGTH-n);
+                PROFILE_COUNT_DISK_READ(PROF_DISK_CROMEMCO, drive_selected);
                 drive_current_byte = 0;
                 drive_drq_timeout = timer_get_cycles() + (166667/DRIVE_NUM_SECTORS) * 2;
                 drive_motor_timeout = timer_get_cycles() + MOTOR_TIME;
@@ -938,6 +940,7 @@ void cdrive_setup()
     {
       drive_mounted_disk_type[i] = 0xff;
       drive_mounted_disk[i] = 0;
+      drive_file[i] = IMAGE_FILE_NONE;
     }
   
   cdrive_register_ports();
@@ -28,6 +28,7 @@
 #include "cdrive.h"
 #include "tdrive.h"
 #include "hdsk.h"
+#include "image.h"
 #include "prog.h"
 #include "dazzler.h"
 #include "sdmanager.h"
@@ -60,7 +61,7 @@
 
 
 // current configuration number
-static byte config_current = 0;
+static MACHINE_STATE byte config_current = 0;
 
 // config_flags:
 // vvvvvvvv mmmpphrt ttttRRRR dVCDIPFT
@@ -79,7 +80,7 @@ static byte config_current = 0;
 // r = real-time mode for printer
 // h = real-time mode for hard drives
 // v = config file version
-uint32_t config_flags;
+MACHINE_STATE uint32_t config_flags;
 
 
 // config_flags2:
@@ -90,7 +91,7 @@ uint32_t config_flags;
 // M    = VDM-1 memory address (6 highest bits)
 // KKK  = map VDM-1 keyboard to serial device (000=NONE, 1=SIO, 2=ACR, 3=2SIO1, 4=2SIO2, 5=2SIO3, 6=2SIO4)
 // P    = Processor (0=i8080, 1=z80)
-uint32_t config_flags2;
+MACHINE_STATE uint32_t config_flags2;
 
 
 // config_serial_settings:
@@ -102,7 +103,7 @@ uint32_t config_flags2;
 // 4444 = baud rate for fifth  host interface (see baud rates above)
 // PPP  = primary serial interface (maximum number depends on host)
 // x    = unused
-uint32_t config_serial_settings, new_config_serial_settings;
+MACHINE_STATE uint32_t config_serial_settings, new_config_serial_settings;
 
 
 // cofig_serial_settings2:
@@ -112,11 +113,11 @@ uint32_t config_serial_settings, new_config_serial_settings;
 // PP = parity         (0=none, 1=even, 2=odd)
 // S  = stop bits      (0=1, 1=2)
 // FFFFF = support XON/XOFF flow control when sending data (for all 5 host interfaces)
-uint32_t config_serial_settings2, new_config_serial_settings2;
+MACHINE_STATE uint32_t config_serial_settings2, new_config_serial_settings2;
 
 
 // config_serial_device_settings[0-5]
-// xxxxxxxx xxxxMMMR TT77UUVV CNNNBBBB
+// xxxxxxxx DDDGMMMR TT77UUVV CNNNBBBB
 // BBBB = baud rate for serial playback (see baud rates above)
 // NNN  = NULs to send after a carriage return when playing back examples
 // C    = trap CLOAD/CSAVE in extended BASIC (for CSM_ACR device only)
@@ -126,29 +127,31 @@ uint32_t config_serial_settings2, new_config_serial_settings2;
 // TT   = translate backspace to (00=off, 01=underscore, 10=autodetect, 11=delete)
 // R    = force realtime operation (use baud rate even if not using interrupts)
 // VV   = 88-SIO board version (0=rev0, 1=rev1, 2=Cromemco)
-uint32_t config_serial_device_settings[NUM_SERIAL_DEVICES];
+// G    = guest-paced input (deliver next input byte as soon as the previous one was read)
+// DDD  = character times to wait after a carriage return in guest-paced mode
+MACHINE_STATE uint32_t config_serial_device_settings[NUM_SERIAL_DEVICES];
 
 // map emulated device (SIO/2SIO etc.) to host serial port number
-byte config_serial_sim_to_host[NUM_SERIAL_DEVICES];
+MACHINE_STATE byte config_serial_sim_to_host[NUM_SERIAL_DEVICES];
 
 // masks defining which interrupts (INT_*) are at which vector interrupt levels
-uint32_t config_interrupt_vi_mask[8];
+MACHINE_STATE uint32_t config_interrupt_vi_mask[8];
 
 
 // mask defining whch interrupts (INT_*) are connected if VI board is not installed
-uint32_t config_interrupt_mask;
+MACHINE_STATE uint32_t config_interrupt_mask;
 
 
 // program to be run when AUX1 is raised
-byte config_aux1_prog;
+MACHINE_STATE byte config_aux1_prog;
 
 
 // amount of RAM installed
-uint32_t config_mem_size;
+MACHINE_STATE uint32_t config_mem_size;
 
 // status bytes for generic printer emulation
-byte config_printer_generic_status_busy;
-byte config_printer_generic_status_ready;
+MACHINE_STATE byte config_printer_generic_status_busy;
+MACHINE_STATE byte config_printer_generic_status_ready;
 
 
 // --------------------------------------------------------------------------------
@@ -403,6 +406,22 @@ bool config_serial_realtime(byte dev)
   return get_bits(config_serial_device_settings[dev], 16, 1) ? true : false;
 }
 
+bool config_serial_guest_paced(byte dev)
+{
+  return get_bits(config_serial_device_settings[dev], 20, 1) ? true : false;
+}
+
+byte config_serial_guest_paced_cr_delay(byte dev)
+{
+  return get_bits(config_serial_device_settings[dev], 21, 3);
+}
+
+void config_serial_set_guest_paced(byte dev, bool on)
+{
+  config_serial_device_settings[dev] = set_bits(config_serial_device_settings[dev], 20, 1, on ? 1 : 0);
+  serial_set_config(dev);
+}
+
 byte config_host_serial_primary()
 {
   return get_bits(config_serial_settings, 8, 3);
@@ -2250,6 +2269,146 @@ void config_edit_hdsk()
 #endif
 
 
+// --------------------------------------------------------------------------------
+
+#if defined(HOST_HAS_FILESYS) && (NUM_DRIVES>0 || NUM_CDRIVES>0 || NUM_TDRIVES>0 || NUM_HDSK_UNITS>0)
+
+static void print_overlay_session(byte session)
+{
+  if( session==IMAGE_OVERLAY_NONE )
+    Serial.print(F("off"));
+  else
+    {
+      Serial.print(F("session "));
+      if( session<16 ) Serial.print('0');
+      Serial.print(session, HEX);
+    }
+}
+
+
+static void print_overlay_status()
+{
+  print_overlay_session(image_overlay_get_session());
+  if( image_overlay_get_session()!=IMAGE_OVERLAY_NONE )
+    { Serial.print(F(", ")); Serial.print(image_overlay_num_blocks()); Serial.print(F(" modified sectors")); }
+}
+
+
+static bool config_overlay_apply(byte image_type, byte image_num, char op)
+{
+  if( image_num==0 )
+    return true;
+  else if( op=='C' )
+    return image_overlay_commit(image_type, image_num);
+  else if( op=='D' )
+    return image_overlay_discard(image_type, image_num);
+  else
+    return true;
+}
+
+
+static bool config_overlay_remount(byte session, char op)
+{
+  // overlays can only be committed or discarded while their images are
+  // closed => unmount all images (writing back cached data), apply the 
+  // operation and mount the images again (in the given overlay session)
+  byte i, j, n = 0, mounted[NUM_DRIVES+NUM_CDRIVES+NUM_TDRIVES+4*NUM_HDSK_UNITS];
+  bool ok = true;
+
+  for(i=0; i<NUM_DRIVES; i++)  { mounted[n++] = drive_get_mounted_image(i); drive_unmount(i); }
+  for(i=0; i<NUM_CDRIVES; i++) { mounted[n++] = cdrive_get_mounted_image(i); cdrive_unmount(i); }
+  for(i=0; i<NUM_TDRIVES; i++) { mounted[n++] = tdrive_get_mounted_image(i); tdrive_unmount(i); }
+  for(i=0; i<NUM_HDSK_UNITS; i++)
+    for(j=0; j<4; j++)
+      { mounted[n++] = hdsk_get_mounted_image(i, j); hdsk_unmount(i, j); }
+
+  n = 0;
+  for(i=0; i<NUM_DRIVES; i++)  ok &= config_overlay_apply(IMAGE_FLOPPY,   mounted[n++], op);
+  for(i=0; i<NUM_CDRIVES; i++) ok &= config_overlay_apply(IMAGE_CROMEMCO, mounted[n++], op);
+  for(i=0; i<NUM_TDRIVES; i++) ok &= config_overlay_apply(IMAGE_TARBELL,  mounted[n++], op);
+  for(i=0; i<4*NUM_HDSK_UNITS; i++) ok &= config_overlay_apply(IMAGE_HDSK, mounted[n++], op);
+
+  image_overlay_set_session(session);
+
+  n = 0;
+  for(i=0; i<NUM_DRIVES; i++)  { if( mounted[n]>0 ) drive_mount(i, mounted[n]); n++; }
+  for(i=0; i<NUM_CDRIVES; i++) { if( mounted[n]>0 ) cdrive_mount(i, mounted[n]); n++; }
+  for(i=0; i<NUM_TDRIVES; i++) { if( mounted[n]>0 ) tdrive_mount(i, mounted[n]); n++; }
+  for(i=0; i<NUM_HDSK_UNITS; i++)
+    for(j=0; j<4; j++)
+      { if( mounted[n]>0 ) hdsk_mount(i, j, mounted[n]); n++; }
+
+  return ok;
+}
+
+
+void config_edit_overlays()
+{
+  bool go = true;
+  byte session = image_overlay_get_session();
+
+  byte row, col, r_session, r_status, r_cmd;
+  row = 4;
+  col = 26;
+  Serial.print(F("\033[2J\033[0;0H\n"));
+
+  Serial.println(F("Configure disk image overlays\n"));
+  Serial.print(F("Overlay (s)ession/S    : ")); print_overlay_session(session); Serial.println(); r_session = row++;
+  Serial.print(F("Mounted images         : ")); print_overlay_status(); Serial.println(); r_status = row++;
+
+  Serial.println(F("\n(C)ommit overlay changes to mounted disk images"));
+  Serial.println(F("(D)iscard overlay changes of mounted disk images"));
+  Serial.println(F("\nE(x)it to main menu")); row+=5;
+  Serial.print(F("\n\nCommand: ")); r_cmd = row+2;
+
+  while( go )
+    {
+      set_cursor(r_cmd, 10);
+      while( !serial_available() ) delay(50);
+      char c = serial_read();
+      if( c>31 && c<127 ) Serial.println(c);
+
+      switch( c )
+        {
+        case 's':
+        case 'S':
+          {
+            // cycle through "off", 00, 01, ... FE
+            if( c=='s' )
+              session = session==IMAGE_OVERLAY_NONE ? 0 : session+1;
+            else
+              session = session==0 ? IMAGE_OVERLAY_NONE : session-1;
+            set_cursor(r_session, col);
+            print_overlay_session(session);
+            Serial.print(F("\033[K"));
+            break;
+          }
+
+        case 'C':
+        case 'D':
+          {
+            if( image_overlay_get_session()==IMAGE_OVERLAY_NONE ) break;
+            bool ok = config_overlay_remount(image_overlay_get_session(), c);
+            set_cursor(r_status, col);
+            print_overlay_status();
+            if( !ok ) Serial.print(F(" (error)"));
+            Serial.print(F("\033[K"));
+            break;
+          }
+
+        case 27:
+        case 'x': go = false; break;
+        }
+    }
+
+  // newly selected session takes effect for all mounted images
+  if( session!=image_overlay_get_session() )
+    config_overlay_remount(session, 0);
+}
+
+#endif
+
+
 // --------------------------------------------------------------------------------
 
 
@@ -2475,7 +2634,7 @@ void config_edit_vdm1()
 void config_edit_serial_device(byte dev)
 {
   uint32_t settings = config_serial_device_settings[dev];
-  byte row, col, r_iface, r_baud, r_force, r_nuls, r_7bits, r_ucase, r_bspace, r_traps, r_cmd, r_rev;
+  byte row, col, r_iface, r_baud, r_force, r_guest, r_crdelay, r_nuls, r_7bits, r_ucase, r_bspace, r_traps, r_cmd, r_rev;
   bool redraw = true;
 
   while( true )
@@ -2489,6 +2648,8 @@ void config_edit_serial_device(byte dev)
           Serial.print(F("\nMap to host (i)nterface    : ")); r_iface = row++; print_serial_device_mapped_to(settings); Serial.println();
           Serial.print(F("Simulated (b)aud rate      : ")); r_baud = row++; Serial.println(config_baud_rate(get_bits(settings, 0, 4)));
           Serial.print(F("(F)orce baud rate          : ")); r_force = row++; print_flag(settings, 1ul<<16, 0, 0); Serial.println();
+          Serial.print(F("(G)uest-paced input        : ")); r_guest = row++; print_flag(settings, 1ul<<20, 0, 0); Serial.println();
+          Serial.print(F("Guest-paced CR (d)elay     : ")); r_crdelay = row++; Serial.println(get_bits(settings, 21, 3));
           Serial.print(F("Example playback (N)ULs    : ")); r_nuls = row++; Serial.println(get_bits(settings, 4, 3));
           Serial.print(F("Use (7) bits               : ")); r_7bits = row++; print_serial_flag(settings, 12); Serial.println();
           Serial.print(F("Serial input (u)ppercase   : ")); r_ucase = row++; print_serial_flag(settings, 10); Serial.println();
@@ -2556,6 +2717,21 @@ void config_edit_serial_device(byte dev)
             break;
           }
 
+        case 'G': 
+          {
+            settings = toggle_bits(settings, 20, 1); 
+            print_flag(settings, 1ul<<20, r_guest, col); 
+            break;
+          }
+
+        case 'd': 
+          {
+            settings = toggle_bits(settings, 21, 3); 
+            set_cursor(r_crdelay, col); 
+            Serial.println(get_bits(settings, 21, 3));
+            break;
+          }
+
         case 'N': 
           {
             settings = toggle_bits(settings, 4, 3); 
@@ -3178,6 +3354,9 @@ void config_edit()
 #if NUM_HDSK_UNITS>0
           Serial.print(F("(H) Configure hard disks    : ")); print_hdsk_mounted(); Serial.println(); row++;
 #endif
+#if defined(HOST_HAS_FILESYS) && (NUM_DRIVES>0 || NUM_CDRIVES>0 || NUM_TDRIVES>0 || NUM_HDSK_UNITS>0)
+          Serial.print(F("(O) Disk image overlays     : ")); print_overlay_status(); Serial.println(); row++;
+#endif
 #if USE_DAZZLER>0
           Serial.print(F("(Z) Configure Dazzler       : ")); print_dazzler_mapped_to(); Serial.println(); r_dazzler = row++;
 #endif
@@ -3263,6 +3442,9 @@ void config_edit()
 #if NUM_HDSK_UNITS>0
         case 'H': config_edit_hdsk(); break;
 #endif
+#if defined(HOST_HAS_FILESYS) && (NUM_DRIVES>0 || NUM_CDRIVES>0 || NUM_TDRIVES>0 || NUM_HDSK_UNITS>0)
+        case 'O': config_edit_overlays(); break;
+#endif
 #if USE_DAZZLER>0
         case 'Z':
           config_flags2 = toggle_bits(config_flags2, 0, 3, 0, HOST_NUM_SERIAL_PORTS);
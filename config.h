@@ -11,7 +11,10 @@
 // 0 = use Intel 8080
 // 1 = use Zilog Z80  (uses 20 bytes more RAM than i8080)
 // 2 = allow switching between i8080 and z80 via configuration (uses more RAM and flash memory)
+// (may be overridden from the compiler command line, see "bench" target in Makefile)
+#ifndef USE_Z80
 #define USE_Z80 0
+#endif
 
 
 // If this is set to 1 and the host provides a file system (i.e. an SD card is connected)
@@ -26,11 +29,66 @@
 
 
 // Setting USE_PROFILING_DETAIL to 1 will (every 10 seconds) show a 
-// list of which opcodes were executed how many times (if profiling is enabled).
-// Reduces performance and uses 1k of RAM
+// list of which instructions were executed how many times and how many
+// cycles they took (if profiling is enabled).
+// Reduces performance and uses 2k of RAM (14k if Z80 support is enabled)
 #define USE_PROFILING_DETAIL 0
 
 
+// Setting USE_PROFILING_PC to 1 keeps instruction and cycle counters for each
+// address while profiling is enabled (in the configuration or by the 'O' serial
+// debugger command). Uses 512k of RAM so only useful on the PC.
+#define USE_PROFILING_PC 0
+
+
+// Setting USE_PROFILING_CALLS to 1 keeps a shadow call stack (tracking CALL, RST, RET
+// and interrupts) and counts the cycles spent in each call path while profiling
+// is enabled. The result can be written in "folded stacks" format for flame graph
+// tools ('O' serial debugger command). Uses about 160k of RAM so only useful on the PC.
+#define USE_PROFILING_CALLS 0
+
+
+// Setting USE_PROFILING_IO to 1 counts reads and writes for each I/O port
+// and measures the host time spent in the device handlers while profiling is
+// enabled. Rates are shown in the performance line and a per-port report is
+// available through the 'O' serial debugger command. On the PC, the per-port
+// counts are also published by the metrics endpoint ("-m port").
+// Not supported on the MEGA.
+#define USE_PROFILING_IO 0
+
+
+// Setting USE_PROFILING_INTERRUPTS to 1 collects histograms of the latency (in cycles)
+// between a device asserting its interrupt line and the CPU acknowledging the
+// interrupt, as well as counts of interrupts that were lost (line cleared before
+// acknowledge) or coalesced (raised again before acknowledge) while profiling is
+// enabled. The report is available through the 'O' serial debugger command.
+#define USE_PROFILING_INTERRUPTS 0
+
+
+// Setting USE_PROFILING_COVERAGE to 1 records one bit per address for each
+// executed instruction, memory read and memory write (always, independent of
+// the profiling setting). The bitmaps can be written to a file through the 'O'
+// serial debugger command or the "-v" command line option on the PC and merged
+// or used to annotate a listing with the "covtool" program. Uses 24k of RAM.
+#define USE_PROFILING_COVERAGE 0
+
+
+// Setting USE_PROFILING_TRACE to 1 records every executed instruction (address,
+// opcode bytes, registers, cycle counter, memory writes and I/O) in a ring buffer
+// while profiling is enabled. The buffer is written to a file by the 'O' serial
+// debugger command, when a breakpoint is reached or with the "-w" command line
+// option on the PC. Uses 32M of RAM so only useful on the PC.
+#define USE_PROFILING_TRACE 0
+
+
+// Setting USE_PROFILING_HOST to 1 measures the host time (using the processor's
+// time stamp counter) spent in the simulator itself: the simulation loop, timers,
+// host interrupt checks, I/O handlers, serial output and file access. The
+// breakdown is shown by the 'O' serial debugger command and printed to stderr
+// when the simulator exits. Only supported on the PC.
+#define USE_PROFILING_HOST 0
+
+
 // Enables throttling of CPU speed. This only makes sense to enable
 // on the Due since the Mega is too slow anyways and the throttling 
 // checks would only reduce performance further.
@@ -49,6 +107,18 @@
 #define NUM_DRIVES 4
 
 
+// Keeps the complete image of each mounted MITS disk in RAM (about 330k per
+// 8" disk) and writes modified sectors back to the image file when the
+// simulation stops, the disk is unmounted, the simulator exits and at
+// least once per second of simulated time. Only used on the PC, the
+// Arduino hosts do not have enough RAM.
+#if defined(_WIN32) || defined(__linux__)
+#define USE_DRIVE_CACHE 1
+#else
+#define USE_DRIVE_CACHE 0
+#endif
+
+
 // Enables support for Cromemco disk drives (maximum 4).
 // Set to 0 to disable Cromemco drive support.
 #define NUM_CDRIVES 0
@@ -65,6 +135,14 @@
 #define NUM_HDSK_UNITS 1
 
 
+// Recognizes the byte-by-byte loops that the HDSK boot loader and BIOS use
+// to move data between memory and the controller's sector buffers and
+// performs the whole transfer at once (charging the same number of CPU
+// cycles). Speeds up hard disk access considerably. Has no effect if any
+// of the per-instruction profiling options above are enabled.
+#define USE_HDSK_BULK_TRANSFER 1
+
+
 // Enables printer emulation which uses about 140 bytes of RAM.
 #define USE_PRINTER 1
 
@@ -128,6 +206,13 @@
 
 #include "Arduino.h"
 
+// Hosts that can run several simulated machines within one process
+// (Windows/Linux PC, see Arduino/Arduino.h) define MACHINE_STATE such that
+// each machine thread has its own copy of all simulator state.
+#ifndef MACHINE_STATE
+#define MACHINE_STATE
+#endif
+
 #define CF_THROTTLE     0x01
 #define CF_PROFILE      0x02
 #define CF_SERIAL_PANEL 0x04
@@ -167,11 +252,11 @@
 #define NUM_SERIAL_DEVICES 4
 #endif
 
-extern uint32_t config_flags, config_flags2;
-extern uint32_t config_serial_settings;
-extern uint32_t config_interrupt_mask;
-extern uint32_t config_interrupt_vi_mask[8];
-extern byte     config_serial_sim_to_host[NUM_SERIAL_DEVICES];
+extern MACHINE_STATE uint32_t config_flags, config_flags2;
+extern MACHINE_STATE uint32_t config_serial_settings;
+extern MACHINE_STATE uint32_t config_interrupt_mask;
+extern MACHINE_STATE uint32_t config_interrupt_vi_mask[8];
+extern MACHINE_STATE byte     config_serial_sim_to_host[NUM_SERIAL_DEVICES];
 
 void config_setup(int n = 0);
 void config_edit();
@@ -203,6 +288,9 @@ bool     config_host_serial_xonxoff(byte iface);
 
 #define  config_serial_map_sim_to_host(dev) config_serial_sim_to_host[dev]
 bool     config_serial_realtime(byte dev);
+bool     config_serial_guest_paced(byte dev);
+byte     config_serial_guest_paced_cr_delay(byte dev);
+void     config_serial_set_guest_paced(byte dev, bool on);
 uint32_t config_serial_playback_baud_rate(byte dev);
 byte     config_serial_playback_example_nuls(byte dev);
 byte     config_serial_backspace(byte dev, uint16_t PC);
@@ -0,0 +1,215 @@
+// -----------------------------------------------------------------------------
+// Altair 8800 Simulator
+// Copyright (C) 2017-2019 David Hansel
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+// -----------------------------------------------------------------------------
+
+// Tool for the coverage files written by the simulator (see USE_PROFILING_COVERAGE
+// in config.h, the "-v" option in batch mode or the 'O' serial debugger command).
+//
+// usage: covtool merge output input1 input2 ...
+//        covtool summary file
+//        covtool annotate file [listing]
+//
+//   merge     combines the coverage of several runs into one file
+//   summary   prints the executed, read and written address ranges (only
+//             instruction start addresses are marked as executed, so starts
+//             less than 4 bytes apart are combined into one executed range)
+//   annotate  prints a listing with each line prefixed by the coverage of
+//             its address: "X" executed, "R" read, "W" written, "-" none
+//
+// Listing lines must start with a hexadecimal address (optionally followed
+// by ':'), such as the disassembly shown by the 'D' serial debugger command
+// or a listing file produced by an assembler. All other lines are copied
+// unchanged. A line covers the addresses up to the address of the next
+// line (at most 16 bytes). The listing is read from stdin if not given.
+//
+// A coverage file contains three 8k bitmaps (executed, read, written).
+// Bit (a&7) of byte (a>>3) represents address a.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define COV_MAP_SIZE   0x2000
+#define COV_FILE_SIZE  (3*COV_MAP_SIZE)
+#define COV_EXEC       0
+#define COV_READ       1
+#define COV_WRITE      2
+
+
+static unsigned char coverage[COV_FILE_SIZE];
+
+
+static bool cov_get(int map, unsigned int a)
+{
+  return (coverage[map*COV_MAP_SIZE + (a>>3)] & (1<<(a&7)))!=0;
+}
+
+
+static bool read_coverage(const char *fname, unsigned char *data)
+{
+  FILE *f = fopen(fname, "rb");
+  if( f==NULL ) { fprintf(stderr, "Can not open coverage file: %s\n", fname); return false; }
+
+  size_t n = fread(data, 1, COV_FILE_SIZE, f);
+  bool eof = fgetc(f)==EOF;
+  fclose(f);
+  if( n!=COV_FILE_SIZE || !eof ) { fprintf(stderr, "Not a coverage file: %s\n", fname); return false; }
+  return true;
+}
+
+
+static int merge(int argc, char **argv)
+{
+  unsigned char data[COV_FILE_SIZE];
+  memset(coverage, 0, COV_FILE_SIZE);
+  for(int i=1; i<argc; i++)
+    {
+      if( !read_coverage(argv[i], data) ) return 1;
+      for(int j=0; j<COV_FILE_SIZE; j++) coverage[j] |= data[j];
+    }
+
+  FILE *f = fopen(argv[0], "wb");
+  if( f==NULL || fwrite(coverage, 1, COV_FILE_SIZE, f)!=COV_FILE_SIZE )
+    { fprintf(stderr, "Can not write coverage file: %s\n", argv[0]); if( f ) fclose(f); return 1; }
+
+  fclose(f);
+  return 0;
+}
+
+
+static int summary(const char *fname)
+{
+  static const char *names[3] = {"Executed", "Read", "Written"};
+  if( !read_coverage(fname, coverage) ) return 1;
+
+  for(int map=0; map<3; map++)
+    {
+      unsigned int n = 0, gap = map==COV_EXEC ? 4 : 1;
+      vector<pair<unsigned int, unsigned int> > ranges;
+      for(unsigned int a=0; a<0x10000; a++)
+        if( cov_get(map, a) )
+          {
+            if( !ranges.empty() && a-ranges.back().second<=gap )
+              ranges.back().second = a;
+            else
+              ranges.push_back(make_pair(a, a));
+            n++;
+          }
+
+      printf("%s: %u addresses in %lu ranges\n", names[map], n, (unsigned long) ranges.size());
+      for(size_t i=0; i<ranges.size(); i++)
+        printf("  %04X-%04X\n", ranges[i].first, ranges[i].second);
+    }
+
+  return 0;
+}
+
+
+static int get_address(const string &line)
+{
+  // hexadecimal address at the start of the line, followed by ':' or white space
+  size_t i = 0;
+  while( i<line.size() && (line[i]==' ' || line[i]=='\t') ) i++;
+
+  unsigned int a = 0;
+  size_t n = 0;
+  while( i+n<line.size() && isxdigit((unsigned char) line[i+n]) && n<5 )
+    {
+      char c = toupper(line[i+n]);
+      a = a*16 + (c<='9' ? c-'0' : c-'A'+10);
+      n++;
+    }
+
+  if( n!=4 || (i+n<line.size() && line[i+n]!=':' && !isspace((unsigned char) line[i+n])) )
+    return -1;
+
+  return a;
+}
+
+
+static int annotate(const char *fname, const char *listing)
+{
+  if( !read_coverage(fname, coverage) ) return 1;
+
+  FILE *f = listing ? fopen(listing, "r") : stdin;
+  if( f==NULL ) { fprintf(stderr, "Can not open listing: %s\n", listing); return 1; }
+
+  vector<string> lines;
+  vector<int> addr;
+  char buf[1024];
+  while( fgets(buf, sizeof(buf), f) )
+    {
+      string line = buf;
+      while( !line.empty() && (line[line.size()-1]=='\n' || line[line.size()-1]=='\r') ) line.erase(line.size()-1);
+      lines.push_back(line);
+      addr.push_back(get_address(line));
+    }
+  if( f!=stdin ) fclose(f);
+
+  unsigned int num_code = 0, num_exec = 0;
+  for(size_t i=0; i<lines.size(); i++)
+    {
+      if( addr[i]<0 )
+        { printf("     %s\n", lines[i].c_str()); continue; }
+
+      // the line covers all addresses up to the next line's address
+      unsigned int a = addr[i], len = 1;
+      for(size_t j=i+1; j<lines.size(); j++)
+        if( addr[j]>=0 )
+          {
+            if( addr[j]>addr[i] && addr[j]-addr[i]<=16 ) len = addr[j]-addr[i];
+            break;
+          }
+
+      bool x = cov_get(COV_EXEC, a), r = false, w = false;
+      for(unsigned int k=0; k<len; k++)
+        {
+          r |= cov_get(COV_READ,  (a+k) & 0xFFFF);
+          w |= cov_get(COV_WRITE, (a+k) & 0xFFFF);
+        }
+
+      num_code++;
+      if( x ) num_exec++;
+      printf("%c%c%c  %s\n", x ? 'X' : '-', r ? 'R' : '-', w ? 'W' : '-', lines[i].c_str());
+    }
+
+  fprintf(stderr, "%u of %u listing lines executed (%.1f%%)\n", num_exec, num_code,
+          num_code>0 ? (100.0*num_exec)/num_code : 0.0);
+  return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  if( argc>=4 && strcmp(argv[1], "merge")==0 )
+    return merge(argc-2, argv+2);
+  else if( argc==3 && strcmp(argv[1], "summary")==0 )
+    return summary(argv[2]);
+  else if( (argc==3 || argc==4) && strcmp(argv[1], "annotate")==0 )
+    return annotate(argv[2], argc==4 ? argv[3] : NULL);
+
+  fprintf(stderr, "usage: %s merge output input1 input2 ...\n", argv[0]);
+  fprintf(stderr, "       %s summary file\n", argv[0]);
+  fprintf(stderr, "       %s annotate file [listing]\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,157 @@
+// -----------------------------------------------------------------------------
+// Altair 8800 Simulator
+// Copyright (C) 2017-2019 David Hansel
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+// -----------------------------------------------------------------------------
+
+// CPU benchmark for the PC version of the simulator. Runs programs from the
+// simulator's program table (by default the CPU diagnostic and exerciser
+// which use the small CP/M BDOS stub in prog_tools.cpp for console output)
+// in batch mode until they return to CP/M (jump to 0000).
+//
+// usage: cpubench [-r runs] [-p program]... simulator...
+//   -r runs     number of repetitions for each program (default 5)
+//   -p program  name of program to run (can be given multiple times)
+//
+// Output is CSV, one line per simulator and program:
+//   simulator,program,runs,instructions,cycles,seconds_median,seconds_stddev,
+//   mips_median,mips_stddev,mhz_median,mhz_stddev
+// where "mhz" is the effective emulated clock rate (cycles per second).
+// Times are the simulator's own run time as reported in its summary line
+// (from the first executed instruction until the program stops), so process
+// start-up and shutdown are not included.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#define popen  _popen
+#define pclose _pclose
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+using namespace std;
+
+
+static double median(vector<double> v)
+{
+  sort(v.begin(), v.end());
+  size_t n = v.size();
+  return n==0 ? 0 : (n&1) ? v[n/2] : (v[n/2-1]+v[n/2])/2;
+}
+
+
+static double stddev(const vector<double> &v)
+{
+  if( v.size()<2 ) return 0;
+
+  double sum = 0, sum2 = 0;
+  for(size_t i=0; i<v.size(); i++) sum += v[i];
+  double mean = sum/v.size();
+  for(size_t i=0; i<v.size(); i++) sum2 += (v[i]-mean)*(v[i]-mean);
+  return sqrt(sum2/(v.size()-1));
+}
+
+
+// runs the program once, returns false if it did not complete
+static bool run(const string &simulator, const string &program,
+                unsigned long long *cycles, unsigned long long *instructions, double *seconds)
+{
+  // console output is discarded, the summary line (stderr) is captured
+  string cmd = simulator + " -b -p \"" + program + "\" -s 0 2>&1 >" NULL_DEVICE;
+
+  FILE *f = popen(cmd.c_str(), "r");
+  if( f==NULL ) return false;
+
+  char line[256];
+  bool ok = false;
+  while( fgets(line, sizeof(line), f) )
+    if( strncmp(line, "Reached stop address ", 21)==0 )
+      ok = sscanf(strstr(line, " after "), " after %llu cycles, %llu instructions (%lf seconds)", 
+                  cycles, instructions, seconds)==3 && *seconds>0;
+
+  return pclose(f)==0 && ok;
+}
+
+
+int main(int argc, char **argv)
+{
+  int runs = 5;
+  vector<string> programs, simulators;
+
+  for(int i=1; i<argc; i++)
+    {
+      if( strcmp(argv[i], "-r")==0 && i+1<argc )
+        runs = atoi(argv[++i]);
+      else if( strcmp(argv[i], "-p")==0 && i+1<argc )
+        programs.push_back(argv[++i]);
+      else
+        simulators.push_back(argv[i]);
+    }
+
+  if( simulators.empty() || runs<1 )
+    {
+      fprintf(stderr, "usage: %s [-r runs] [-p program]... simulator...\n", argv[0]);
+      return 1;
+    }
+
+  if( programs.empty() )
+    {
+      programs.push_back("CPU Diagnostic");
+      programs.push_back("CPU Exerciser");
+    }
+
+  printf("simulator,program,runs,instructions,cycles,seconds_median,seconds_stddev,"
+         "mips_median,mips_stddev,mhz_median,mhz_stddev\n");
+
+  int status = 0;
+  for(size_t s=0; s<simulators.size(); s++)
+    for(size_t p=0; p<programs.size(); p++)
+      {
+        vector<double> seconds, mips, mhz;
+        unsigned long long cycles = 0, instructions = 0;
+        for(int r=0; r<runs; r++)
+          {
+            double t;
+            if( !run(simulators[s], programs[p], &cycles, &instructions, &t) )
+              {
+                fprintf(stderr, "%s: \"%s\" did not complete\n", simulators[s].c_str(), programs[p].c_str());
+                status = 1;
+                break;
+              }
+
+            seconds.push_back(t);
+            mips.push_back(instructions/t/1000000.0);
+            mhz.push_back(cycles/t/1000000.0);
+          }
+
+        if( (int) seconds.size()==runs )
+          {
+            printf("%s,\"%s\",%i,%llu,%llu,%.6f,%.6f,%.3f,%.3f,%.3f,%.3f\n",
+                   simulators[s].c_str(), programs[p].c_str(), runs, instructions, cycles,
+                   median(seconds), stddev(seconds), median(mips), stddev(mips), median(mhz), stddev(mhz));
+            fflush(stdout);
+          }
+      }
+
+  return status;
+}
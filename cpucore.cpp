@@ -23,12 +23,12 @@
 #include "cpucore_i8080.h"
 
 // registers shared between i8080 and z80 implementation
-union unionAF regAF;
-union unionBC regBC;
-union unionDE regDE;
-union unionHL regHL;
-union unionPC regPCU;
-uint16_t regSP;
+MACHINE_STATE union unionAF regAF;
+MACHINE_STATE union unionBC regBC;
+MACHINE_STATE union unionDE regDE;
+MACHINE_STATE union unionHL regHL;
+MACHINE_STATE union unionPC regPCU;
+MACHINE_STATE uint16_t regSP;
 
 #if USE_Z80==0 // fixed I8080 CPU
 
@@ -43,9 +43,9 @@ void cpu_print_registers() { cpucore_z80_print_registers(); }
 #elif USE_Z80==2 // CPU is switchable
 
 
-CPUFUN cpu_opcodes[256];
-static int processor = -1;
-static int clock_KHz = 0;
+MACHINE_STATE CPUFUN cpu_opcodes[256];
+static MACHINE_STATE int processor = -1;
+static MACHINE_STATE int clock_KHz = 0;
 
 
 void cpu_setup()
@@ -21,37 +21,37 @@
 #define CPU_CLOCK_Z80   2000
 
 
-extern union unionAF
+extern MACHINE_STATE union unionAF
 {
   struct { byte A, F; };
   uint16_t AF;
 } regAF;
 
-extern union unionBC
+extern MACHINE_STATE union unionBC
 {
   struct { byte C, B; };
   uint16_t BC;
 } regBC;
 
-extern union unionDE
+extern MACHINE_STATE union unionDE
 {
   struct { byte E, D; };
   uint16_t DE;
 } regDE;
 
-extern union unionHL
+extern MACHINE_STATE union unionHL
 {
   struct { byte L, H; };
   uint16_t HL;
 } regHL;
 
-extern union unionPC
+extern MACHINE_STATE union unionPC
 {
   struct { byte L, H; };
   uint16_t PC;
 } regPCU;
 
-extern uint16_t regSP;
+extern MACHINE_STATE uint16_t regSP;
 
 #define regA  regAF.A
 #define regS  regAF.F
@@ -76,7 +76,7 @@ extern uint16_t regSP;
 #elif USE_Z80==1 
 
   // fixed Z80 CPU
-  extern byte regRL;
+  extern MACHINE_STATE byte regRL;
   #define cpu_opcodes cpucore_z80_opcodes
   #define cpu_clock_KHz()     CPU_CLOCK_Z80
   #define cpu_get_processor() PROC_Z80
@@ -84,7 +84,7 @@ extern uint16_t regSP;
 #else 
 
   // CPU is switchable
-  extern byte regRL;
+  extern MACHINE_STATE byte regRL;
   void cpu_set_processor(int processor);
   int  cpu_get_processor();
   int  cpu_clock_KHz();
@@ -92,7 +92,11 @@ extern uint16_t regSP;
 #endif
 
 typedef void (*CPUFUN)();
+#if USE_Z80==2
+extern MACHINE_STATE CPUFUN cpu_opcodes[256];
+#else
 extern CPUFUN cpu_opcodes[256];
+#endif
 #define CPU_EXEC(opcode) (cpu_opcodes[opcode])();
 
 void cpu_setup();
@@ -92,6 +92,42 @@ inline uint16_t MEM_READ_WORD(uint16_t addr)
 }
 
 
+// same as MEM_READ_WORD but for instruction operands, which are not
+// recorded as data reads in the coverage map
+inline uint16_t MEM_FETCH_WORD(uint16_t addr)
+{
+  if( host_read_status_led_WAIT() )
+    {
+      byte l, h;
+      l = MEM_READ_STEP(addr);
+      addr++;
+      h = MEM_READ_STEP(addr);
+      return l | (h * 256);
+    }
+  else
+    {
+      byte l, h;
+#if USE_REAL_MREAD_TIMING>0
+      l = MEM_FETCH(addr);
+      for(uint8_t i=0; i<5; i++) asm("NOP");
+      addr++;
+      h = MEM_FETCH(addr);
+#else
+      host_set_status_leds_READMEM();
+      host_set_addr_leds(addr);
+      l = MFETCH(addr);
+      host_set_data_leds(l);
+      for(uint8_t i=0; i<5; i++) asm("NOP");
+      addr++;
+      host_set_addr_leds(addr);
+      h = MFETCH(addr);
+#endif
+      host_set_data_leds(h);
+      return l | (h * 256);
+    }
+}
+
+
 inline void MEM_WRITE_WORD(uint16_t addr, uint16_t v)
 {
   if( host_read_status_led_WAIT() )
@@ -469,7 +505,7 @@ static void cpu_CALL()
 {
   regPC += 2;
   pushPC();
-  regPC = MEM_READ_WORD(regPC-2);
+  regPC = MEM_FETCH_WORD(regPC-2);
   TIMER_ADD_CYCLES(17);
 }
 
@@ -531,7 +567,7 @@ static void cpu_DCRM()
 
 static void cpu_ADI()
 {
-  byte opd2 = MEM_READ(regPC);
+  byte opd2 = MEM_FETCH(regPC);
   uint16_t w    = regA + opd2;
   setCarryBit(w & 0x100);
   setHalfCarryBitAdd(regA, opd2, w);
@@ -543,7 +579,7 @@ static void cpu_ADI()
 
 static void cpu_ACI()
 {
-  byte opd2 = MEM_READ(regPC);
+  byte opd2 = MEM_FETCH(regPC);
   uint16_t w    = regA + opd2;
   if(regS & PS_CARRY) w++;
   setHalfCarryBitAdd(regA, opd2, w);
@@ -556,7 +592,7 @@ static void cpu_ACI()
 
 static void cpu_SUI()
 {
-  byte opd2 = MEM_READ(regPC);
+  byte opd2 = MEM_FETCH(regPC);
   uint16_t w    = regA - opd2;
   setCarryBit(w&0x100);
   setHalfCarryBitSub(regA, opd2, w);
@@ -568,7 +604,7 @@ static void cpu_SUI()
 
 static void cpu_SBI()
 {
-  byte opd2 = MEM_READ(regPC);
+  byte opd2 = MEM_FETCH(regPC);
   uint16_t w    = regA - opd2;
   if(regS & PS_CARRY) w--;
   setHalfCarryBitSub(regA, opd2, w);
@@ -581,7 +617,7 @@ static void cpu_SBI()
 
 static void cpu_ANI()
 {
-  byte opd2 = MEM_READ(regPC);
+  byte opd2 = MEM_FETCH(regPC);
   setHalfCarryBit(regA&0x08 | opd2&0x08);
   regA &= opd2;
   setCarryBit(0);
@@ -592,7 +628,7 @@ static void cpu_ANI()
 
 static void cpu_XRI()
 {
-  regA ^= MEM_READ(regPC);
+  regA ^= MEM_FETCH(regPC);
   setCarryBit(0);
   setHalfCarryBit(0);
   setStatusBits(regA);
@@ -602,7 +638,7 @@ static void cpu_XRI()
 
 static void cpu_ORI()
 {
-  regA |= MEM_READ(regPC);
+  regA |= MEM_FETCH(regPC);
   setCarryBit(0);
   setHalfCarryBit(0);
   setStatusBits(regA);
@@ -612,7 +648,7 @@ static void cpu_ORI()
 
 static void cpu_CPI()
 {
-  byte opd2  = MEM_READ(regPC);
+  byte opd2  = MEM_FETCH(regPC);
   uint16_t w = regA - opd2;
   setCarryBit(w&0x100);
   setHalfCarryBitSub(regA, opd2, w);
@@ -754,7 +790,7 @@ static void cpu_INXSP()
 
 static void cpu_LDA()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regA = MEM_READ(addr);
   regPC += 2;
   TIMER_ADD_CYCLES(13);
@@ -772,7 +808,7 @@ CPU_LDX(DE);
 
 static void cpu_LHLD()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regL = MEM_READ(addr);
   regH = MEM_READ(addr+1);
   regPC += 2;
@@ -781,7 +817,7 @@ static void cpu_LHLD()
 
 static void cpu_LXIS()
 {
-  regSP = MEM_READ_WORD(regPC);
+  regSP = MEM_FETCH_WORD(regPC);
   regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
@@ -789,8 +825,8 @@ static void cpu_LXIS()
 #define CPU_LXI(REGH,REGL) \
   static void cpu_LXI ## REGH ## REGL() \
   { \
-    reg ## REGL = MEM_READ(regPC); \
-    reg ## REGH = MEM_READ(regPC+1); \
+    reg ## REGL = MEM_FETCH(regPC); \
+    reg ## REGH = MEM_FETCH(regPC+1); \
     regPC += 2; \
     TIMER_ADD_CYCLES(10); \
   }
@@ -824,7 +860,7 @@ CPU_LXI(H,L);
 #define CPU_MVRI(REGTO)                         \
   static void cpu_MV ## REGTO ## I()                   \
   {                                             \
-    reg ## REGTO = MEM_READ(regPC);             \
+    reg ## REGTO = MEM_FETCH(regPC);             \
     regPC++;                                    \
     TIMER_ADD_CYCLES(7);                         \
   }
@@ -910,7 +946,7 @@ CPU_MVRI(A);
 static void cpu_MVMI()
 {
   // MVI dst, M 
-  MEM_WRITE(regHL.HL, MEM_READ(regPC));
+  MEM_WRITE(regHL.HL, MEM_FETCH(regPC));
   regPC++;
   TIMER_ADD_CYCLES(10);
 }
@@ -1080,69 +1116,69 @@ static void cpu_RM()
 
 static void cpu_JMP()
 {
-  regPC = MEM_READ_WORD(regPC);
+  regPC = MEM_FETCH_WORD(regPC);
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JNZ()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_ZERO) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JZ()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_ZERO) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JNC()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_CARRY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JC()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_CARRY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JPO()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_PARITY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JPE()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_PARITY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JP()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_SIGN) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_JM()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_SIGN) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_CNZ()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_ZERO) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1152,7 +1188,7 @@ static void cpu_CNZ()
 
 static void cpu_CZ()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_ZERO) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1162,7 +1198,7 @@ static void cpu_CZ()
 
 static void cpu_CNC()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_CARRY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1172,7 +1208,7 @@ static void cpu_CNC()
 
 static void cpu_CC()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_CARRY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1182,7 +1218,7 @@ static void cpu_CC()
 
 static void cpu_CPO()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_PARITY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1192,7 +1228,7 @@ static void cpu_CPO()
 
 static void cpu_CPE()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_PARITY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1202,7 +1238,7 @@ static void cpu_CPE()
 
 static void cpu_CP()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_SIGN) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1212,7 +1248,7 @@ static void cpu_CP()
 
 static void cpu_CM()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_SIGN) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1222,7 +1258,7 @@ static void cpu_CM()
 
 static void cpu_SHLD()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   MEM_WRITE(addr,   regL);
   MEM_WRITE(addr+1u, regH);
   regPC += 2;
@@ -1237,7 +1273,7 @@ static void cpu_SPHL()
 
 static void cpu_STA()
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   MEM_WRITE(addr, regA);
   regPC += 2;
   TIMER_ADD_CYCLES(13);
@@ -1278,14 +1314,14 @@ static void cpu_XCHG()
 
 static void cpu_OUT()
 {
-  altair_out(MEM_READ(regPC), regA);
+  altair_out(MEM_FETCH(regPC), regA);
   TIMER_ADD_CYCLES(10);
   regPC++;
 }
 
 static void cpu_IN()
 {
-  regA = altair_in(MEM_READ(regPC));
+  regA = altair_in(MEM_FETCH(regPC));
   TIMER_ADD_CYCLES(10);
   regPC++;
 }
@@ -34,7 +34,7 @@
 #define PS_UNUSED20    0x20
 #define PS_UNUSED      (PS_UNUSED08 | PS_UNUSED20)
 
-extern union unionIXY
+extern MACHINE_STATE union unionIXY
 {
   struct { byte L, H; };
   uint16_t HL;
@@ -42,15 +42,41 @@ extern union unionIXY
 
 
 // additional Z80 registers
-union unionAF regAF_;
-union unionBC regBC_;
-union unionDE regDE_;
-union unionHL regHL_;
-union unionIXY regIX, regIY;
-byte regRL, regRH, regI;
+MACHINE_STATE union unionAF regAF_;
+MACHINE_STATE union unionBC regBC_;
+MACHINE_STATE union unionDE regDE_;
+MACHINE_STATE union unionHL regHL_;
+MACHINE_STATE union unionIXY regIX, regIY;
+MACHINE_STATE byte regRL, regRH, regI;
+
+// register pointers can not be kept in a static table since the
+// registers themselves are per-machine (see MACHINE_STATE)
+static inline byte *get_register(byte i)
+{
+  switch( i )
+    {
+    case 0: return &regB;
+    case 1: return &regC;
+    case 2: return &regD;
+    case 3: return &regE;
+    case 4: return &regH;
+    case 5: return &regL;
+    case 7: return &regA;
+    }
 
-byte     *registers[8]      = {&regB, &regC, &regD, &regE, &regH, &regL, NULL, &regA };
-uint16_t *registers_wide[4] = {&regBC.BC, &regDE.DE, &regHL.HL, &regSP};
+  return NULL;
+}
+
+static inline uint16_t *get_register_wide(byte i)
+{
+  switch( i )
+    {
+    case 0:  return &regBC.BC;
+    case 1:  return &regDE.DE;
+    case 2:  return &regHL.HL;
+    default: return &regSP;
+    }
+}
 
 #define setCarryBit(v) if(v) regS |= PS_CARRY; else regS &= ~PS_CARRY
 
@@ -99,6 +125,42 @@ inline uint16_t MEM_READ_WORD(uint16_t addr)
 }
 
 
+// same as MEM_READ_WORD but for instruction operands, which are not
+// recorded as data reads in the coverage map
+inline uint16_t MEM_FETCH_WORD(uint16_t addr)
+{
+  if( host_read_status_led_WAIT() )
+    {
+      byte l, h;
+      l = MEM_READ_STEP(addr);
+      addr++;
+      h = MEM_READ_STEP(addr);
+      return l | (h * 256);
+    }
+  else
+    {
+      byte l, h;
+#if USE_REAL_MREAD_TIMING>0
+      l = MEM_FETCH(addr);
+      for(uint8_t i=0; i<5; i++) asm("NOP");
+      addr++;
+      h = MEM_FETCH(addr);
+#else
+      host_set_status_leds_READMEM();
+      host_set_addr_leds(addr);
+      l = MFETCH(addr);
+      host_set_data_leds(l);
+      for(uint8_t i=0; i<5; i++) asm("NOP");
+      addr++;
+      host_set_addr_leds(addr);
+      h = MFETCH(addr);
+      host_set_data_leds(h);
+#endif
+      return l | (h * 256);
+    }
+}
+
+
 inline void MEM_WRITE_WORD(uint16_t addr, uint16_t v)
 {
   if( host_read_status_led_WAIT() )
@@ -402,7 +464,7 @@ inline uint16_t addw2(uint16_t opd1, uint16_t opd2)
 
 static void cpu_lda() /* ld a, (NNNN) */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regA = MEM_READ(addr);
   regPC += 2;
   TIMER_ADD_CYCLES(13);
@@ -410,7 +472,7 @@ static void cpu_lda() /* ld a, (NNNN) */
 
 static void cpu_sta() /* ld (NNNN), a */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   MEM_WRITE(addr, regA);
   regPC += 2;
   TIMER_ADD_CYCLES(13);
@@ -432,7 +494,7 @@ static void cpu_sta() /* ld (NNNN), a */
 
 static void cpu_lhld() /* ld hl,(NNNN) */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regL = MEM_READ(addr);
   regH = MEM_READ(addr+1);
   regPC += 2;
@@ -441,7 +503,7 @@ static void cpu_lhld() /* ld hl,(NNNN) */
 
 static void cpu_shld() /* ld (NNNN), hl */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   MEM_WRITE(addr,   regL);
   MEM_WRITE(addr+1u, regH);
   regPC += 2;
@@ -450,7 +512,7 @@ static void cpu_shld() /* ld (NNNN), hl */
 
 static void cpu_lxiSP() /* ld sp, NNNN */
 {
-  regSP = MEM_READ_WORD(regPC);
+  regSP = MEM_FETCH_WORD(regPC);
   regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
@@ -458,8 +520,8 @@ static void cpu_lxiSP() /* ld sp, NNNN */
 #define CPU_LXI(REGH,REGL) /* ld <BC,DE,HL>, NNNN */ \
   static void cpu_lxi ## REGH ## REGL()         \
   {                                             \
-    reg ## REGL = MEM_READ(regPC);              \
-    reg ## REGH = MEM_READ(regPC+1);            \
+    reg ## REGL = MEM_FETCH(regPC);              \
+    reg ## REGH = MEM_FETCH(regPC+1);            \
     regPC += 2;                                 \
     TIMER_ADD_CYCLES(10);                       \
   }
@@ -488,14 +550,14 @@ static void cpu_lxiSP() /* ld sp, NNNN */
 #define CPU_LDRI(REGTO) /* ld <b,c,d,e,h,l,a>, NN */ \
   static void cpu_ld ## REGTO ## I()            \
   {                                             \
-    reg ## REGTO = MEM_READ(regPC);             \
+    reg ## REGTO = MEM_FETCH(regPC);             \
     regPC++;                                    \
     TIMER_ADD_CYCLES(7);                        \
   }
 
 static void cpu_ldMI() /* ld (hl), NN */
 {
-  MEM_WRITE(regHL.HL, MEM_READ(regPC));
+  MEM_WRITE(regHL.HL, MEM_FETCH(regPC));
   regPC++;
   TIMER_ADD_CYCLES(10);
 }
@@ -743,35 +805,35 @@ static void cpu_cpM() /* cp (hl) */
 
 static void cpu_add() /* add a,NN */
 {
-  regA = add(regA, MEM_READ(regPC), 0);
+  regA = add(regA, MEM_FETCH(regPC), 0);
   regPC++;
   TIMER_ADD_CYCLES(7);
 }
 
 static void cpu_adc() /* adc a,NN */
 {
-  regA = add(regA, MEM_READ(regPC), regS & PS_CARRY);
+  regA = add(regA, MEM_FETCH(regPC), regS & PS_CARRY);
   regPC++;
   TIMER_ADD_CYCLES(7);
 }
 
 static void cpu_sub() /* sub a,NN */
 {
-  regA = sub(regA, MEM_READ(regPC), 0);
+  regA = sub(regA, MEM_FETCH(regPC), 0);
   regPC++;
   TIMER_ADD_CYCLES(7);
 }
 
 static void cpu_sbc() /* sbc a,NN */
 {
-  regA = sub(regA, MEM_READ(regPC), regS & PS_CARRY);
+  regA = sub(regA, MEM_FETCH(regPC), regS & PS_CARRY);
   regPC++;
   TIMER_ADD_CYCLES(7);
 }
 
 static void cpu_and() /* and NN */
 {
-  regA &= MEM_READ(regPC);
+  regA &= MEM_FETCH(regPC);
   setStatusBitsLogic(regA, PS_HALFCARRY);
   regPC++;
   TIMER_ADD_CYCLES(7);
@@ -779,7 +841,7 @@ static void cpu_and() /* and NN */
 
 static void cpu_xor() /* xor NN */
 {
-  regA ^= MEM_READ(regPC);
+  regA ^= MEM_FETCH(regPC);
   setStatusBitsLogic(regA, 0);
   regPC++;
   TIMER_ADD_CYCLES(7);
@@ -787,7 +849,7 @@ static void cpu_xor() /* xor NN */
 
 static void cpu_or() /* or NN */
 {
-  regA |= MEM_READ(regPC);
+  regA |= MEM_FETCH(regPC);
   setStatusBitsLogic(regA, 0);
   regPC++;
   TIMER_ADD_CYCLES(7);
@@ -795,7 +857,7 @@ static void cpu_or() /* or NN */
 
 static void cpu_cpi() /* cp NN */
 {
-  cp(regA, MEM_READ(regPC));
+  cp(regA, MEM_FETCH(regPC));
   regPC++;
   TIMER_ADD_CYCLES(7);
 }
@@ -1012,62 +1074,62 @@ CPU_INX(HL);
 
 static void cpu_jp() /* jp NNNN */
 {
-  regPC = MEM_READ_WORD(regPC);
+  regPC = MEM_FETCH_WORD(regPC);
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jpnz() /* jp nz, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_ZERO) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jpz() /* jp z, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_ZERO) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jpnc() /* jp nc, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_CARRY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jpc() /* jp c, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_CARRY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jppo() /* jp po, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_PARITY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jppe() /* jp pe, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_PARITY) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jpp() /* jp p, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( !(regS & PS_SIGN) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
 
 static void cpu_jpm() /* jp m, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   if( (regS & PS_SIGN) ) regPC = addr; else regPC += 2;
   TIMER_ADD_CYCLES(10);
 }
@@ -1081,14 +1143,14 @@ static void cpu_jpHL() /* jp (hl) */
 
 static void cpu_jr() /* jr NN */
 {
-  int8_t offset = MEM_READ(regPC);
+  int8_t offset = MEM_FETCH(regPC);
   regPC += offset+1;
   TIMER_ADD_CYCLES(12);
 }
 
 static void cpu_jrz() /* jr z, NN */
 {
-  int8_t offset = MEM_READ(regPC);
+  int8_t offset = MEM_FETCH(regPC);
   if( (regS & PS_ZERO) ) 
     { regPC += offset+1; TIMER_ADD_CYCLES(12); }
   else 
@@ -1097,7 +1159,7 @@ static void cpu_jrz() /* jr z, NN */
 
 static void cpu_jrnz() /* jr nz, NN */
 {
-  int8_t offset = MEM_READ(regPC);
+  int8_t offset = MEM_FETCH(regPC);
   if( !(regS & PS_ZERO) ) 
     { regPC += offset+1; TIMER_ADD_CYCLES(12); }
   else 
@@ -1106,7 +1168,7 @@ static void cpu_jrnz() /* jr nz, NN */
 
 static void cpu_jrc() /* jr c, NN */
 {
-  int8_t offset = MEM_READ(regPC);
+  int8_t offset = MEM_FETCH(regPC);
   if( (regS & PS_CARRY) ) 
     { regPC += offset+1; TIMER_ADD_CYCLES(12); }
   else 
@@ -1115,7 +1177,7 @@ static void cpu_jrc() /* jr c, NN */
 
 static void cpu_jrnc()  /* jr nc, NN */
 {
-  int8_t offset = MEM_READ(regPC);
+  int8_t offset = MEM_FETCH(regPC);
   if( !(regS & PS_CARRY) ) 
     { regPC += offset+1; TIMER_ADD_CYCLES(12); }
   else 
@@ -1124,7 +1186,7 @@ static void cpu_jrnc()  /* jr nc, NN */
 
 static void cpu_djnz() /* djnz NN */
 {
-  int8_t offset = MEM_READ(regPC);
+  int8_t offset = MEM_FETCH(regPC);
   if( --regB != 0 )
     { regPC += offset+1; TIMER_ADD_CYCLES(13); }
   else 
@@ -1136,13 +1198,13 @@ static void cpu_call() // call NNNN
 {
   regPC += 2;
   pushPC();
-  regPC = MEM_READ_WORD(regPC-2);
+  regPC = MEM_FETCH_WORD(regPC-2);
   TIMER_ADD_CYCLES(17);
 }
 
 static void cpu_cnz() /* call nz, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_ZERO) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1152,7 +1214,7 @@ static void cpu_cnz() /* call nz, NNNN */
 
 static void cpu_cz() /* call z, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_ZERO) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1162,7 +1224,7 @@ static void cpu_cz() /* call z, NNNN */
 
 static void cpu_cnc() /* call nc, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_CARRY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1172,7 +1234,7 @@ static void cpu_cnc() /* call nc, NNNN */
 
 static void cpu_cc() /* call c, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_CARRY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1182,7 +1244,7 @@ static void cpu_cc() /* call c, NNNN */
 
 static void cpu_cpo() /* call po, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_PARITY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1192,7 +1254,7 @@ static void cpu_cpo() /* call po, NNNN */
 
 static void cpu_cpe() /* call pe, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_PARITY) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1202,7 +1264,7 @@ static void cpu_cpe() /* call pe, NNNN */
 
 static void cpu_cp() /* call p, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( !(regS & PS_SIGN) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1212,7 +1274,7 @@ static void cpu_cp() /* call p, NNNN */
 
 static void cpu_cm() /* call m, NNNN */
 {
-  uint16_t addr = MEM_READ_WORD(regPC);
+  uint16_t addr = MEM_FETCH_WORD(regPC);
   regPC+=2; 
   if( (regS & PS_SIGN) ) 
     { pushPC(); regPC = addr; TIMER_ADD_CYCLES(17); }
@@ -1421,14 +1483,14 @@ static void cpu_nop() /* nop */
 
 static void cpu_out() /* out NN */
 {
-  altair_out(MEM_READ(regPC), regA);
+  altair_out(MEM_FETCH(regPC), regA);
   TIMER_ADD_CYCLES(10);
   regPC++;
 }
 
 static void cpu_in() /* in NN */
 {
-  regA = altair_in(MEM_READ(regPC));
+  regA = altair_in(MEM_FETCH(regPC));
   TIMER_ADD_CYCLES(10);
   regPC++;
 }
@@ -1549,10 +1611,10 @@ static byte cpu_bitop(byte opcode, byte *v, byte mode) // Z80 bit operations
 static void cpu_bit() // 0xCB prefix
 {
   // Z80 BIT operations
-  byte *reg, opcode = MEM_READ(regPC);
+  byte *reg, opcode = MEM_FETCH(regPC);
   byte cycles = 0;
 
-  reg = registers[opcode & 0x07];
+  reg = get_register(opcode & 0x07);
   if( reg==NULL ) 
     { 
       // read HL memory location
@@ -1580,11 +1642,11 @@ static void cpu_ixiybit(union unionIXY *regIXY) // 0xDD/0xFD 0xCB prefix
   byte m, opcode, cycles = 0, *reg;
 
   // construct indexed address
-  addr = regIXY->HL + ((int8_t) MEM_READ(regPC));
+  addr = regIXY->HL + ((int8_t) MEM_FETCH(regPC));
   regPC++;
   
   // read opcode
-  opcode = MEM_READ(regPC);
+  opcode = MEM_FETCH(regPC);
   regPC++;
 
   // read value
@@ -1598,7 +1660,7 @@ static void cpu_ixiybit(union unionIXY *regIXY) // 0xDD/0xFD 0xCB prefix
   if( opcode < 0x40 || opcode > 0x7F ) { MEM_WRITE(addr, m); cycles += 3; }
 
   // copy to register (if required)
-  reg = registers[opcode & 0x07];
+  reg = get_register(opcode & 0x07);
   if( reg!=NULL ) *reg = m;
 
   TIMER_ADD_CYCLES(cycles);
@@ -1611,7 +1673,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
   // Z80 IX/IY register instructions
   uint16_t addr, w;
   int8_t c;
-  byte b, opcode = MEM_READ(regPC);
+  byte b, opcode = MEM_FETCH(regPC);
   regPC++;
   switch(opcode)
     {
@@ -1626,13 +1688,13 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x21: // ld  ix, **
-      regIXY->HL = MEM_READ_WORD(regPC);
+      regIXY->HL = MEM_FETCH_WORD(regPC);
       regPC += 2;
       TIMER_ADD_CYCLES(14);
       break;
 
     case 0x22: // ld (**),ix
-      addr = MEM_READ_WORD(regPC);
+      addr = MEM_FETCH_WORD(regPC);
       MEM_WRITE_WORD(addr, regIXY->HL);
       regPC += 2;
       TIMER_ADD_CYCLES(20);
@@ -1654,7 +1716,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
       
     case 0x26: // ld ixh,*
-      regIXY->H = MEM_READ(regPC);
+      regIXY->H = MEM_FETCH(regPC);
       regPC += 1;
       TIMER_ADD_CYCLES(11);
       break;
@@ -1665,7 +1727,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x2A: // ld ix, (**)
-      addr = MEM_READ_WORD(regPC);
+      addr = MEM_FETCH_WORD(regPC);
       regIXY->HL = MEM_READ_WORD(addr);
       regPC += 2;
       TIMER_ADD_CYCLES(20);
@@ -1687,13 +1749,13 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
       
     case 0x2E: // ld ixl,*
-      regIXY->L = MEM_READ(regPC);
+      regIXY->L = MEM_FETCH(regPC);
       regPC += 1;
       TIMER_ADD_CYCLES(11);
       break;
 
     case 0x34: // inc (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC += 1;
       addr = regIXY->HL + c;
       b = inc(MEM_READ(addr));
@@ -1702,7 +1764,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x35: // dec (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       b = dec(MEM_READ(addr));
@@ -1711,10 +1773,10 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x36: // ld (ix+*),*
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
-      b = MEM_READ(regPC);
+      b = MEM_FETCH(regPC);
       regPC++;
       MEM_WRITE(addr, b);
       TIMER_ADD_CYCLES(19);
@@ -1736,7 +1798,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x46: // ld b, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regB = MEM_READ(addr);
@@ -1754,7 +1816,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x4E: // ld c, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regC = MEM_READ(addr);
@@ -1772,7 +1834,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x56: // ld d, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regD = MEM_READ(addr);
@@ -1790,7 +1852,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x5E: // ld e, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regE = MEM_READ(addr);
@@ -1828,7 +1890,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x66: // ld h, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regH = MEM_READ(addr);
@@ -1871,7 +1933,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x6E: // ld l, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regL = MEM_READ(addr);
@@ -1884,7 +1946,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x70: // ld (ix+*),b
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regB);
@@ -1892,7 +1954,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x71: // ld (ix+*),c
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regC);
@@ -1900,7 +1962,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x72: // ld (ix+*),d
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regD);
@@ -1908,7 +1970,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x73: // ld (ix+*),e
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regE);
@@ -1916,7 +1978,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x74: // ld (ix+*),h
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regH);
@@ -1924,7 +1986,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x75: // ld (ix+*),l
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regL);
@@ -1932,7 +1994,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x77: // ld (ix+*),a
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       MEM_WRITE(addr, regA);
@@ -1950,7 +2012,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x7E: // ld a,(ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA = MEM_READ(addr);
@@ -1968,7 +2030,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x86: // add a, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA = add(regA, MEM_READ(addr), 0);
@@ -1986,7 +2048,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x8E: // adc a, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA = add(regA, MEM_READ(addr), regS & PS_CARRY);
@@ -2004,7 +2066,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x96: // sub a, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA = sub(regA, MEM_READ(addr), 0);
@@ -2022,7 +2084,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0x9E: // sbc a, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA = sub(regA, MEM_READ(addr), regS & PS_CARRY);
@@ -2042,7 +2104,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0xA6: // and (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA &= MEM_READ(addr);
@@ -2063,7 +2125,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0xAE: // xor (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA ^= MEM_READ(addr);
@@ -2084,7 +2146,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0xB6: // or (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       regA |= MEM_READ(addr);
@@ -2103,7 +2165,7 @@ static void cpu_ixiy(union unionIXY *regIXY) // 0xDD/0xFD prefix
       break;
 
     case 0xBE: // cp a, (ix+*)
-      c = MEM_READ(regPC);
+      c = MEM_FETCH(regPC);
       regPC++;
       addr = regIXY->HL + c;
       cp(regA, MEM_READ(addr));
@@ -2167,7 +2229,7 @@ static void cpu_ext() // 0xED prefix
 {
   // Z80 extended instructions
   uint16_t addr, w;
-  byte b, *reg, cycles = 0, opcode = MEM_READ(regPC);
+  byte b, *reg, cycles = 0, opcode = MEM_FETCH(regPC);
   regPC++;
 
   switch( opcode )
@@ -2181,7 +2243,7 @@ static void cpu_ext() // 0xED prefix
     case 0x78: // in (b/c/d/e/h/l/a) (c)
       b = altair_in(regC);
       setStatusBitsLogic(b, regS & PS_CARRY);
-      reg = registers[(opcode&0x38)/8];
+      reg = get_register((opcode&0x38)/8);
       if( reg!=NULL ) *reg = b;
       TIMER_ADD_CYCLES(12);
       break;
@@ -2193,7 +2255,7 @@ static void cpu_ext() // 0xED prefix
     case 0x61:
     case 0x69:
     case 0x79: // out (c), (b/c/d/e/h/l/a)
-      reg = registers[(opcode&0x38)/8];
+      reg = get_register((opcode&0x38)/8);
       altair_out(regC, reg==NULL ? 0 : *reg);
       TIMER_ADD_CYCLES(12);
       break;
@@ -2202,7 +2264,7 @@ static void cpu_ext() // 0xED prefix
     case 0x52:
     case 0x62:
     case 0x72: // sbc (hl), (bc,de,hl,sp)
-      regHL.HL = subw(regHL.HL, *registers_wide[(opcode&0x30)/16], regS & PS_CARRY);
+      regHL.HL = subw(regHL.HL, *get_register_wide((opcode&0x30)/16), regS & PS_CARRY);
       TIMER_ADD_CYCLES(15);
       break;
 
@@ -2210,7 +2272,7 @@ static void cpu_ext() // 0xED prefix
     case 0x5A:
     case 0x6A:
     case 0x7A: // adc (hl), (bc,de,hl,sp)
-      regHL.HL = addw(regHL.HL, *registers_wide[(opcode&0x30)/16], regS & PS_CARRY);
+      regHL.HL = addw(regHL.HL, *get_register_wide((opcode&0x30)/16), regS & PS_CARRY);
       TIMER_ADD_CYCLES(15);
       break;
 
@@ -2218,9 +2280,9 @@ static void cpu_ext() // 0xED prefix
     case 0x53:
     case 0x63:
     case 0x73: // ld (**), (bc,de,hl,sp)
-      addr = MEM_READ_WORD(regPC);
+      addr = MEM_FETCH_WORD(regPC);
       regPC += 2;
-      w = *registers_wide[(opcode&0x30)/16];
+      w = *get_register_wide((opcode&0x30)/16);
       MEM_WRITE_WORD(addr, w);
       TIMER_ADD_CYCLES(20);
       break;
@@ -2229,9 +2291,9 @@ static void cpu_ext() // 0xED prefix
     case 0x5B:
     case 0x6B:
     case 0x7B: // ld (bc,de,hl,sp), (**)
-      addr = MEM_READ_WORD(regPC);
+      addr = MEM_FETCH_WORD(regPC);
       regPC += 2;
-      *registers_wide[(opcode&0x30)/16] = MEM_READ_WORD(addr);
+      *get_register_wide((opcode&0x30)/16) = MEM_READ_WORD(addr);
       TIMER_ADD_CYCLES(20);
       break;
      
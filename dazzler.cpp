@@ -60,29 +60,87 @@ void dazzler_setup() {}
 #define FEAT_KEYBAORD 0x20
 #define FEAT_FRAMEBUF 0x40
 
+#define RESYNC_CTRL   0x01
+#define RESYNC_PICT   0x02
+#define RESYNC_BUF1   0x04
+#define RESYNC_BUF2   0x08
+
 #define DEBUGLVL 0
 
-byte dazzler_iface = 0xff;
-int  dazzler_client_version = -1;
-uint16_t dazzler_client_features = 0;
-uint32_t dazzler_vsync_cycles = 0;
+MACHINE_STATE byte dazzler_iface = 0xff;
+MACHINE_STATE int  dazzler_client_version = -1;
+MACHINE_STATE uint16_t dazzler_client_features = 0;
+MACHINE_STATE uint32_t dazzler_vsync_cycles = 0;
 
-uint16_t dazzler_mem_addr1, dazzler_mem_addr2, dazzler_mem_start, dazzler_mem_end, dazzler_mem_size;
-volatile byte d7a_port[5] = {0xff, 0x00, 0x00, 0x00, 0x00};
+MACHINE_STATE uint16_t dazzler_mem_addr1, dazzler_mem_addr2, dazzler_mem_start, dazzler_mem_end, dazzler_mem_size;
+MACHINE_STATE volatile byte d7a_port[5] = {0xff, 0x00, 0x00, 0x00, 0x00};
 
+// state last sent to the client (CTRL/CTRLPIC data) and RESYNC_* flags for
+// the parts of that state which the client missed because its output
+// buffer was full
+MACHINE_STATE byte dazzler_ctrl = 0x00, dazzler_pict = 0x00, dazzler_resync = 0;
 
-static void dazzler_send(const byte *data, uint16_t size)
+
+#ifdef HOST_HAS_NONBLOCKING_SERIAL_WRITE
+static byte dazzler_resync_flag(byte cmd)
 {
-  if( dazzler_iface<0xff )
+  switch( cmd & 0xf0 )
     {
-      size_t n, ptr = 0;
-      while( size>0 )
-        {
-          n = host_serial_write(dazzler_iface, ((const char *) data)+ptr, size);
-          ptr  += n;
-          size -= (uint16_t) n;
-        }
+    case DAZ_MEMBYTE:
+    case DAZ_FULLFRAME: return (cmd & BUFFER2) ? RESYNC_BUF2 : RESYNC_BUF1;
+    case DAZ_CTRL:      return RESYNC_CTRL;
+    case DAZ_CTRLPIC:   return RESYNC_PICT;
     }
+
+  // DAC samples and the version request are not re-sent
+  return 0;
+}
+#endif
+
+
+static bool dazzler_send_ok(byte cmd, uint16_t size)
+{
+  if( dazzler_iface==0xff ) return false;
+
+#ifdef HOST_HAS_NONBLOCKING_SERIAL_WRITE
+  // never wait for the client here, if the message does not fit into the
+  // output buffer as a whole then drop it and re-send the affected state
+  // once the client has caught up (data for state which is already waiting
+  // to be re-sent is dropped too, the re-sent state includes it)
+  byte flag = dazzler_resync_flag(cmd);
+  if( (dazzler_resync & flag) || host_serial_available_for_write(dazzler_iface) < size )
+    {
+      dazzler_resync |= flag;
+      return false;
+    }
+#endif
+
+  return true;
+}
+
+
+static void dazzler_write(const byte *data, uint16_t size)
+{
+#ifdef HOST_HAS_NONBLOCKING_SERIAL_WRITE
+  // dazzler_send_ok() made sure that everything fits
+  host_serial_write(dazzler_iface, (const char *) data, size);
+#else
+  // the serial transmit buffer may be smaller than the data
+  size_t n, ptr = 0;
+  while( size>0 )
+    {
+      n = host_serial_write(dazzler_iface, ((const char *) data)+ptr, size);
+      ptr  += n;
+      size -= (uint16_t) n;
+    }
+#endif
+}
+
+
+static void dazzler_send(const byte *data, uint16_t size)
+{
+  if( dazzler_send_ok(data[0], size) )
+    dazzler_write(data, size);
 }
 
 
@@ -90,14 +148,33 @@ static void dazzler_send_fullframe(uint8_t buffer_flag, uint16_t addr)
 {
   // send full picture memory
   byte b = DAZ_FULLFRAME | buffer_flag | (dazzler_mem_size > 512 ? 1 : 0);
-  dazzler_send(&b, 1);
-  dazzler_send(Mem+addr, dazzler_mem_size > 512 ? 2048 : 512);
+  uint16_t size = dazzler_mem_size > 512 ? 2048 : 512;
+  if( dazzler_send_ok(b, 1+size) )
+    {
+      dazzler_write(&b, 1);
+      dazzler_write(Mem+addr, size);
+    }
 #if DEBUGLVL>0
   printf("dazzler_send_fullframe(%i, %04X)\n", buffer_flag, addr);
 #endif
 }
 
 
+static void dazzler_resync_client()
+{
+  byte b[2], flags = dazzler_resync;
+
+  // re-send the missed state in the order it was originally sent in, each
+  // part is only sent (and its flag cleared) if it fits as a whole so this
+  // may take several calls while the client drains its buffer
+  dazzler_resync = 0;
+  if( flags & RESYNC_CTRL ) { b[0] = DAZ_CTRL; b[1] = dazzler_ctrl; dazzler_send(b, 2); }
+  if( flags & RESYNC_PICT ) { b[0] = DAZ_CTRLPIC; b[1] = dazzler_pict; dazzler_send(b, 2); }
+  if( flags & RESYNC_BUF1 ) { if( dazzler_mem_addr1!=0xFFFF ) dazzler_send_fullframe(BUFFER1, dazzler_mem_addr1); }
+  if( flags & RESYNC_BUF2 ) { if( dazzler_mem_addr2!=0xFFFF ) dazzler_send_fullframe(BUFFER2, dazzler_mem_addr2); }
+}
+
+
 static void dazzler_send_frame(int buffer_flag, uint16_t addr_old, uint16_t addr_new)
 {
   uint8_t b[3];
@@ -170,6 +247,8 @@ void dazzler_write_mem_do(uint16_t a, byte v)
 {
   byte b[3];
 
+  if( dazzler_resync ) dazzler_resync_client();
+
 #if DEBUGLVL>2
   printf("dazzler_write_mem(%04x, %02x)\n", a, v);
 #endif
@@ -201,7 +280,7 @@ void dazzler_out_ctrl(byte v)
 
 #if DEBUGLVL>0
   {
-    static byte prev = 0xff;
+    static MACHINE_STATE byte prev = 0xff;
     if( v!=prev ) { printf("dazzler_out_ctrl(%02x)\n", v); prev = v; }
   }
 #endif
@@ -210,7 +289,7 @@ void dazzler_out_ctrl(byte v)
 
   // if client uses a framebuffer then we need to send CTRL before FULLFRAME data
   // so the client renders the data with the new properties
-  if( dazzler_client_features & FEAT_FRAMEBUF ) { b[1] = v; dazzler_send(b, 2); }
+  if( dazzler_client_features & FEAT_FRAMEBUF ) { b[1] = dazzler_ctrl = v; dazzler_send(b, 2); }
 
   // D7: 1=enabled, 0=disabled
   // D6-D0: bits 15-9 of dazzler memory address
@@ -265,7 +344,7 @@ void dazzler_out_ctrl(byte v)
   else 
     {
       // new address range, both buffers are in use => pick one to overwrite
-      static bool first = true;
+      static MACHINE_STATE bool first = true;
       if( first )
         {
           dazzler_send_frame(BUFFER1, dazzler_mem_addr1, a);
@@ -304,7 +383,7 @@ void dazzler_out_ctrl(byte v)
 
   // if client does not have a framebuffer (i.e. renders in real-time) then we can
   // send CTRL after FULLFRAME data (avoids initial short initial incorrect display)
-  if( !(dazzler_client_features & FEAT_FRAMEBUF) ) { b[1] = v; dazzler_send(b, 2); }
+  if( !(dazzler_client_features & FEAT_FRAMEBUF) ) { b[1] = dazzler_ctrl = v; dazzler_send(b, 2); }
 }
 
 
@@ -317,7 +396,7 @@ void dazzler_out_pict(byte v)
   // D3-D0: color info for x4 high res mode
 
 #if DEBUGLVL>0
-  static byte prev = 0xff;
+  static MACHINE_STATE byte prev = 0xff;
   if( v!=prev ) { printf("dazzler_out_pict(%02x)\n", v); prev = v; }
 #endif
 
@@ -329,7 +408,7 @@ void dazzler_out_pict(byte v)
 
   // if client uses a framebuffer then we need to send  CTRLPIC before FULLFRAME data
   // so the client renders the data with the new properties
-  if( dazzler_client_features & FEAT_FRAMEBUF ) { b[1] = v; dazzler_send(b, 2); }
+  if( dazzler_client_features & FEAT_FRAMEBUF ) { b[1] = dazzler_pict = v; dazzler_send(b, 2); }
 
   uint16_t s = v & 0x20 ? 2048 : 512;
   if( s > dazzler_mem_size )
@@ -348,14 +427,14 @@ void dazzler_out_pict(byte v)
 
   // if client does not have a framebuffer (i.e. renders in real-time) then we can
   // send CTRL after FULLFRAME data (avoids initial short initial incorrect display)
-  if( !(dazzler_client_features & FEAT_FRAMEBUF) ) { b[1] = v; dazzler_send(b, 2); }
+  if( !(dazzler_client_features & FEAT_FRAMEBUF) ) { b[1] = dazzler_pict = v; dazzler_send(b, 2); }
 }
 
 
 void dazzler_out_dac(byte dacnum, byte v)
 {
-  static byte     prev_sample[7] = {0, 0, 0, 0, 0, 0, 0};
-  static uint32_t prev_sample_cycles[7] = {0, 0, 0, 0, 0, 0, 0};
+  static MACHINE_STATE byte     prev_sample[7] = {0, 0, 0, 0, 0, 0, 0};
+  static MACHINE_STATE uint32_t prev_sample_cycles[7] = {0, 0, 0, 0, 0, 0, 0};
 
   if( (dazzler_client_features & FEAT_DAC) && v!=prev_sample[dacnum] )
     {
@@ -379,6 +458,8 @@ void dazzler_out_dac(byte dacnum, byte v)
 
 void dazzler_out(byte port, byte data)
 {
+  if( dazzler_resync ) dazzler_resync_client();
+
   if( port==0x0E )
     dazzler_out_ctrl(data);
   else if( port==0x0F )
@@ -399,7 +480,7 @@ inline void set_d7a_port(byte p, byte v)
 
 void dazzler_receive(byte iface, byte data)
 {
-  static byte state=0, bufdata[3];
+  static MACHINE_STATE byte state=0, bufdata[3];
 
 #if DEBUGLVL>1
   Serial.print("dazzler_receive: "); Serial.println(data, HEX);
@@ -498,6 +579,10 @@ byte dazzler_in(byte port)
 {
   byte v = 0;
 
+  // programs usually poll the VSYNC/joystick ports so this is where
+  // we catch up if the client missed state while no output happened
+  if( dazzler_resync ) dazzler_resync_client();
+
   if( port==0x0e )
     {
       // the values here are approximated and certainly not
@@ -575,7 +660,7 @@ void dazzler_register_ports()
 
 void dazzler_set_iface(byte iface)
 {
-  static host_serial_receive_callback_tp fprev = NULL;
+  static MACHINE_STATE host_serial_receive_callback_tp fprev = NULL;
 
   if( iface==0xff )
     dazzler_out_ctrl(0);
@@ -589,6 +674,7 @@ void dazzler_set_iface(byte iface)
       dazzler_iface = iface;
       dazzler_client_version = -1;
       dazzler_client_features = 0;
+      dazzler_resync = 0;
       fprev = host_serial_set_receive_callback(dazzler_iface, dazzler_receive);
       
 #if DEBUGLVL>0
@@ -614,6 +700,7 @@ void dazzler_setup()
   dazzler_mem_end   = 0x0000;
   dazzler_client_version = -1;
   dazzler_client_features = 0;
+  dazzler_resync = 0;
 
   dazzler_set_iface(config_dazzler_interface());
 }
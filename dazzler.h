@@ -8,7 +8,7 @@
 
 #include <Arduino.h>
 
-extern uint16_t dazzler_mem_start, dazzler_mem_end;
+extern MACHINE_STATE uint16_t dazzler_mem_start, dazzler_mem_end;
 
 #define dazzler_write_mem(a, v) { if( (a)<dazzler_mem_end && (a)>=dazzler_mem_start && Mem[a]!=(v) ) dazzler_write_mem_do(a, v); }
 
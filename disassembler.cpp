@@ -22,18 +22,332 @@
 #include "disassembler_i8080.h"
 #include "disassembler_z80.h"
 #include "cpucore.h"
+#include "numsys.h"
+#include "mem.h"
 
 
-byte disassemble(byte *Mem, uint16_t PC, bool print_bytes)
+#ifdef HOST_HAS_FILESYS
+#define DA_MAX_SYMS   1024
+#define DA_SYM_LEN    16
+
+struct DisassemblerSymbol
+{
+  uint16_t addr;
+  char     name[DA_SYM_LEN];
+};
+
+static MACHINE_STATE struct DisassemblerSymbol da_syms[DA_MAX_SYMS];
+static MACHINE_STATE uint16_t da_num_syms = 0;
+#endif
+
+
+static byte da_format_byte(char *buf, byte b)
+{
+  switch( numsys_get() )
+    {
+    case NUMSYS_HEX:
+      buf[0] = "0123456789ABCDEF"[b/16];
+      buf[1] = "0123456789ABCDEF"[b&15];
+      return 2;
+
+    case NUMSYS_OCT:
+      buf[0] = '0' + ((b&0700) >> 6);
+      buf[1] = '0' + ((b&0070) >> 3);
+      buf[2] = '0' +  (b&0007);
+      return 3;
+
+    default:
+      buf[0] = b<100 ? ' ' : '0' + b/100;
+      buf[1] = b<10  ? ' ' : '0' + (b/10)%10;
+      buf[2] = '0' + b%10;
+      return 3;
+    }
+}
+
+
+static byte da_format_word(char *buf, uint16_t w)
+{
+  byte n;
+  switch( numsys_get() )
+    {
+    case NUMSYS_HEX:
+      da_format_byte(buf,   w >> 8);
+      da_format_byte(buf+2, w & 0xff);
+      return 4;
+
+    case NUMSYS_OCT:
+      for(n=0; n<6; n++) buf[n] = '0' + ((w >> (15-n*3)) & 007);
+      return 6;
+
+    default:
+      for(n=5; n>0; n--) { buf[n-1] = (w>0 || n==5) ? '0' + w%10 : ' '; w /= 10; }
+      return 5;
+    }
+}
+
+
+void da_char(struct DisassemblerInfo *d, char c)
+{
+  // the first space separates the mnemonic from the operands
+  if( d->olen==0 && c==' ' )
+    d->mlen |= 0x80;
+  else if( d->mlen & 0x80 )
+    { if( d->olen<sizeof(d->operands)-1 ) d->operands[d->olen++] = c; }
+  else if( d->mlen<sizeof(d->mnemonic)-1 )
+    d->mnemonic[d->mlen++] = c;
+}
+
+
+void da_str(struct DisassemblerInfo *d, const char *s)
+{
+  char c;
+  while( (c=pgm_read_byte(s++))!=0 ) da_char(d, c);
+}
+
+
+void da_byte(struct DisassemblerInfo *d, byte b)
+{
+  char buf[3];
+  byte n = da_format_byte(buf, b);
+  for(byte i=0; i<n; i++) da_char(d, buf[i]);
+}
+
+
+void da_word(struct DisassemblerInfo *d, uint16_t w)
+{
+  char buf[6];
+  byte n = da_format_word(buf, w);
+  for(byte i=0; i<n; i++) da_char(d, buf[i]);
+}
+
+
+void da_addr(struct DisassemblerInfo *d, uint16_t a)
+{
+  const char *s = disassembler_get_symbol(a);
+  if( s!=NULL )
+    { while( *s ) da_char(d, *s++); }
+  else
+    da_word(d, a);
+}
+
+
+void da_target(struct DisassemblerInfo *d, byte flags, uint16_t a)
+{
+  d->flags |= flags | DA_TARGET;
+  d->target = a;
+  da_addr(d, a);
+}
+
+
+byte disassemble_info(const byte *Mem, uint16_t PC, struct DisassemblerInfo *info)
 {
+  info->flags  = 0;
+  info->target = 0;
+  info->mlen   = 0;
+  info->olen   = 0;
+
 #if USE_Z80==0 // fixed I8080 CPU
-  return disassemble_i8080(Mem, PC, print_bytes);
+  info->length = disassemble_i8080(Mem, PC, info);
 #elif USE_Z80==1 // fixed Z80 CPU
-  return disassemble_z80(Mem, PC, print_bytes);
+  info->length = disassemble_z80(Mem, PC, info);
 #else // CPU is switchable
   if( cpu_get_processor() == PROC_I8080 )
-    return disassemble_i8080(Mem, PC, print_bytes);
+    info->length = disassemble_i8080(Mem, PC, info);
+  else
+    info->length = disassemble_z80(Mem, PC, info);
+#endif
+
+  info->mlen &= 0x7F;
+  info->mnemonic[info->mlen] = 0;
+  info->operands[info->olen] = 0;
+  return info->length;
+}
+
+
+byte disassemble_text(const byte *Mem, uint16_t PC, char *buf, byte bufsize, bool print_bytes)
+{
+  struct DisassemblerInfo info;
+  char tmp[3], *p = buf, *end = buf+bufsize-1;
+  byte i, j, n;
+  bool z80 = cpu_get_processor()==PROC_Z80;
+
+#define PUT(c) if( p<end ) *p++ = (c)
+  disassemble_info(Mem, PC, &info);
+  if( print_bytes )
+    {
+      // instruction bytes, padded to the longest instruction
+      for(i=0; i<(z80 ? 4 : 3); i++)
+        {
+          n = da_format_byte(tmp, DA_READ(PC+i));
+          PUT(' ');
+          for(j=0; j<n; j++) { PUT(i<info.length ? tmp[j] : ' '); }
+        }
+      PUT(':'); PUT(' ');
+    }
+
+  for(i=0; i<info.mlen; i++) { PUT(info.mnemonic[i]); }
+  if( info.olen>0 )
+    {
+      // Z80 operands start in column 6, i8080 operands after one space
+      do { PUT(' '); i++; } while( z80 && i<5 );
+      for(i=0; i<info.olen; i++) { PUT(info.operands[i]); }
+    }
+#undef PUT
+
+  *p = 0;
+  return info.length;
+}
+
+
+byte disassemble(const byte *Mem, uint16_t PC, bool print_bytes)
+{
+  char buf[80];
+  byte n = disassemble_text(Mem, PC, buf, 80, print_bytes);
+  Serial.print(buf);
+  return n;
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+
+
+const char *disassembler_get_symbol(uint16_t addr)
+{
+#ifdef HOST_HAS_FILESYS
+  // symbols are sorted by address
+  int lo = 0, hi = da_num_syms-1;
+  while( lo<=hi )
+    {
+      int mid = (lo+hi)/2;
+      if( da_syms[mid].addr==addr )
+        return da_syms[mid].name;
+      else if( da_syms[mid].addr<addr )
+        lo = mid+1;
+      else
+        hi = mid-1;
+    }
+#endif
+
+  return NULL;
+}
+
+
+const char *disassembler_get_name(uint16_t addr, char *buf)
+{
+  int found = -1;
+
+#ifdef HOST_HAS_FILESYS
+  // find closest symbol at or below the address
+  int lo = 0, hi = da_num_syms-1;
+  while( lo<=hi )
+    {
+      int mid = (lo+hi)/2;
+      if( da_syms[mid].addr<=addr )
+        { found = mid; lo = mid+1; }
+      else
+        hi = mid-1;
+    }
+#endif
+
+  // numbers in the current number system (as in the disassembly) but
+  // without the padding of decimal numbers, offsets without leading zeros
+  char num[7], *p = num;
+  byte n = da_format_word(num, found<0 ? addr : addr-da_syms[found].addr);
+  num[n] = 0;
+  while( *p==' ' ) p++;
+
+  if( found<0 )
+    strcpy(buf, p);
+#ifdef HOST_HAS_FILESYS
+  else if( da_syms[found].addr==addr )
+    strcpy(buf, da_syms[found].name);
   else
-    return disassemble_z80(Mem, PC, print_bytes);
+    {
+      while( *p=='0' && p[1]!=0 ) p++;
+      sprintf(buf, "%s+%s", da_syms[found].name, p);
+    }
+#endif
+
+  return buf;
+}
+
+
+#ifdef HOST_HAS_FILESYS
+
+static bool da_is_hex(const char *s)
+{
+  int n = strlen(s);
+  if( n>1 && (s[n-1]=='h' || s[n-1]=='H') ) n--;
+  if( n==0 || n>5 ) return false;
+  for(int i=0; i<n; i++) if( !isxdigit(s[i]) ) return false;
+  return true;
+}
+
+
+bool disassembler_read_symbols(HOST_FILESYS_FILE_TYPE f)
+{
+  char token[DA_SYM_LEN], c = 0;
+  byte n = 0;
+  bool comment = false, have_addr = false;
+  uint16_t addr = 0;
+
+  da_num_syms = 0;
+  while( true )
+    {
+      bool eof = host_filesys_file_read(f, 1, &c)!=1;
+      if( eof ) c = 0;
+      if( eof || c==' ' || c=='\t' || c=='\r' || c=='\n' || c==';' )
+        {
+          if( n>0 && !comment )
+            {
+              token[n] = 0;
+              if( have_addr )
+                {
+                  // strip trailing ':' from label names
+                  if( token[n-1]==':' ) token[n-1] = 0;
+                  if( da_num_syms<DA_MAX_SYMS )
+                    {
+                      // insert into sorted list
+                      int i = da_num_syms++;
+                      while( i>0 && da_syms[i-1].addr>addr ) { da_syms[i] = da_syms[i-1]; i--; }
+                      da_syms[i].addr = addr;
+                      strcpy(da_syms[i].name, token);
+                    }
+                  have_addr = false;
+                }
+              else if( da_is_hex(token) )
+                {
+                  addr = (uint16_t) strtol(token, NULL, 16);
+                  have_addr = true;
+                }
+            }
+
+          n = 0;
+          if( c==';' ) comment = true;
+          if( c=='\n' ) comment = false;
+          if( eof ) break;
+        }
+      else if( n<DA_SYM_LEN-1 )
+        token[n++] = c;
+    }
+
+  return true;
+}
+
+
+#endif
+
+
+bool disassembler_load_symbols(const char *filename)
+{
+#ifdef HOST_HAS_FILESYS
+  HOST_FILESYS_FILE_TYPE f = host_filesys_file_open(filename, false);
+  if( !f ) return false;
+
+  bool ok = disassembler_read_symbols(f);
+  host_filesys_file_close(f);
+  return ok;
+#else
+  return false;
 #endif
 }
@@ -6,6 +6,67 @@
 #ifndef DISASSEMBLER_H
 #define DISASSEMBLER_H
 
-byte disassemble(byte *Mem, uint16_t PC, bool print_bytes);
+#include "host.h"
+
+#define DA_JUMP    0x01  // instruction jumps (to target if DA_TARGET is set)
+#define DA_CALL    0x02  // instruction calls a subroutine at target
+#define DA_RET     0x04  // instruction returns from a subroutine/interrupt
+#define DA_COND    0x08  // jump/call/return is conditional
+#define DA_TARGET  0x10  // target address is valid
+
+// decoded instruction. Numbers are formatted in the current number system
+// (see numsys.h), addresses which have a name in the symbol table are
+// replaced by the name.
+struct DisassemblerInfo
+{
+  byte     length;        // instruction length in bytes
+  byte     flags;         // DA_* flags above
+  uint16_t target;        // jump/call target address
+  char     mnemonic[8];
+  char     operands[32];
+  byte     mlen, olen;    // used while decoding
+};
+
+// decode the instruction at PC, returns its length (reads memory without
+// triggering memory access profiling, Mem may point to any 64k buffer)
+byte disassemble_info(const byte *Mem, uint16_t PC, struct DisassemblerInfo *info);
+
+// decode the instruction at PC into buf (optionally preceded by the instruction
+// bytes), returns its length
+byte disassemble_text(const byte *Mem, uint16_t PC, char *buf, byte bufsize, bool print_bytes);
+
+// print the instruction at PC to the serial console, returns its length
+byte disassemble(const byte *Mem, uint16_t PC, bool print_bytes);
+
+// symbol file contains pairs of "hex-address name" separated by white
+// space (e.g. M80/L80 .SYM files), ';' starts a comment until end of line
+bool disassembler_load_symbols(const char *filename);
+#ifdef HOST_HAS_FILESYS
+bool disassembler_read_symbols(HOST_FILESYS_FILE_TYPE f);
+#endif
+
+// name of the symbol at the address (NULL if none)
+const char *disassembler_get_symbol(uint16_t addr);
+
+// writes "name" or "name+offset" for the closest symbol at or below
+// the address (or the address if there is none) to buf, numbers are
+// formatted in the current number system
+const char *disassembler_get_name(uint16_t addr, char *buf);
+
+
+// used by the processor specific disassemblers, reads from the Mem parameter
+// (if that is the simulated memory and it is smaller than 64k then reads
+// outside of it behave as in the CPU, see MREAD_MEM in mem.h)
+#if MEMSIZE < 0x10000
+#define DA_READ(a) (Mem==::Mem ? MREAD_MEM((uint16_t) (a)) : Mem[(uint16_t) (a)])
+#else
+#define DA_READ(a) Mem[(uint16_t) (a)]
+#endif
+void da_char(struct DisassemblerInfo *d, char c);
+void da_str(struct DisassemblerInfo *d, const char *s); // s in PROGMEM
+void da_byte(struct DisassemblerInfo *d, byte b);
+void da_word(struct DisassemblerInfo *d, uint16_t w);
+void da_addr(struct DisassemblerInfo *d, uint16_t a);
+void da_target(struct DisassemblerInfo *d, byte flags, uint16_t a);
 
 #endif
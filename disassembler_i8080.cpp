@@ -27,594 +27,604 @@
 #if USE_Z80 != 1
 
 
-typedef byte (*DAFUN)(byte, byte *, uint16_t);
+typedef byte (*DAFUN)(byte, const byte *, uint16_t, struct DisassemblerInfo *);
 
 
-static void printRegName(byte regname)
+static void printRegName(struct DisassemblerInfo *d, byte regname)
 {
   switch(regname)
     {
-    case 0: Serial.print('B'); break; 
-    case 1: Serial.print('C'); break; 
-    case 2: Serial.print('D'); break; 
-    case 3: Serial.print('E'); break; 
-    case 4: Serial.print('H'); break; 
-    case 5: Serial.print('L'); break; 
-    case 6: Serial.print('M'); break; 
-    case 7: Serial.print('A'); break; 
-    default: Serial.print('?'); break; 
+    case 0: da_char(d, 'B'); break; 
+    case 1: da_char(d, 'C'); break; 
+    case 2: da_char(d, 'D'); break; 
+    case 3: da_char(d, 'E'); break; 
+    case 4: da_char(d, 'H'); break; 
+    case 5: da_char(d, 'L'); break; 
+    case 6: da_char(d, 'M'); break; 
+    case 7: da_char(d, 'A'); break; 
+    default: da_char(d, '?'); break; 
     }
 }
 
-static void printDblRegName(byte regname)
+static void printDblRegName(struct DisassemblerInfo *d, byte regname)
 {
   switch(regname)
     {
-    case 0: { Serial.print('B'); Serial.print('C'); break; }
-    case 1: { Serial.print('D'); Serial.print('E'); break; }
-    case 2: { Serial.print('H'); Serial.print('L'); break; }
-    case 3: { Serial.print('S'); Serial.print('P'); break; }
-    default: Serial.print('?'); break; 
+    case 0: { da_char(d, 'B'); da_char(d, 'C'); break; }
+    case 1: { da_char(d, 'D'); da_char(d, 'E'); break; }
+    case 2: { da_char(d, 'H'); da_char(d, 'L'); break; }
+    case 3: { da_char(d, 'S'); da_char(d, 'P'); break; }
+    default: da_char(d, '?'); break; 
     }
 }
 
-static byte da_ADC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ADC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ADC "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("ADC "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_ADD(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ADD(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ADD "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("ADD "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_SBB(byte opcode, byte *Mem, uint16_t PC)
+static byte da_SBB(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("SBB "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("SBB "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_SUB(byte opcode, byte *Mem, uint16_t PC)
+static byte da_SUB(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("SUB "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("SUB "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_ANA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ANA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ANA "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("ANA "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_XRA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_XRA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("XRA "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("XRA "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_ORA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ORA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ORA "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("ORA "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_CMP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CMP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CMP "));
-  printRegName(opcode&0007);
+  da_str(d, PSTR("CMP "));
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_CALL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CALL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CALL "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CALL "));
+  da_target(d, DA_CALL, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_DCR(byte opcode, byte *Mem, uint16_t PC)
+static byte da_DCR(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("DCR "));
-  printRegName((opcode&0070)>>3);
+  da_str(d, PSTR("DCR "));
+  printRegName(d, (opcode&0070)>>3);
   return 1;
 }
 
-static byte da_ADI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ADI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ADI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("ADI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_ACI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ACI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ACI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("ACI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_SUI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_SUI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("SUI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("SUI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_SBI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_SBI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("SBI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("SBI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_ANI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ANI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ANI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("ANI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_XRI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_XRI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("XRI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("XRI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_ORI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ORI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("ORI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("ORI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_CPI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CPI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CPI "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("CPI "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_CMA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CMA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CMA"));
+  da_str(d, PSTR("CMA"));
   return 1;
 }
 
-static byte da_CMC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CMC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CMC"));
+  da_str(d, PSTR("CMC"));
   return 1;
 }
 
-static byte da_DAA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_DAA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("DAA"));
+  da_str(d, PSTR("DAA"));
   return 1;
 }
 
-static byte da_DAD(byte opcode, byte *Mem, uint16_t PC)
+static byte da_DAD(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("DAD "));
-  printDblRegName((opcode & 0060)>>4);
+  da_str(d, PSTR("DAD "));
+  printDblRegName(d, (opcode & 0060)>>4);
   return 1;
 }
 
-static byte da_DCX(byte opcode, byte *Mem, uint16_t PC)
+static byte da_DCX(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("DCX "));
-  printDblRegName((opcode & 0060)>>4);
+  da_str(d, PSTR("DCX "));
+  printDblRegName(d, (opcode & 0060)>>4);
   return 1;
 }
 
-static byte da_DI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_DI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("DI"));
+  da_str(d, PSTR("DI"));
   return 1;
 }
 
-static byte da_EI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_EI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("EI"));
+  da_str(d, PSTR("EI"));
   return 1;
 }
 
-static byte da_HLT(byte opcode, byte *Mem, uint16_t PC)
+static byte da_HLT(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("HLT"));
+  da_str(d, PSTR("HLT"));
   return 1;
 }
 
-static byte da_INR(byte opcode, byte *Mem, uint16_t PC)
+static byte da_INR(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("INR "));
-  printRegName((opcode&0070)>>3);
+  da_str(d, PSTR("INR "));
+  printRegName(d, (opcode&0070)>>3);
   return 1;
 }
 
-static byte da_INX(byte opcode, byte *Mem, uint16_t PC)
+static byte da_INX(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("INX "));
-  printDblRegName((opcode & 0060)>>4);
+  da_str(d, PSTR("INX "));
+  printDblRegName(d, (opcode & 0060)>>4);
   return 1;
 }
 
-static byte da_LDA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_LDA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("LDA "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("LDA "));
+  da_addr(d, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_LDAX(byte opcode, byte *Mem, uint16_t PC)
+static byte da_LDAX(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("LDAX "));
-  printDblRegName((opcode & 0060)>>4);
+  da_str(d, PSTR("LDAX "));
+  printDblRegName(d, (opcode & 0060)>>4);
   return 1;
 }
 
-static byte da_LHLD(byte opcode, byte *Mem, uint16_t PC)
+static byte da_LHLD(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("LHLD "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("LHLD "));
+  da_addr(d, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_LXI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_LXI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("LXI "));
-  printDblRegName((opcode & 0060)>>4);
-  Serial.print(',');
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("LXI "));
+  printDblRegName(d, (opcode & 0060)>>4);
+  da_char(d, ',');
+  da_word(d, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
   
-static byte da_MOV(byte opcode, byte *Mem, uint16_t PC)
+static byte da_MOV(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("MOV "));
-  printRegName((opcode&0070)>>3);
-  Serial.print(',');
-  printRegName(opcode&0007);
+  da_str(d, PSTR("MOV "));
+  printRegName(d, (opcode&0070)>>3);
+  da_char(d, ',');
+  printRegName(d, opcode&0007);
   return 1;
 }
 
-static byte da_MVI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_MVI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("MVI "));
-  printRegName((opcode&0070)>>3);
-  Serial.print(',');
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("MVI "));
+  printRegName(d, (opcode&0070)>>3);
+  da_char(d, ',');
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
-static byte da_MVR(byte opcode, byte *Mem, uint16_t PC)
+static byte da_MVR(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("MVR "));
-  printRegName((opcode&0070)>>3);
-  Serial.print(',');
-  printDblRegName(2);
+  da_str(d, PSTR("MVR "));
+  printRegName(d, (opcode&0070)>>3);
+  da_char(d, ',');
+  printDblRegName(d, 2);
   return 1;
 }
 
-static byte da_NOP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_NOP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("NOP"));
+  da_str(d, PSTR("NOP"));
   return 1;
 }
 
-static byte da_PCHL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_PCHL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("PCHL"));
+  d->flags |= DA_JUMP;
+  da_str(d, PSTR("PCHL"));
   return 1;
 }
 
-static byte da_POP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_POP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("POP "));
-  printDblRegName((opcode&0060)>>4);
+  da_str(d, PSTR("POP "));
+  printDblRegName(d, (opcode&0060)>>4);
   return 1;
 }
 
-static byte da_POPA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_POPA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("POP AS"));
+  da_str(d, PSTR("POP AS"));
   return 1;
 }
 
-static byte da_PUSH(byte opcode, byte *Mem, uint16_t PC)
+static byte da_PUSH(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("PUSH "));
-  printDblRegName((opcode&0060)>>4);
+  da_str(d, PSTR("PUSH "));
+  printDblRegName(d, (opcode&0060)>>4);
   return 1;
 }
 
-static byte da_PUSA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_PUSA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("PUSH AS"));
+  da_str(d, PSTR("PUSH AS"));
   return 1;
 }
 
-static byte da_RLC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RLC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RLC"));
+  da_str(d, PSTR("RLC"));
   return 1;
 }
 
-static byte da_RRC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RRC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RRC"));
+  da_str(d, PSTR("RRC"));
   return 1;
 }
 
-static byte da_RAL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RAL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RAL"));
+  da_str(d, PSTR("RAL"));
   return 1;
 }
 
-static byte da_RAR(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RAR(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RAR"));
+  da_str(d, PSTR("RAR"));
   return 1;
 }
 
-static byte da_RET(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RET(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RET"));
+  d->flags |= DA_RET;
+  da_str(d, PSTR("RET"));
   return 1;
 }
 
-static byte da_RST(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RST(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RST "));
-  numsys_print_word(opcode & 0070);
+  da_str(d, PSTR("RST "));
+  da_target(d, DA_CALL, opcode & 0070);
   return 1;
 }
 
-static byte da_RNZ(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RNZ(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RNZ"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RNZ"));
   return 1;
 }
 
-static byte da_RZ(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RZ(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RZ"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RZ"));
   return 1;
 }
 
-static byte da_RNC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RNC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RNC"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RNC"));
   return 1;
 }
 
-static byte da_RC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RC"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RC"));
   return 1;
 }
 
-static byte da_RPO(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RPO(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RPO"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RPO"));
   return 1;
 }
 
-static byte da_RPE(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RPE(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RPE"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RPE"));
   return 1;
 }
 
-static byte da_RP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RP"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RP"));
   return 1;
 }
 
-static byte da_RM(byte opcode, byte *Mem, uint16_t PC)
+static byte da_RM(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("RM"));
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("RM"));
   return 1;
 }
 
-static byte da_JMP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JMP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JMP "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JMP "));
+  da_target(d, DA_JUMP, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JNZ(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JNZ(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JNZ "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JNZ "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JZ(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JZ(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JZ "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JZ "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JNC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JNC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JNC "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JNC "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JC "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JC "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JPO(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JPO(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JPO "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JPO "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JPE(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JPE(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JPE "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JPE "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JP "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JP "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_JM(byte opcode, byte *Mem, uint16_t PC)
+static byte da_JM(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("JM "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("JM "));
+  da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CNZ(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CNZ(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CNZ "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CNZ "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CZ(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CZ(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CZ "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CZ "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CNC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CNC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CNC "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CNC "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CC "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CC "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CPO(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CPO(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CPO "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CPO "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CPE(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CPE(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CPE "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CPE "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CP "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CP "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_CM(byte opcode, byte *Mem, uint16_t PC)
+static byte da_CM(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("CM "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("CM "));
+  da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_SHLD(byte opcode, byte *Mem, uint16_t PC)
+static byte da_SHLD(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("SHLD "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("SHLD "));
+  da_addr(d, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_SPHL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_SPHL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("SPHL"));
+  da_str(d, PSTR("SPHL"));
   return 1;
 }
 
-static byte da_STA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_STA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("STA "));
-  numsys_print_word(MREAD(PC+1) | (MREAD(PC+2) << 8));
+  da_str(d, PSTR("STA "));
+  da_addr(d, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_STAX(byte opcode, byte *Mem, uint16_t PC)
+static byte da_STAX(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("STAX "));
-  printDblRegName((opcode&0060)>>4);
+  da_str(d, PSTR("STAX "));
+  printDblRegName(d, (opcode&0060)>>4);
   return 1;
 }
 
-static byte da_STC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_STC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("STC"));
+  da_str(d, PSTR("STC"));
   return 1;
 }
 
-static byte da_XTHL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_XTHL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("XTHL"));
+  da_str(d, PSTR("XTHL"));
   return 1;
 }
 
-static byte da_XCHG(byte opcode, byte *Mem, uint16_t PC)
+static byte da_XCHG(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("XCHG"));
+  da_str(d, PSTR("XCHG"));
   return 1;
 }
 
-static byte da_OUT(byte opcode, byte *Mem, uint16_t PC)
+static byte da_OUT(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("OUT "));
-  numsys_print_byte(MREAD(PC+1));  
+  da_str(d, PSTR("OUT "));
+  da_byte(d, DA_READ(PC+1));  
   return 2;
 }
 
 
-static byte da_IN(byte opcode, byte *Mem, uint16_t PC)
+static byte da_IN(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  Serial.print(F("IN "));
-  numsys_print_byte(MREAD(PC+1));
+  da_str(d, PSTR("IN "));
+  da_byte(d, DA_READ(PC+1));
   return 2;
 }
 
 
-static byte da_NUL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_NUL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
   byte res = 1;
 
-  Serial.print('<');
-  numsys_print_byte(opcode);
-  Serial.print(F("> ["));
+  da_char(d, '<');
+  da_byte(d, opcode);
+  da_str(d, PSTR("> ["));
 
   // the following opcodes are not official but (at least on 
   // the Intel 8080) behave like other opcodes. 
@@ -627,16 +637,16 @@ static byte da_NUL(byte opcode, byte *Mem, uint16_t PC)
     case 0040:
     case 0050:
     case 0060:
-    case 0070: res = da_NOP(opcode, Mem, PC); break;
-    case 0313: res = da_JMP(opcode, Mem, PC); break;
-    case 0331: res = da_RET(opcode, Mem, PC); break;
+    case 0070: res = da_NOP(opcode, Mem, PC, d); break;
+    case 0313: res = da_JMP(opcode, Mem, PC, d); break;
+    case 0331: res = da_RET(opcode, Mem, PC, d); break;
     case 0335:
     case 0355:
-    case 0375: res = da_CALL(opcode, Mem, PC); break;
-    default:   res = 1; Serial.print(F("???")); break;
+    case 0375: res = da_CALL(opcode, Mem, PC, d); break;
+    default:   res = 1; da_str(d, PSTR("???")); break;
     }
 
-  Serial.print(']');
+  da_char(d, ']');
   return res;
 }
 
@@ -679,13 +689,13 @@ const DAFUN da_opcodes[] PROGMEM = {
   };
 
 
-byte disassemble_i8080(byte *Mem, uint16_t PC, bool pb)
+byte disassemble_i8080(const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  byte opcode = MREAD(PC);
+  byte opcode = DA_READ(PC);
 #if defined(__AVR_ATmega2560__)
-  return ((DAFUN)pgm_read_word(&da_opcodes[opcode]))(opcode, Mem, PC);
+  return ((DAFUN)pgm_read_word(&da_opcodes[opcode]))(opcode, Mem, PC, d);
 #else
-  return (da_opcodes[opcode])(opcode, Mem, PC);
+  return (da_opcodes[opcode])(opcode, Mem, PC, d);
 #endif
 }
 
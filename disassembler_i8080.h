@@ -6,6 +6,7 @@
 #ifndef DISASSEMBLER_I8080_H
 #define DISASSEMBLER_I8080_H
 
-byte disassemble_i8080(byte *Mem, uint16_t PC, bool print_bytes);
+struct DisassemblerInfo;
+byte disassemble_i8080(const byte *Mem, uint16_t PC, struct DisassemblerInfo *info);
 
 #endif
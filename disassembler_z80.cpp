@@ -26,164 +26,157 @@
 
 #if USE_Z80 != 0
 
-typedef byte (*DAFUN)(byte, byte *, uint16_t);
+typedef byte (*DAFUN)(byte, const byte *, uint16_t, struct DisassemblerInfo *);
 
-static bool print_bytes = true;
-
-
-static void pRN(byte regname)
+static void pRN(struct DisassemblerInfo *d, byte regname)
 {
   switch(regname)
     {
-    case 0: Serial.print('b'); break; 
-    case 1: Serial.print('c'); break; 
-    case 2: Serial.print('d'); break; 
-    case 3: Serial.print('e'); break; 
-    case 4: Serial.print('h'); break; 
-    case 5: Serial.print('l'); break; 
-    case 6: Serial.print(F("(hl)")); break; 
-    case 7: Serial.print('a'); break; 
-    default: Serial.print('?'); break; 
+    case 0: da_char(d, 'b'); break; 
+    case 1: da_char(d, 'c'); break; 
+    case 2: da_char(d, 'd'); break; 
+    case 3: da_char(d, 'e'); break; 
+    case 4: da_char(d, 'h'); break; 
+    case 5: da_char(d, 'l'); break; 
+    case 6: da_str(d, PSTR("(hl)")); break; 
+    case 7: da_char(d, 'a'); break; 
+    default: da_char(d, '?'); break; 
     }
 }
 
-static void pR2N(byte regname)
+static void pR2N(struct DisassemblerInfo *d, byte regname)
 {
   switch(regname)
     {
-    case 0: { Serial.print('b'); Serial.print('c'); break; }
-    case 1: { Serial.print('d'); Serial.print('e'); break; }
-    case 2: { Serial.print('h'); Serial.print('l'); break; }
-    case 3: { Serial.print('s'); Serial.print('p'); break; }
-    default: Serial.print('?'); break; 
+    case 0: { da_char(d, 'b'); da_char(d, 'c'); break; }
+    case 1: { da_char(d, 'd'); da_char(d, 'e'); break; }
+    case 2: { da_char(d, 'h'); da_char(d, 'l'); break; }
+    case 3: { da_char(d, 's'); da_char(d, 'p'); break; }
+    default: da_char(d, '?'); break; 
     }
 }
 
-static void pC(byte cond)
+static void pC(struct DisassemblerInfo *d, byte cond)
 {
   switch( cond )
     {
-    case 0: { Serial.print('n'); Serial.print('z'); break; }
-    case 1: { Serial.print('z'); break; }
-    case 2: { Serial.print('n'); Serial.print('c'); break; }
-    case 3: { Serial.print('c'); break; }
-    case 4: { Serial.print('p'); Serial.print('o'); break; }
-    case 5: { Serial.print('p'); Serial.print('e'); break; }
-    case 6: { Serial.print('p'); break; }
-    case 7: { Serial.print('m'); break; }
+    case 0: { da_char(d, 'n'); da_char(d, 'z'); break; }
+    case 1: { da_char(d, 'z'); break; }
+    case 2: { da_char(d, 'n'); da_char(d, 'c'); break; }
+    case 3: { da_char(d, 'c'); break; }
+    case 4: { da_char(d, 'p'); da_char(d, 'o'); break; }
+    case 5: { da_char(d, 'p'); da_char(d, 'e'); break; }
+    case 6: { da_char(d, 'p'); break; }
+    case 7: { da_char(d, 'm'); break; }
     }
 }
 
-static void pB(byte *Mem, uint16_t addr)
+static void pB(struct DisassemblerInfo *d, const byte *Mem, uint16_t addr)
 {
-  numsys_print_byte(MREAD(addr));
+  da_byte(d, DA_READ(addr));
 }
 
-static void pW(byte *Mem, uint16_t addr)
+static void pW(struct DisassemblerInfo *d, const byte *Mem, uint16_t addr)
 {
-  numsys_print_word(MREAD(addr) | (MREAD(addr+1) << 8));
+  da_word(d, DA_READ(addr) | (DA_READ(addr+1) << 8));
 }
 
-static void pBN(byte *Mem, uint16_t addr, byte n)
+static void pA(struct DisassemblerInfo *d, const byte *Mem, uint16_t addr)
 {
-  if( !print_bytes ) return;
-  byte bl = numsys_get_byte_length()+1;
-  for(int i=0; i<n; i++) { Serial.print(' '); numsys_print_byte(MREAD(addr+i)); }
-  for(int i=0; i<bl*(4-n); i++) Serial.print(' ');
-  Serial.print(F(": "));
+  da_addr(d, DA_READ(addr) | (DA_READ(addr+1) << 8));
 }
 
 
 // --------------------------------------------  load/exchange  --------------------------------------------------
 
 
-static byte da_LDA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_LDA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("ld   a,(")); pW(Mem, PC+1); Serial.print(')');
+  da_str(d, PSTR("ld   a,(")); pA(d, Mem, PC+1); da_char(d, ')');
   return 3;
 }
 
-static byte da_ldx(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ldx(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ld   a,(")); pR2N((opcode & 0060)>>4); Serial.print(')');
+  da_str(d, PSTR("ld   a,(")); pR2N(d, (opcode & 0060)>>4); da_char(d, ')');
   return 1;
 }
 
-static byte da_lhld(byte opcode, byte *Mem, uint16_t PC)
+static byte da_lhld(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("ld   hl,(")); pW(Mem, PC+1); Serial.print(')');
+  da_str(d, PSTR("ld   hl,(")); pA(d, Mem, PC+1); da_char(d, ')');
   return 3;
 }
 
-static byte da_lxi(byte opcode, byte *Mem, uint16_t PC)
+static byte da_lxi(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("ld   ")); pR2N((opcode & 0060)>>4); Serial.print(','); pW(Mem, PC+1);
+  da_str(d, PSTR("ld   ")); pR2N(d, (opcode & 0060)>>4); da_char(d, ','); pW(d, Mem, PC+1);
   return 3;
 }
   
-static byte da_ldRR(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ldRR(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ld   ")); pRN((opcode&0070)>>3); Serial.print(','); pRN(opcode&0007);
+  da_str(d, PSTR("ld   ")); pRN(d, (opcode&0070)>>3); da_char(d, ','); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_ldRI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ldRI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("ld   ")); pRN((opcode&0070)>>3); Serial.print(','); pB(Mem, PC+1);
+  da_str(d, PSTR("ld   ")); pRN(d, (opcode&0070)>>3); da_char(d, ','); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_ldRM(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ldRM(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ld   ")); pRN((opcode&0070)>>3); Serial.print(F(",(hl)"));
+  da_str(d, PSTR("ld   ")); pRN(d, (opcode&0070)>>3); da_str(d, PSTR(",(hl)"));
   return 1;
 }
 
-static byte da_shld(byte opcode, byte *Mem, uint16_t PC)
+static byte da_shld(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("ld   (")); pW(Mem, PC+1); Serial.print(F("),hl"));
+  da_str(d, PSTR("ld   (")); pA(d, Mem, PC+1); da_str(d, PSTR("),hl"));
   return 3;
 }
 
-static byte da_ldSP(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ldSP(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ld   sp,hl"));
+  da_str(d, PSTR("ld   sp,hl"));
   return 1;
 }
 
-static byte da_STA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_STA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("ld   (")); pW(Mem, PC+1); Serial.print(F("),a"));
+  da_str(d, PSTR("ld   (")); pA(d, Mem, PC+1); da_str(d, PSTR("),a"));
   return 3;
 }
 
-static byte da_stx(byte opcode, byte *Mem, uint16_t PC)
+static byte da_stx(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ld   (")); pR2N((opcode&0060)>>4); Serial.print(F("),a"));
+  da_str(d, PSTR("ld   (")); pR2N(d, (opcode&0060)>>4); da_str(d, PSTR("),a"));
   return 1;
 }
 
-static byte da_exsp(byte opcode, byte *Mem, uint16_t PC)
+static byte da_exsp(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ex   (sp),hl"));
+  da_str(d, PSTR("ex   (sp),hl"));
   return 1;
 }
 
-static byte da_exde(byte opcode, byte *Mem, uint16_t PC)
+static byte da_exde(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ex   de,hl"));
+  da_str(d, PSTR("ex   de,hl"));
   return 1;
 }
 
-static byte da_exx(byte opcode, byte *Mem, uint16_t PC)
+static byte da_exx(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("exx"));
+  da_str(d, PSTR("exx"));
   return 1;
 }
 
-static byte da_exaf(byte opcode, byte *Mem, uint16_t PC)
+static byte da_exaf(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ex   af,af'"));
+  da_str(d, PSTR("ex   af,af'"));
   return 1;
 }
 
@@ -191,129 +184,129 @@ static byte da_exaf(byte opcode, byte *Mem, uint16_t PC)
 // ------------------------------------------  arithmetic/logic/rotate  ------------------------------------------------
 
 
-static byte da_adc(byte opcode, byte *Mem, uint16_t PC)
+static byte da_adc(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("adc  ")); pRN(opcode&0007);
+  da_str(d, PSTR("adc  ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_add(byte opcode, byte *Mem, uint16_t PC)
+static byte da_add(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("add  ")); pRN(opcode&0007);
+  da_str(d, PSTR("add  ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_sbc(byte opcode, byte *Mem, uint16_t PC)
+static byte da_sbc(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("sbc  ")); pRN(opcode&0007);
+  da_str(d, PSTR("sbc  ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_sub(byte opcode, byte *Mem, uint16_t PC)
+static byte da_sub(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("sub  ")); pRN(opcode&0007);
+  da_str(d, PSTR("sub  ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_and(byte opcode, byte *Mem, uint16_t PC)
+static byte da_and(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("and  ")); pRN(opcode&0007);
+  da_str(d, PSTR("and  ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_xor(byte opcode, byte *Mem, uint16_t PC)
+static byte da_xor(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("xor  ")); pRN(opcode&0007);
+  da_str(d, PSTR("xor  ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_or(byte opcode, byte *Mem, uint16_t PC)
+static byte da_or(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("or   ")); pRN(opcode&0007);
+  da_str(d, PSTR("or   ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_cp(byte opcode, byte *Mem, uint16_t PC)
+static byte da_cp(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("cp   ")); pRN(opcode&0007);
+  da_str(d, PSTR("cp   ")); pRN(d, opcode&0007);
   return 1;
 }
 
-static byte da_addI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_addI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("add  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("add  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_adcI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_adcI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("adc  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("adc  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_subI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_subI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("sub  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("sub  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_sbcI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_sbcI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("sbc  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("sbc  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_andI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_andI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("and  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("and  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_xorI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_xorI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("xor  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("xor  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_orI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_orI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("or   ")); pB(Mem, PC+1);
+  da_str(d, PSTR("or   ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_cpI(byte opcode, byte *Mem, uint16_t PC)
+static byte da_cpI(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("cp   ")); pB(Mem, PC+1);
+  da_str(d, PSTR("cp   ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_dad(byte opcode, byte *Mem, uint16_t PC)
+static byte da_dad(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("add  hl,")); pR2N((opcode & 0060)>>4);
+  da_str(d, PSTR("add  hl,")); pR2N(d, (opcode & 0060)>>4);
   return 1;
 }
 
-static byte da_rlca(byte opcode, byte *Mem, uint16_t PC)
+static byte da_rlca(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("rlca"));
+  da_str(d, PSTR("rlca"));
   return 1;
 }
 
-static byte da_rrca(byte opcode, byte *Mem, uint16_t PC)
+static byte da_rrca(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("rrca"));
+  da_str(d, PSTR("rrca"));
   return 1;
 }
 
-static byte da_rla(byte opcode, byte *Mem, uint16_t PC)
+static byte da_rla(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("rla"));
+  da_str(d, PSTR("rla"));
   return 1;
 }
 
-static byte da_rra(byte opcode, byte *Mem, uint16_t PC)
+static byte da_rra(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("rra"));
+  da_str(d, PSTR("rra"));
   return 1;
 }
 
@@ -321,45 +314,45 @@ static byte da_rra(byte opcode, byte *Mem, uint16_t PC)
 // --------------------------------------------  increment/decrement  ---------------------------------------------------
 
 
-static byte da_dec(byte opcode, byte *Mem, uint16_t PC)
+static byte da_dec(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("dec  ")); pRN((opcode&0070)>>3);
+  da_str(d, PSTR("dec  ")); pRN(d, (opcode&0070)>>3);
   return 1;
 }
 
-static byte da_dcx(byte opcode, byte *Mem, uint16_t PC)
+static byte da_dcx(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("dec  ")); pR2N((opcode & 0060)>>4);
+  da_str(d, PSTR("dec  ")); pR2N(d, (opcode & 0060)>>4);
   return 1;
 }
 
-static byte da_di(byte opcode, byte *Mem, uint16_t PC)
+static byte da_di(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("di"));
+  da_str(d, PSTR("di"));
   return 1;
 }
 
-static byte da_ei(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ei(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ei"));
+  da_str(d, PSTR("ei"));
   return 1;
 }
 
-static byte da_hlt(byte opcode, byte *Mem, uint16_t PC)
+static byte da_hlt(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("hlt"));
+  da_str(d, PSTR("hlt"));
   return 1;
 }
 
-static byte da_inc(byte opcode, byte *Mem, uint16_t PC)
+static byte da_inc(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("inc  ")); pRN((opcode&0070)>>3);
+  da_str(d, PSTR("inc  ")); pRN(d, (opcode&0070)>>3);
   return 1;
 }
 
-static byte da_inx(byte opcode, byte *Mem, uint16_t PC)
+static byte da_inx(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("inc  ")); pR2N((opcode & 0060)>>4);
+  da_str(d, PSTR("inc  ")); pR2N(d, (opcode & 0060)>>4);
   return 1;
 }
 
@@ -367,69 +360,72 @@ static byte da_inx(byte opcode, byte *Mem, uint16_t PC)
 // --------------------------------------------  jump/call/return  ---------------------------------------------------
 
 
-static byte da_jmp(byte opcode, byte *Mem, uint16_t PC)
+static byte da_jmp(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("jp   ")); pW(Mem, PC+1);
+  da_str(d, PSTR("jp   ")); da_target(d, DA_JUMP, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_jpC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_jpC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("jp   ")); pC((opcode&0x38)/8); Serial.print(','); pW(Mem, PC+1);
+  da_str(d, PSTR("jp   ")); pC(d, (opcode&0x38)/8); da_char(d, ','); da_target(d, DA_JUMP|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_jpHL(byte opcode, byte *Mem, uint16_t PC)
+static byte da_jpHL(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("jp   (hl)"));
+  d->flags |= DA_JUMP;
+  da_str(d, PSTR("jp   (hl)"));
   return 1;
 }
 
-static byte da_jr(byte opcode, byte *Mem, uint16_t PC)
+static byte da_jr(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("jr   ")); numsys_print_word(PC + 2 + (int8_t) (MREAD(PC+1)));
+  da_str(d, PSTR("jr   ")); da_target(d, DA_JUMP, PC + 2 + (int8_t) (DA_READ(PC+1)));
   return 2;
 }
 
-static byte da_jrC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_jrC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("jr   ")); pC((opcode&0x18)/8); Serial.print(','); numsys_print_word(PC + 2 + (int8_t) (MREAD(PC+1)));
+  da_str(d, PSTR("jr   ")); pC(d, (opcode&0x18)/8); da_char(d, ','); da_target(d, DA_JUMP|DA_COND, PC + 2 + (int8_t) (DA_READ(PC+1)));
   return 2;
 }
 
-static byte da_djnz(byte opcode, byte *Mem, uint16_t PC)
+static byte da_djnz(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("djnz ")); numsys_print_word(PC + 2 + (int8_t) (MREAD(PC+1)));
+  da_str(d, PSTR("djnz ")); da_target(d, DA_JUMP|DA_COND, PC + 2 + (int8_t) (DA_READ(PC+1)));
   return 2;
 }
 
-static byte da_call(byte opcode, byte *Mem, uint16_t PC)
+static byte da_call(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("call ")); pW(Mem, PC+1);
+  da_str(d, PSTR("call ")); da_target(d, DA_CALL, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_callC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_callC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 3); Serial.print(F("call ")); pC((opcode&0x38)/8); Serial.print(','); pW(Mem, PC+1);
+  da_str(d, PSTR("call ")); pC(d, (opcode&0x38)/8); da_char(d, ','); da_target(d, DA_CALL|DA_COND, DA_READ(PC+1) | (DA_READ(PC+2) << 8));
   return 3;
 }
 
-static byte da_ret(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ret(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ret"));
+  d->flags |= DA_RET;
+  da_str(d, PSTR("ret"));
   return 1;
 }
 
-static byte da_retC(byte opcode, byte *Mem, uint16_t PC)
+static byte da_retC(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ret  ")); pC((opcode&0x38)/8);
+  d->flags |= DA_RET|DA_COND;
+  da_str(d, PSTR("ret  ")); pC(d, (opcode&0x38)/8);
   return 1;
 }
 
-static byte da_rst(byte opcode, byte *Mem, uint16_t PC)
+static byte da_rst(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("rst ")); numsys_print_word(opcode & 0070);
+  da_str(d, PSTR("rst  ")); da_target(d, DA_CALL, opcode & 0070);
   return 1;
 }
 
@@ -437,69 +433,69 @@ static byte da_rst(byte opcode, byte *Mem, uint16_t PC)
 // --------------------------------------------  other  ---------------------------------------------------
 
 
-static byte da_nop(byte opcode, byte *Mem, uint16_t PC)
+static byte da_nop(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("nop"));
+  da_str(d, PSTR("nop"));
   return 1;
 }
 
-static byte da_out(byte opcode, byte *Mem, uint16_t PC)
+static byte da_out(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("out  ")); pB(Mem, PC+1);
+  da_str(d, PSTR("out  ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_in(byte opcode, byte *Mem, uint16_t PC)
+static byte da_in(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 2); Serial.print(F("in   ")); pB(Mem, PC+1);
+  da_str(d, PSTR("in   ")); pB(d, Mem, PC+1);
   return 2;
 }
 
-static byte da_cpl(byte opcode, byte *Mem, uint16_t PC)
+static byte da_cpl(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("cpl"));
+  da_str(d, PSTR("cpl"));
   return 1;
 }
 
-static byte da_scf(byte opcode, byte *Mem, uint16_t PC)
+static byte da_scf(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("scf"));
+  da_str(d, PSTR("scf"));
   return 1;
 }
 
-static byte da_ccf(byte opcode, byte *Mem, uint16_t PC)
+static byte da_ccf(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("ccf"));
+  da_str(d, PSTR("ccf"));
   return 1;
 }
 
-static byte da_daa(byte opcode, byte *Mem, uint16_t PC)
+static byte da_daa(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("daa"));
+  da_str(d, PSTR("daa"));
   return 1;
 }
 
-static byte da_pop(byte opcode, byte *Mem, uint16_t PC)
+static byte da_pop(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("pop  ")); pR2N((opcode&0060)>>4);
+  da_str(d, PSTR("pop  ")); pR2N(d, (opcode&0060)>>4);
   return 1;
 }
 
-static byte da_popA(byte opcode, byte *Mem, uint16_t PC)
+static byte da_popA(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("pop  af"));
+  da_str(d, PSTR("pop  af"));
   return 1;
 }
 
-static byte da_push(byte opcode, byte *Mem, uint16_t PC)
+static byte da_push(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("push ")); pR2N((opcode&0060)>>4);
+  da_str(d, PSTR("push ")); pR2N(d, (opcode&0060)>>4);
   return 1;
 }
 
-static byte da_pusa(byte opcode, byte *Mem, uint16_t PC)
+static byte da_pusa(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  pBN(Mem, PC, 1); Serial.print(F("push af"));
+  da_str(d, PSTR("push af"));
   return 1;
 }
 
@@ -507,224 +503,228 @@ static byte da_pusa(byte opcode, byte *Mem, uint16_t PC)
 // --------------------------------------------  prefixes (0xCB, 0xDD, 0xED, 0xFD)  ---------------------------------------------------
 
 
-static void printIXYOffset(char xy, char offset)
+static void printIXYOffset(struct DisassemblerInfo *d, char xy, char offset)
 {
-  Serial.print('(');
-  Serial.print('i'); 
-  Serial.print(xy);
+  da_char(d, '(');
+  da_char(d, 'i'); 
+  da_char(d, xy);
   if( offset<0 ) 
-    { Serial.print('-'); numsys_print_byte(-offset); }
+    { da_char(d, '-'); da_byte(d, -offset); }
   else
-    { Serial.print('+'); numsys_print_byte(offset); }
-  Serial.print(')');
+    { da_char(d, '+'); da_byte(d, offset); }
+  da_char(d, ')');
 }
 
 
-static void da_bitop(byte opcode, char xy, char offset)
+static void da_bitop(struct DisassemblerInfo *d, byte opcode, char xy, char offset)
 {
   if( (opcode & 0xC0)==0 )
     {
-      byte carry = 0;
-      
       // rotate operations
       switch( opcode & 0x38 )
         {
-        case 0x00: Serial.print(F("rlc  ")); break;
-        case 0x08: Serial.print(F("rrc  ")); break;
-        case 0x10: Serial.print(F("rl   ")); break;
-        case 0x18: Serial.print(F("rr   ")); break;
-        case 0x20: Serial.print(F("sla  ")); break;
-        case 0x28: Serial.print(F("sra  ")); break;
-        case 0x30: Serial.print(F("sll  ")); break;
-        case 0x38: Serial.print(F("srl  ")); break;
+        case 0x00: da_str(d, PSTR("rlc  ")); break;
+        case 0x08: da_str(d, PSTR("rrc  ")); break;
+        case 0x10: da_str(d, PSTR("rl   ")); break;
+        case 0x18: da_str(d, PSTR("rr   ")); break;
+        case 0x20: da_str(d, PSTR("sla  ")); break;
+        case 0x28: da_str(d, PSTR("sra  ")); break;
+        case 0x30: da_str(d, PSTR("sll  ")); break;
+        case 0x38: da_str(d, PSTR("srl  ")); break;
         }
-      
-      pRN(opcode & 0x07);
     }
   else
     {
       switch(opcode & 0xC0)
         {
-        case 0x40: Serial.print(F("bit  ")); break;
-        case 0x80: Serial.print(F("res  ")); break;
-        case 0xC0: Serial.print(F("set  ")); break;
+        case 0x40: da_str(d, PSTR("bit  ")); break;
+        case 0x80: da_str(d, PSTR("res  ")); break;
+        case 0xC0: da_str(d, PSTR("set  ")); break;
         }
+
+      da_char(d, '0' + (opcode & 0x38)/8);
+      da_char(d, ',');
     }
 
-  Serial.print((opcode & 0x38)/8);
-  if( xy!=0 ) { Serial.print(','); printIXYOffset(xy, offset); }
-  if( xy==0 || ((opcode&0xC0)!=0x40 && (opcode&0x07)!=0x06) ) { Serial.print(','); pRN(opcode & 0x07); }
+  if( xy==0 )
+    pRN(d, opcode & 0x07);
+  else
+    {
+      // undocumented: result of (ix+d) operations is also stored in register
+      printIXYOffset(d, xy, offset);
+      if( (opcode&0xC0)!=0x40 && (opcode&0x07)!=0x06 ) { da_char(d, ','); pRN(d, opcode & 0x07); }
+    }
 }
 
 
-static byte da_ixiy(byte prefix, byte *Mem, uint16_t PC) // 0xDD/0xFD prefix
+static byte da_ixiy(byte prefix, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d) // 0xDD/0xFD prefix
 {
   // IX/IY register instructions (0xDD/0xFD prefix)
-#define pr(s1, s2) {Serial.print(F(s1)); Serial.print('i'); Serial.print(xy); Serial.print(F(s2)); }
-  byte opcode = MREAD(PC+1);
+#define pr(s1, s2) {da_str(d, PSTR(s1)); da_char(d, 'i'); da_char(d, xy); da_str(d, PSTR(s2)); }
+  byte opcode = DA_READ(PC+1);
   char xy = prefix==0xDD ? 'x' : 'y';
 
   switch( opcode )
     {
-    case 0x09: pBN(Mem, PC, 2); pr("add  ", ",bc"); return 2;
-    case 0x19: pBN(Mem, PC, 2); pr("add  ", ",de"); return 2;
-    case 0x21: pBN(Mem, PC, 4); pr("ld   ", ","); pW(Mem, PC+2); return 4;
-    case 0x22: pBN(Mem, PC, 4); Serial.print(F("ld   (")); pW(Mem, PC+2); pr("),",""); return 4;
-    case 0x23: pBN(Mem, PC, 2); pr("inc  ", ""); return 2; 
-    case 0x24: pBN(Mem, PC, 2); pr("inc  ", "h"); return 2; 
-    case 0x25: pBN(Mem, PC, 2); pr("dec  ", "h"); return 2; 
-    case 0x26: pBN(Mem, PC, 3); pr("ld   ", "h,"); pB(Mem, PC+2); return 3;
-    case 0x29: pBN(Mem, PC, 2); pr("add  ", ",i"); Serial.print(xy); return 2;
-    case 0x2A: pBN(Mem, PC, 4); pr("ld   ", ",("); pW(Mem, PC+2); Serial.print(')'); return 4;
-    case 0x2B: pBN(Mem, PC, 2); pr("dec  ", ""); return 2; 
-    case 0x2C: pBN(Mem, PC, 2); pr("inc  ", "l"); return 2; 
-    case 0x2D: pBN(Mem, PC, 2); pr("dec  ", "l"); return 2; 
-    case 0x2E: pBN(Mem, PC, 3); pr("ld   ", "l,"); pB(Mem, PC+2); return 3;
-    case 0x34: pBN(Mem, PC, 3); Serial.print(F("inc  ")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x35: pBN(Mem, PC, 3); Serial.print(F("dec  ")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x36: pBN(Mem, PC, 4); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(','); pB(Mem, PC+3); return 4;
-    case 0x39: pBN(Mem, PC, 2); pr("add  ", ",sp"); return 2;
-    case 0x44: pBN(Mem, PC, 2); pr("ld   b,", "h"); return 2;
-    case 0x45: pBN(Mem, PC, 2); pr("ld   b,", "l"); return 2;
-    case 0x46: pBN(Mem, PC, 3); Serial.print(F("ld   b,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x4C: pBN(Mem, PC, 2); pr("ld   c,", "h"); return 2;
-    case 0x4D: pBN(Mem, PC, 2); pr("ld   c,", "l"); return 2;
-    case 0x4E: pBN(Mem, PC, 3); Serial.print(F("ld   c,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x54: pBN(Mem, PC, 2); pr("ld   d,", "h"); return 2;
-    case 0x55: pBN(Mem, PC, 2); pr("ld   d,", "l"); return 2;
-    case 0x56: pBN(Mem, PC, 3); Serial.print(F("ld   d,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x5C: pBN(Mem, PC, 2); pr("ld   e,", "h"); return 2;
-    case 0x5D: pBN(Mem, PC, 2); pr("ld   e,", "l"); return 2;
-    case 0x5E: pBN(Mem, PC, 3); Serial.print(F("ld   e,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x60: pBN(Mem, PC, 2); pr("ld   ","h,b"); return 2;
-    case 0x61: pBN(Mem, PC, 2); pr("ld   ","h,c"); return 2;
-    case 0x62: pBN(Mem, PC, 2); pr("ld   ","h,d"); return 2;
-    case 0x63: pBN(Mem, PC, 2); pr("ld   ","h,e"); return 2;
-    case 0x64: pBN(Mem, PC, 2); pr("ld   ","h,i"); Serial.print(xy); Serial.print('h'); return 2;
-    case 0x65: pBN(Mem, PC, 2); pr("ld   ","h,i"); Serial.print(xy); Serial.print('l'); return 2;
-    case 0x66: pBN(Mem, PC, 3); Serial.print(F("ld   h,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x67: pBN(Mem, PC, 2); pr("ld   ","l,a"); return 2;
-    case 0x68: pBN(Mem, PC, 2); pr("ld   ","l,b"); return 2;
-    case 0x69: pBN(Mem, PC, 2); pr("ld   ","l,c"); return 2;
-    case 0x6A: pBN(Mem, PC, 2); pr("ld   ","l,d"); return 2;
-    case 0x6B: pBN(Mem, PC, 2); pr("ld   ","l,e"); return 2;
-    case 0x6C: pBN(Mem, PC, 2); pr("ld   ","l,i"); Serial.print(xy); Serial.print('h'); return 2;
-    case 0x6D: pBN(Mem, PC, 2); pr("ld   ","l,i"); Serial.print(xy); Serial.print('l'); return 2;
-    case 0x6E: pBN(Mem, PC, 3); Serial.print(F("ld   l,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x6F: pBN(Mem, PC, 2); pr("ld   ","l,a"); return 2;
-    case 0x70: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",b")); return 3;
-    case 0x71: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",c")); return 3;
-    case 0x72: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",d")); return 3;
-    case 0x73: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",e")); return 3;
-    case 0x74: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",h")); return 3;
-    case 0x75: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",l")); return 3;
-    case 0x77: pBN(Mem, PC, 3); Serial.print(F("ld   ")); printIXYOffset(xy, MREAD(PC+2)); Serial.print(F(",a")); return 3;
-    case 0x7C: pBN(Mem, PC, 2); pr("ld   a,", "h"); return 2;
-    case 0x7D: pBN(Mem, PC, 2); pr("ld   a,", "l"); return 2;
-    case 0x7E: pBN(Mem, PC, 3); Serial.print(F("ld   a,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x84: pBN(Mem, PC, 2); pr("add  a,", "h"); return 2;
-    case 0x85: pBN(Mem, PC, 2); pr("add  a,", "l"); return 2;
-    case 0x86: pBN(Mem, PC, 3); Serial.print(F("add  a,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x8C: pBN(Mem, PC, 2); pr("adc  a,", "h"); return 2;
-    case 0x8D: pBN(Mem, PC, 2); pr("adc  a,", "l"); return 2;
-    case 0x8E: pBN(Mem, PC, 3); Serial.print(F("adc  a,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x94: pBN(Mem, PC, 2); pr("sub  a,", "h"); return 2;
-    case 0x95: pBN(Mem, PC, 2); pr("sub  a,", "l"); return 2;
-    case 0x96: pBN(Mem, PC, 3); Serial.print(F("sub  a,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0x9C: pBN(Mem, PC, 2); pr("sbc  a,", "h"); return 2;
-    case 0x9D: pBN(Mem, PC, 2); pr("sbc  a,", "l"); return 2;
-    case 0x9E: pBN(Mem, PC, 3); Serial.print(F("sbc  a,")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0xA4: pBN(Mem, PC, 2); pr("and  ", "h"); return 2;
-    case 0xA5: pBN(Mem, PC, 2); pr("and  ", "l"); return 2;
-    case 0xA6: pBN(Mem, PC, 3); Serial.print(F("and  ")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0xAC: pBN(Mem, PC, 2); pr("xor  ", "h"); return 2;
-    case 0xAD: pBN(Mem, PC, 2); pr("xor  ", "l"); return 2;
-    case 0xAE: pBN(Mem, PC, 3); Serial.print(F("xor  ")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0xB4: pBN(Mem, PC, 2); pr("or   ", "h"); return 2;
-    case 0xB5: pBN(Mem, PC, 2); pr("or   ", "l"); return 2;
-    case 0xB6: pBN(Mem, PC, 3); Serial.print(F("or   ")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0xBC: pBN(Mem, PC, 2); pr("cp   ", "h"); return 2;
-    case 0xBD: pBN(Mem, PC, 2); pr("cp   ", "l"); return 2;
-    case 0xBE: pBN(Mem, PC, 3); Serial.print(F("cp   ")); printIXYOffset(xy, MREAD(PC+2)); return 3;
-    case 0xCB: pBN(Mem, PC, 4); da_bitop(MREAD(PC+3), xy, MREAD(PC+2)); return 4;
-    case 0xE1: pBN(Mem, PC, 2); pr("pop  ", ""); return 2;
-    case 0xE3: pBN(Mem, PC, 2); pr("ex   (sp),", ""); return 2;
-    case 0xE5: pBN(Mem, PC, 2); pr("push ", ""); return 2;
-    case 0xE9: pBN(Mem, PC, 2); pr("jp   (", ")"); return 2;
-    case 0xF9: pBN(Mem, PC, 2); pr("ld   sp,", ""); return 2;
+    case 0x09: pr("add  ", ",bc"); return 2;
+    case 0x19: pr("add  ", ",de"); return 2;
+    case 0x21: pr("ld   ", ","); pW(d, Mem, PC+2); return 4;
+    case 0x22: da_str(d, PSTR("ld   (")); pA(d, Mem, PC+2); pr("),",""); return 4;
+    case 0x23: pr("inc  ", ""); return 2; 
+    case 0x24: pr("inc  ", "h"); return 2; 
+    case 0x25: pr("dec  ", "h"); return 2; 
+    case 0x26: pr("ld   ", "h,"); pB(d, Mem, PC+2); return 3;
+    case 0x29: pr("add  ", ",i"); da_char(d, xy); return 2;
+    case 0x2A: pr("ld   ", ",("); pA(d, Mem, PC+2); da_char(d, ')'); return 4;
+    case 0x2B: pr("dec  ", ""); return 2; 
+    case 0x2C: pr("inc  ", "l"); return 2; 
+    case 0x2D: pr("dec  ", "l"); return 2; 
+    case 0x2E: pr("ld   ", "l,"); pB(d, Mem, PC+2); return 3;
+    case 0x34: da_str(d, PSTR("inc  ")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x35: da_str(d, PSTR("dec  ")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x36: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_char(d, ','); pB(d, Mem, PC+3); return 4;
+    case 0x39: pr("add  ", ",sp"); return 2;
+    case 0x44: pr("ld   b,", "h"); return 2;
+    case 0x45: pr("ld   b,", "l"); return 2;
+    case 0x46: da_str(d, PSTR("ld   b,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x4C: pr("ld   c,", "h"); return 2;
+    case 0x4D: pr("ld   c,", "l"); return 2;
+    case 0x4E: da_str(d, PSTR("ld   c,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x54: pr("ld   d,", "h"); return 2;
+    case 0x55: pr("ld   d,", "l"); return 2;
+    case 0x56: da_str(d, PSTR("ld   d,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x5C: pr("ld   e,", "h"); return 2;
+    case 0x5D: pr("ld   e,", "l"); return 2;
+    case 0x5E: da_str(d, PSTR("ld   e,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x60: pr("ld   ","h,b"); return 2;
+    case 0x61: pr("ld   ","h,c"); return 2;
+    case 0x62: pr("ld   ","h,d"); return 2;
+    case 0x63: pr("ld   ","h,e"); return 2;
+    case 0x64: pr("ld   ","h,i"); da_char(d, xy); da_char(d, 'h'); return 2;
+    case 0x65: pr("ld   ","h,i"); da_char(d, xy); da_char(d, 'l'); return 2;
+    case 0x66: da_str(d, PSTR("ld   h,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x67: pr("ld   ","h,a"); return 2;
+    case 0x68: pr("ld   ","l,b"); return 2;
+    case 0x69: pr("ld   ","l,c"); return 2;
+    case 0x6A: pr("ld   ","l,d"); return 2;
+    case 0x6B: pr("ld   ","l,e"); return 2;
+    case 0x6C: pr("ld   ","l,i"); da_char(d, xy); da_char(d, 'h'); return 2;
+    case 0x6D: pr("ld   ","l,i"); da_char(d, xy); da_char(d, 'l'); return 2;
+    case 0x6E: da_str(d, PSTR("ld   l,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x6F: pr("ld   ","l,a"); return 2;
+    case 0x70: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",b")); return 3;
+    case 0x71: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",c")); return 3;
+    case 0x72: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",d")); return 3;
+    case 0x73: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",e")); return 3;
+    case 0x74: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",h")); return 3;
+    case 0x75: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",l")); return 3;
+    case 0x77: da_str(d, PSTR("ld   ")); printIXYOffset(d, xy, DA_READ(PC+2)); da_str(d, PSTR(",a")); return 3;
+    case 0x7C: pr("ld   a,", "h"); return 2;
+    case 0x7D: pr("ld   a,", "l"); return 2;
+    case 0x7E: da_str(d, PSTR("ld   a,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x84: pr("add  a,", "h"); return 2;
+    case 0x85: pr("add  a,", "l"); return 2;
+    case 0x86: da_str(d, PSTR("add  a,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x8C: pr("adc  a,", "h"); return 2;
+    case 0x8D: pr("adc  a,", "l"); return 2;
+    case 0x8E: da_str(d, PSTR("adc  a,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x94: pr("sub  a,", "h"); return 2;
+    case 0x95: pr("sub  a,", "l"); return 2;
+    case 0x96: da_str(d, PSTR("sub  a,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0x9C: pr("sbc  a,", "h"); return 2;
+    case 0x9D: pr("sbc  a,", "l"); return 2;
+    case 0x9E: da_str(d, PSTR("sbc  a,")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0xA4: pr("and  ", "h"); return 2;
+    case 0xA5: pr("and  ", "l"); return 2;
+    case 0xA6: da_str(d, PSTR("and  ")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0xAC: pr("xor  ", "h"); return 2;
+    case 0xAD: pr("xor  ", "l"); return 2;
+    case 0xAE: da_str(d, PSTR("xor  ")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0xB4: pr("or   ", "h"); return 2;
+    case 0xB5: pr("or   ", "l"); return 2;
+    case 0xB6: da_str(d, PSTR("or   ")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0xBC: pr("cp   ", "h"); return 2;
+    case 0xBD: pr("cp   ", "l"); return 2;
+    case 0xBE: da_str(d, PSTR("cp   ")); printIXYOffset(d, xy, DA_READ(PC+2)); return 3;
+    case 0xCB: da_bitop(d, DA_READ(PC+3), xy, DA_READ(PC+2)); return 4;
+    case 0xE1: pr("pop  ", ""); return 2;
+    case 0xE3: pr("ex   (sp),", ""); return 2;
+    case 0xE5: pr("push ", ""); return 2;
+    case 0xE9: d->flags |= DA_JUMP; pr("jp   (", ")"); return 2;
+    case 0xF9: pr("ld   sp,", ""); return 2;
 
     default:
-      pBN(Mem, PC, 1); 
-      Serial.print('[');
-      numsys_print_byte(prefix);
-      Serial.print(']');
+      
+      da_char(d, '[');
+      da_byte(d, prefix);
+      da_char(d, ']');
       return 1;
     }
 }
 
 
-static byte da_bit(byte opcode, byte *Mem, uint16_t PC) // 0xCB prefix
+static byte da_bit(byte opcode, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d) // 0xCB prefix
 {
-  pBN(Mem, PC, 2); 
-  da_bitop(MREAD(PC+1), 0, 0);
+  
+  da_bitop(d, DA_READ(PC+1), 0, 0);
   return 2;
 }
 
 
-static byte da_ext(byte prefix, byte *Mem, uint16_t PC) // 0xED prefix
+static byte da_ext(byte prefix, const byte *Mem, uint16_t PC, struct DisassemblerInfo *d) // 0xED prefix
 {
   // extended instructions
-  byte opcode = MREAD(PC+1);
+  byte opcode = DA_READ(PC+1);
 
   switch( opcode & 0xCF )
     {
     case 0x40: 
-    case 0x48: pBN(Mem, PC, 2); Serial.print(F("in   ")); pRN((opcode & 0x38)/8); Serial.print(F(",(c)")); return 2;
+    case 0x48: da_str(d, PSTR("in   ")); pRN(d, (opcode & 0x38)/8); da_str(d, PSTR(",(c)")); return 2;
     case 0x41:
-    case 0x49: pBN(Mem, PC, 2); Serial.print(F("out  ")); pRN((opcode & 0x38)/8); Serial.print(F(",(c)")); return 2;
-    case 0x42: pBN(Mem, PC, 2); Serial.print(F("sbc  hl,")); pR2N((opcode & 0x30)/16); return 2;
-    case 0x4A: pBN(Mem, PC, 2); Serial.print(F("adc  hl,")); pR2N((opcode & 0x30)/16); return 2;
-    case 0x43: pBN(Mem, PC, 4); Serial.print(F("ld   (")); pW(Mem, PC+2); Serial.print(F("),")); pR2N((opcode & 0x30)/16); return 4;
-    case 0x4B: pBN(Mem, PC, 4); Serial.print(F("ld   ")); pR2N((opcode & 0x30)/16); Serial.print(F(",(")); pW(Mem, PC+2); Serial.print(')'); return 4;
+    case 0x49: da_str(d, PSTR("out  ")); pRN(d, (opcode & 0x38)/8); da_str(d, PSTR(",(c)")); return 2;
+    case 0x42: da_str(d, PSTR("sbc  hl,")); pR2N(d, (opcode & 0x30)/16); return 2;
+    case 0x4A: da_str(d, PSTR("adc  hl,")); pR2N(d, (opcode & 0x30)/16); return 2;
+    case 0x43: da_str(d, PSTR("ld   (")); pA(d, Mem, PC+2); da_str(d, PSTR("),")); pR2N(d, (opcode & 0x30)/16); return 4;
+    case 0x4B: da_str(d, PSTR("ld   ")); pR2N(d, (opcode & 0x30)/16); da_str(d, PSTR(",(")); pA(d, Mem, PC+2); da_char(d, ')'); return 4;
     case 0x44:
-    case 0x4C: pBN(Mem, PC, 2); Serial.print(F("neg")); return 2;
+    case 0x4C: da_str(d, PSTR("neg")); return 2;
     case 0x45:
-    case 0x4D: pBN(Mem, PC, 2); Serial.print(F("retn")); return 2;
-    case 0x46: pBN(Mem, PC, 2); Serial.print(F("im   ")); Serial.print((opcode & 0x10) ? F("0")   : F("1")); return 2;
-    case 0x4E: pBN(Mem, PC, 2); Serial.print(F("im   ")); Serial.print((opcode & 0x10) ? F("0/1") : F("2")); return 2;
+    case 0x4D: d->flags |= DA_RET; da_str(d, opcode==0x4D ? PSTR("reti") : PSTR("retn")); return 2;
+    case 0x46: da_str(d, PSTR("im   ")); da_str(d, (opcode & 0x10) ? PSTR("1") : PSTR("0")); return 2;
+    case 0x4E: da_str(d, PSTR("im   ")); da_str(d, (opcode & 0x10) ? PSTR("2") : PSTR("0/1")); return 2;
       
     default:
       {
         switch( opcode )
           {
-          case 0x47: pBN(Mem, PC, 2); Serial.print(F("ld   i,a")); return 2;
-          case 0x4F: pBN(Mem, PC, 2); Serial.print(F("ld   r,a")); return 2;
-          case 0x57: pBN(Mem, PC, 2); Serial.print(F("ld   a,i")); return 2;
-          case 0x5F: pBN(Mem, PC, 2); Serial.print(F("ld   a,r")); return 2;
-          case 0x67: pBN(Mem, PC, 2); Serial.print(F("rrd")); return 2;
-          case 0x6F: pBN(Mem, PC, 2); Serial.print(F("rld")); return 2;
-          case 0xA0: pBN(Mem, PC, 2); Serial.print(F("ldi")); return 2;
-          case 0xA1: pBN(Mem, PC, 2); Serial.print(F("cpi")); return 2;
-          case 0xA2: pBN(Mem, PC, 2); Serial.print(F("ini")); return 2;
-          case 0xA3: pBN(Mem, PC, 2); Serial.print(F("outi")); return 2;
-          case 0xA8: pBN(Mem, PC, 2); Serial.print(F("ldd")); return 2;
-          case 0xA9: pBN(Mem, PC, 2); Serial.print(F("cpd")); return 2;
-          case 0xAA: pBN(Mem, PC, 2); Serial.print(F("ind")); return 2;
-          case 0xAB: pBN(Mem, PC, 2); Serial.print(F("outd")); return 2;
-          case 0xB0: pBN(Mem, PC, 2); Serial.print(F("ldir")); return 2;
-          case 0xB1: pBN(Mem, PC, 2); Serial.print(F("cpir")); return 2;
-          case 0xB2: pBN(Mem, PC, 2); Serial.print(F("inir")); return 2;
-          case 0xB3: pBN(Mem, PC, 2); Serial.print(F("otir")); return 2;
-          case 0xB8: pBN(Mem, PC, 2); Serial.print(F("lddr")); return 2;
-          case 0xB9: pBN(Mem, PC, 2); Serial.print(F("cpdr")); return 2;
-          case 0xBA: pBN(Mem, PC, 2); Serial.print(F("indr")); return 2;
-          case 0xBB: pBN(Mem, PC, 2); Serial.print(F("otdr")); return 2;
+          case 0x47: da_str(d, PSTR("ld   i,a")); return 2;
+          case 0x4F: da_str(d, PSTR("ld   r,a")); return 2;
+          case 0x57: da_str(d, PSTR("ld   a,i")); return 2;
+          case 0x5F: da_str(d, PSTR("ld   a,r")); return 2;
+          case 0x67: da_str(d, PSTR("rrd")); return 2;
+          case 0x6F: da_str(d, PSTR("rld")); return 2;
+          case 0xA0: da_str(d, PSTR("ldi")); return 2;
+          case 0xA1: da_str(d, PSTR("cpi")); return 2;
+          case 0xA2: da_str(d, PSTR("ini")); return 2;
+          case 0xA3: da_str(d, PSTR("outi")); return 2;
+          case 0xA8: da_str(d, PSTR("ldd")); return 2;
+          case 0xA9: da_str(d, PSTR("cpd")); return 2;
+          case 0xAA: da_str(d, PSTR("ind")); return 2;
+          case 0xAB: da_str(d, PSTR("outd")); return 2;
+          case 0xB0: da_str(d, PSTR("ldir")); return 2;
+          case 0xB1: da_str(d, PSTR("cpir")); return 2;
+          case 0xB2: da_str(d, PSTR("inir")); return 2;
+          case 0xB3: da_str(d, PSTR("otir")); return 2;
+          case 0xB8: da_str(d, PSTR("lddr")); return 2;
+          case 0xB9: da_str(d, PSTR("cpdr")); return 2;
+          case 0xBA: da_str(d, PSTR("indr")); return 2;
+          case 0xBB: da_str(d, PSTR("otdr")); return 2;
       
           default:
-            pBN(Mem, PC, 1); 
-            Serial.print('[');
-            numsys_print_byte(prefix);
-            Serial.print(']');
+            
+            da_char(d, '[');
+            da_byte(d, prefix);
+            da_char(d, ']');
             return 1;
           }
       }
@@ -771,14 +771,13 @@ const DAFUN da_opcodes[] PROGMEM = {
 };
 
 
-byte disassemble_z80(byte *Mem, uint16_t PC, bool pb)
+byte disassemble_z80(const byte *Mem, uint16_t PC, struct DisassemblerInfo *d)
 {
-  print_bytes = pb;
-  byte opcode = MREAD(PC);
+  byte opcode = DA_READ(PC);
 #if defined(__AVR_ATmega2560__)
-  return ((DAFUN)pgm_read_word(&da_opcodes[opcode]))(opcode, Mem, PC);
+  return ((DAFUN)pgm_read_word(&da_opcodes[opcode]))(opcode, Mem, PC, d);
 #else
-  return (da_opcodes[opcode])(opcode, Mem, PC);
+  return (da_opcodes[opcode])(opcode, Mem, PC, d);
 #endif
 }
 
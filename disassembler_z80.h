@@ -6,6 +6,7 @@
 #ifndef DISASSEMBLER_Z80_H
 #define DISASSEMBLER_Z80_H
 
-byte disassemble_z80(byte *Mem, uint16_t PC, bool print_bytes);
+struct DisassemblerInfo;
+byte disassemble_z80(const byte *Mem, uint16_t PC, struct DisassemblerInfo *info);
 
 #endif
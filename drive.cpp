@@ -26,6 +26,7 @@
 #include "image.h"
 #include "host.h"
 #include "io.h"
+#include "profile.h"
 
 #if NUM_DRIVES == 0
 
@@ -38,6 +39,7 @@ bool drive_unmount(byte drive_num) { return false; }
 byte drive_get_mounted_image(byte drive_num) { return 0; }
 void drive_reset() {}
 void drive_set_realtime(bool b) {}
+void drive_sync() {}
 
 #elif NUM_DRIVES>16
 
@@ -61,24 +63,32 @@ void drive_set_realtime(bool b) {}
 #define DRIVE_STATUS_INT_EN      8
 #define DRIVE_STATUS_REALTIME   16
 
-static byte drive_selected = 0xff;
-static byte drive_mounted_disk[NUM_DRIVES];
-static byte drive_status[NUM_DRIVES];
-static byte drive_current_track[NUM_DRIVES];
-static byte drive_current_sector[NUM_DRIVES];
-static byte drive_current_byte[NUM_DRIVES];
-static byte drive_sector_buffer[NUM_DRIVES][DRIVE_SECTOR_LENGTH];
-static byte drive_num_sectors[NUM_DRIVES];
-static byte drive_num_tracks[NUM_DRIVES];
-static HOST_FILESYS_FILE_TYPE drive_file[NUM_DRIVES];
+static MACHINE_STATE byte drive_selected = 0xff;
+static MACHINE_STATE byte drive_mounted_disk[NUM_DRIVES];
+static MACHINE_STATE byte drive_status[NUM_DRIVES];
+static MACHINE_STATE byte drive_current_track[NUM_DRIVES];
+static MACHINE_STATE byte drive_current_sector[NUM_DRIVES];
+static MACHINE_STATE byte drive_current_byte[NUM_DRIVES];
+static MACHINE_STATE byte drive_sector_buffer[NUM_DRIVES][DRIVE_SECTOR_LENGTH];
+static MACHINE_STATE byte drive_num_sectors[NUM_DRIVES];
+static MACHINE_STATE byte drive_num_tracks[NUM_DRIVES];
+static MACHINE_STATE byte drive_file[NUM_DRIVES];
+
+#if USE_DRIVE_CACHE>0
+// complete disk image in RAM plus one "dirty" bit per sector (bit n of
+// drive_cache_dirty[d][t] is set if sector n on track t was modified)
+#define DRIVE_CACHE_SYNC_DELAY 1000000
+static MACHINE_STATE byte    *drive_cache[NUM_DRIVES];
+static MACHINE_STATE uint32_t drive_cache_dirty[NUM_DRIVES][DRIVE_NUM_TRACKS];
+#endif
 
 #define DRIVE_SECTOR_TRUE_DELAY       5170
 #define DRIVE_SECTOR_NOT_TRUE_DELAY     30
 #define DRIVE_HEAD_STEP_DELAY1       10000
 #define DRIVE_HEAD_STEP_DELAY2        1000
 #define DRIVE_HEAD_STEP_DELAY3       20000
-static bool drive_sector_true = false;
-static byte drive_head_moving = 0;
+static MACHINE_STATE bool drive_sector_true = false;
+static MACHINE_STATE byte drive_head_moving = 0;
 
 static void drive_register_ports();
 
@@ -88,6 +98,81 @@ static uint32_t drive_get_file_pos(byte drive_num)
 }
 
 
+#if USE_DRIVE_CACHE>0
+
+static void drive_cache_sync(byte drive_num)
+{
+  // write all modified sectors back to the image file, combining
+  // consecutive modified sectors into one write
+  if( drive_cache[drive_num]==NULL ) return;
+
+  bool written = false;
+  uint16_t n = drive_num_tracks[drive_num] * drive_num_sectors[drive_num];
+  for(uint16_t i=0; i<n; )
+    {
+      byte t = i / drive_num_sectors[drive_num], s = i % drive_num_sectors[drive_num];
+      if( drive_cache_dirty[drive_num][t] & (1ul << s) )
+        {
+          uint16_t start = i;
+          do
+            {
+              drive_cache_dirty[drive_num][t] &= ~(1ul << s);
+              i++;
+              t = i / drive_num_sectors[drive_num];
+              s = i % drive_num_sectors[drive_num];
+            }
+          while( i<n && (drive_cache_dirty[drive_num][t] & (1ul << s)) );
+
+          uint32_t pos = (uint32_t) start * DRIVE_SECTOR_LENGTH;
+          image_file_seek(drive_file[drive_num], pos);
+          image_file_write(drive_file[drive_num], (uint32_t) (i-start) * DRIVE_SECTOR_LENGTH, drive_cache[drive_num]+pos);
+          written = true;
+        }
+      else
+        i++;
+    }
+
+  if( written ) image_file_flush(drive_file[drive_num]);
+}
+
+
+static bool drive_cache_load(byte drive_num)
+{
+  if( drive_file[drive_num]==IMAGE_FILE_NONE ) return false;
+
+  uint32_t len = (uint32_t) drive_num_tracks[drive_num] * drive_num_sectors[drive_num] * DRIVE_SECTOR_LENGTH;
+  drive_cache[drive_num] = (byte *) malloc(len);
+  if( drive_cache[drive_num]==NULL ) return false;
+
+  // image files may be shorter than the full disk (or empty) => rest reads as 0
+  image_file_seek(drive_file[drive_num], 0);
+  uint32_t n = image_file_read(drive_file[drive_num], len, drive_cache[drive_num]);
+  if( n<len ) memset(drive_cache[drive_num]+n, 0, len-n);
+  memset(drive_cache_dirty[drive_num], 0, sizeof(drive_cache_dirty[drive_num]));
+  return true;
+}
+
+
+static void drive_cache_free(byte drive_num)
+{
+  drive_cache_sync(drive_num);
+  free(drive_cache[drive_num]);
+  drive_cache[drive_num] = NULL;
+}
+
+#endif
+
+
+void drive_sync()
+{
+#if USE_DRIVE_CACHE>0
+  timer_stop(TIMER_DSYNC);
+  for(byte i=0; i<NUM_DRIVES; i++)
+    drive_cache_sync(i);
+#endif
+}
+
+
 static void drive_flush(byte drive_num)
 {
   if( (drive_status[drive_num] & DRIVE_STATUS_WRITE) && drive_current_byte[drive_num]>0 )
@@ -95,11 +180,23 @@ static void drive_flush(byte drive_num)
       drive_sector_true = false;
 
       //Serial.print(F("Writing disk: ")); Serial.println(drive_get_file_pos(drive_selected));
-      host_filesys_file_seek(drive_file[drive_num], drive_get_file_pos(drive_num));
-      host_filesys_file_write(drive_file[drive_num], drive_current_byte[drive_num], drive_sector_buffer[drive_num]);
+#if USE_DRIVE_CACHE>0
+      if( drive_cache[drive_num]!=NULL )
+        {
+          memcpy(drive_cache[drive_num]+drive_get_file_pos(drive_num), drive_sector_buffer[drive_num], drive_current_byte[drive_num]);
+          drive_cache_dirty[drive_num][drive_current_track[drive_num]] |= 1ul << drive_current_sector[drive_num];
+          if( !timer_running(TIMER_DSYNC) ) timer_start(TIMER_DSYNC);
+        }
+      else
+#endif
+        {
+          image_file_seek(drive_file[drive_num], drive_get_file_pos(drive_num));
+          image_file_write(drive_file[drive_num], drive_current_byte[drive_num], drive_sector_buffer[drive_num]);
+          image_file_flush(drive_file[drive_num]);
+        }
       drive_status[drive_num] &= ~DRIVE_STATUS_WRITE;
       drive_current_byte[drive_num] = 0xff;
-      host_filesys_file_flush(drive_file[drive_num]);
+      PROFILE_COUNT_DISK_WRITE(PROF_DISK_DCDD, drive_num);
     }
 }
 
@@ -162,9 +259,12 @@ bool drive_unmount(byte drive_num)
   if( drive_num<NUM_DRIVES && (drive_status[drive_num] & DRIVE_STATUS_HAVEDISK) )
     {
       drive_flush(drive_num);
+#if USE_DRIVE_CACHE>0
+      drive_cache_free(drive_num);
+#endif
       drive_status[drive_num] &= DRIVE_STATUS_REALTIME;
       drive_mounted_disk[drive_num] = 0;
-      host_filesys_file_close(drive_file[drive_num]);
+      image_file_close(drive_file[drive_num]);
       altair_interrupt(INT_DRIVE, false);
       drive_register_ports();
     }
@@ -198,13 +298,10 @@ bool drive_mount(byte drive_num, byte image_num)
       if( drive_status[drive_num] & DRIVE_STATUS_HAVEDISK ) drive_unmount(drive_num);
       if( image_num>0 )
         {
-          char filename[13];
-          image_get_filename(IMAGE_FLOPPY, image_num, filename, 13, false);
-          int32_t size = host_filesys_file_size(filename);
-
           drive_mounted_disk[drive_num] = image_num;
           drive_status[drive_num] |= DRIVE_STATUS_HAVEDISK;
-          drive_file[drive_num] = host_filesys_file_open(filename, true);
+          drive_file[drive_num] = image_file_open(IMAGE_FLOPPY, image_num, DRIVE_SECTOR_LENGTH);
+          uint32_t size = image_file_size(drive_file[drive_num]);
 
           if( size>0 && size<100000 )
             {
@@ -219,6 +316,11 @@ bool drive_mount(byte drive_num, byte image_num)
               drive_num_sectors[drive_num] = DRIVE_NUM_SECTORS;
             }
 
+#if USE_DRIVE_CACHE>0
+          // if the image does not fit into RAM then access the file directly
+          drive_cache_load(drive_num);
+#endif
+
           drive_register_ports();
           return true;
         }
@@ -360,9 +462,17 @@ byte drive_in(byte addr)
               {
                 // read new sector from file
                 //Serial.print(F("Reading disk: ")); Serial.println(drive_get_file_pos(drive_selected));
-                host_filesys_file_seek(drive_file[drive_selected], drive_get_file_pos(drive_selected));
-                byte n = host_filesys_file_read(drive_file[drive_selected], DRIVE_SECTOR_LENGTH, drive_sector_buffer[drive_selected]);
-                if( n<DRIVE_SECTOR_LENGTH ) memset(drive_sector_buffer[drive_selected]+n, 0, DRIVE_SECTOR_LENGTH-n);
+#if USE_DRIVE_CACHE>0
+                if( drive_cache[drive_selected]!=NULL )
+                  memcpy(drive_sector_buffer[drive_selected], drive_cache[drive_selected]+drive_get_file_pos(drive_selected), DRIVE_SECTOR_LENGTH);
+                else
+#endif
+                  {
+                    image_file_seek(drive_file[drive_selected], drive_get_file_pos(drive_selected));
+                    byte n = image_file_read(drive_file[drive_selected], DRIVE_SECTOR_LENGTH, drive_sector_buffer[drive_selected]);
+                    if( n<DRIVE_SECTOR_LENGTH ) memset(drive_sector_buffer[drive_selected]+n, 0, DRIVE_SECTOR_LENGTH-n);
+                  }
+                PROFILE_COUNT_DISK_READ(PROF_DISK_DCDD, drive_selected);
                 drive_current_byte[drive_selected] = 0;
               }
             
@@ -535,12 +645,21 @@ void drive_setup()
       drive_mounted_disk[i] = 0;
       drive_num_tracks[i] = DRIVE_NUM_TRACKS;
       drive_num_sectors[i] = DRIVE_NUM_SECTORS;
+      drive_file[i] = IMAGE_FILE_NONE;
+#if USE_DRIVE_CACHE>0
+      drive_cache[i] = NULL;
+#endif
     }
 
   drive_register_ports();
   
   // prepare sector change timer interrupt 
   timer_setup(TIMER_DRIVE, DRIVE_SECTOR_TRUE_DELAY, drive_sector_interrupt);
+
+#if USE_DRIVE_CACHE>0
+  // write modified sectors back to the image files at most one second after modification
+  timer_setup(TIMER_DSYNC, DRIVE_CACHE_SYNC_DELAY, drive_sync);
+#endif
 }
 
 
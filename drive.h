@@ -17,5 +17,6 @@ bool drive_unmount(byte drive_num);
 byte drive_get_mounted_image(byte drive_num);
 void drive_reset();
 void drive_set_realtime(bool b);
+void drive_sync();
 
 #endif
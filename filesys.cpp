@@ -23,7 +23,7 @@
 #include "serial.h"
 
 #define MAX_OPEN_FILES 3
-static byte num_open_files = 0;
+static MACHINE_STATE byte num_open_files = 0;
 
 #ifndef HOST_BUFFERSIZE
 #define HOST_BUFFERSIZE 0
@@ -36,8 +36,8 @@ static byte num_open_files = 0;
 // --------------------------- Host provides filesystem ---------------------------
 
 
-static byte file_open[MAX_OPEN_FILES];
-static HOST_FILESYS_FILE_TYPE file_info[MAX_OPEN_FILES];
+static MACHINE_STATE byte file_open[MAX_OPEN_FILES];
+static MACHINE_STATE HOST_FILESYS_FILE_TYPE file_info[MAX_OPEN_FILES];
 
 static byte alloc_file_id(bool write)
 {
@@ -65,7 +65,7 @@ static void free_file_id(byte fid)
 
 static const char* filesys_get_fname(char nm1, char nm2)
 {
-  static char buf[10];
+  static MACHINE_STATE char buf[10];
 
   switch( nm1 )
     {
@@ -284,12 +284,12 @@ struct DirEntryStruct
   uint32_t pos;
 };
 
-static uint32_t dir_start = 0;
-static struct DirEntryStruct file_data[MAX_OPEN_FILES];
+static MACHINE_STATE uint32_t dir_start = 0;
+static MACHINE_STATE struct DirEntryStruct file_data[MAX_OPEN_FILES];
 
 #if HOST_BUFFERSIZE>1
-static uint32_t write_buffer_len = 0;
-static byte     write_buffer[HOST_BUFFERSIZE];
+static MACHINE_STATE uint32_t write_buffer_len = 0;
+static MACHINE_STATE byte     write_buffer[HOST_BUFFERSIZE];
 #endif
 
 
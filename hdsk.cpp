@@ -25,9 +25,20 @@
 #include "timer.h"
 #include "image.h"
 #include "io.h"
+#include "profile.h"
+#include "mem.h"
+#include "breakpoint.h"
 
 #define DEBUGLVL 0
 
+// bulk transfers skip the per-instruction hooks of the simulation loop
+// so they can not be used together with per-instruction profiling
+#if USE_HDSK_BULK_TRANSFER>0 && USE_PROFILING_DETAIL==0 && USE_PROFILING_PC==0 && USE_PROFILING_CALLS==0 && USE_PROFILING_IO==0 && USE_PROFILING_COVERAGE==0 && USE_PROFILING_TRACE==0
+#define HDSK_BULK_TRANSFER 1
+#else
+#define HDSK_BULK_TRANSFER 0
+#endif
+
 #if NUM_HDSK_UNITS == 0
 
 void hdsk_reset() {}
@@ -40,6 +51,7 @@ bool hdsk_unmount(byte unit_num, byte platter_num) { return false; }
 byte hdsk_get_mounted_image(byte unit_num, byte platter_num) { return 0; }
 void hdsk_dir() {}
 void hdsk_set_realtime(bool b) {}
+bool hdsk_set_bulk_transfer(bool b) { return !b; }
 
 #elif !defined(HOST_HAS_FILESYS)
 
@@ -48,8 +60,8 @@ void hdsk_set_realtime(bool b) {}
 #else
 
 
-static byte pio_data[4];
-static byte pio_control[4];
+static MACHINE_STATE byte pio_data[4];
+static MACHINE_STATE byte pio_control[4];
 
 #if DEBUGLVL >= 3
 const char *signames[8] = { "CREADY", "CSTAT", "ACSTA", "ACMD", "CDSTA", "CDATA", "ADSTA", "ADATA" };
@@ -72,6 +84,14 @@ static void hdsk_CDATA_strobe();
 // lets the controller know that ADATA was written (CB2 of port 2)
 static void hdsk_ADATA_strobe();
 
+#if HDSK_BULK_TRANSFER>0
+// performs the remainder of a recognized CDATA read loop
+static byte hdsk_bulk_read(byte data);
+
+// performs the remainder of a recognized ADATA write loop
+static void hdsk_bulk_write();
+#endif
+
 
 static void hdsk_4pio_CRDY_set(bool set = true)
 {
@@ -141,7 +161,12 @@ void hdsk_4pio_out(byte addr, byte data)
       switch( port )
         {
         case 1: hdsk_ACMD_strobe();  break; // PIO port 1 section B: ACMD
-        case 3: hdsk_ADATA_strobe(); break; // PIO port 2 section B: ADATA
+        case 3: // PIO port 2 section B: ADATA
+          hdsk_ADATA_strobe();
+#if HDSK_BULK_TRANSFER>0
+          hdsk_bulk_write();
+#endif
+          break;
         }
     }
 }
@@ -176,7 +201,12 @@ byte hdsk_4pio_in(byte addr)
       switch( port )
         {
         case 0: hdsk_CSTAT_strobe(); break; // PIO port 1 section A: CSTAT
-        case 2: hdsk_CDATA_strobe(); break; // PIO port 2 section A: CDATA
+        case 2: // PIO port 2 section A: CDATA
+          hdsk_CDATA_strobe();
+#if HDSK_BULK_TRANSFER>0
+          data = hdsk_bulk_read(data);
+#endif
+          break;
         }
     }
   
@@ -195,19 +225,19 @@ byte hdsk_4pio_in(byte addr)
 
 // -------------------------------------------------------------------------------------------------
 
-static bool hdsk_realtime;
-static byte hdsk_buffer_num;
-static byte hdsk_buffer_ptr;
-static byte hdsk_buffer_ctr;
-static byte hdsk_ivbyte_num;
-static byte hdsk_unit, hdsk_head, hdsk_sect, hdsk_current_sect;
-static byte hdsk_ivbyte_B, hdsk_ivbyte_C, hdsk_ivbyte_E, hdsk_ivbyte_I;
-static word hdsk_cyl[4], hdsk_seek;
-static byte hdsk_buffer[4][256];
-static byte hdsk_mounted_image[NUM_HDSK_UNITS][4];
-static HOST_FILESYS_FILE_TYPE hdsk_file[NUM_HDSK_UNITS][4];
+static MACHINE_STATE bool hdsk_realtime;
+static MACHINE_STATE byte hdsk_buffer_num;
+static MACHINE_STATE byte hdsk_buffer_ptr;
+static MACHINE_STATE byte hdsk_buffer_ctr;
+static MACHINE_STATE byte hdsk_ivbyte_num;
+static MACHINE_STATE byte hdsk_unit, hdsk_head, hdsk_sect, hdsk_current_sect;
+static MACHINE_STATE byte hdsk_ivbyte_B, hdsk_ivbyte_C, hdsk_ivbyte_E, hdsk_ivbyte_I;
+static MACHINE_STATE word hdsk_cyl[4], hdsk_seek;
+static MACHINE_STATE byte hdsk_buffer[4][256];
+static MACHINE_STATE byte hdsk_mounted_image[NUM_HDSK_UNITS][4];
+static MACHINE_STATE byte hdsk_file[NUM_HDSK_UNITS][4];
 
-static uint32_t hdsk_current_sect_cycles;
+static MACHINE_STATE uint32_t hdsk_current_sect_cycles;
 
 #define NUM_TRACKS           406
 #define NUM_SECTORS           24
@@ -257,8 +287,8 @@ static uint32_t hdsk_current_sect_cycles;
 #define ADATA  pio_data[3]
 #define CRDY_INTERRUPT ((pio_control[0] & 1)!=0)
 
-static byte hdsk_current_cmd;
-static bool hdsk_ACMD_strobed;
+static MACHINE_STATE byte hdsk_current_cmd;
+static MACHINE_STATE bool hdsk_ACMD_strobed;
 
 void hdsk_ivbyte_set(byte addr, byte value);
 byte hdsk_ivbyte_read(byte addr);
@@ -285,7 +315,7 @@ static const char *hdsk_cmd_str(byte cmd)
 }
 
 
-inline HOST_FILESYS_FILE_TYPE &get_file()
+inline byte get_file()
 {
   return hdsk_file[hdsk_unit][hdsk_head/2];
 }
@@ -378,8 +408,8 @@ void check_read_only()
   // if we can't write but we can read then the disk image is write-protected
   // otherwise there is some other serious error
   byte dummy;
-  host_filesys_file_seek(get_file(), mk_offset());
-  if( host_filesys_file_read(get_file(), 1, &dummy)>0 )
+  image_file_seek(get_file(), mk_offset());
+  if( image_file_read(get_file(), 1, &dummy)>0 )
     CSTAT |= ERR_WRITE_PROTECT;
   else
     CSTAT |= ERR_CRC_HEADER_READ;
@@ -405,7 +435,7 @@ void hdsk_timer()
                 hdsk_cyl[hdsk_unit] = hdsk_seek;
                 
                 // seek to the beginning of the new track in the file
-                host_filesys_file_seek(get_file(), mk_offset());
+                image_file_seek(get_file(), mk_offset());
               }
 
 #if DEBUGLVL >= 2
@@ -415,7 +445,7 @@ void hdsk_timer()
 
             // write two sectors at a time
             uint32_t t = micros();
-            if( host_filesys_file_set(get_file(), 2*NUM_BYTES_PER_SECTOR, 0)<2*NUM_BYTES_PER_SECTOR )
+            if( image_file_set(get_file(), 2*NUM_BYTES_PER_SECTOR, 0)<2*NUM_BYTES_PER_SECTOR )
               {
                 // could not write
                 check_read_only();
@@ -451,7 +481,7 @@ void hdsk_timer()
           {
             // format is finished
             hdsk_seek = 405;
-            host_filesys_file_flush(get_file());
+            image_file_flush(get_file());
           }
 
         break;
@@ -566,20 +596,24 @@ void hdsk_ACMD_strobe()
           }
         else 
           {
-            host_filesys_file_seek(get_file(), mk_offset());
-            if( host_filesys_file_read(get_file(), NUM_BYTES_PER_SECTOR, hdsk_buffer[hdsk_buffer_num]) < NUM_BYTES_PER_SECTOR )
+            image_file_seek(get_file(), mk_offset());
+            if( image_file_read(get_file(), NUM_BYTES_PER_SECTOR, hdsk_buffer[hdsk_buffer_num]) < NUM_BYTES_PER_SECTOR )
               {
                 // error while reading
                 CSTAT |= ERR_CRC_SECTOR_READ;
                 hdsk_current_cmd = CMD_NONE;
                 hdsk_4pio_CRDY_set(); // ready for next command
               }
-            else if( hdsk_realtime || CRDY_INTERRUPT )
-              timer_start(TIMER_HDSK, hdsk_calc_time_to_sector(hdsk_sect));
             else
               {
-                hdsk_current_cmd = CMD_NONE;
-                hdsk_4pio_CRDY_set(); // ready for next command
+                PROFILE_COUNT_DISK_READ(PROF_DISK_HDSK, hdsk_unit);
+                if( hdsk_realtime || CRDY_INTERRUPT )
+                  timer_start(TIMER_HDSK, hdsk_calc_time_to_sector(hdsk_sect));
+                else
+                  {
+                    hdsk_current_cmd = CMD_NONE;
+                    hdsk_4pio_CRDY_set(); // ready for next command
+                  }
               }
           }
             
@@ -603,8 +637,8 @@ void hdsk_ACMD_strobe()
           }
         else 
           {
-            host_filesys_file_seek(get_file(), mk_offset());
-            if( host_filesys_file_write(get_file(), NUM_BYTES_PER_SECTOR, hdsk_buffer[hdsk_buffer_num])<NUM_BYTES_PER_SECTOR )
+            image_file_seek(get_file(), mk_offset());
+            if( image_file_write(get_file(), NUM_BYTES_PER_SECTOR, hdsk_buffer[hdsk_buffer_num])<NUM_BYTES_PER_SECTOR )
               {
                 // can't write
                 check_read_only();
@@ -614,7 +648,8 @@ void hdsk_ACMD_strobe()
             else 
               {
                 // success
-                host_filesys_file_flush(get_file());
+                image_file_flush(get_file());
+                PROFILE_COUNT_DISK_WRITE(PROF_DISK_HDSK, hdsk_unit);
                 if( hdsk_realtime || CRDY_INTERRUPT )
                   timer_start(TIMER_HDSK, hdsk_calc_time_to_sector(hdsk_sect));
                 else
@@ -672,8 +707,8 @@ void hdsk_ACMD_strobe()
                 hdsk_sect = 0;
                 for(hdsk_cyl[hdsk_unit]=0; hdsk_cyl[hdsk_unit]<NUM_TRACKS; hdsk_cyl[hdsk_unit]++)
                   {
-                    host_filesys_file_seek(get_file(), mk_offset());
-                    if( host_filesys_file_set(get_file(), NUM_BYTES_PER_SECTOR*NUM_SECTORS, 0)<NUM_BYTES_PER_SECTOR*NUM_SECTORS )
+                    image_file_seek(get_file(), mk_offset());
+                    if( image_file_set(get_file(), NUM_BYTES_PER_SECTOR*NUM_SECTORS, 0)<NUM_BYTES_PER_SECTOR*NUM_SECTORS )
                       {
                         // could not write
                         check_read_only();
@@ -786,6 +821,156 @@ void hdsk_ADATA_strobe()
 }
 
 
+#if HDSK_BULK_TRANSFER>0
+
+// The HDSK boot loader and BIOS move data to/from the controller buffers
+// using tight loops of the form
+//    loop: IN 0245  / MOV M,A or STAX D / INX H or INX D / DCR B or DCR C / JNZ loop
+//    loop: MOV A,M or LDAX D / OUT 0247 / INX H or INX D / DCR B or DCR C / JNZ loop
+// (INX and DCR in either order). When the CPU executes the IN/OUT of such a loop
+// we perform all further iterations except the last one right away. The CPU then 
+// executes the rest of the last iteration itself, so registers and flags end up
+// exactly as they would have when running the loop instruction by instruction.
+// Both CPU cores charge the same number of cycles for these loops (the Z80 core 
+// uses 6 cycles for INX and 4 for DCR, the 8080 core 5 for each).
+#define HDSK_BULK_LOOP_LEN     8
+#define HDSK_BULK_READ_CYCLES  (10+1+7+5+5+10)
+#define HDSK_BULK_WRITE_CYCLES (7+10+5+5+10)
+
+static MACHINE_STATE bool hdsk_bulk_enabled = true;
+
+
+static bool hdsk_bulk_loop(uint16_t start, uint16_t addr, uint16_t *ptr, byte **ctr)
+{
+  // check for INX/DCR followed by "JNZ start" at addr
+  byte code[5];
+  for(byte i=0; i<5; i++) code[i] = MREAD_MEM(addr++);
+
+  byte inx = ptr==&regHL.HL ? 0x23 : 0x13;
+  if( code[0]==inx ) 
+    code[0] = code[1];
+  else if( code[1]!=inx ) 
+    return false;
+
+  if( code[0]==0x05 )
+    *ctr = &regB;
+  else if( code[0]==0x0D )
+    *ctr = &regC;
+  else
+    return false;
+
+  return code[2]==0xC2 && code[3]==(start & 0xff) && code[4]==(start / 256);
+}
+
+
+static bool hdsk_bulk_possible(uint16_t start)
+{
+  // no bulk transfers while single-stepping or if a breakpoint is set within the loop
+  return hdsk_bulk_enabled && !host_read_status_led_WAIT() && !breakpoint_in_range(start, HDSK_BULK_LOOP_LEN);
+}
+
+
+static bool hdsk_bulk_before_timer(byte cycles)
+{
+  // true if no timer expires during the next loop iteration. Stopping before
+  // an iteration in which a timer expires lets the CPU run that iteration, so
+  // the timer function (and a possible interrupt) runs after the same
+  // instruction as without bulk transfers.
+  return timer_cycle_counter+cycles < timer_next_expire_cycles;
+}
+
+
+static void hdsk_bulk_step(byte cycles)
+{
+  // account for the five instructions of a skipped loop iteration
+#ifdef HOST_HAS_BATCH_MODE
+  if( prof_instruction_active ) prof_instruction_count += 5;
+#endif
+#if USE_Z80!=0
+  regRL += 5;
+#endif
+
+  // no timer expires here (see hdsk_bulk_before_timer)
+  TIMER_ADD_CYCLES(cycles);
+}
+
+
+byte hdsk_bulk_read(byte data)
+{
+  // called after reading CDATA, regPC points to the port number of the IN instruction
+  uint16_t start = regPC-1, *ptr;
+  if( hdsk_current_cmd!=CMD_READBUF || hdsk_buffer_ctr==1 || !hdsk_bulk_possible(start) )
+    return data;
+
+  byte op = MREAD_MEM((uint16_t) (regPC+1)), *ctr;
+  if( op==0x77 )      ptr = &regHL.HL;
+  else if( op==0x12 ) ptr = &regDE.DE;
+  else return data;
+
+  if( MREAD_MEM(start)!=0xDB || MREAD_MEM(regPC)!=0245 || !hdsk_bulk_loop(start, regPC+2, ptr, &ctr) )
+    return data;
+
+  // stop before the iteration that completes the command (sets CRDY which may
+  // cause an interrupt) or ends the loop, if an interrupt is pending, a timer
+  // expires or if the loop would overwrite itself
+  while( hdsk_current_cmd==CMD_READBUF && hdsk_buffer_ctr!=1 && *ctr!=1 && 
+         (uint16_t) (*ptr-start)>=HDSK_BULK_LOOP_LEN && !altair_interrupt_pending() &&
+         hdsk_bulk_before_timer(HDSK_BULK_READ_CYCLES) )
+    {
+      // MOV M,A/STAX D - INX - DCR - JNZ of the current iteration
+      MEM_WRITE(*ptr, data);
+      (*ptr)++;
+      (*ctr)--;
+
+      // IN 0245 of the next iteration
+      data = CDATA;
+      pio_control[2] &= 0x7f;
+      hdsk_CDATA_strobe();
+      PROFILE_COUNT_IO_INP(0245);
+      hdsk_bulk_step(HDSK_BULK_READ_CYCLES);
+    }
+
+  return data;
+}
+
+
+void hdsk_bulk_write()
+{
+  // called after writing ADATA, regPC points to the port number of the OUT instruction
+  uint16_t start = regPC-2, *ptr;
+  if( hdsk_current_cmd!=CMD_WRITEBUF || hdsk_buffer_ctr==1 || !hdsk_bulk_possible(start) )
+    return;
+
+  byte op = MREAD_MEM(start), *ctr;
+  if( op==0x7E )      ptr = &regHL.HL;
+  else if( op==0x1A ) ptr = &regDE.DE;
+  else return;
+
+  if( MREAD_MEM((uint16_t) (regPC-1))!=0xD3 || MREAD_MEM(regPC)!=0247 || !hdsk_bulk_loop(start, regPC+1, ptr, &ctr) )
+    return;
+
+  // stop before the iteration that completes the command or ends the loop,
+  // if an interrupt is pending or a timer expires
+  while( hdsk_current_cmd==CMD_WRITEBUF && hdsk_buffer_ctr!=1 && *ctr!=1 && 
+         (pio_control[3] & 4)!=0 && !altair_interrupt_pending() &&
+         hdsk_bulk_before_timer(HDSK_BULK_WRITE_CYCLES) )
+    {
+      // INX - DCR - JNZ of the current iteration
+      (*ptr)++;
+      (*ctr)--;
+
+      // MOV A,M/LDAX D - OUT 0247 of the next iteration
+      regA = MEM_READ(*ptr);
+      ADATA = regA;
+      hdsk_ADATA_strobe();
+      PROFILE_COUNT_IO_OUT(0247);
+      hdsk_bulk_step(HDSK_BULK_WRITE_CYCLES);
+    }
+}
+
+#endif
+
+
 void hdsk_ivbyte_set(byte addr, byte value)
 {
 #if DEBUGLVL >= 2
@@ -941,7 +1126,10 @@ void hdsk_setup()
 
   for(i=0; i<NUM_HDSK_UNITS; i++)
     for(j=0; j<4; j++)
-      hdsk_mounted_image[i][j] = 0;
+      {
+        hdsk_mounted_image[i][j] = 0;
+        hdsk_file[i][j] = IMAGE_FILE_NONE;
+      }
 
   hdsk_ivbyte_B = 0xff;
   hdsk_ivbyte_C = 0xff;
@@ -977,10 +1165,8 @@ bool hdsk_mount(byte unit_num, byte platter_num, byte image_num)
       hdsk_unmount(unit_num, platter_num);
       if( image_num>0 )
         {
-          char filename[13];
           hdsk_mounted_image[unit_num][platter_num] = image_num;
-          image_get_filename(IMAGE_HDSK, image_num, filename, 13, false);
-          hdsk_file[unit_num][platter_num] = host_filesys_file_open(filename, true);
+          hdsk_file[unit_num][platter_num] = image_file_open(IMAGE_HDSK, image_num, NUM_BYTES_PER_SECTOR);
           hdsk_register_ports();
         }
 
@@ -998,7 +1184,7 @@ bool hdsk_unmount(byte unit_num, byte platter_num)
       if (hdsk_mounted_image[unit_num][platter_num] > 0)
         {
           hdsk_mounted_image[unit_num][platter_num] = 0;
-          host_filesys_file_close(hdsk_file[unit_num][platter_num]);
+          image_file_close(hdsk_file[unit_num][platter_num]);
           hdsk_register_ports();
         }
       return true;
@@ -1029,4 +1215,15 @@ void hdsk_set_realtime(bool b)
 }
 
 
+bool hdsk_set_bulk_transfer(bool b)
+{
+#if HDSK_BULK_TRANSFER>0
+  hdsk_bulk_enabled = b;
+  return true;
+#else
+  return !b;
+#endif
+}
+
+
 #endif
@@ -11,6 +11,10 @@ byte hdsk_get_mounted_image(byte unit_num, byte platter_num);
 void hdsk_dir();
 void hdsk_set_realtime(bool b);
 
+// turns the USE_HDSK_BULK_TRANSFER fast path on or off at run time,
+// returns false if asked to turn it on but it is not compiled in
+bool hdsk_set_bulk_transfer(bool b);
+
 void hdsk_reset();
 void hdsk_setup();
 
@@ -20,7 +20,10 @@
 #if defined(_WIN32) || defined(__linux__)
 
 #include <time.h>
+#include <stdarg.h>
 #include <string>
+#include <atomic>
+#include <chrono>
 #include "Altair8800.h"
 #include "mem.h"
 #include "serial.h"
@@ -28,6 +31,13 @@
 #include "host_pc.h"
 #include "profile.h"
 #include "timer.h"
+#include "drive.h"
+#include "hdsk.h"
+#include "image.h"
+#include "breakpoint.h"
+#include "prog.h"
+#include "disassembler.h"
+#include "config.h"
 
 
 // un-define Serial which was #define'd to SwitchSerialClass in switch_serial.h
@@ -49,6 +59,13 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <pthread.h>
 #include <unistd.h>
 typedef int SOCKET;
 #define INVALID_SOCKET -1
@@ -60,15 +77,15 @@ static unsigned long long int signal_write_buf = 1;
 
 #include <Arduino.h>
 
-byte data_leds;
-uint16_t status_leds;
-uint16_t addr_leds;
-byte stop_request;
+MACHINE_STATE byte data_leds;
+MACHINE_STATE uint16_t status_leds;
+MACHINE_STATE uint16_t addr_leds;
+MACHINE_STATE byte stop_request;
 
 //#define DEBUG
 
-uint32_t boot_timeout = 0;
-uint16_t boot_function_switches = 0, boot_address_switches = 0;
+static MACHINE_STATE uint32_t boot_timeout = 0;
+static MACHINE_STATE uint16_t boot_function_switches = 0, boot_address_switches = 0;
 
 
 // for HOST_PC, function switches are only read during boot to determine
@@ -115,7 +132,24 @@ void host_reset_function_switch_state()
 // ----------------------------------------------------------------------------------
 
 
-static FILE *storagefile = NULL;
+static MACHINE_STATE FILE *storagefile = NULL;
+
+// these are defined and initialized in the main() function in Arduino/Arduino.cpp
+extern int    g_argc;
+extern char **g_argv;
+extern bool g_batch;
+
+
+static const char *storage_filename(const char *ext)
+{
+  // machine 0 uses AltairStorage.dat, all others AltairStorage<n>.dat
+  static MACHINE_STATE char fname[30];
+  if( g_machine==0 )
+    snprintf(fname, 30, "AltairStorage.%s", ext);
+  else
+    snprintf(fname, 30, "AltairStorage%i.%s", g_machine, ext);
+  return fname;
+}
 
 
 bool host_storage_init(bool write)
@@ -124,11 +158,11 @@ bool host_storage_init(bool write)
 
   if( write )
     {
-      storagefile = fopen("AltairStorage.dat", "r+b");
+      storagefile = fopen(storage_filename("dat"), "r+b");
       if( storagefile==NULL ) 
         {
           void *chunk = calloc(1024, 1);
-          storagefile = fopen("AltairStorage.dat", "wb");
+          storagefile = fopen(storage_filename("dat"), "wb");
           if( storagefile!=NULL )
             {
               uint32_t size;
@@ -138,11 +172,11 @@ bool host_storage_init(bool write)
               fclose(storagefile);
             }
       
-          storagefile = fopen("AltairStorage.dat", "r+b");
+          storagefile = fopen(storage_filename("dat"), "r+b");
         }
     }
   else
-    storagefile = fopen("AltairStorage.dat", "rb");
+    storagefile = fopen(storage_filename("dat"), "rb");
 
   return storagefile!=NULL;
 }
@@ -150,7 +184,7 @@ bool host_storage_init(bool write)
 
 void host_storage_close()
 {
-  if( storagefile ) fclose(storagefile);
+  if( storagefile ) { fclose(storagefile); storagefile = NULL; }
 }
 
 
@@ -200,7 +234,9 @@ void host_storage_move(uint32_t to, uint32_t from, uint32_t len)
 void host_storage_invalidate()
 {
   if( storagefile ) { fclose(storagefile); storagefile = NULL; }
-  rename("AltairStorage.dat", "AltairStorage.bak");
+  char *fname = strdup(storage_filename("dat"));
+  rename(fname, storage_filename("bak"));
+  free(fname);
 }
 
 
@@ -233,7 +269,11 @@ static bool isDir(const char *path)
 
 static const char *get_full_path(const char *filename)
 {
-  static char fnamebuf[30];
+  static MACHINE_STATE char fnamebuf[30];
+
+  // names that include a directory are host paths (e.g. "-C" captures)
+  if( strchr(filename, DIRSEP[0])!=NULL ) return filename;
+
   snprintf(fnamebuf, 30, "disks" DIRSEP "%s", filename);
   return fnamebuf;
 }
@@ -259,12 +299,14 @@ FILE *host_filesys_file_open(const char *filename, bool write)
 
 uint32_t host_filesys_file_read(FILE *&f, uint32_t len, void *buffer)
 {
+  PROFILE_HOST_SCOPE(PROF_HOST_FILE);
   return fread(buffer, 1, len, f);
 }
 
 
 uint32_t host_filesys_file_write(FILE *&f, uint32_t len, const void *buffer)
 {
+  PROFILE_HOST_SCOPE(PROF_HOST_FILE);
   return fwrite(buffer, 1, len, f);
 }
 
@@ -285,12 +327,14 @@ uint32_t host_filesys_file_set(FILE *&f, uint32_t len, byte b)
 
 void host_filesys_file_flush(FILE *&f)
 {
+  PROFILE_HOST_SCOPE(PROF_HOST_FILE);
   fflush(f);
 }
 
 
 bool host_filesys_file_seek(FILE *&f, uint32_t pos)
 {
+  PROFILE_HOST_SCOPE(PROF_HOST_FILE);
   return fseek(f, pos, SEEK_SET)==0;
 }
 
@@ -309,7 +353,9 @@ bool host_filesys_file_eof(FILE *&f)
 
 void host_filesys_file_close(FILE *&f)
 {
-  fclose(f);
+  // like File::close() on the Arduino, leaves the handle invalid
+  if( f ) fclose(f);
+  f = NULL;
 }
 
 
@@ -394,7 +440,7 @@ bool host_filesys_ok()
 
 // ----------------------------------------------------------------------------------------------------
 
-static host_serial_receive_callback_tp serial_receive_callbacks[HOSTPC_NUM_SOCKET_CONN+1];
+static MACHINE_STATE host_serial_receive_callback_tp serial_receive_callbacks[HOST_NUM_SERIAL_PORTS];
 
 static int ctrlC = 0;
 
@@ -410,9 +456,203 @@ uint32_t host_get_random()
 }
 
 
-static int      inp_serial[HOSTPC_NUM_SOCKET_CONN+1];
-static uint32_t cycles_per_char[HOSTPC_NUM_SOCKET_CONN+1];
-static SOCKET   iface_socket[HOSTPC_NUM_SOCKET_CONN];
+// Serial data is passed between the input/output thread and the simulation
+// thread through lock-free single-producer/single-consumer ring buffers:
+// one per interface for each direction. head and tail are free-running byte
+// counters: only the producer advances head, only the consumer advances tail.
+#define HOST_SERIAL_BUFFER_SIZE 4096  // must be a power of 2
+
+struct HostSerialBuffer
+{
+  std::atomic<uint32_t> head, tail;
+  byte data[HOST_SERIAL_BUFFER_SIZE];
+};
+
+// output is handed to the input/output thread (or written to the console)
+// when a buffer is half full or when this many cycles have passed since
+// the first unsent character
+#define HOST_SERIAL_FLUSH_CYCLES 10000
+
+#define OUT_PENDING_SOCKET  0x01
+#define OUT_PENDING_CONSOLE 0x02
+
+
+// Each simulated machine has its own set of host serial interfaces which
+// is shared between the machine's simulation thread and its input thread.
+// Machine 0 has the console as interface 0 and clients connected to port
+// 8800 as interfaces 1-4. Other machines have no console, all of their
+// interfaces are clients connected to port 8800+<machine number>.
+// On Linux, "-L device=port,..." adds listening ports for simulated serial
+// devices: any number of clients connecting there share the host interface
+// the device is mapped to (all of them receive its output). "-P device,..."
+// creates a pseudo terminal for each given device which behaves like such
+// a client while a program has it open.
+struct HostSerialData
+{
+  int      machine;
+  int      port;
+  int      first_socket_iface;
+  struct HostSerialBuffer inbuf[HOST_NUM_SERIAL_PORTS];
+  struct HostSerialBuffer outbuf[HOST_NUM_SERIAL_PORTS];
+  byte     out_pending;         // OUT_PENDING_* flags, simulation thread only
+  uint32_t out_pending_cycles;  // simulation thread only
+#ifdef _WIN32
+  SOCKET   iface_socket[HOST_NUM_SERIAL_PORTS];
+  HANDLE   signalEvent;
+#else
+  std::atomic<int>  iface_conns[HOST_NUM_SERIAL_PORTS]; // number of clients per interface
+  int               dev_port[NUM_SERIAL_DEVICES];       // "-L" listening port per device (0=none)
+  std::atomic<byte> dev_iface[NUM_SERIAL_DEVICES];      // host interface of each device...
+  std::atomic<bool> dev_iface_request;                  // ...published on request
+  const char       *dev_pty[NUM_SERIAL_DEVICES];        // "-P": NULL=none, else symlink path (may be empty)
+  char              dev_pty_name[NUM_SERIAL_DEVICES][32];
+  int      signalEvent;
+  int      console_fd;  // -1 if no console input (or end of batch input)
+#endif
+};
+
+#ifdef _WIN32
+#define IFACE_CONNECTED(hs, i) ((hs)->iface_socket[i]!=INVALID_SOCKET)
+#else
+#define IFACE_CONNECTED(hs, i) ((hs)->iface_conns[i]>0)
+#endif
+
+static MACHINE_STATE struct HostSerialData *hs;
+static MACHINE_STATE uint32_t cycles_per_char[HOST_NUM_SERIAL_PORTS];
+
+#define IS_CONSOLE(hs, i) ((i)==0 && (hs)->machine==0)
+
+static const char *host_serial_port_name(struct HostSerialData *hs, byte i);
+#ifndef _WIN32
+static void host_serial_publish_mapping(struct HostSerialData *hs);
+#endif
+static void batch_check_output(byte c);
+static void metrics_check();
+static int  metrics_port = 0;
+
+
+// number of bytes that can be added to the buffer (producer only)
+static uint32_t sbuf_free(struct HostSerialBuffer *b)
+{
+  return HOST_SERIAL_BUFFER_SIZE - (b->head.load(std::memory_order_relaxed) - b->tail.load(std::memory_order_acquire));
+}
+
+
+// contiguous free space at the buffer head (producer only), data
+// written there becomes visible to the consumer in sbuf_commit
+static byte *sbuf_space(struct HostSerialBuffer *b, uint32_t *len)
+{
+  uint32_t pos = b->head.load(std::memory_order_relaxed) & (HOST_SERIAL_BUFFER_SIZE-1);
+  uint32_t n   = sbuf_free(b);
+  *len = n < HOST_SERIAL_BUFFER_SIZE-pos ? n : HOST_SERIAL_BUFFER_SIZE-pos;
+  return b->data + pos;
+}
+
+
+static void sbuf_commit(struct HostSerialBuffer *b, uint32_t n)
+{
+  b->head.store(b->head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+
+static void sbuf_put(struct HostSerialBuffer *b, byte c)
+{
+  uint32_t len;
+  byte *p = sbuf_space(b, &len);
+  if( len>0 ) { *p = c; sbuf_commit(b, 1); }
+}
+
+
+// number of bytes waiting in the buffer (consumer only)
+static uint32_t sbuf_available(struct HostSerialBuffer *b)
+{
+  return b->head.load(std::memory_order_acquire) - b->tail.load(std::memory_order_relaxed);
+}
+
+
+// contiguous data at the buffer tail (consumer only), the space
+// is returned to the producer in sbuf_consume
+static byte *sbuf_data(struct HostSerialBuffer *b, uint32_t *len)
+{
+  uint32_t pos = b->tail.load(std::memory_order_relaxed) & (HOST_SERIAL_BUFFER_SIZE-1);
+  uint32_t n   = sbuf_available(b);
+  *len = n < HOST_SERIAL_BUFFER_SIZE-pos ? n : HOST_SERIAL_BUFFER_SIZE-pos;
+  return b->data + pos;
+}
+
+
+static void sbuf_consume(struct HostSerialBuffer *b, uint32_t n)
+{
+  b->tail.store(b->tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+
+#ifdef _WIN32
+// only used by the Windows input/output thread, which drops
+// buffered output when a client connects or disconnects
+static void sbuf_discard(struct HostSerialBuffer *b)
+{
+  b->tail.store(b->head.load(std::memory_order_acquire), std::memory_order_release);
+}
+#endif
+
+
+static int sbuf_peek(struct HostSerialBuffer *b)
+{
+  uint32_t len;
+  byte *p = sbuf_data(b, &len);
+  return len>0 ? *p : -1;
+}
+
+
+static int inbuf_get(struct HostSerialData *hs, byte i)
+{
+  struct HostSerialBuffer *b = &hs->inbuf[i];
+  uint32_t n = sbuf_available(b);
+  if( n==0 ) return -1;
+
+  byte c = sbuf_peek(b);
+  sbuf_consume(b, 1);
+
+  // the input thread stops waiting for input on a full buffer
+  // => signal it that it can receive more
+  if( n==HOST_SERIAL_BUFFER_SIZE ) SignalEvent(hs->signalEvent);
+
+  return c;
+}
+
+
+// hand buffered socket output over to the input/output thread
+// and write out buffered console output
+static void output_flush(struct HostSerialData *hs)
+{
+  if( hs->out_pending & OUT_PENDING_SOCKET )  SignalEvent(hs->signalEvent);
+  if( hs->out_pending & OUT_PENDING_CONSOLE ) Serial.flush();
+  hs->out_pending = 0;
+}
+
+
+#ifdef _WIN32
+// called by the input/output thread: send as much buffered output as the
+// socket takes without blocking
+static void outbuf_send(struct HostSerialData *hs, byte i)
+{
+  struct HostSerialBuffer *b = &hs->outbuf[i];
+  uint32_t len;
+
+  while( sbuf_available(b)>0 )
+    {
+      byte *p = sbuf_data(b, &len);
+      int r = send(hs->iface_socket[i], (const char *) p, len, 0);
+
+      // stop if the socket would block (a dropped connection
+      // is detected when reading from the socket)
+      if( r<=0 ) break;
+      sbuf_consume(b, r);
+    }
+}
+#endif
+
 
 static SOCKET set_up_listener(const char* pcAddress, int nPort)
 {
@@ -442,27 +682,30 @@ static SOCKET set_up_listener(const char* pcAddress, int nPort)
 }
 
 
-#ifdef _WIN32
+// device names used by the "-L", "-P", "-C" and "-R" options
+static const char *host_serial_dev_names[6] = {"sio", "acr", "2sio1", "2sio2", "2sio3", "2sio4"};
+
 
-static HANDLE signalEvent;
+#ifdef _WIN32
 
 DWORD WINAPI host_input_thread(void *data)
 {
-  WSAEVENT eventHandles[6], socket_accept_event, socket_read_event[HOSTPC_NUM_SOCKET_CONN];
+  struct HostSerialData *hs = (struct HostSerialData *) data;
+  WSAEVENT eventHandles[HOST_NUM_SERIAL_PORTS+3], socket_accept_event, socket_read_event[HOST_NUM_SERIAL_PORTS];
   SOCKET accept_socket = INVALID_SOCKET;
 
   // initialize socket for secondary interface
   WSADATA wsaData;
   WSAStartup(MAKEWORD(1,1), &wsaData);
 #if HOSTPC_NUM_SOCKET_CONN>0
-  accept_socket = set_up_listener("127.0.0.1", htons(8800));
+  accept_socket = set_up_listener("127.0.0.1", htons(hs->port));
   if( accept_socket == INVALID_SOCKET )
-    printf("Can not listen on port 8800 => secondary interface not available\n");
+    fprintf(g_batch ? stderr : stdout, "Can not listen on port %i => secondary interface not available\n", hs->port);
   else
     {
       socket_accept_event = WSACreateEvent();
       WSAEventSelect(accept_socket, socket_accept_event, FD_ACCEPT);
-      for(int i=0; i<HOSTPC_NUM_SOCKET_CONN; i++) socket_read_event[i] = WSACreateEvent();
+      for(int i=0; i<HOST_NUM_SERIAL_PORTS; i++) socket_read_event[i] = WSACreateEvent();
     }
 #endif
   
@@ -473,7 +716,7 @@ DWORD WINAPI host_input_thread(void *data)
     {
       int i, n = 0;
 
-      if( inp_serial[0]<0 )
+      if( hs->machine==0 && !g_batch && sbuf_free(&hs->inbuf[0])>0 )
         { 
           // ready to receive more data on console (primary input)
           eventHandles[n++] = stdIn; 
@@ -482,18 +725,22 @@ DWORD WINAPI host_input_thread(void *data)
      if( accept_socket != INVALID_SOCKET )
        eventHandles[n++] = socket_accept_event; 
 
-      for(i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
-        if( iface_socket[i] != INVALID_SOCKET && inp_serial[i+1]<0 )
+      for(i=hs->first_socket_iface; i<HOST_NUM_SERIAL_PORTS; i++)
+        if( hs->iface_socket[i] != INVALID_SOCKET )
           {
-            // ready to receive more data on this socket
-            eventHandles[n++] = socket_read_event[i]; 
+            // send buffered output
+            outbuf_send(hs, i);
+
+            // ready to receive more data or to send remaining output on this socket
+            if( sbuf_free(&hs->inbuf[i])>0 || sbuf_available(&hs->outbuf[i])>0 )
+              eventHandles[n++] = socket_read_event[i]; 
           }
 
       // adding this allows host_check_interrupts to signal this thread that 
       // an input has been read and we can accept more inputs now (otherwise
       // we may get stuck in WSAWaitForMultipleEvents even though more input
       // is available)
-      eventHandles[n++] = signalEvent;
+      eventHandles[n++] = hs->signalEvent;
 
       // wait until we either
       // - get input on console (if we are ready to accept more)
@@ -510,7 +757,8 @@ DWORD WINAPI host_input_thread(void *data)
               if( Serial.available() )
                 {
                   // we received some console input (reading it resets the event)
-                  inp_serial[0] = Serial.read();
+                  do { sbuf_put(&hs->inbuf[0], Serial.read()); }
+                  while( sbuf_free(&hs->inbuf[0])>0 && Serial.available() );
                 }
               else
                 {
@@ -524,25 +772,26 @@ DWORD WINAPI host_input_thread(void *data)
             {
               sockaddr_in sinRemote;
               socklen_t nAddrSize = sizeof(sinRemote);
-              for(i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
-                if( iface_socket[i]==INVALID_SOCKET )
+              for(i=hs->first_socket_iface; i<HOST_NUM_SERIAL_PORTS; i++)
+                if( hs->iface_socket[i]==INVALID_SOCKET )
                   break;
 
-              if( i<HOSTPC_NUM_SOCKET_CONN )
+              if( i<HOST_NUM_SERIAL_PORTS )
                 {
-                  iface_socket[i] = accept(accept_socket, (sockaddr*)&sinRemote, &nAddrSize);
-                  if( iface_socket[i]!=INVALID_SOCKET )
+                  hs->iface_socket[i] = accept(accept_socket, (sockaddr*)&sinRemote, &nAddrSize);
+                  if( hs->iface_socket[i]!=INVALID_SOCKET )
                     {
                       const char *s = "[Connected as: ";
-                      send(iface_socket[i],s,strlen(s), 0);
-                      s = host_serial_port_name(i+1);
-                      send(iface_socket[i],s,strlen(s), 0);
+                      send(hs->iface_socket[i],s,strlen(s), 0);
+                      s = host_serial_port_name(hs, i);
+                      send(hs->iface_socket[i],s,strlen(s), 0);
                       s = "]\r\n";
-                      send(iface_socket[i],s,strlen(s), 0);
+                      send(hs->iface_socket[i],s,strlen(s), 0);
                       
-                      //printf("Connected client to serial #%i\n", i+1);
+                      //printf("Connected client to serial #%i\n", i);
+                      sbuf_discard(&hs->outbuf[i]);
                       WSAResetEvent(socket_read_event[i]);
-                      WSAEventSelect(iface_socket[i], socket_read_event[i], FD_READ | FD_CLOSE);
+                      WSAEventSelect(hs->iface_socket[i], socket_read_event[i], FD_READ | FD_WRITE | FD_CLOSE);
                     }
                 }
               else
@@ -557,27 +806,29 @@ DWORD WINAPI host_input_thread(void *data)
             }
           else
             {
-              for(i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
+              for(i=hs->first_socket_iface; i<HOST_NUM_SERIAL_PORTS; i++)
                 if( eventHandles[result]==socket_read_event[i] )
                   {
                     // either input or connection drop
-                    char c;
-                    if( recv(iface_socket[i], &c, 1, 0)==0 )
+                    uint32_t len;
+                    byte *p = sbuf_space(&hs->inbuf[i], &len);
+                    int r = recv(hs->iface_socket[i], (char *) p, len, 0);
+                    if( r==0 )
                       {
                         // no input => connection was dropped
-                        iface_socket[i] = INVALID_SOCKET;
-                        inp_serial[i+1] = -1;
-                        //printf("Disconnected serial #%i\n", i+2);
+                        hs->iface_socket[i] = INVALID_SOCKET;
+                        sbuf_discard(&hs->outbuf[i]);
+                        //printf("Disconnected serial #%i\n", i);
                       }
                     else
                       {
                         // received input on socket
                         DWORD n;
-                        inp_serial[i+1] = (byte) c;
-                        //printf("Received %i on serial #%i\n", c, i+2);
+                        if( r>0 ) sbuf_commit(&hs->inbuf[i], r);
+                        //printf("Received %i bytes on serial #%i\n", r, i);
                         
                         // if no more data to read then reset the event
-                        if( ioctlsocket(iface_socket[i], FIONREAD, &n)==0 && n==0 ) WSAResetEvent(socket_read_event[i]);
+                        if( ioctlsocket(hs->iface_socket[i], FIONREAD, &n)==0 && n==0 ) WSAResetEvent(socket_read_event[i]);
                       }
                   }
             }
@@ -589,372 +840,1844 @@ DWORD WINAPI host_input_thread(void *data)
 
 #else
 
-static int signalEvent;
+// Client connections and listening ports of the Linux input/output thread.
+// All sockets are non-blocking. Connections are registered edge-triggered
+// with epoll, so their readiness is remembered here until it can be acted
+// upon (i.e. there is room in the input buffer or output to send).
+#define HS_EV_SIGNAL   0
+#define HS_EV_CONSOLE  1
+#define HS_EV_LISTENER 2
+#define HS_EV_CONN     3
 
-void *host_input_thread(void *data)
+struct HostSerialListener
 {
-  SOCKET accept_socket = INVALID_SOCKET;
-  fd_set s_rd, s_wr, s_ex;
-  int i;
+  byte   kind;      // HS_EV_LISTENER
+  byte   dev;       // serial device for "-L" listeners, 0xff for default port
+  SOCKET sock;
+  struct HostSerialListener *next;
+};
 
-  // initialize socket for secondary interface
-#if HOSTPC_NUM_SOCKET_CONN>0
-  accept_socket = set_up_listener("0.0.0.0", htons(8800));
-  if( accept_socket == INVALID_SOCKET )
-    printf("Can not listen on port 8800 => secondary interface not available\r\n");
-#endif
+struct HostSerialConn
+{
+  byte     kind;    // HS_EV_CONN
+  byte     iface;   // 0xff while waiting for the device mapping (0xfe: pty of unmapped device)
+  byte     dev;
+  bool     readable, writable;
+  bool     pty;     // sock is the master side of a pseudo terminal
+  bool     hangup;  // pseudo terminal is not open on the other side
+  SOCKET   sock;    // INVALID_SOCKET once closed (freed in next loop iteration)
+  uint32_t out_pos; // next byte of the interface's output buffer to send
+  struct HostSerialConn *next;
+};
 
-  FD_ZERO(&s_wr);
-  FD_ZERO(&s_ex);
-  while( 1 )
-    {
-      FD_ZERO(&s_rd);
-
-      int nfds = 0;
-      if( inp_serial[0]<0 )
-	{
-          // ready to receive more data on console (primary interface)
-	  FD_SET(fileno(stdin), &s_rd);
-	  if( fileno(stdin)>=nfds ) nfds = fileno(stdin)+1;
-	}
-
-      for(i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
-	if( iface_socket[i] != INVALID_SOCKET && inp_serial[i+1]<0 )
-	  {
-	    // ready to receive more data on socket
-	    FD_SET(iface_socket[i], &s_rd); 
-	    if( iface_socket[i]>=nfds ) nfds = iface_socket[i]+1;
-	  }
-
-      if( accept_socket != INVALID_SOCKET )
-	{
-          // ready to accept connection on socket
-	  FD_SET(accept_socket, &s_rd); 
-	  if( accept_socket>=nfds ) nfds = accept_socket+1;
-	}
+static const byte hs_ev_signal = HS_EV_SIGNAL, hs_ev_console = HS_EV_CONSOLE;
 
-      // adding this allows host_check_interrupts to signal this thread that 
-      // an input has been read and we can accept more inputs now (otherwise
-      // we may get stuck in WSAWaitForMultipleEvents even though more input
-      // is available)
-      FD_SET(signalEvent, &s_rd);
-      if( signalEvent>=nfds ) nfds = signalEvent+1;
 
-      // wait until we either
-      // - get input on console (if we are ready to accept more)
-      // - get input on socket (if we are ready to accept more)
-      // - a new client is connected (if none is connected right now)
-      // - host_check_interrupts has signaled that there was a change in
-      //   whether we are ready to accept more data
-      if( select(nfds, &s_rd, NULL, NULL, NULL) >= 0 )
-        {
-	  if( FD_ISSET(signalEvent, &s_rd) )
-	    {
-	      // clear the signal
-	      byte buf[8]; 
-	      read(signalEvent, buf, 8)==0;
-	    }
-
-          if( FD_ISSET(fileno(stdin), &s_rd) )
-	    inp_serial[0] = Serial.read();
-
-	  for(i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
-	    if( iface_socket[i] != INVALID_SOCKET && FD_ISSET(iface_socket[i], &s_rd) )
-            {
-              char c;
-              if( recv(iface_socket[i], &c, 1, MSG_NOSIGNAL)==0 )
-                {
-                  // no input => connection was dropped
-                  iface_socket[i] = INVALID_SOCKET;
-                  inp_serial[i+1] = -1;
-                }
-              else
-                {
-                  // received input on socket
-		  //printf("Received %02X on serial #%i\r\n", (byte) c, i+1);
-                  inp_serial[i+1] = (byte) c;
-                }
-            }
+static void conn_send_text(struct HostSerialConn *c, const char *text)
+{
+  // a failed write shows up as an error or hangup event
+  // in host_input_thread which closes the connection
+  ssize_t n;
+  if( c->pty )
+    n = write(c->sock, text, strlen(text));
+  else
+    n = send(c->sock, text, strlen(text), MSG_NOSIGNAL);
+  (void) n;
+}
 
-	  if( accept_socket != INVALID_SOCKET && FD_ISSET(accept_socket, &s_rd) )
-            {
-              sockaddr_in sinRemote;
-              socklen_t nAddrSize = sizeof(sinRemote);
 
-	      for(i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
-		if( iface_socket[i]==INVALID_SOCKET )
-		  break;
-
-	      if( i<HOSTPC_NUM_SOCKET_CONN )
-		{
-		  // accept a new connection
-		  iface_socket[i] = accept(accept_socket, (sockaddr*)&sinRemote, &nAddrSize);
-		  if( iface_socket[i]!=INVALID_SOCKET )
-		    {
-		      // make a connected telnet client enter CHAR mode
-		      //write(iface_socket[i],"\377\375\042\377\373\001",6)==0;
-		      const char *s = "[Connected as: ";
-		      send(iface_socket[i],s,strlen(s), 0);
-		      s = host_serial_port_name(i+1);
-		      send(iface_socket[i],s,strlen(s), 0);
-		      s = "]\r\n";
-		      send(iface_socket[i],s,strlen(s), 0);
-		    }
-		}
-              else
-                {
-                  SOCKET s = accept(accept_socket, (sockaddr*)&sinRemote, &nAddrSize);
-                  const char *msg = "[Too many client connections]";
-                  send(s,msg,strlen(msg), 0);
-                  shutdown(s, 2);
-                }
-            }
-        }
-    }
+static void conn_attach(struct HostSerialData *hs, struct HostSerialConn *c, byte iface)
+{
+  c->iface   = iface;
+  c->out_pos = hs->outbuf[iface].head.load(std::memory_order_acquire);
+  hs->iface_conns[iface]++;
 
-  return NULL;
+  // programs using a pseudo terminal do not expect a greeting
+  if( !c->pty )
+    {
+      conn_send_text(c, "[Connected as: ");
+      conn_send_text(c, host_serial_port_name(hs, iface));
+      conn_send_text(c, "]\r\n");
+    }
 }
 
-#endif
-
-bool serial_interrupts_paused = false;
 
-static void host_check_ctrlc(char c)
+static void conn_detach(struct HostSerialData *hs, struct HostSerialConn *c)
 {
-  static unsigned long prevCtrlC = 0;
+  if( c->iface<HOST_NUM_SERIAL_PORTS ) hs->iface_conns[c->iface]--;
+  c->iface = 0xff;
+}
 
-  if( c==3 )
+
+static void conn_close(struct HostSerialData *hs, int epfd, struct HostSerialConn *c)
+{
+  struct epoll_event ev;
+  conn_detach(hs, c);
+  if( c->pty )
     {
-      // CTRL-C was pressed.  If we receive two CTRL-C in short order
-      // then we terminate the emulator.
-      if( millis()<prevCtrlC+50 || millis()>prevCtrlC+250 )
-        prevCtrlC = millis();
-      else
-        exit(0);
+      // the pseudo terminal stays, wait until it is opened again
+      epoll_ctl(epfd, EPOLL_CTL_DEL, c->sock, &ev);
+      c->hangup = true;
     }
   else
-    prevCtrlC = 0;
+    {
+      close(c->sock);
+      c->sock = INVALID_SOCKET;
+    }
 }
 
 
-void host_check_interrupts()
+// read from the connection until it would block or the input buffer is full,
+// returns false if the connection was closed
+static bool conn_read(struct HostSerialData *hs, struct HostSerialConn *c)
 {
-  static unsigned long prevCtrlC = 0;
-  static uint32_t prev_char_cycles[HOSTPC_NUM_SOCKET_CONN+1] = {0};
+  while( c->readable && sbuf_free(&hs->inbuf[c->iface])>0 )
+    {
+      uint32_t len;
+      byte *p = sbuf_space(&hs->inbuf[c->iface], &len);
+      int r = c->pty ? read(c->sock, p, len) : recv(c->sock, p, len, MSG_NOSIGNAL);
+      if( r>0 )
+        sbuf_commit(&hs->inbuf[c->iface], r);
+      else if( r<0 && (errno==EAGAIN || errno==EWOULDBLOCK) )
+        c->readable = false;
+      else if( r<0 && errno==EINTR )
+        continue;
+      else
+        return false; // EIO if a pseudo terminal was closed
+    }
 
-  // check input from interface 0 (console)
-  if( inp_serial[0]>=0 || ctrlC>0 )
-    if( host_read_status_led_WAIT() || (timer_get_cycles()-prev_char_cycles[0]) >= cycles_per_char[0] )
-      {
-	int c = -1;
-	
-	if( ctrlC>0 )
-	  { c = 3; ctrlC--; }
-	else if( inp_serial[0]>=0 )
-	  { 
-	    c = inp_serial[0]; 
-	    
-	    // we have consumed the input => signal input thread to receive more
-	    inp_serial[0] = -1; 
-	    SignalEvent(signalEvent); 
-	  }
+  return true;
+}
 
-        // double ctrl-c on console quits emulator
-        host_check_ctrlc(c);
-	
-	if( c>=0 )
-          (serial_receive_callbacks[0])(0, (byte) c);
-	
-	prev_char_cycles[0] = timer_get_cycles();
-      }
 
-  // check input from interface 1-HOSTPC_NUM_SOCKET_CONN+1 (sockets)
-  for(int i=1; i<HOSTPC_NUM_SOCKET_CONN+1; i++)
-    if( inp_serial[i]>=0 )
-      if( host_read_status_led_WAIT() || (timer_get_cycles()-prev_char_cycles[i]) >= cycles_per_char[i] )
-        {
-          // double ctrl-c on primary interface quits emulator
-          if( i==SwitchSerial.getSelected() ) host_check_ctrlc(inp_serial[i]);
+// send output until the connection would block or all output is sent
+static void conn_send(struct HostSerialData *hs, struct HostSerialConn *c)
+{
+  struct HostSerialBuffer *b = &hs->outbuf[c->iface];
+  uint32_t head = b->head.load(std::memory_order_acquire);
 
-          (serial_receive_callbacks[i])(i, (byte) inp_serial[i]);
-          
-          // we have consumed the input => signal input thread to receive more
-          inp_serial[i] = -1;
-          SignalEvent(signalEvent); 
-          
-          prev_char_cycles[i] = timer_get_cycles();
+  while( c->writable && c->out_pos!=head )
+    {
+      // send both parts of a wrapped-around buffer in one call
+      uint32_t n = head-c->out_pos, pos = c->out_pos & (HOST_SERIAL_BUFFER_SIZE-1);
+      uint32_t len = n < HOST_SERIAL_BUFFER_SIZE-pos ? n : HOST_SERIAL_BUFFER_SIZE-pos;
+      struct iovec iov[2];
+      struct msghdr msg;
+      iov[0].iov_base = b->data+pos;
+      iov[0].iov_len  = len;
+      iov[1].iov_base = b->data;
+      iov[1].iov_len  = n-len;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov     = iov;
+      msg.msg_iovlen  = n>len ? 2 : 1;
+
+      int r = c->pty ? writev(c->sock, iov, msg.msg_iovlen) : sendmsg(c->sock, &msg, MSG_NOSIGNAL);
+      if( r>0 )
+        c->out_pos += r;
+      else if( r<0 && errno==EINTR )
+        continue;
+      else
+        {
+          // would block (a dropped connection is detected when reading)
+          c->writable = false;
         }
+    }
 }
 
 
-void host_serial_interrupts_pause()
+// send output of an interface to all of its clients, buffer space is
+// released once the slowest client has sent it
+static void iface_send(struct HostSerialData *hs, struct HostSerialConn *conns, byte i)
 {
-  serial_interrupts_paused = true;
-}
+  struct HostSerialBuffer *b = &hs->outbuf[i];
+  uint32_t head = b->head.load(std::memory_order_acquire);
+  uint32_t tail = b->tail.load(std::memory_order_relaxed);
+  uint32_t min  = head - tail;
 
+  for(struct HostSerialConn *c=conns; c!=NULL; c=c->next)
+    if( c->iface==i )
+      {
+        conn_send(hs, c);
+        if( c->out_pos-tail < min ) min = c->out_pos-tail;
+      }
 
-void host_serial_interrupts_resume()
-{
-  serial_interrupts_paused = false;
+  // no clients => output is discarded
+  if( min>0 ) sbuf_consume(b, min);
 }
 
 
-// ----------------------------------------------------------------------------------------------------
-
-
-void host_serial_setup(byte iface, uint32_t baud, uint32_t config, bool set_primary_interface)
+static void host_input_accept(struct HostSerialData *hs, int epfd, struct HostSerialListener *l, struct HostSerialConn **conns)
 {
-  // assuming 10 bits (start bit + 8 data bits + stop bit) per character
-  if( iface<HOSTPC_NUM_SOCKET_CONN+1 ) cycles_per_char[iface]  = (10*2000000)/baud;
-
-  // switch the primary serial interface (if requested)
-  if( set_primary_interface ) SwitchSerial.select(iface); 
-}
-
+  sockaddr_in sinRemote;
+  socklen_t nAddrSize = sizeof(sinRemote);
+  SOCKET s = accept(l->sock, (sockaddr*)&sinRemote, &nAddrSize);
+  if( s==INVALID_SOCKET ) return;
 
-host_serial_receive_callback_tp host_serial_set_receive_callback(byte iface, host_serial_receive_callback_tp f)
-{
-  host_serial_receive_callback_tp old_f = NULL;
+  byte iface = 0xff;
+  if( l->dev==0xff )
+    {
+      // default port: first interface without a client
+      for(int i=hs->first_socket_iface; i<HOST_NUM_SERIAL_PORTS && iface==0xff; i++)
+        if( hs->iface_conns[i]==0 )
+          iface = i;
 
-  if( iface < HOSTPC_NUM_SOCKET_CONN+1 ) 
+      if( iface==0xff )
+        {
+          const char *msg = "[Too many client connections]";
+          send(s, msg, strlen(msg), MSG_NOSIGNAL);
+          shutdown(s, 2);
+          close(s);
+          return;
+        }
+    }
+  else
     {
-      old_f = serial_receive_callbacks[iface];
-      serial_receive_callbacks[iface] = f;
+      // the device's host interface is only known to the simulation
+      // thread => ask it to publish the mapping
+      hs->dev_iface_request = true;
     }
 
-  return old_f;
+  // make a connected telnet client enter CHAR mode
+  //write(s,"\377\375\042\377\373\001",6)==0;
+
+  struct HostSerialConn *c = (struct HostSerialConn *) malloc(sizeof(struct HostSerialConn));
+  c->kind     = HS_EV_CONN;
+  c->iface    = 0xff;
+  c->dev      = l->dev;
+  c->readable = false;
+  c->writable = true;
+  c->pty      = false;
+  c->hangup   = false;
+  c->sock     = s;
+  c->next     = *conns;
+  *conns = c;
+  if( iface!=0xff ) conn_attach(hs, c, iface);
+
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+
+  struct epoll_event ev;
+  ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.ptr = c;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, s, &ev);
 }
 
 
-void host_serial_end(byte i)
-{}
-
-
-bool host_serial_ok(byte i)
+static void host_input_pty(struct HostSerialData *hs, struct HostSerialConn **conns, byte dev)
 {
-  return i==0 || (i<HOSTPC_NUM_SOCKET_CONN+1 && iface_socket[i-1]!=INVALID_SOCKET);
-}
+  // in batch mode stdout is the console output
+  FILE *out = g_batch ? stderr : stdout;
+  int m = posix_openpt(O_RDWR | O_NOCTTY);
+  if( m<0 || grantpt(m)!=0 || unlockpt(m)!=0 || ptsname(m)==NULL )
+    {
+      fprintf(out, "Can not create pseudo terminal for serial device %s\r\n", host_serial_dev_names[dev]);
+      if( m>=0 ) close(m);
+      return;
+    }
 
+  // raw mode (no echo or line editing) for the slave side. Opening and
+  // closing it also puts the master into the "hangup" state which ends
+  // when a program opens the pseudo terminal.
+  const char *name = ptsname(m);
+  int sl = open(name, O_RDWR | O_NOCTTY);
+  if( sl>=0 )
+    {
+      struct termios t;
+      tcgetattr(sl, &t);
+      cfmakeraw(&t);
+      tcsetattr(sl, TCSANOW, &t);
+      close(sl);
+    }
+  fcntl(m, F_SETFL, fcntl(m, F_GETFL) | O_NONBLOCK);
+  snprintf(hs->dev_pty_name[dev], sizeof(hs->dev_pty_name[dev]), "%s", name);
 
-int host_serial_available(byte i)
-{
-  return i<HOSTPC_NUM_SOCKET_CONN+1 && inp_serial[i]>=0 ? 1 : 0;
+  const char *link = hs->dev_pty[dev];
+  char path[256];
+  if( link[0]!=0 )
+    {
+      // other machines get a link named <path>.<machine number>
+      if( hs->machine>0 ) snprintf(path, sizeof(path), "%s.%i", link, hs->machine); else snprintf(path, sizeof(path), "%s", link);
+      unlink(path);
+      if( symlink(name, path)==0 ) name = path;
+    }
+  fprintf(out, "Serial device %s: %s\r\n", host_serial_dev_names[dev], name);
+
+  struct HostSerialConn *c = (struct HostSerialConn *) malloc(sizeof(struct HostSerialConn));
+  c->kind     = HS_EV_CONN;
+  c->iface    = 0xff;
+  c->dev      = dev;
+  c->readable = false;
+  c->writable = true;
+  c->pty      = true;
+  c->hangup   = true;
+  c->sock     = m;
+  c->next     = *conns;
+  *conns = c;
 }
 
 
-int host_serial_peek(byte i)
+static void host_input_listen(struct HostSerialData *hs, int epfd, struct HostSerialListener **listeners, byte dev, int port)
 {
-  return i<HOSTPC_NUM_SOCKET_CONN+1 ? inp_serial[i] : -1;
+  SOCKET s = set_up_listener("0.0.0.0", htons(port));
+  if( s == INVALID_SOCKET )
+    {
+      // in batch mode stdout is the console output (and e.g. parallel
+      // regression runs compete for the same port)
+      FILE *out = g_batch ? stderr : stdout;
+      fprintf(out, "Can not listen on port %i => ", port);
+      if( dev==0xff )
+        fprintf(out, "secondary interface not available\r\n");
+      else
+        fprintf(out, "no clients for serial device %i\r\n", dev);
+      return;
+    }
+
+  struct HostSerialListener *l = (struct HostSerialListener *) malloc(sizeof(struct HostSerialListener));
+  l->kind = HS_EV_LISTENER;
+  l->dev  = dev;
+  l->sock = s;
+  l->next = *listeners;
+  *listeners = l;
+
+  struct epoll_event ev;
+  ev.events   = EPOLLIN;
+  ev.data.ptr = l;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, s, &ev);
 }
 
 
-int host_serial_read(byte i)
+// returns false at the end of batch input
+static bool host_input_console(struct HostSerialData *hs)
 {
-  if( i<HOSTPC_NUM_SOCKET_CONN+1 )
+  if( !g_batch )
     {
-      int res = inp_serial[i];
-      inp_serial[i] = -1;
-      if( res>=0 && serial_interrupts_paused ) SignalEvent(signalEvent);
-      return res;
+      // curses may have buffered more than one key
+      do { sbuf_put(&hs->inbuf[0], Serial.read()); }
+      while( sbuf_free(&hs->inbuf[0])>0 && Serial.available() );
     }
   else
-    return -1;
-}
-
-
-void host_serial_flush(byte i)
-{}
-
+    {
+      // batch input from file or pipe, translate LF to CR
+      // (same as Serial.read) and stop reading at end of file
+      uint32_t len;
+      byte *p = sbuf_space(&hs->inbuf[0], &len);
+      int r = read(hs->console_fd, p, len);
+      if( r>0 )
+        {
+          for(int j=0; j<r; j++) if( p[j]==10 ) p[j] = 13;
+          sbuf_commit(&hs->inbuf[0], r);
+        }
+      else
+        return false;
+    }
 
-int host_serial_available_for_write(byte i)
-{
-  if( i==0 )
-    return Serial.availableForWrite();
-  else if( i<HOSTPC_NUM_SOCKET_CONN+1 )
-    return iface_socket[i-1] != INVALID_SOCKET;
-  else
-    return false;
+  return true;
 }
 
 
-size_t host_serial_write(byte i, uint8_t data)
+void *host_input_thread(void *data)
 {
-  if( i==0 )
-    { Serial.write(data); return 1; }
-  else if( i<HOSTPC_NUM_SOCKET_CONN+1 && iface_socket[i-1] != INVALID_SOCKET )
-    { send(iface_socket[i-1], (char *) &data, 1, 0 /*MSG_NOSIGNAL*/); return 1; }
+  struct HostSerialData *hs = (struct HostSerialData *) data;
+  struct HostSerialListener *listeners = NULL;
+  struct HostSerialConn *conns = NULL, *c, **pc;
+  struct epoll_event ev, events[16];
+  bool console_watched = false, console_poll = false;
+  int i, n, epfd = epoll_create1(0);
+
+  // signal from the simulation thread: input was consumed from a full
+  // buffer, there is new output or the device mapping was published
+  ev.events   = EPOLLIN;
+  ev.data.ptr = (void *) &hs_ev_signal;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, hs->signalEvent, &ev);
+
+  // initialize sockets for secondary interfaces
+#if HOSTPC_NUM_SOCKET_CONN>0
+  host_input_listen(hs, epfd, &listeners, 0xff, hs->port);
+  for(i=0; i<NUM_SERIAL_DEVICES; i++)
+    if( hs->dev_port[i]>0 )
+      host_input_listen(hs, epfd, &listeners, i, hs->dev_port[i]);
+#endif
 
-  return 0;
-}
+  // pseudo terminals
+  for(i=0; i<NUM_SERIAL_DEVICES; i++)
+    if( hs->dev_pty[i]!=NULL )
+      host_input_pty(hs, &conns, i);
 
+  while( 1 )
+    {
+      bool hangup = false;
+
+      // free closed connections, check for pseudo terminals opened by a
+      // program and attach new clients of "-L" listeners and pseudo
+      // terminals once the simulation thread has published the device mapping
+      for(pc=&conns; (c=*pc)!=NULL; )
+        if( c->sock==INVALID_SOCKET )
+          { *pc = c->next; free(c); }
+        else
+          {
+            if( c->hangup )
+              {
+                // check whether a program has opened the pseudo terminal
+                struct pollfd p = {c->sock, POLLIN, 0};
+                if( poll(&p, 1, 0)>=0 && !(p.revents & POLLHUP) )
+                  {
+                    c->hangup   = false;
+                    c->readable = true;
+                    c->writable = true;
+                    hs->dev_iface_request = true;
+                    ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    ev.data.ptr = c;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, c->sock, &ev);
+                  }
+              }
+            else if( c->iface==0xff && !hs->dev_iface_request )
+              {
+                byte iface = hs->dev_iface[c->dev];
+                if( iface<HOST_NUM_SERIAL_PORTS && !IS_CONSOLE(hs, iface) )
+                  conn_attach(hs, c, iface);
+                else
+                  {
+                    conn_send_text(c, "[Serial device is not mapped to a client interface]\r\n");
+                    if( c->pty )
+                      c->iface = 0xfe;
+                    else
+                      {
+                        shutdown(c->sock, 2);
+                        conn_close(hs, epfd, c);
+                      }
+                  }
+              }
+
+            if( c->iface==0xfe )
+              {
+                // discard input to an unmapped device until the pty is closed
+                byte buf[256];
+                while( c->readable )
+                  {
+                    int r = read(c->sock, buf, sizeof(buf));
+                    if( r<0 && (errno==EAGAIN || errno==EINTR) )
+                      c->readable = errno==EINTR;
+                    else if( r<=0 )
+                      { conn_close(hs, epfd, c); break; }
+                  }
+              }
+            else if( c->iface!=0xff && !c->hangup && !conn_read(hs, c) )
+              {
+                // receive input that did not fit into the buffer before
+                conn_close(hs, epfd, c);
+              }
+
+            if( c->hangup ) hangup = true;
+            pc = &c->next;
+          }
+
+      // send buffered output
+      for(i=hs->first_socket_iface; i<HOST_NUM_SERIAL_PORTS; i++)
+        iface_send(hs, conns, i);
+
+      // only wait for console input if we are ready to accept more
+      // (files can not be watched by epoll, they are always ready)
+      bool console_ready = hs->console_fd>=0 && sbuf_free(&hs->inbuf[0])>0;
+      if( console_poll )
+        {
+          if( console_ready && !host_input_console(hs) ) hs->console_fd = -1;
+          console_ready = hs->console_fd>=0 && sbuf_free(&hs->inbuf[0])>0;
+        }
+      else if( console_ready!=console_watched )
+        {
+          ev.events   = EPOLLIN;
+          ev.data.ptr = (void *) &hs_ev_console;
+          if( epoll_ctl(epfd, console_ready ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, hs->console_fd, &ev)==0 )
+            console_watched = console_ready;
+          else if( errno==EPERM )
+            console_poll = true;
+        }
+
+      // pseudo terminals are checked periodically while not open
+      n = epoll_wait(epfd, events, 16, console_poll && console_ready ? 0 : (hangup ? 100 : -1));
+      for(i=0; i<n; i++)
+        {
+          byte kind = *((byte *) events[i].data.ptr);
+          if( kind==HS_EV_SIGNAL )
+            {
+              // clear the signal
+              byte buf[8]; 
+              read(hs->signalEvent, buf, 8)==0;
+            }
+          else if( kind==HS_EV_CONSOLE )
+            {
+              if( !host_input_console(hs) )
+                {
+                  // end of batch input
+                  epoll_ctl(epfd, EPOLL_CTL_DEL, hs->console_fd, &ev);
+                  hs->console_fd  = -1;
+                  console_watched = false;
+                }
+            }
+          else if( kind==HS_EV_LISTENER )
+            host_input_accept(hs, epfd, (struct HostSerialListener *) events[i].data.ptr, &conns);
+          else if( kind==HS_EV_CONN )
+            {
+              c = (struct HostSerialConn *) events[i].data.ptr;
+              if( c->sock==INVALID_SOCKET || c->hangup ) continue;
+              if( events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR) ) c->readable = true;
+              if( events[i].events & EPOLLOUT ) c->writable = true;
+
+              // input is read and output sent at the top of the loop
+            }
+        }
+    }
+
+  return NULL;
+}
+
+#endif
+
+static MACHINE_STATE bool serial_interrupts_paused = false;
+
+static void host_check_ctrlc(char c)
+{
+  static MACHINE_STATE unsigned long prevCtrlC = 0;
+
+  if( c==3 )
+    {
+      // CTRL-C was pressed.  If we receive two CTRL-C in short order
+      // then we terminate the emulator.
+      if( millis()<prevCtrlC+50 || millis()>prevCtrlC+250 )
+        prevCtrlC = millis();
+      else
+        machine_exit(0);
+    }
+  else
+    prevCtrlC = 0;
+}
+
+
+// input is paced by the interface's baud rate unless
+// devices mapped to it are guest-paced
+static bool host_serial_input_due(byte iface, uint32_t prev_char_cycles)
+{
+  int pace = serial_host_input_pace(iface);
+  return pace>0 || (pace<0 && (timer_get_cycles()-prev_char_cycles) >= cycles_per_char[iface]);
+}
+
+
+void host_check_interrupts()
+{
+  static MACHINE_STATE uint32_t prev_char_cycles[HOST_NUM_SERIAL_PORTS] = {0};
+  PROFILE_HOST_SCOPE(PROF_HOST_INTERRUPTS);
+
+  // handle requests from other threads (e.g. exit)
+  machine_poll();
+
+  // write out buffered output (simulation time does not
+  // necessarily advance while the CPU is stopped)
+  if( hs->out_pending && (host_read_status_led_WAIT() || timer_get_cycles()-hs->out_pending_cycles >= HOST_SERIAL_FLUSH_CYCLES) )
+    output_flush(hs);
+
+#ifndef _WIN32
+  // input/output thread needs the device mapping for a new client
+  if( hs->dev_iface_request.load(std::memory_order_relaxed) ) host_serial_publish_mapping(hs);
+#endif
+
+  // publish counters while the CPU is stopped
+  if( metrics_port>0 ) metrics_check();
+
+  // check input from interface 0 (console)
+  if( hs->machine==0 && (sbuf_available(&hs->inbuf[0])>0 || ctrlC>0) )
+    if( host_read_status_led_WAIT() || host_serial_input_due(0, prev_char_cycles[0]) )
+      {
+	int c = -1;
+	
+	if( ctrlC>0 )
+	  { c = 3; ctrlC--; }
+	else
+	  c = inbuf_get(hs, 0);
+
+        // double ctrl-c on console quits emulator
+        host_check_ctrlc(c);
+	
+	if( c>=0 )
+          {
+            prof_metrics.serial_in[0]++;
+            (serial_receive_callbacks[0])(0, (byte) c);
+          }
+	
+	prev_char_cycles[0] = timer_get_cycles();
+      }
+
+  // check input from socket interfaces
+  for(int i=hs->first_socket_iface; i<HOST_NUM_SERIAL_PORTS; i++)
+    if( sbuf_available(&hs->inbuf[i])>0 )
+      if( host_read_status_led_WAIT() || host_serial_input_due(i, prev_char_cycles[i]) )
+        {
+          int c = inbuf_get(hs, i);
+
+          // double ctrl-c on primary interface of machine 0 quits emulator
+          if( hs->machine==0 && i==SwitchSerial.getSelected() ) host_check_ctrlc(c);
+
+          prof_metrics.serial_in[i]++;
+          (serial_receive_callbacks[i])(i, (byte) c);
+          
+          prev_char_cycles[i] = timer_get_cycles();
+        }
+}
+
+
+void host_serial_interrupts_pause()
+{
+  serial_interrupts_paused = true;
+}
+
+
+void host_serial_interrupts_resume()
+{
+  serial_interrupts_paused = false;
+}
+
+
+// ----------------------------------------------------------------------------------------------------
+
+
+void host_serial_setup(byte iface, uint32_t baud, uint32_t config, bool set_primary_interface)
+{
+  // assuming 10 bits (start bit + 8 data bits + stop bit) per character
+  if( iface<HOST_NUM_SERIAL_PORTS ) cycles_per_char[iface]  = (10*2000000)/baud;
+
+  // switch the primary serial interface (if requested)
+  if( set_primary_interface ) SwitchSerial.select(iface); 
+}
+
+
+host_serial_receive_callback_tp host_serial_set_receive_callback(byte iface, host_serial_receive_callback_tp f)
+{
+  host_serial_receive_callback_tp old_f = NULL;
+
+  if( iface < HOST_NUM_SERIAL_PORTS ) 
+    {
+      old_f = serial_receive_callbacks[iface];
+      serial_receive_callbacks[iface] = f;
+    }
+
+  return old_f;
+}
+
+
+void host_serial_end(byte i)
+{}
+
+
+bool host_serial_ok(byte i)
+{
+  return i<HOST_NUM_SERIAL_PORTS && (IS_CONSOLE(hs, i) || IFACE_CONNECTED(hs, i));
+}
+
+
+// the simulator is waiting for console input => make sure
+// any prompt it printed is visible
+#define CONSOLE_INPUT_POLLED(hs, i) if( IS_CONSOLE(hs, i) && (hs->out_pending & OUT_PENDING_CONSOLE) ) output_flush(hs)
+
+int host_serial_available(byte i)
+{
+  CONSOLE_INPUT_POLLED(hs, i);
+  return i<HOST_NUM_SERIAL_PORTS ? sbuf_available(&hs->inbuf[i]) : 0;
+}
+
+
+int host_serial_peek(byte i)
+{
+  CONSOLE_INPUT_POLLED(hs, i);
+  return i<HOST_NUM_SERIAL_PORTS ? sbuf_peek(&hs->inbuf[i]) : -1;
+}
+
+
+int host_serial_read(byte i)
+{
+  CONSOLE_INPUT_POLLED(hs, i);
+  if( i<HOST_NUM_SERIAL_PORTS )
+    {
+      int res = inbuf_get(hs, i);
+      if( res>=0 ) prof_metrics.serial_in[i]++;
+      return res;
+    }
+  else
+    return -1;
+}
+
+
+void host_serial_flush(byte i)
+{
+  output_flush(hs);
+}
+
+
+int host_serial_available_for_write(byte i)
+{
+  if( IS_CONSOLE(hs, i) )
+    return Serial.availableForWrite();
+  else if( i<HOST_NUM_SERIAL_PORTS && IFACE_CONNECTED(hs, i) )
+    return sbuf_free(&hs->outbuf[i]);
+  else
+    return 0;
+}
+
+
+static void output_written(struct HostSerialData *hs, byte i)
+{
+  if( hs->out_pending==0 ) hs->out_pending_cycles = timer_get_cycles();
+
+  if( IS_CONSOLE(hs, i) )
+    hs->out_pending |= OUT_PENDING_CONSOLE;
+  else
+    {
+      hs->out_pending |= OUT_PENDING_SOCKET;
+      if( sbuf_free(&hs->outbuf[i]) < HOST_SERIAL_BUFFER_SIZE/2 ) output_flush(hs);
+    }
+}
+
+
+size_t host_serial_write(byte i, uint8_t data)
+{
+  PROFILE_HOST_SCOPE(PROF_HOST_SERIAL);
+  if( IS_CONSOLE(hs, i) )
+    { prof_metrics.serial_out[0]++; batch_check_output(data); Serial.write(data); output_written(hs, 0); return 1; }
+  else if( i<HOST_NUM_SERIAL_PORTS && IFACE_CONNECTED(hs, i) )
+    {
+      // the simulated serial card does not report the transmit register
+      // empty while the buffer is full => data written anyway is dropped
+      if( sbuf_free(&hs->outbuf[i])==0 ) { output_flush(hs); return 0; }
+      prof_metrics.serial_out[i]++;
+      sbuf_put(&hs->outbuf[i], data);
+      output_written(hs, i);
+      return 1;
+    }
+
+  return 0;
+}
+
+
+size_t host_serial_write(byte i, const char *buf, size_t n)
+{
+  PROFILE_HOST_SCOPE(PROF_HOST_SERIAL);
+  if( IS_CONSOLE(hs, i) )
+    { 
+      prof_metrics.serial_out[0] += n; 
+      for(size_t j=0; j<n; j++) batch_check_output(buf[j]); 
+      Serial.write(buf, n);
+      output_written(hs, 0);
+      return n;
+    }
+  else if( i<HOST_NUM_SERIAL_PORTS && IFACE_CONNECTED(hs, i) )
+    {
+      size_t k = 0;
+      uint32_t len;
+      byte *p;
+
+      // copy as much as fits into the buffer and return how much that was,
+      // never wait for the client here (this runs on the simulation thread)
+      while( k<n && (p=sbuf_space(&hs->outbuf[i], &len), len>0) )
+        {
+          if( len>n-k ) len = n-k;
+          memcpy(p, buf+k, len);
+          sbuf_commit(&hs->outbuf[i], len);
+          k += len;
+        }
+
+      if( k>0 )
+        { prof_metrics.serial_out[i] += k; output_written(hs, i); }
+
+      return k;
+    }
+
+  // not connected => just swallow data so we don't block
+  return n;
+}
+
+
+static const char *host_serial_port_name(struct HostSerialData *hs, byte i)
+{
+  static MACHINE_STATE char buf[60];
+  static const char *suffix[5] = {"st", "nd", "rd", "th", "th"};
+
+  if( IS_CONSOLE(hs, i) )
+    return "Console";
+  else if( i<HOST_NUM_SERIAL_PORTS )
+    {
+      int n = i-hs->first_socket_iface;
+      int l = snprintf(buf, sizeof(buf), "%i%s client port %i", n+1, suffix[n], hs->port);
+#ifndef _WIN32
+      // add "-L" ports and "-P" pseudo terminals of devices mapped to this interface
+      for(byte dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+        if( hs->dev_iface[dev]==i && l<(int) sizeof(buf) )
+          {
+            if( hs->dev_port[dev]>0 )
+              l += snprintf(buf+l, sizeof(buf)-l, "/%i", hs->dev_port[dev]);
+            if( hs->dev_pty_name[dev][0]!=0 && l<(int) sizeof(buf) )
+              l += snprintf(buf+l, sizeof(buf)-l, " %s", hs->dev_pty_name[dev]);
+          }
+#endif
+      return buf;
+    }
+
+ return "???";
+}
+
+
+#ifndef _WIN32
+// make the current mapping of serial devices to host interfaces
+// available to the input/output thread
+static void host_serial_publish_mapping(struct HostSerialData *hs)
+{
+  for(byte dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+    hs->dev_iface[dev] = config_serial_map_sim_to_host(dev);
+
+  if( hs->dev_iface_request )
+    {
+      hs->dev_iface_request = false;
+      SignalEvent(hs->signalEvent);
+    }
+}
+
+
+// "-L device=port,...": listening ports for simulated serial devices
+// "-P device[=link],...": pseudo terminals for simulated serial devices
+static void host_serial_parse_listeners(struct HostSerialData *hs)
+{
+  for(int i=1; i+1<g_argc; i++)
+    if( strcmp(g_argv[i], "-L")==0 || strcmp(g_argv[i], "-P")==0 )
+      {
+        bool pty = g_argv[i][1]=='P';
+        char *arg = strdup(g_argv[i+1]), *item, *save = NULL;
+        for(item=strtok_r(arg, ",", &save); item!=NULL; item=strtok_r(NULL, ",", &save))
+          {
+            char *eq = strchr(item, '=');
+            byte dev;
+            if( eq!=NULL ) *eq = 0;
+            for(dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+              if( strcasecmp(item, host_serial_dev_names[dev])==0 )
+                break;
+
+            // other machines listen on port+<machine number>
+            if( pty && dev<NUM_SERIAL_DEVICES )
+              hs->dev_pty[dev] = eq!=NULL ? strdup(eq+1) : "";
+            else if( eq!=NULL && dev<NUM_SERIAL_DEVICES && atoi(eq+1)>0 )
+              hs->dev_port[dev] = atoi(eq+1) + hs->machine;
+            else
+              printf("Invalid %s \"%s\" (expected device%s with device one of sio, acr, 2sio1-%i)\r\n",
+                     pty ? "pseudo terminal" : "listener", item, pty ? "[=link]" : "=port", NUM_SERIAL_DEVICES-2);
+          }
+        free(arg);
+      }
+}
+#endif
+
+
+const char *host_serial_port_name(byte i)
+{
+#ifndef _WIN32
+  host_serial_publish_mapping(hs);
+#endif
+  return host_serial_port_name(hs, i);
+}
+
+
+bool host_serial_port_baud_limits(byte i, uint32_t *min, uint32_t *max)
+{
+  if( i<HOST_NUM_SERIAL_PORTS )
+    {
+      *min = 110;
+      *max = 115200;
+      return true;
+    }
+  else
+    return false;
+}
+
+
+bool host_serial_port_has_configs(byte i)
+{
+  return false;
+}
+
+
+bool host_serial_port_support_xonxoff(byte i)
+{
+  return false;
+}
+
+
+// ----------------------------------------------------------------------------------------------------
+
+#ifdef HOST_TICKS_NSEC
+uint64_t host_get_ticks()
+{
+#if defined(__linux__)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+double host_get_ticks_per_second()
+{
+  return 1e9;
+}
+#else
+// calibrate the time stamp counter against the system clock since program start
+static const uint64_t host_ticks_start = host_get_ticks();
+static const std::chrono::steady_clock::time_point host_ticks_start_time = std::chrono::steady_clock::now();
+
+double host_get_ticks_per_second()
+{
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now()-host_ticks_start_time).count();
+  if( sec<0.05 )
+    {
+      delay(50);
+      sec = std::chrono::duration<double>(std::chrono::steady_clock::now()-host_ticks_start_time).count();
+    }
+
+  return (host_get_ticks()-host_ticks_start) / sec;
+}
+#endif
+
+
+#if USE_PROFILING_HOST>0
+static void host_profile_exit()
+{
+  // the counters are thread-local, so each machine prints its own
+  // (one machine at a time so the lines do not interleave)
+  static std::atomic_flag busy = ATOMIC_FLAG_INIT;
+  while( busy.test_and_set(std::memory_order_acquire) ) delay(1);
+  if( g_num_machines>1 ) fprintf(stderr, "Machine %i:\n", g_machine);
+  profile_host_print(stderr);
+  busy.clear(std::memory_order_release);
+}
+#endif
+
+
+static void host_exit_handler()
+{
+  // called within each machine's thread when the simulator exits
+  // (see machine_exit in Arduino/Arduino.cpp)
+  serial_close_files();
+  drive_sync();
+#if USE_PROFILING_HOST>0
+  host_profile_exit();
+#endif
+}
+
+
+// ----------------------------------------------------------------------------------------------------
+
+void host_system_info()
+{
+#if defined(_WIN32)
+  SwitchSerial.println("Host is Windows PC");
+#else
+  SwitchSerial.println("Host is Linux/Unix PC");
+#endif
+}
+
+
+// ----------------------------------------------------------------------------------
+// Command line options for loading and starting programs:
+//   -p name           load (and run) program "name" from table in prog.cpp
+//   -l file[@addr]    load binary memory image at addr (default 0)
+//   -x file           load Intel HEX file
+//   -d drive:image    mount disk image number <image> in 88-DCDD drive <drive>
+//   -H platter:image  mount hard disk image number <image> on platter <platter> of 88-HDSK unit 0
+//   -B 0|1            turn HDSK bulk transfers (USE_HDSK_BULK_TRANSFER) off or on
+//   -g addr           start running at addr
+//   -s addr           stop when PC reaches addr
+//   -t cycles         stop after the given number of CPU cycles
+//   -o text           stop when console output contains text (\r \n \t \\ escapes)
+//   -v file           write coverage bitmaps to file when stopping (USE_PROFILING_COVERAGE)
+//   -w file           trace instructions and write the trace to file when stopping (USE_PROFILING_TRACE)
+//   -y file           print the instructions in trace file and exit (USE_PROFILING_TRACE)
+//   -a file           load symbol file for disassembly and call profiling
+//   -u from-to        print disassembly of memory range (after loading programs) and exit
+//   -C dev=file[,t][,r=size]  capture output of serial device dev (sio, acr, 2sio1-4) to
+//                     file, t: prefix lines with time since start, r: start a new file
+//                     (renaming the full one to file.1, file.2, ...) after size bytes
+//                     (k/m suffix for kilo/megabytes)
+//   -R dev=file       replay file as input to serial device dev
+// Addresses and numbers may be decimal or hex (with 0x prefix).
+//
+// In batch mode (-b) there is no terminal: console output goes to stdout
+// and console input is read from stdin or the file given with "-i file".
+// Memory and registers start out cleared, the simulation runs unthrottled
+// without serial panel/debug output and starts at the "-g" address (or at
+// 0 or the ROM autostart address if not given). The simulator exits as soon
+// as the CPU of machine 0 stops, for example at a HLT instruction. A summary
+// line is printed to stderr and the exit status is:
+//   0: stopped at HLT, the "-s" address or after the "-o" text was seen
+//   1: invalid command line option or file not found
+//   2: "-t" cycle limit reached
+//   3: stopped for any other reason (e.g. a breakpoint)
+
+#define BATCH_STOP_NONE   0
+#define BATCH_STOP_HLT    1
+#define BATCH_STOP_PC     2
+#define BATCH_STOP_OUTPUT 3
+#define BATCH_STOP_CYCLES 4
+
+#define BATCH_TIMER_CYCLES 1000000
+
+static MACHINE_STATE byte     batch_stop_reason = BATCH_STOP_NONE;
+static MACHINE_STATE int      batch_stop_pc = -1;
+static MACHINE_STATE uint64_t batch_cycles = 0, batch_cycles_max = 0;
+static MACHINE_STATE uint32_t batch_cycles_timer = 0;
+static MACHINE_STATE char    *batch_stop_text = NULL;
+static MACHINE_STATE int     *batch_stop_text_next = NULL;
+static MACHINE_STATE int      batch_stop_text_len = 0, batch_stop_text_pos = 0;
+static MACHINE_STATE unsigned long batch_start_micros = 0;
+#if USE_PROFILING_COVERAGE>0
+static MACHINE_STATE const char *batch_coverage_file = NULL;
+#endif
+#if USE_PROFILING_TRACE>0
+static MACHINE_STATE const char *batch_trace_file = NULL;
+#endif
+
+
+static FILE *batch_input_file()
+{
+  for(int i=1; i+1<g_argc; i++)
+    if( strcmp(g_argv[i], "-i")==0 )
+      {
+        FILE *f = fopen(g_argv[i+1], "rb");
+        if( f==NULL ) { fprintf(stderr, "Can not open input file: %s\n", g_argv[i+1]); machine_exit(1); }
+        return f;
+      }
+
+  return stdin;
+}
+
+
+static void batch_error(const char *msg, const char *arg)
+{
+  if( g_batch )
+    {
+      fprintf(stderr, "%s: %s\n", msg, arg);
+      machine_exit(1);
+    }
+  else
+    printf("%s: %s\r\n", msg, arg);
+}
+
+
+// "dev=file[,t][,r=size]" for "-C", "dev=file" for "-R"
+static bool batch_serial_file(bool capture, const char *arg)
+{
+  char *buf = strdup(arg), *fname = strchr(buf, '='), *opts = NULL;
+  bool ok = false, timestamps = false;
+  uint32_t rotate_size = 0;
+  byte dev;
+
+  if( fname!=NULL ) *fname++ = 0;
+  for(dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+    if( strcasecmp(buf, host_serial_dev_names[dev])==0 )
+      break;
+
+  if( capture && fname!=NULL && (opts=strchr(fname, ','))!=NULL ) *opts++ = 0;
+  for(char *save = NULL, *o = opts ? strtok_r(opts, ",", &save) : NULL; o!=NULL; o = strtok_r(NULL, ",", &save))
+    {
+      char *p;
+      if( strcmp(o, "t")==0 )
+        timestamps = true;
+      else if( strncmp(o, "r=", 2)==0 && (rotate_size=strtoul(o+2, &p, 0))>0 )
+        {
+          if( *p=='k' || *p=='K' ) rotate_size *= 1024;
+          else if( *p=='m' || *p=='M' ) rotate_size *= 1024*1024;
+        }
+      else
+        dev = NUM_SERIAL_DEVICES;
+    }
+
+  // files without a directory would be taken from the "disks" directory
+  if( dev<NUM_SERIAL_DEVICES && fname!=NULL && *fname!=0 )
+    {
+      std::string path = strchr(fname, DIRSEP[0])==NULL ? std::string("." DIRSEP) + fname : std::string(fname);
+      ok = capture ? serial_capture_start_file(dev, path.c_str(), timestamps, rotate_size) : serial_replay_start_file(dev, path.c_str());
+    }
+
+  free(buf);
+  return ok;
+}
+
+
+static void batch_set_stop_text(const char *s)
+{
+  // translate escape sequences
+  batch_stop_text = (char *) malloc(strlen(s)+1);
+  batch_stop_text_len = 0;
+  for(const char *p=s; *p; p++)
+    {
+      char c = *p;
+      if( c=='\\' && p[1]!=0 )
+        switch( *++p )
+          {
+          case 'r': c = '\r'; break;
+          case 'n': c = '\n'; break;
+          case 't': c = '\t'; break;
+          default:  c = *p;   break;
+          }
+      batch_stop_text[batch_stop_text_len++] = c;
+    }
+
+  // for each position, store the length of the longest proper prefix of
+  // the text that is also a suffix of the text up to here (so the search
+  // never has to re-examine output that was already seen)
+  batch_stop_text_next = (int *) malloc(sizeof(int) * (batch_stop_text_len+1));
+  batch_stop_text_next[0] = 0;
+  for(int i=1, k=0; i<batch_stop_text_len; i++)
+    {
+      while( k>0 && batch_stop_text[i]!=batch_stop_text[k] ) k = batch_stop_text_next[k-1];
+      if( batch_stop_text[i]==batch_stop_text[k] ) k++;
+      batch_stop_text_next[i] = k;
+    }
+
+  batch_stop_text_pos = 0;
+}
+
+
+static void batch_check_output(byte c)
+{
+  if( batch_stop_text_len>0 )
+    {
+      while( batch_stop_text_pos>0 && batch_stop_text[batch_stop_text_pos]!=(char) c ) 
+        batch_stop_text_pos = batch_stop_text_next[batch_stop_text_pos-1];
+      
+      if( batch_stop_text[batch_stop_text_pos]==(char) c && ++batch_stop_text_pos==batch_stop_text_len )
+        {
+          batch_stop_text_pos = 0;
+          batch_stop_reason = BATCH_STOP_OUTPUT;
+          altair_interrupt(INT_SW_STOP);
+        }
+    }
+}
+
+
+static uint64_t batch_get_cycles()
+{
+  return batch_cycles + (uint32_t) (timer_get_cycles()-batch_cycles_timer);
+}
+
+
+static void batch_timer();
+static void batch_timer_start()
+{
+  // count cycles in 64 bits (timer_get_cycles() wraps around after 
+  // about 35 minutes of simulated time) and stop at the cycle limit
+  uint64_t n = BATCH_TIMER_CYCLES;
+  if( batch_cycles_max>0 && batch_cycles_max-batch_cycles < n ) n = batch_cycles_max-batch_cycles;
+
+  // timer periods are in microseconds (2 cycles)
+  batch_cycles_timer = timer_get_cycles();
+  timer_setup(TIMER_BATCH, 0, batch_timer);
+  timer_start(TIMER_BATCH, (uint32_t) (n+1)/2);
+}
+
+
+static void batch_timer()
+{
+  batch_cycles = batch_get_cycles();
+  if( batch_cycles_max>0 && batch_cycles>=batch_cycles_max )
+    {
+      batch_cycles_max  = 0;
+      batch_stop_reason = BATCH_STOP_CYCLES;
+      altair_interrupt(INT_SW_STOP);
+    }
 
-size_t host_serial_write(byte i, const char *buf, size_t n)
+  batch_timer_start();
+}
+
+
+static bool batch_load_binary(const char *arg)
 {
-  if( i==0 )
-    { return Serial.write(buf, n); }
-  else if( i<HOSTPC_NUM_SOCKET_CONN+1 && iface_socket[i-1] != INVALID_SOCKET )
-    { return send(iface_socket[i-1], (const char *) buf, n, 0 /*MSG_NOSIGNAL*/); }
+  char *fname = strdup(arg);
+  unsigned long addr = 0;
+  char *at = strrchr(fname, '@');
+  if( at!=NULL ) { *at = 0; addr = strtoul(at+1, NULL, 0); }
 
-  // not connected => just swallow data so we don't block
-  return n;
+  FILE *f = addr<MEMSIZE ? fopen(fname, "rb") : NULL;
+  if( f!=NULL )
+    {
+      fread(Mem+addr, 1, MEMSIZE-addr, f);
+      fclose(f);
+    }
+
+  free(fname);
+  return f!=NULL;
 }
 
 
-const char *host_serial_port_name(byte i)
+static int batch_hex_byte(const char *s)
 {
-  switch(i)
+  int v = 0;
+  for(byte i=0; i<2; i++)
     {
-    case 0: return "Console";
-    case 1: return "1st client port 8800";
-    case 2: return "2nd client port 8800";
-    case 3: return "3rd client port 8800";
-    case 4: return "4th client port 8800";
+      char c = s[i];
+      if( c>='0' && c<='9' )      v = v*16 + (c-'0');
+      else if( c>='A' && c<='F' ) v = v*16 + (c-'A'+10);
+      else if( c>='a' && c<='f' ) v = v*16 + (c-'a'+10);
+      else return -1;
     }
 
- return "???";
+  return v;
 }
 
 
-bool host_serial_port_baud_limits(byte i, uint32_t *min, uint32_t *max)
+static bool batch_load_hex(const char *fname)
 {
-  if( i<HOSTPC_NUM_SOCKET_CONN+1 )
+  FILE *f = fopen(fname, "r");
+  if( f==NULL ) return false;
+
+  char line[600];
+  bool ok = true;
+  while( ok && fgets(line, 600, f) )
     {
-      *min = 110;
-      *max = 115200;
-      return true;
+      char *p = line;
+      while( isspace(*p) ) p++;
+      if( *p==0 ) continue;
+      if( *p++!=':' ) { ok = false; break; }
+
+      // record length, address, type, data and checksum
+      int n = batch_hex_byte(p), b[260];
+      for(int i=0; ok && i<n+4; i++) 
+        ok = (b[i] = batch_hex_byte(p+2+i*2))>=0;
+      if( n<0 || !ok ) { ok = false; break; }
+
+      byte cs = n;
+      for(int i=0; i<n+4; i++) cs += b[i];
+      if( cs!=0 ) { ok = false; break; }
+
+      if( b[2]==0 )
+        {
+          uint16_t a = b[0]*256+b[1];
+          for(int i=0; i<n; i++) Mem[(a+i) & (MEMSIZE-1)] = b[3+i];
+        }
+      else if( b[2]==1 )
+        break;
     }
-  else
-    return false;
+
+  fclose(f);
+  return ok;
 }
 
 
-bool host_serial_port_has_configs(byte i)
+void host_batch_setup()
 {
-  return false;
+  int start_addr = -1;
+
+  if( g_batch )
+    {
+      // count instructions for the summary printed when stopping
+      prof_instruction_active = true;
+
+      // start from a known state
+      mem_ram_init(0, MEMSIZE-1, true);
+      regA = 0; regS = 0; regB = 0; regC = 0; regD = 0; regE = 0; regH = 0; regL = 0; regSP = 0;
+
+      // run unthrottled and without serial panel or debug output
+      config_flags &= ~(CF_THROTTLE | CF_SERIAL_PANEL | CF_SERIAL_DEBUG);
+
+      // deliver input files as fast as the simulated program reads them
+      for(byte dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+        config_serial_set_guest_paced(dev, true);
+    }
+
+  for(int i=1; i<g_argc; i++)
+    {
+      const char *opt = g_argv[i], *arg = i+1<g_argc ? g_argv[i+1] : NULL;
+
+      if( strlen(opt)!=2 || opt[0]!='-' || strchr("plxdHBgstovwyauCR", opt[1])==NULL )
+        continue;
+      else if( arg==NULL )
+        { batch_error("Missing argument for option", opt); continue; }
+
+      i++;
+      switch( opt[1] )
+        {
+        case 'p':
+          {
+            uint16_t pc;
+            byte n = prog_find(arg);
+            if( n==0 )
+              batch_error("Unknown program", arg);
+            else if( prog_load(n, &pc) )
+              start_addr = pc;
+            break;
+          }
+
+        case 'l':
+          if( !batch_load_binary(arg) ) batch_error("Can not load memory image", arg);
+          break;
+
+        case 'x':
+          if( !batch_load_hex(arg) ) batch_error("Can not load Intel HEX file", arg);
+          break;
+
+        case 'd':
+          {
+            char *p;
+            int drive = strtol(arg, &p, 0);
+            if( *p!=':' || !drive_mount(drive, strtol(p+1, NULL, 0)) ) 
+              batch_error("Can not mount disk", arg);
+            break;
+          }
+
+        case 'H':
+          {
+            char *p;
+            int platter = strtol(arg, &p, 0);
+            if( *p!=':' || !hdsk_mount(0, platter, strtol(p+1, NULL, 0)) )
+              batch_error("Can not mount hard disk", arg);
+            break;
+          }
+
+        case 'B':
+          if( !hdsk_set_bulk_transfer(strtoul(arg, NULL, 0)!=0) )
+            batch_error("HDSK bulk transfers not enabled (USE_HDSK_BULK_TRANSFER), can not use", arg);
+          break;
+
+        case 'g': start_addr    = strtoul(arg, NULL, 0) & 0xFFFF; break;
+        case 's': batch_stop_pc = strtoul(arg, NULL, 0) & 0xFFFF; break;
+        case 't': batch_cycles_max = strtoull(arg, NULL, 0);      break;
+        case 'o': batch_set_stop_text(arg);                      break;
+
+        case 'v':
+#if USE_PROFILING_COVERAGE>0
+          batch_coverage_file = arg;
+#else
+          batch_error("Coverage recording not enabled (USE_PROFILING_COVERAGE), can not write", arg);
+#endif
+          break;
+
+        case 'w':
+#if USE_PROFILING_TRACE>0
+          if( profile_trace_enable(true) )
+            batch_trace_file = arg;
+          else
+            batch_error("Not enough memory for instruction trace", arg);
+#else
+          batch_error("Instruction trace not enabled (USE_PROFILING_TRACE), can not write", arg);
+#endif
+          break;
+
+        case 'y':
+          {
+#if USE_PROFILING_TRACE>0
+            FILE *f = fopen(arg, "rb");
+            bool ok = f!=NULL && profile_trace_print(f);
+            if( f!=NULL ) fclose(f);
+            if( !ok ) batch_error("Can not read trace file", arg);
+            Serial.flush();
+            machine_exit(0);
+#else
+            batch_error("Instruction trace not enabled (USE_PROFILING_TRACE), can not read", arg);
+#endif
+            break;
+          }
+
+        case 'a':
+          {
+            FILE *f = fopen(arg, "r");
+            if( f==NULL || !disassembler_read_symbols(f) ) batch_error("Can not read symbol file", arg);
+            if( f!=NULL ) fclose(f);
+            break;
+          }
+
+        case 'C':
+        case 'R':
+          if( !batch_serial_file(opt[1]=='C', arg) ) 
+            batch_error(opt[1]=='C' ? "Can not capture serial device" : "Can not replay to serial device", arg);
+          break;
+
+        case 'u':
+          {
+            char *p;
+            uint32_t a = strtoul(arg, &p, 0) & 0xFFFF, to = *p=='-' ? strtoul(p+1, NULL, 0) & 0xFFFF : a;
+            while( a<=to )
+              {
+                char buf[80];
+                const char *name = disassembler_get_symbol(a);
+                if( name!=NULL ) printf("%s:\n", name);
+                uint16_t pc = a;
+                a += disassemble_text(Mem, pc, buf, 80, true);
+                printf("%04X:%s\n", pc, buf);
+              }
+            machine_exit(0);
+          }
+        }
+    }
+
+  if( g_batch && start_addr<0 )
+    {
+      uint16_t a = mem_get_rom_autostart_address();
+      start_addr = a==0xFFFF ? 0 : a;
+    }
+
+  if( batch_stop_pc>=0 ) breakpoint_add(batch_stop_pc);
+  if( g_batch || batch_cycles_max>0 ) batch_timer_start();
+
+  // run time is measured from here (right before the first instruction
+  // is executed), cpubench uses it to compute MIPS and MHz
+  batch_start_micros = micros();
+
+  if( start_addr>=0 )
+    {
+      regPC = start_addr;
+      host_clr_status_led_WAIT();
+    }
 }
 
 
-bool host_serial_port_support_xonxoff(byte i)
+void host_batch_cpu_stopped()
 {
-  return false;
+  byte reason = batch_stop_reason;
+  batch_stop_reason = BATCH_STOP_NONE;
+  if( reason==BATCH_STOP_NONE )
+    {
+      if( host_read_status_led_HLTA() )
+        reason = BATCH_STOP_HLT;
+      else if( regPC==batch_stop_pc )
+        reason = BATCH_STOP_PC;
+    }
+
+  if( g_batch && g_machine==0 )
+    {
+      static const char *reasons[5] = {"Stopped", "HLT", "Reached stop address", "Found output text", "Reached cycle limit"};
+      static const int   status[5]  = {3, 0, 0, 0, 2};
+
+      Serial.flush();
+#if USE_PROFILING_COVERAGE>0
+      if( batch_coverage_file!=NULL )
+        {
+          // same format as profile_coverage_write (but not relative to the "disks" directory)
+          FILE *f = fopen(batch_coverage_file, "wb");
+          if( f==NULL ||
+              fwrite(prof_cov_exec,  1, sizeof(prof_cov_exec),  f)!=sizeof(prof_cov_exec) ||
+              fwrite(prof_cov_read,  1, sizeof(prof_cov_read),  f)!=sizeof(prof_cov_read) ||
+              fwrite(prof_cov_write, 1, sizeof(prof_cov_write), f)!=sizeof(prof_cov_write) )
+            fprintf(stderr, "Can not write coverage file: %s\n", batch_coverage_file);
+          if( f!=NULL ) fclose(f);
+        }
+#endif
+#if USE_PROFILING_TRACE>0
+      if( batch_trace_file!=NULL )
+        {
+          FILE *f = fopen(batch_trace_file, "wb");
+          if( f==NULL || !profile_trace_save(f) )
+            fprintf(stderr, "Can not write trace file: %s\n", batch_trace_file);
+          if( f!=NULL ) fclose(f);
+        }
+#endif
+      fprintf(stderr, "%s at PC=%04X after %llu cycles, %llu instructions (%.6f seconds)\n", 
+              reasons[reason], regPC, (unsigned long long) batch_get_cycles(), 
+              (unsigned long long) prof_instruction_count, (micros()-batch_start_micros)/1000000.0);
+      machine_exit(status[reason]);
+    }
 }
 
 
-// ----------------------------------------------------------------------------------------------------
+#ifdef _WIN32
+static DWORD WINAPI host_batch_input_thread(void *data)
+{
+  struct HostSerialData *hs = (struct HostSerialData *) data;
+  FILE *f = batch_input_file();
 
-void host_system_info()
+  int c;
+  while( (c=fgetc(f))!=EOF )
+    {
+      // wait until the simulation has made room in the input buffer
+      while( sbuf_free(&hs->inbuf[0])==0 ) Sleep(1);
+      sbuf_put(&hs->inbuf[0], c==10 ? 13 : c);
+    }
+
+  return 0;
+}
+#endif
+
+
+// ----------------------------------------------------------------------------------
+// Metrics endpoint, enabled by "-m port":
+// Machine 0 serves the counters of all machines via HTTP on 127.0.0.1:<port>.
+// "GET /json" returns JSON, any other request returns Prometheus text format,
+// for example: curl http://localhost:<port>/metrics
+// Per-port I/O counters are only included if USE_PROFILING_IO is enabled.
+//
+// Each machine copies its counters into its own slot about every 100ms (real
+// time). A slot is protected by a sequence number that is odd while the slot
+// is being written. The server thread re-reads a slot until it sees the same
+// even sequence number before and after copying it so it never needs a lock
+// and never stalls the simulation.
+
+#define METRICS_TIMER_USEC      10000
+#define METRICS_PUBLISH_MILLIS  100
+#define METRICS_MAX_MACHINES    64
+
+#if USE_THROTTLE>0
+extern MACHINE_STATE uint16_t throttle_delay;
+#endif
+
+struct HostMetricsSnapshot
 {
-#if defined(_WIN32)
-  SwitchSerial.println("Host is Windows PC");
+  uint64_t cycles, instructions;
+  float    mhz;
+  int      throttle, throttle_delay;
+  bool     running;
+  byte     timers;
+  struct ProfileMetrics counters;
+};
+
+struct HostMetricsSlot
+{
+  std::atomic<uint32_t> seq;
+  struct HostMetricsSnapshot data;
+};
+
+MACHINE_STATE struct ProfileMetrics prof_metrics;
+
+static struct HostMetricsSlot metrics_slots[METRICS_MAX_MACHINES];
+static MACHINE_STATE uint64_t metrics_cycles = 0, metrics_prev_cycles = 0;
+static MACHINE_STATE uint32_t metrics_cycles_timer = 0;
+static MACHINE_STATE unsigned long metrics_prev_millis = 0;
+
+
+static void metrics_publish()
+{
+  unsigned long now = millis();
+  metrics_cycles += (uint32_t) (timer_get_cycles()-metrics_cycles_timer);
+  metrics_cycles_timer = timer_get_cycles();
+
+  if( now-metrics_prev_millis >= METRICS_PUBLISH_MILLIS && g_machine<METRICS_MAX_MACHINES )
+    {
+      struct HostMetricsSlot *slot = metrics_slots + g_machine;
+      slot->seq.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      slot->data.cycles       = metrics_cycles;
+      slot->data.instructions = prof_instruction_count;
+      slot->data.mhz          = (metrics_cycles-metrics_prev_cycles) / ((now-metrics_prev_millis) * 1000.0);
+      slot->data.throttle     = config_throttle();
+#if USE_THROTTLE>0
+      slot->data.throttle_delay = throttle_delay;
 #else
-  SwitchSerial.println("Host is Linux/Unix PC");
+      slot->data.throttle_delay = 0;
 #endif
+      slot->data.running      = !host_read_status_led_WAIT();
+      slot->data.timers       = timer_queue_len;
+      slot->data.counters     = prof_metrics;
+
+      slot->seq.fetch_add(1, std::memory_order_release);
+      metrics_prev_cycles = metrics_cycles;
+      metrics_prev_millis = now;
+    }
 }
 
 
-// these are defined and initialized in the main() function in Arduino/Arduino.cpp
-extern int    g_argc;
-extern char **g_argv;
+static void metrics_check()
+{
+  // the metrics timer only runs while the CPU is running
+  if( host_read_status_led_WAIT() ) metrics_publish();
+}
+
+
+static bool metrics_read_slot(int machine, struct HostMetricsSnapshot *data)
+{
+  struct HostMetricsSlot *slot = metrics_slots + machine;
+  uint32_t seq;
+
+  do
+    {
+      seq = slot->seq.load(std::memory_order_acquire);
+      if( seq==0 ) return false;
+      if( seq & 1 ) continue;
+      *data = slot->data;
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+  while( (seq & 1) || slot->seq.load(std::memory_order_relaxed)!=seq );
+
+  return true;
+}
+
+
+static void metrics_printf(std::string &s, const char *format, ...)
+{
+  char buf[200];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buf, 200, format, args);
+  va_end(args);
+  s += buf;
+}
+
+
+static const char *metrics_disk_names[4] = {"dcdd", "cromemco", "tarbell", "hdsk"};
+
+static void metrics_format_prometheus(std::string &s, struct HostMetricsSnapshot *data, bool *valid, int n)
+{
+  static const char *names[7][3] = 
+    {{"cycles_total",       "counter", "CPU cycles executed"},
+     {"instructions_total", "counter", "instructions executed"},
+     {"mhz",                "gauge",   "effective CPU clock in MHz"},
+     {"running",            "gauge",   "1 if the CPU is running, 0 if stopped"},
+     {"throttle",           "gauge",   "throttle setting (0=off, <0=auto, >0=manual delay)"},
+     {"throttle_delay",     "gauge",   "current throttle delay loop count"},
+     {"timers_queued",      "gauge",   "number of timers in the timer queue"}};
+
+  for(int k=0; k<7; k++)
+    {
+      metrics_printf(s, "# HELP altair_%s %s\n# TYPE altair_%s %s\n", names[k][0], names[k][2], names[k][0], names[k][1]);
+      for(int m=0; m<n; m++)
+        if( valid[m] )
+          {
+            metrics_printf(s, "altair_%s{machine=\"%i\"} ", names[k][0], m);
+            switch( k )
+              {
+              case 0: metrics_printf(s, "%llu\n", (unsigned long long) data[m].cycles); break;
+              case 1: metrics_printf(s, "%llu\n", (unsigned long long) data[m].instructions); break;
+              case 2: metrics_printf(s, "%.3f\n", data[m].mhz); break;
+              case 3: metrics_printf(s, "%i\n", data[m].running ? 1 : 0); break;
+              case 4: metrics_printf(s, "%i\n", data[m].throttle); break;
+              case 5: metrics_printf(s, "%i\n", data[m].throttle_delay); break;
+              case 6: metrics_printf(s, "%i\n", data[m].timers); break;
+              }
+          }
+    }
+
+  s += "# HELP altair_interrupts_total interrupts delivered to the CPU\n# TYPE altair_interrupts_total counter\n";
+  for(int m=0; m<n; m++)
+    if( valid[m] )
+      metrics_printf(s, "altair_interrupts_total{machine=\"%i\"} %llu\n", m, (unsigned long long) data[m].counters.interrupts);
+
+#if USE_PROFILING_IO>0
+  for(int k=0; k<2; k++)
+    {
+      const char *name = k==0 ? "io_reads_total" : "io_writes_total";
+      metrics_printf(s, "# HELP altair_%s %s I/O port\n# TYPE altair_%s counter\n", name, k==0 ? "IN instructions per" : "OUT instructions per", name);
+      for(int m=0; m<n; m++)
+        if( valid[m] )
+          for(int p=0; p<256; p++)
+            {
+              uint64_t v = k==0 ? data[m].counters.io_inp[p] : data[m].counters.io_out[p];
+              if( v>0 ) metrics_printf(s, "altair_%s{machine=\"%i\",port=\"0x%02x\"} %llu\n", name, m, p, (unsigned long long) v);
+            }
+    }
+#endif
+
+  for(int k=0; k<2; k++)
+    {
+      const char *name = k==0 ? "serial_bytes_in_total" : "serial_bytes_out_total";
+      metrics_printf(s, "# HELP altair_%s bytes %s host serial interface\n# TYPE altair_%s counter\n", name, k==0 ? "received from" : "sent to", name);
+      for(int m=0; m<n; m++)
+        if( valid[m] )
+          for(int i=0; i<HOST_NUM_SERIAL_PORTS; i++)
+            metrics_printf(s, "altair_%s{machine=\"%i\",interface=\"%i\"} %llu\n", name, m, i, 
+                           (unsigned long long) (k==0 ? data[m].counters.serial_in[i] : data[m].counters.serial_out[i]));
+    }
+
+  for(int k=0; k<2; k++)
+    {
+      const char *name = k==0 ? "disk_sectors_read_total" : "disk_sectors_written_total";
+      metrics_printf(s, "# HELP altair_%s disk sectors %s\n# TYPE altair_%s counter\n", name, k==0 ? "read" : "written", name);
+      for(int m=0; m<n; m++)
+        if( valid[m] )
+          for(int c=0; c<4; c++)
+            for(int d=0; d<16; d++)
+              {
+                uint32_t v = k==0 ? data[m].counters.disk_read[c][d] : data[m].counters.disk_write[c][d];
+                if( v>0 ) metrics_printf(s, "altair_%s{machine=\"%i\",controller=\"%s\",drive=\"%i\"} %lu\n", name, m, metrics_disk_names[c], d, (unsigned long) v);
+              }
+    }
+}
+
+
+#if USE_PROFILING_IO>0
+static void metrics_format_json_ports(std::string &s, const char *name, uint64_t *counts)
+{
+  bool first = true;
+  metrics_printf(s, ",\"%s\":{", name);
+  for(int p=0; p<256; p++)
+    if( counts[p]>0 )
+      {
+        metrics_printf(s, "%s\"0x%02x\":%llu", first ? "" : ",", p, (unsigned long long) counts[p]);
+        first = false;
+      }
+  s += "}";
+}
+#endif
+
+
+static void metrics_format_json_disks(std::string &s, const char *name, uint32_t counts[4][16])
+{
+  metrics_printf(s, ",\"%s\":{", name);
+  for(int c=0; c<4; c++)
+    {
+      bool first = true;
+      metrics_printf(s, "%s\"%s\":{", c==0 ? "" : ",", metrics_disk_names[c]);
+      for(int d=0; d<16; d++)
+        if( counts[c][d]>0 )
+          {
+            metrics_printf(s, "%s\"%i\":%lu", first ? "" : ",", d, (unsigned long) counts[c][d]);
+            first = false;
+          }
+      s += "}";
+    }
+  s += "}";
+}
+
+
+static void metrics_format_json(std::string &s, struct HostMetricsSnapshot *data, bool *valid, int n)
+{
+  bool first = true;
+  s += "{\"machines\":[";
+  for(int m=0; m<n; m++)
+    if( valid[m] )
+      {
+        struct HostMetricsSnapshot *d = data+m;
+        metrics_printf(s, "%s{\"machine\":%i,\"running\":%s,\"cycles\":%llu,\"instructions\":%llu,\"mhz\":%.3f",
+                       first ? "" : ",", m, d->running ? "true" : "false", 
+                       (unsigned long long) d->cycles, (unsigned long long) d->instructions, d->mhz);
+        metrics_printf(s, ",\"throttle\":%i,\"throttle_delay\":%i,\"timers_queued\":%i,\"interrupts\":%llu",
+                       d->throttle, d->throttle_delay, d->timers, (unsigned long long) d->counters.interrupts);
+#if USE_PROFILING_IO>0
+        metrics_format_json_ports(s, "io_reads",  d->counters.io_inp);
+        metrics_format_json_ports(s, "io_writes", d->counters.io_out);
+#endif
+
+        for(int k=0; k<2; k++)
+          {
+            uint64_t *counts = k==0 ? d->counters.serial_in : d->counters.serial_out;
+            metrics_printf(s, ",\"%s\":[", k==0 ? "serial_in" : "serial_out");
+            for(int i=0; i<HOST_NUM_SERIAL_PORTS; i++)
+              metrics_printf(s, "%s%llu", i==0 ? "" : ",", (unsigned long long) counts[i]);
+            s += "]";
+          }
+
+        metrics_format_json_disks(s, "disk_read",  d->counters.disk_read);
+        metrics_format_json_disks(s, "disk_write", d->counters.disk_write);
+        s += "}";
+        first = false;
+      }
+  s += "]}\n";
+}
+
+
+static void metrics_handle_request(SOCKET c)
+{
+  // read the request header (a client that does not send a request,
+  // e.g. "nc localhost <port>", gets the Prometheus text after a timeout)
+  char req[1024];
+  int n = 0, r;
+  while( n<1023 && (r=recv(c, req+n, 1023-n, 0))>0 )
+    {
+      n += r;
+      req[n] = 0;
+      if( strstr(req, "\r\n\r\n") || strstr(req, "\n\n") ) break;
+    }
+  req[n] = 0;
+
+  // take a snapshot of all machines
+  static struct HostMetricsSnapshot data[METRICS_MAX_MACHINES];
+  static bool valid[METRICS_MAX_MACHINES];
+  int num = g_num_machines<METRICS_MAX_MACHINES ? g_num_machines : METRICS_MAX_MACHINES;
+  for(int m=0; m<num; m++) valid[m] = metrics_read_slot(m, data+m);
+
+  std::string body, header;
+  bool json = strncmp(req, "GET /json", 9)==0;
+  if( json )
+    metrics_format_json(body, data, valid, num);
+  else
+    metrics_format_prometheus(body, data, valid, num);
+
+  metrics_printf(header, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+                 json ? "application/json" : "text/plain; version=0.0.4", (unsigned long) body.size());
+  body = header + body;
+
+  size_t pos = 0;
+  while( pos<body.size() )
+    {
+#ifdef _WIN32
+      r = send(c, body.data()+pos, body.size()-pos, 0);
+#else
+      r = send(c, body.data()+pos, body.size()-pos, MSG_NOSIGNAL);
+#endif
+      if( r<=0 ) break;
+      pos += r;
+    }
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI host_metrics_thread(void *data)
+#else
+static void *host_metrics_thread(void *data)
+#endif
+{
+#ifdef _WIN32
+  WSADATA wsaData;
+  WSAStartup(MAKEWORD(1,1), &wsaData);
+#endif
+
+  SOCKET accept_socket = set_up_listener("127.0.0.1", htons(metrics_port));
+  if( accept_socket == INVALID_SOCKET )
+    fprintf(stderr, "Can not listen on port %i => metrics not available\n", metrics_port);
+  else
+    while( true )
+      {
+        SOCKET c = accept(accept_socket, NULL, NULL);
+        if( c==INVALID_SOCKET ) continue;
+
+#ifdef _WIN32
+        DWORD timeout = 1000;
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, (const char *) &timeout, sizeof(timeout));
+        metrics_handle_request(c);
+        closesocket(c);
+#else
+        struct timeval timeout = {1, 0};
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        metrics_handle_request(c);
+        close(c);
+#endif
+      }
+
+  return 0;
+}
+
+
+static void metrics_setup()
+{
+  for(int i=1; i+1<g_argc; i++)
+    if( strcmp(g_argv[i], "-m")==0 )
+      metrics_port = atoi(g_argv[i+1]);
+
+  if( metrics_port>0 )
+    {
+      prof_instruction_active = true;
+      metrics_cycles_timer = timer_get_cycles();
+      metrics_prev_millis  = millis();
+      timer_setup(TIMER_METRICS, METRICS_TIMER_USEC, metrics_publish);
+      timer_start(TIMER_METRICS, METRICS_TIMER_USEC, true);
+
+      // machine 0 serves the counters of all machines
+      if( g_machine==0 )
+        {
+#ifdef _WIN32
+          DWORD id; 
+          HANDLE h = CreateThread(0, 0, host_metrics_thread, NULL, 0, &id);
+          CloseHandle(h);
+#else
+          pthread_t id;
+          pthread_create(&id, NULL, host_metrics_thread, NULL);
+          pthread_detach(id);
+#endif
+        }
+    }
+}
+
 
 void host_setup()
 {
@@ -966,12 +2689,33 @@ void host_setup()
   // open storage data file for mini file system
   host_storage_init(true);
 
-  inp_serial[0] = -1;
-  for(int i=0; i<HOSTPC_NUM_SOCKET_CONN; i++)
+  // set up host serial interfaces for this machine
+  hs = new HostSerialData;
+  hs->machine = g_machine;
+  hs->port    = 8800 + g_machine;
+  hs->first_socket_iface = g_machine==0 ? 1 : 0;
+  for(int i=0; i<HOST_NUM_SERIAL_PORTS; i++)
+    {
+#ifdef _WIN32
+      hs->iface_socket[i] = INVALID_SOCKET;
+#else
+      hs->iface_conns[i]  = 0;
+#endif
+      hs->inbuf[i].head  = hs->inbuf[i].tail  = 0;
+      hs->outbuf[i].head = hs->outbuf[i].tail = 0;
+    }
+  hs->out_pending = 0;
+#ifndef _WIN32
+  for(int i=0; i<NUM_SERIAL_DEVICES; i++)
     {
-      iface_socket[i] = INVALID_SOCKET;
-      inp_serial[i+1] = -1;
+      hs->dev_port[i]  = 0;
+      hs->dev_iface[i] = 0xff;
+      hs->dev_pty[i]   = NULL;
+      hs->dev_pty_name[i][0] = 0;
     }
+  hs->dev_iface_request = false;
+  host_serial_parse_listeners(hs);
+#endif
 
 #if defined(_WIN32)
   // send CTRL-C to input instead of processing it (otherwise the
@@ -985,32 +2729,76 @@ void host_setup()
   SetConsoleMode(hstdin, mode & ~ENABLE_PROCESSED_INPUT);
 
   // create an event that can be sent to awaken the input thread
-  signalEvent = CreateEvent(NULL, false, false, NULL);
+  hs->signalEvent = CreateEvent(NULL, false, false, NULL);
 
   // create the input thread
   DWORD id; 
-  HANDLE h = CreateThread(0, 0, host_input_thread, NULL, 0, &id);
+  HANDLE h = CreateThread(0, 0, host_input_thread, hs, 0, &id);
   CloseHandle(h);
+
+  // in batch mode, console input is read by a separate thread
+  if( g_batch && g_machine==0 )
+    {
+      h = CreateThread(0, 0, host_batch_input_thread, hs, 0, &id);
+      CloseHandle(h);
+    }
 #elif defined(__linux__)
   // handle CTRL-C in sig_handler so only pressing it twice
   // will terminate the simulator (otherwise CTRL-C could not
   // be sent to the emulated program
-  signal(SIGINT, sig_handler);
+  if( !g_batch ) signal(SIGINT, sig_handler);
+
+  // only machine 0 has console input
+  if( g_machine>0 )
+    hs->console_fd = -1;
+  else if( g_batch )
+    hs->console_fd = fileno(batch_input_file());
+  else
+    hs->console_fd = fileno(stdin);
+
+  // the simulated program may discard input that arrives while it is busy
+  // (e.g. BASIC checking for CTRL-C during output), so make an input file
+  // available from the first instruction on instead of whenever the input
+  // thread gets to it. Otherwise batch runs would not be reproducible.
+  struct stat st;
+  if( g_batch && hs->console_fd>=0 && fstat(hs->console_fd, &st)==0 && S_ISREG(st.st_mode) )
+    if( !host_input_console(hs) ) hs->console_fd = -1;
 
   // create an event that can be sent to awaken the input thread
-  signalEvent = eventfd(0, 0);
+  hs->signalEvent = eventfd(0, 0);
 
   // create the input thread
   pthread_t id;
-  pthread_create(&id, NULL, host_input_thread, 0);
+  pthread_create(&id, NULL, host_input_thread, hs);
   pthread_detach(id);
 #endif
   
   // initialize random number generator
   srand((unsigned int) time(NULL));
 
+  // serve live counters if requested
+  metrics_setup();
+
+  // write back cached disk sectors and capture files (and print the
+  // host time breakdown if USE_PROFILING_HOST is enabled) when exiting
+  machine_set_exit_handler(host_exit_handler);
+
+  // "-O session": mount disk images with copy-on-write overlays, each
+  // machine uses its own session (session, session+1, ...)
+  for(int i=1; i+1<g_argc; i++)
+    if( strcmp(g_argv[i], "-O")==0 )
+      {
+        // the last machine's session must not wrap around to IMAGE_OVERLAY_NONE
+        // (the error is reported once, by machine 0)
+        unsigned long session = strtoul(g_argv[i+1], NULL, 0);
+        if( session+g_num_machines-1 >= IMAGE_OVERLAY_NONE )
+          { if( g_machine==0 ) batch_error("Overlay session out of range", g_argv[i+1]); }
+        else
+          image_overlay_set_session(session + g_machine);
+      }
+
   // set serial receive callbacks to default
-  for(byte i=0; i<HOSTPC_NUM_SOCKET_CONN+1; i++)
+  for(byte i=0; i<HOST_NUM_SERIAL_PORTS; i++)
     host_serial_set_receive_callback(i, serial_receive_host_data);
 
   // handle RESET and DEPOSIT boot functions
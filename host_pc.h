@@ -19,7 +19,8 @@ typedef struct __dirstream DIR;
 #define HOST_STORAGESIZE 0x80000 /* 512k */
 #define HOST_BUFFERSIZE  0x400   /* 1k */
 
-// maximum is 4
+// maximum is 4 (the configuration stores host interface numbers in 3 bits),
+// on Linux any number of clients can share an interface via "-L" listeners
 #define HOSTPC_NUM_SOCKET_CONN  4
 
 #define HOST_NUM_SERIAL_PORTS   (HOSTPC_NUM_SOCKET_CONN+1)
@@ -36,6 +37,10 @@ typedef struct __dirstream DIR;
 #define HOST_FILESYS_FILE_TYPE FILE*
 #define HOST_FILESYS_DIR_TYPE  DIR*
 
+// host_serial_write() never waits for a client, it returns a short count
+// when the connection's output buffer (4k) is full
+#define HOST_HAS_NONBLOCKING_SERIAL_WRITE
+
 
 #ifdef _MSC_VER
 #define snprintf sprintf_s
@@ -47,10 +52,10 @@ typedef struct __dirstream DIR;
 #undef  MAX_BREAKPOINTS
 #define MAX_BREAKPOINTS 10
 
-extern byte data_leds;
-extern uint16_t status_leds;
-extern uint16_t addr_leds;
-extern byte stop_request;
+extern MACHINE_STATE byte data_leds;
+extern MACHINE_STATE uint16_t status_leds;
+extern MACHINE_STATE uint16_t addr_leds;
+extern MACHINE_STATE byte stop_request;
 
 #define host_read_sense_switches()             0
 uint16_t host_read_addr_switches();
@@ -110,6 +115,29 @@ void host_check_interrupts();
 void host_serial_interrupts_pause();
 void host_serial_interrupts_resume();
 
+// command line options for loading/starting programs and batch mode
+// (see "host_batch_setup" in host_pc.cpp)
+#define HOST_HAS_BATCH_MODE
+void host_batch_setup();
+void host_batch_cpu_stopped();
+
+// live counters served over a local socket (see "-m" option in host_pc.cpp)
+#define HOST_HAS_METRICS
+
+// time stamp counter for measuring host time (see USE_PROFILING_HOST)
+#define HOST_HAS_TICKS
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define host_get_ticks() __rdtsc()
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define host_get_ticks() __rdtsc()
+#else
+#define HOST_TICKS_NSEC
+uint64_t host_get_ticks();
+#endif
+double host_get_ticks_per_second();
+
 // external bus I/O not supported on this platform
 #define host_read_status_WAIT() 0
 #define host_read_data_bus()    0xFF
@@ -19,6 +19,7 @@
 
 #include "host.h"
 #include "image.h"
+#include "config.h"
 
 #ifdef HOST_HAS_FILESYS
 
@@ -28,8 +29,8 @@ static const char *dirfilename[4]    = {"DISKDIR.TXT",  "HDSKDIR.TXT", "TDISKDIR
 
 const char *image_get_dir_content(byte image_type)
 {
-  static byte  contenttype  = -1;
-  static char *contentcache = NULL;
+  static MACHINE_STATE byte  contenttype  = -1;
+  static MACHINE_STATE char *contentcache = NULL;
 
   if( image_type != contenttype )
     {
@@ -80,7 +81,7 @@ bool image_get_filename(byte image_type, byte image_num, char *filename, int buf
 
 const char *image_get_filename(byte image_type, byte image_num, bool check_exist)
 {
-  static char buf[13];
+  static MACHINE_STATE char buf[13];
   if( image_get_filename(image_type, image_num, buf, 13, check_exist) )
     return buf;
   else
@@ -90,7 +91,7 @@ const char *image_get_filename(byte image_type, byte image_num, bool check_exist
 
 const char *image_get_description(byte image_type, byte image_num)
 {
-  static char *buf = NULL;
+  static MACHINE_STATE char *buf = NULL;
   const char *fname = image_get_filename(image_type, image_num);
 
   if( fname!=NULL )
@@ -118,4 +119,460 @@ const char *image_get_description(byte image_type, byte image_num)
 }
 
 
+
+// -----------------------------------------------------------------------------------------------------------------------
+
+
+// Overlay file layout: 12-byte header ("AOVL", block size, logical image size)
+// followed by records of a 4-byte block number and the block data.
+// The records are appended in the order in which blocks are first modified,
+// the (block number -> record) index is kept in memory, sorted by block number.
+#define IMAGE_OVERLAY_HEADER_SIZE 12
+#define IMAGE_MAX_FILES (NUM_DRIVES+NUM_CDRIVES+NUM_TDRIVES+4*NUM_HDSK_UNITS+1)
+
+struct ImageOverlayBlock {
+  uint32_t block;
+  uint32_t record;
+};
+
+struct ImageFile {
+  bool     open, overlay, overlay_dirty;
+  byte     image_type, image_num;
+  uint16_t block_size;
+  uint32_t pos, size;
+  uint32_t num_blocks, max_blocks;
+  struct ImageOverlayBlock *blocks;
+  HOST_FILESYS_FILE_TYPE base;
+  HOST_FILESYS_FILE_TYPE delta;
+};
+
+static MACHINE_STATE struct ImageFile image_files[IMAGE_MAX_FILES];
+static MACHINE_STATE byte image_overlay_session = IMAGE_OVERLAY_NONE;
+
+
+static void image_get_overlay_filename(byte image_type, byte image_num, char *filename, int buf_len)
+{
+  image_get_filename(image_type, image_num, filename, buf_len, false);
+  char *ext = strrchr(filename, '.');
+  if( ext!=NULL && ext+4<filename+buf_len ) 
+    snprintf(ext+1, 4, "O%02X", image_overlay_session);
+}
+
+
+static void image_overlay_put_uint32(byte *buf, uint32_t v)
+{
+  buf[0] = v & 0xff; buf[1] = (v >> 8) & 0xff; buf[2] = (v >> 16) & 0xff; buf[3] = (v >> 24) & 0xff;
+}
+
+
+static uint32_t image_overlay_get_uint32(const byte *buf)
+{
+  return buf[0] | (buf[1] << 8) | (((uint32_t) buf[2]) << 16) | (((uint32_t) buf[3]) << 24);
+}
+
+
+static uint32_t image_overlay_record_pos(struct ImageFile *f, uint32_t record)
+{
+  return IMAGE_OVERLAY_HEADER_SIZE + record * (4ul + f->block_size) + 4;
+}
+
+
+static int32_t image_overlay_find(struct ImageFile *f, uint32_t block, bool insert)
+{
+  // binary search for block in index
+  uint32_t lo = 0, hi = f->num_blocks;
+  while( lo<hi )
+    {
+      uint32_t mid = (lo+hi)/2;
+      if( f->blocks[mid].block<block )
+        lo = mid+1;
+      else
+        hi = mid;
+    }
+
+  if( lo<f->num_blocks && f->blocks[lo].block==block )
+    return lo;
+  else if( !insert )
+    return -1;
+
+  if( f->num_blocks==f->max_blocks )
+    {
+      uint32_t n = f->max_blocks==0 ? 64 : f->max_blocks*2;
+      struct ImageOverlayBlock *b = (struct ImageOverlayBlock *) realloc(f->blocks, n * sizeof(struct ImageOverlayBlock));
+      if( b==NULL ) return -1;
+      f->blocks = b;
+      f->max_blocks = n;
+    }
+
+  memmove(f->blocks+lo+1, f->blocks+lo, (f->num_blocks-lo) * sizeof(struct ImageOverlayBlock));
+  f->blocks[lo].block  = block;
+  f->blocks[lo].record = f->num_blocks++;
+  return lo;
+}
+
+
+static bool image_overlay_write_header(struct ImageFile *f)
+{
+  byte hdr[IMAGE_OVERLAY_HEADER_SIZE] = {'A', 'O', 'V', 'L', (byte) (f->block_size & 0xff), (byte) (f->block_size >> 8), 0, 0};
+  image_overlay_put_uint32(hdr+8, f->size);
+  return host_filesys_file_seek(f->delta, 0) && host_filesys_file_write(f->delta, IMAGE_OVERLAY_HEADER_SIZE, hdr)==IMAGE_OVERLAY_HEADER_SIZE;
+}
+
+
+static bool image_overlay_load(struct ImageFile *f, const char *filename)
+{
+  // read header and build index from the records in an existing overlay file
+  byte buf[IMAGE_OVERLAY_HEADER_SIZE];
+  f->delta = host_filesys_file_open(filename, true);
+  if( !f->delta || host_filesys_file_read(f->delta, IMAGE_OVERLAY_HEADER_SIZE, buf)<IMAGE_OVERLAY_HEADER_SIZE ||
+      memcmp(buf, "AOVL", 4)!=0 || (buf[4] | (buf[5] << 8))!=f->block_size )
+    return false;
+
+  f->size = image_overlay_get_uint32(buf+8);
+  uint32_t nrecords = (host_filesys_file_size(filename) - IMAGE_OVERLAY_HEADER_SIZE) / (4ul + f->block_size);
+  for(uint32_t r=0; r<nrecords; r++)
+    {
+      if( !host_filesys_file_seek(f->delta, image_overlay_record_pos(f, r)-4) || 
+          host_filesys_file_read(f->delta, 4, buf)<4 ||
+          image_overlay_find(f, image_overlay_get_uint32(buf), true)<0 )
+        return false;
+    }
+
+  return true;
+}
+
+
+static uint32_t image_overlay_read(struct ImageFile *f, uint32_t len, byte *buffer)
+{
+  uint32_t res = 0;
+  if( f->pos>=f->size ) return 0;
+  if( f->pos+len>f->size ) len = f->size-f->pos;
+
+  while( res<len )
+    {
+      uint32_t block  = f->pos / f->block_size;
+      uint32_t offset = f->pos % f->block_size;
+      uint32_t n = min(len-res, f->block_size-offset), m = 0;
+
+      int32_t i = image_overlay_find(f, block, false);
+      if( i>=0 )
+        {
+          // block was modified => read from overlay file
+          if( host_filesys_file_seek(f->delta, image_overlay_record_pos(f, f->blocks[i].record)+offset) )
+            m = host_filesys_file_read(f->delta, n, buffer+res);
+          if( m<n ) break;
+        }
+      else
+        {
+          // read from base image, parts beyond its end (image was extended
+          // by writing to the overlay) read as 0
+          if( f->base && host_filesys_file_seek(f->base, f->pos) ) 
+            m = host_filesys_file_read(f->base, n, buffer+res);
+          memset(buffer+res+m, 0, n-m);
+        }
+
+      res    += n;
+      f->pos += n;
+    }
+
+  return res;
+}
+
+
+static uint32_t image_overlay_write(struct ImageFile *f, uint32_t len, const byte *buffer)
+{
+  uint32_t res = 0;
+
+  while( res<len )
+    {
+      uint32_t block  = f->pos / f->block_size;
+      uint32_t offset = f->pos % f->block_size;
+      uint32_t n = min(len-res, f->block_size-offset);
+
+      int32_t i = image_overlay_find(f, block, false);
+      if( i<0 )
+        {
+          // first modification of this block => add a new record to the overlay file
+          if( !f->delta )
+            {
+              char filename[13];
+              image_get_overlay_filename(f->image_type, f->image_num, filename, 13);
+              f->delta = host_filesys_file_open(filename, true);
+              if( !f->delta || !image_overlay_write_header(f) ) break;
+            }
+
+          i = image_overlay_find(f, block, true);
+          if( i<0 ) break;
+
+          byte buf[64];
+          image_overlay_put_uint32(buf, block);
+          if( !host_filesys_file_seek(f->delta, image_overlay_record_pos(f, f->blocks[i].record)-4) || 
+              host_filesys_file_write(f->delta, 4, buf)<4 )
+            break;
+
+          if( n<f->block_size )
+            {
+              // block is only partially overwritten => copy it from the base image first
+              uint32_t p, m;
+              if( f->base ) host_filesys_file_seek(f->base, block*f->block_size);
+              for(p=0; p<f->block_size; p+=m)
+                {
+                  m = min(f->block_size-p, (uint32_t) 64);
+                  uint32_t r = f->base ? host_filesys_file_read(f->base, m, buf) : 0;
+                  if( r<m ) memset(buf+r, 0, m-r);
+                  if( host_filesys_file_write(f->delta, m, buf)<m ) break;
+                }
+              if( p<f->block_size ) break;
+            }
+        }
+
+      if( !host_filesys_file_seek(f->delta, image_overlay_record_pos(f, f->blocks[i].record)+offset) ||
+          host_filesys_file_write(f->delta, n, buffer+res)<n )
+        break;
+
+      res    += n;
+      f->pos += n;
+      if( f->pos>f->size ) f->size = f->pos;
+      f->overlay_dirty = true;
+    }
+
+  return res;
+}
+
+
+byte image_file_open(byte image_type, byte image_num, uint16_t block_size)
+{
+  byte fid;
+  for(fid=0; fid<IMAGE_MAX_FILES && image_files[fid].open; fid++);
+  if( fid==IMAGE_MAX_FILES ) return IMAGE_FILE_NONE;
+
+  struct ImageFile *f = image_files+fid;
+  char filename[13];
+  image_get_filename(image_type, image_num, filename, 13, false);
+
+  memset(f, 0, sizeof(struct ImageFile));
+  f->image_type = image_type;
+  f->image_num  = image_num;
+  f->block_size = block_size;
+  f->overlay    = image_overlay_session!=IMAGE_OVERLAY_NONE;
+  f->base       = host_filesys_file_open(filename, !f->overlay);
+  f->size       = f->base ? host_filesys_file_size(filename) : 0;
+
+  if( f->overlay )
+    {
+      // continue a previous session if its overlay file exists
+      image_get_overlay_filename(image_type, image_num, filename, 13);
+      if( host_filesys_file_exists(filename) && !image_overlay_load(f, filename) )
+        {
+          if( f->delta ) host_filesys_file_close(f->delta);
+          if( f->base ) host_filesys_file_close(f->base);
+          free(f->blocks);
+          return IMAGE_FILE_NONE;
+        }
+    }
+  else if( !f->base )
+    return IMAGE_FILE_NONE;
+
+  f->open = true;
+  return fid;
+}
+
+
+uint32_t image_file_read(byte fid, uint32_t len, void *buffer)
+{
+  if( fid>=IMAGE_MAX_FILES || !image_files[fid].open ) return 0;
+  struct ImageFile *f = image_files+fid;
+
+  if( f->overlay )
+    return image_overlay_read(f, len, (byte *) buffer);
+  else
+    {
+      uint32_t n = host_filesys_file_read(f->base, len, buffer);
+      f->pos += n;
+      return n;
+    }
+}
+
+
+uint32_t image_file_write(byte fid, uint32_t len, const void *buffer)
+{
+  if( fid>=IMAGE_MAX_FILES || !image_files[fid].open ) return 0;
+  struct ImageFile *f = image_files+fid;
+
+  if( f->overlay )
+    return image_overlay_write(f, len, (const byte *) buffer);
+  else
+    {
+      uint32_t n = host_filesys_file_write(f->base, len, buffer);
+      f->pos += n;
+      if( f->pos>f->size ) f->size = f->pos;
+      return n;
+    }
+}
+
+
+uint32_t image_file_set(byte fid, uint32_t len, byte b)
+{
+  if( fid>=IMAGE_MAX_FILES || !image_files[fid].open ) return 0;
+  struct ImageFile *f = image_files+fid;
+
+  if( f->overlay )
+    {
+      uint32_t res = 0;
+      byte buf[64];
+      memset(buf, b, 64);
+      while( res<len )
+        {
+          uint32_t n = min(len-res, (uint32_t) 64);
+          if( image_overlay_write(f, n, buf)<n ) break;
+          res += n;
+        }
+      return res;
+    }
+  else
+    {
+      uint32_t n = host_filesys_file_set(f->base, len, b);
+      f->pos += n;
+      if( f->pos>f->size ) f->size = f->pos;
+      return n;
+    }
+}
+
+
+void image_file_flush(byte fid)
+{
+  if( fid>=IMAGE_MAX_FILES || !image_files[fid].open ) return;
+  struct ImageFile *f = image_files+fid;
+
+  if( !f->overlay )
+    host_filesys_file_flush(f->base);
+  else if( f->delta && f->overlay_dirty )
+    {
+      // the header contains the image size which may have changed
+      image_overlay_write_header(f);
+      host_filesys_file_flush(f->delta);
+      f->overlay_dirty = false;
+    }
+}
+
+
+bool image_file_seek(byte fid, uint32_t pos)
+{
+  if( fid>=IMAGE_MAX_FILES || !image_files[fid].open ) return false;
+  struct ImageFile *f = image_files+fid;
+
+  f->pos = pos;
+  return f->overlay ? true : host_filesys_file_seek(f->base, pos);
+}
+
+
+uint32_t image_file_size(byte fid)
+{
+  return fid<IMAGE_MAX_FILES && image_files[fid].open ? image_files[fid].size : 0;
+}
+
+
+void image_file_close(byte &fid)
+{
+  if( fid<IMAGE_MAX_FILES && image_files[fid].open )
+    {
+      struct ImageFile *f = image_files+fid;
+      image_file_flush(fid);
+      if( f->base )  host_filesys_file_close(f->base);
+      if( f->delta ) host_filesys_file_close(f->delta);
+      free(f->blocks);
+      f->blocks = NULL;
+      f->open = false;
+    }
+
+  fid = IMAGE_FILE_NONE;
+}
+
+
+void image_overlay_set_session(byte session)
+{
+  image_overlay_session = session;
+}
+
+
+byte image_overlay_get_session()
+{
+  return image_overlay_session;
+}
+
+
+uint32_t image_overlay_num_blocks()
+{
+  uint32_t n = 0;
+  for(byte fid=0; fid<IMAGE_MAX_FILES; fid++)
+    if( image_files[fid].open ) 
+      n += image_files[fid].num_blocks;
+
+  return n;
+}
+
+
+static bool image_overlay_is_open(byte image_type, byte image_num)
+{
+  for(byte fid=0; fid<IMAGE_MAX_FILES; fid++)
+    if( image_files[fid].open && image_files[fid].image_type==image_type && image_files[fid].image_num==image_num )
+      return true;
+
+  return false;
+}
+
+
+bool image_overlay_discard(byte image_type, byte image_num)
+{
+  char filename[13];
+  if( image_overlay_session==IMAGE_OVERLAY_NONE || image_overlay_is_open(image_type, image_num) ) return false;
+
+  image_get_overlay_filename(image_type, image_num, filename, 13);
+  return !host_filesys_file_exists(filename) || host_filesys_file_remove(filename);
+}
+
+
+bool image_overlay_commit(byte image_type, byte image_num)
+{
+  // note that other sessions using the same image will see the
+  // committed changes mixed with their own overlays
+  char filename[13];
+  if( image_overlay_session==IMAGE_OVERLAY_NONE || image_overlay_is_open(image_type, image_num) ) return false;
+  image_get_overlay_filename(image_type, image_num, filename, 13);
+  if( !host_filesys_file_exists(filename) ) return true;
+
+  // read the overlay file header to get the block size
+  byte buf[IMAGE_OVERLAY_HEADER_SIZE];
+  HOST_FILESYS_FILE_TYPE d = host_filesys_file_open(filename, false);
+  bool ok = d && host_filesys_file_read(d, IMAGE_OVERLAY_HEADER_SIZE, buf)==IMAGE_OVERLAY_HEADER_SIZE && memcmp(buf, "AOVL", 4)==0;
+  if( d ) host_filesys_file_close(d);
+  if( !ok ) return false;
+
+  byte fid = image_file_open(image_type, image_num, buf[4] | (buf[5] << 8));
+  if( fid==IMAGE_FILE_NONE ) return false;
+  struct ImageFile *f = image_files+fid;
+
+  // copy all modified blocks to the image file (not extending it beyond its logical size)
+  image_get_filename(image_type, image_num, filename, 13, false);
+  HOST_FILESYS_FILE_TYPE base = host_filesys_file_open(filename, true);
+  byte *block = (byte *) malloc(f->block_size);
+  ok = base && block!=NULL;
+  for(uint32_t i=0; ok && i<f->num_blocks; i++)
+    {
+      uint32_t pos = f->blocks[i].block * f->block_size;
+      uint32_t n   = pos+f->block_size>f->size ? (pos<f->size ? f->size-pos : 0) : f->block_size;
+      ok = host_filesys_file_seek(f->delta, image_overlay_record_pos(f, f->blocks[i].record)) &&
+        host_filesys_file_read(f->delta, n, block)==n &&
+        host_filesys_file_seek(base, pos) &&
+        host_filesys_file_write(base, n, block)==n;
+    }
+
+  free(block);
+  if( base ) { host_filesys_file_flush(base); host_filesys_file_close(base); }
+  image_file_close(fid);
+
+  return ok && image_overlay_discard(image_type, image_num);
+}
+
+
 #endif
@@ -18,5 +18,28 @@ bool        image_get_filename(byte image_type, byte image_num, char *filename,
 const char *image_get_filename(byte image_type, byte image_num, bool check_exist = true);
 const char *image_get_description(byte image_type, byte image_num);
 
+// Disk image files as used by the disk controllers. The functions mirror
+// the host_filesys_file_* functions. If an overlay session is set when an
+// image is opened then the image file itself is only read and all modified
+// blocks (block_size bytes each) are stored in a separate overlay file
+// (e.g. DISK01.O00 for DISK01.DSK in session 0) which is kept across mounts
+// until its changes are committed to the image or discarded.
+#define IMAGE_FILE_NONE    0xff
+#define IMAGE_OVERLAY_NONE 0xff
+byte     image_file_open(byte image_type, byte image_num, uint16_t block_size);
+uint32_t image_file_read(byte f, uint32_t len, void *buffer);
+uint32_t image_file_write(byte f, uint32_t len, const void *buffer);
+uint32_t image_file_set(byte f, uint32_t len, byte b);
+void     image_file_flush(byte f);
+bool     image_file_seek(byte f, uint32_t pos);
+uint32_t image_file_size(byte f);
+void     image_file_close(byte &f);
+
+void     image_overlay_set_session(byte session);
+byte     image_overlay_get_session();
+uint32_t image_overlay_num_blocks();
+bool     image_overlay_commit(byte image_type, byte image_num);
+bool     image_overlay_discard(byte image_type, byte image_num);
+
 #endif
 
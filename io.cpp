@@ -21,6 +21,7 @@
 #include "config.h"
 #include "host.h"
 #include "numsys.h"
+#include "profile.h"
 
 //#define DEBUG
 
@@ -73,23 +74,62 @@ static void io_unused_out(byte port, byte data)
 // for each port it needs to use. This improves performance, especially if many
 // devices are supported.
 
-static IOFUN_INP portfun_inp[256];
-static IOFUN_OUT portfun_out[256];
+static MACHINE_STATE IOFUN_INP portfun_inp[256];
+static MACHINE_STATE IOFUN_OUT portfun_out[256];
+
+#if USE_PROFILING_IO>0
+// Per-port access counters and host time spent in the device handlers.
+// Handlers usually take less than a microsecond but since the start of a
+// call is not synchronized with the micros() clock, the sum of the measured
+// differences still is a good estimate of the total time.
+static MACHINE_STATE bool     io_prof_active = false;
+static MACHINE_STATE uint32_t io_prof_count_inp[256], io_prof_count_out[256];
+static MACHINE_STATE uint32_t io_prof_usec_inp[256], io_prof_usec_out[256];
+static MACHINE_STATE uint32_t io_prof_start;
+#endif
 
 
 byte io_inp(byte port)
 {
+  byte b;
 #if USE_IO_BUS>0
   // Wait while WAIT signal is asserted by an external device
   // before reading the actual data
   while( host_read_status_WAIT() );
 #endif
-  return portfun_inp[port](port);
+  PROFILE_COUNT_IO_INP(port);
+  PROFILE_HOST_SCOPE(PROF_HOST_IO);
+#if USE_PROFILING_IO>0
+  if( io_prof_active )
+    {
+      uint32_t t = micros();
+      b = portfun_inp[port](port);
+      io_prof_usec_inp[port] += micros()-t;
+      io_prof_count_inp[port]++;
+    }
+  else
+#endif
+  b = portfun_inp[port](port);
+  PROFILE_TRACE_IN(port, b);
+  return b;
 }
 
 
 void io_out(byte port, byte data)
 {
+  PROFILE_COUNT_IO_OUT(port);
+  PROFILE_TRACE_OUT(port, data);
+  PROFILE_HOST_SCOPE(PROF_HOST_IO);
+#if USE_PROFILING_IO>0
+  if( io_prof_active )
+    {
+      uint32_t t = micros();
+      portfun_out[port](port, data);
+      io_prof_usec_out[port] += micros()-t;
+      io_prof_count_out[port]++;
+    }
+  else
+#endif
   portfun_out[port](port, data);
 #if USE_IO_BUS>0
   // Wait while WAIT signal is asserted by an external
@@ -148,6 +188,93 @@ void io_print_registered_ports()
 }
 
 
+#if USE_PROFILING_IO>0
+
+void io_profile_enable(bool b)
+{
+  io_prof_active = b;
+}
+
+
+void io_profile_reset()
+{
+  for(int i=0; i<256; i++)
+    {
+      io_prof_count_inp[i] = 0;
+      io_prof_count_out[i] = 0;
+      io_prof_usec_inp[i]  = 0;
+      io_prof_usec_out[i]  = 0;
+    }
+
+  io_prof_start = micros();
+}
+
+
+void io_profile_get_totals(uint32_t *count, uint32_t *usec)
+{
+  *count = 0;
+  *usec  = 0;
+  for(int i=0; i<256; i++)
+    {
+      *count += io_prof_count_inp[i] + io_prof_count_out[i];
+      *usec  += io_prof_usec_inp[i]  + io_prof_usec_out[i];
+    }
+}
+
+
+static void io_profile_print_num(uint32_t v, byte width)
+{
+  byte digits = 1;
+  for(uint32_t x=v; x>=10; x/=10) digits++;
+  while( digits++<width ) Serial.print(' ');
+  Serial.print(v);
+}
+
+
+void io_profile_print()
+{
+  // rates are per second of wall clock time since the counters were cleared
+  float secs = ((uint32_t) (micros()-io_prof_start)) / 1000000.0;
+  bool printed[256];
+  int i;
+
+  for(i=0; i<256; i++) printed[i] = false;
+
+  Serial.print(F("\r\nI/O port accesses during "));
+  Serial.print(secs);
+  Serial.println(F(" seconds:\r\n"));
+  Serial.println(F("Port       Reads   Reads/s      Writes  Writes/s  Host usec   Host%"));
+  
+  // list ports by number of accesses
+  while( true )
+    {
+      int maxIdx = -1;
+      for(i=0; i<256; i++)
+        if( !printed[i] && io_prof_count_inp[i]+io_prof_count_out[i]>0 && 
+            (maxIdx<0 || io_prof_count_inp[i]+io_prof_count_out[i] > io_prof_count_inp[maxIdx]+io_prof_count_out[maxIdx]) )
+          maxIdx = i;
+
+      if( maxIdx<0 ) break;
+      printed[maxIdx] = true;
+
+      uint32_t usec = io_prof_usec_inp[maxIdx] + io_prof_usec_out[maxIdx];
+      numsys_print_byte(maxIdx);
+      Serial.print(F("  "));
+      io_profile_print_num(io_prof_count_inp[maxIdx], 10);
+      io_profile_print_num(secs>0 ? (uint32_t) (io_prof_count_inp[maxIdx]/secs) : 0, 10);
+      io_profile_print_num(io_prof_count_out[maxIdx], 12);
+      io_profile_print_num(secs>0 ? (uint32_t) (io_prof_count_out[maxIdx]/secs) : 0, 10);
+      io_profile_print_num(usec, 11);
+      Serial.print(F("  "));
+      if( secs>0 && usec/(secs*10000.0) < 10.0 ) Serial.print(' ');
+      Serial.print(secs>0 ? usec/(secs*10000.0) : 0.0);
+      Serial.println('%');
+    }
+}
+
+#endif
+
+
 void io_setup()
 {
   for(int i=0; i<256; i++)
@@ -155,6 +282,10 @@ void io_setup()
       portfun_inp[i] = io_unused_inp;
       portfun_out[i] = io_unused_out;
     }
+
+#if USE_PROFILING_IO>0
+  io_profile_reset();
+#endif
 }
 
 #else // -------------------------------------------------------------------------------
@@ -220,6 +351,7 @@ byte io_inp(byte port)
 
 void io_out(byte port, byte data)
 {
+  PROFILE_COUNT_IO_OUT(port);
   switch( port )
     {
     case 0x00: serial_sio_out_ctrl(port, data); break;
@@ -252,4 +384,12 @@ void io_register_port_out(byte port, IOFUN_OUT f) {}
 void io_print_registered_ports() {}
 void io_setup() {}
 
+#if USE_PROFILING_IO>0
+// I/O profiling is not supported on the MEGA
+void io_profile_enable(bool b) {}
+void io_profile_reset() {}
+void io_profile_get_totals(uint32_t *count, uint32_t *usec) { *count = 0; *usec = 0; }
+void io_profile_print() {}
+#endif
+
 #endif
@@ -19,4 +19,11 @@ void io_out(byte port, byte data);
 void io_print_registered_ports();
 void io_setup();
 
+#if USE_PROFILING_IO>0
+void io_profile_enable(bool b);
+void io_profile_reset();
+void io_profile_get_totals(uint32_t *count, uint32_t *usec);
+void io_profile_print();
+#endif
+
 #endif
@@ -25,10 +25,10 @@
 #include "config.h"
 
 
-word mem_ram_limit = 0xFFFF, mem_protected_limit = 0xFFFF;
-byte mem_protected_flags[32];
+MACHINE_STATE word mem_ram_limit = 0xFFFF, mem_protected_limit = 0xFFFF;
+MACHINE_STATE byte mem_protected_flags[32];
 
-byte Mem[MEMSIZE];
+MACHINE_STATE byte Mem[MEMSIZE];
 
 
 byte MEM_READ_STEP(uint16_t a)
@@ -312,12 +312,12 @@ void mem_disable_inp_ff() {}
 
 #else
 
-byte     mem_roms_num = 0;
-uint16_t mem_roms_start[MAX_NUM_ROMS];
-uint16_t mem_roms_length[MAX_NUM_ROMS];
-uint16_t mem_roms_flags[MAX_NUM_ROMS];
-char     mem_roms_name[MAX_NUM_ROMS][9];
-uint32_t mem_roms_filepos[MAX_NUM_ROMS];
+MACHINE_STATE byte     mem_roms_num = 0;
+MACHINE_STATE uint16_t mem_roms_start[MAX_NUM_ROMS];
+MACHINE_STATE uint16_t mem_roms_length[MAX_NUM_ROMS];
+MACHINE_STATE uint16_t mem_roms_flags[MAX_NUM_ROMS];
+MACHINE_STATE char     mem_roms_name[MAX_NUM_ROMS][9];
+MACHINE_STATE uint32_t mem_roms_filepos[MAX_NUM_ROMS];
 
 
 bool mem_remove_rom(byte i, bool clear)
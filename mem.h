@@ -13,10 +13,10 @@
 #include "cpucore.h"
 #include "Altair8800.h"
 
-extern byte Mem[MEMSIZE];
-extern word mem_protected_limit;
+extern MACHINE_STATE byte Mem[MEMSIZE];
+extern MACHINE_STATE word mem_protected_limit;
 
-extern byte mem_protected_flags[32];
+extern MACHINE_STATE byte mem_protected_flags[32];
 
 #define MEM_IS_WRITABLE(a) ((a) < mem_protected_limit || !(mem_protected_flags[(a)>>11] & (1<<(((a)>>8)&0x07))))
 
@@ -28,31 +28,52 @@ void mem_print_layout();
 
 #if MEMSIZE < 0x10000
 // if we have less than 64k of RAM then always map ROM basic to 0xC000-0xFFFF
-#define MREAD(a)    ((a)>=0xC000 ? prog_basic_read_16k(a) : ((a) < MEMSIZE ? Mem[a] : 0xFF))
-#define MWRITE(a,v) {if( MEM_IS_WRITABLE(a) ) Mem[a]=v;}
+#define MREAD_MEM(a)    ((a)>=0xC000 ? prog_basic_read_16k(a) : ((a) < MEMSIZE ? Mem[a] : 0xFF))
+#define MWRITE_MEM(a,v) {if( MEM_IS_WRITABLE(a) ) Mem[a]=v;}
 #else
 // If we have 64k of RAM then we just copy ROM basic to the upper 16k and write-protect
 // that area.  Faster to check the address on writing than reading since there are far more
 // reads than writes. Also we can skip memory bounds checking because addresses are 16 bit.
-#define MREAD(a)    (Mem[a])
+#define MREAD_MEM(a)    (Mem[a])
 
 #if USE_DAZZLER>0
 #include "dazzler.h"
 #if USE_VDM1>0
 #include "vdm1.h"
-#define MWRITE(a,v) { dazzler_write_mem(a, v); vdm1_write_mem(a, v); if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
+#define MWRITE_MEM(a,v) { dazzler_write_mem(a, v); vdm1_write_mem(a, v); if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
 #else
-#define MWRITE(a,v) { dazzler_write_mem(a, v); if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
+#define MWRITE_MEM(a,v) { dazzler_write_mem(a, v); if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
 #endif
 #elif USE_VDM1>0
 #include "vdm1.h"
-#define MWRITE(a,v) { vdm1_write_mem(a, v); if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
+#define MWRITE_MEM(a,v) { vdm1_write_mem(a, v); if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
 #else
-#define MWRITE(a,v) { if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
+#define MWRITE_MEM(a,v) { if( MEM_IS_WRITABLE(a) ) Mem[a]=v; }
 #endif
 
 #endif
 
+#if USE_PROFILING_COVERAGE>0 || USE_PROFILING_TRACE>0
+// record memory accesses in the coverage bitmaps and instruction trace
+#include "profile.h"
+#endif
+
+#if USE_PROFILING_COVERAGE>0
+#define MREAD(a)    (PROFILE_COVER_READ(a), MREAD_MEM(a))
+#else
+#define MREAD(a)    MREAD_MEM(a)
+#endif
+
+// instruction fetches (opcodes and operands) are not data reads, the CPU
+// loop records the instruction address as executed instead
+#define MFETCH(a)   MREAD_MEM(a)
+
+#if USE_PROFILING_COVERAGE>0 || USE_PROFILING_TRACE>0
+#define MWRITE(a,v) { PROFILE_COVER_WRITE(a); PROFILE_TRACE_WRITE(a, v); MWRITE_MEM(a,v); }
+#else
+#define MWRITE(a,v) MWRITE_MEM(a,v)
+#endif
+
 byte MEM_READ_STEP(uint16_t a);
 void MEM_WRITE_STEP(uint16_t a, byte v);
 
@@ -74,8 +95,23 @@ inline byte MEM_READ(uint16_t a)
     }
   return res;
 }
+inline byte MEM_FETCH(uint16_t a)
+{
+  byte res;
+  if( host_read_status_led_WAIT() )
+    res = MEM_READ_STEP(a);
+  else
+    {
+      host_set_addr_leds(a);
+      host_set_status_leds_READMEM();
+      res = host_set_data_leds(MFETCH(a));
+      host_clr_status_led_MEMR();
+    }
+  return res;
+}
 #else
 #define MEM_READ(a) ( host_read_status_led_WAIT() ? MEM_READ_STEP(a) : (host_set_status_leds_READMEM(),  host_set_addr_leds(a), host_set_data_leds(MREAD(a)) ))
+#define MEM_FETCH(a) ( host_read_status_led_WAIT() ? MEM_READ_STEP(a) : (host_set_status_leds_READMEM(),  host_set_addr_leds(a), host_set_data_leds(MFETCH(a)) ))
 #endif
 
 #if SHOW_MWRITE_OUTPUT>0
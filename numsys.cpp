@@ -22,7 +22,7 @@
 #include "mem.h"
 #include "serial.h"
 
-static byte numsys = NUMSYS_HEX;
+static MACHINE_STATE byte numsys = NUMSYS_HEX;
 
 static byte hexToDec(int hc)
 {
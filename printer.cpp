@@ -44,10 +44,10 @@ void printer_register_ports() {}
 #define STLF_DONE 0
 
 #define BUFFER_SIZE 132
-static byte status = 0x00;
-static bool interrupt_enabled = false;
-static byte buffer_size = 0, buffer_counter = 0, linefeed_status = 0;
-static byte buffer[BUFFER_SIZE];
+static MACHINE_STATE byte status = 0x00;
+static MACHINE_STATE bool interrupt_enabled = false;
+static MACHINE_STATE byte buffer_size = 0, buffer_counter = 0, linefeed_status = 0;
+static MACHINE_STATE byte buffer[BUFFER_SIZE];
 
 
 static bool print_character(byte c, unsigned long delay)
@@ -242,7 +242,7 @@ void printer_oki_setup()
 // Documentation for the C700 printer is at:
 // http://altairclone.com/downloads/manuals/88-C700%20(Centronics).pdf
 
-static byte printer_c700_selected = false;
+static MACHINE_STATE byte printer_c700_selected = false;
 
 void printer_c700_out_ctrl(byte data)
 {
@@ -24,61 +24,1050 @@
 #include "config.h"
 #include "host.h"
 #include "cpucore.h"
+#include "numsys.h"
+#include "mem.h"
+#include "io.h"
 
 #if USE_PROFILING_DETAIL>0
-unsigned long prof_detail_counter, prof_opcode_count[256];
+
+// instruction groups (Z80 prefixes)
+#define PROF_GRP_NONE  0
+#define PROF_GRP_CB    1
+#define PROF_GRP_DD    2
+#define PROF_GRP_ED    3
+#define PROF_GRP_FD    4
+#define PROF_GRP_DDCB  5
+#define PROF_GRP_FDCB  6
+
+#if USE_Z80>0
+#define PROF_NUM_GROUPS 7
+#else
+#define PROF_NUM_GROUPS 1
+#endif
+
+static MACHINE_STATE unsigned long prof_detail_counter;
+static MACHINE_STATE unsigned long prof_opcode_count[PROF_NUM_GROUPS*256], prof_opcode_cycles[PROF_NUM_GROUPS*256];
+static MACHINE_STATE uint16_t prof_opcode_prev;
+static MACHINE_STATE uint32_t prof_opcode_prev_cycles;
+
+
+void prof_count_opcode(byte opcode)
+{
+  uint16_t idx = opcode;
+  uint32_t c   = timer_get_cycles();
+
+#if USE_Z80>0
+  // regPC already points to the byte following the opcode
+  if( cpu_get_processor()==PROC_Z80 )
+    switch( opcode )
+      {
+      case 0xCB: idx = PROF_GRP_CB*256 + MREAD_MEM(regPC); break;
+      case 0xED: idx = PROF_GRP_ED*256 + MREAD_MEM(regPC); break;
+      case 0xDD: 
+      case 0xFD:
+        {
+          byte op2 = MREAD_MEM(regPC);
+          if( op2==0xCB )
+            idx = (opcode==0xDD ? PROF_GRP_DDCB : PROF_GRP_FDCB)*256 + MREAD_MEM((uint16_t) (regPC+2));
+          else
+            idx = (opcode==0xDD ? PROF_GRP_DD : PROF_GRP_FD)*256 + op2;
+          break;
+        }
+      }
+#endif
+
+  prof_opcode_cycles[prof_opcode_prev] += c - prof_opcode_prev_cycles;
+  prof_opcode_count[idx]++;
+  prof_opcode_prev = idx;
+  prof_opcode_prev_cycles = c;
+}
+
 
 void prof_reset_details()
 {
   prof_detail_counter = 0;
-  for(int i=0; i<256; i++) prof_opcode_count[i]=0;
+  prof_opcode_prev_cycles = timer_get_cycles();
+  for(int i=0; i<PROF_NUM_GROUPS*256; i++) { prof_opcode_count[i]=0; prof_opcode_cycles[i]=0; }
 }
 
+
 void prof_print_details()
 {
   int i;
-  byte dummymem[3] = {0, 0, 0};
+  byte dummymem[4];
   unsigned long total;
-  byte maxIdx;
+  int maxIdx;
   float totalpct = 0.0;
 
   total = 0;
-  for(i=0; i<256; i++) total += prof_opcode_count[i];
+  for(i=0; i<PROF_NUM_GROUPS*256; i++) total += prof_opcode_cycles[i];
 
-  int num = 0;
+  // list instructions by time spent until 99% of all cycles are covered
   while( totalpct<.99 )
     {
       maxIdx = 0;
-      for(i=1; i<256; i++)
-        if( prof_opcode_count[i] > prof_opcode_count[maxIdx] )
+      for(i=1; i<PROF_NUM_GROUPS*256; i++)
+        if( prof_opcode_cycles[i] > prof_opcode_cycles[maxIdx] )
           maxIdx = i;
 
-      if( prof_opcode_count[maxIdx]==0 )
+      if( prof_opcode_cycles[maxIdx]==0 )
         break;
       else
         {
-          float pct = ((float) (prof_opcode_count[maxIdx])) / ((float) total);
+          float pct = ((float) (prof_opcode_cycles[maxIdx])) / ((float) total);
           totalpct += pct;
-          dummymem[0] = maxIdx;
+
+          // reconstruct the instruction bytes for the disassembler
+          byte op = maxIdx & 255;
+          dummymem[1] = dummymem[2] = dummymem[3] = 0;
+          switch( maxIdx / 256 )
+            {
+            case PROF_GRP_NONE: dummymem[0] = op; break;
+            case PROF_GRP_CB:   dummymem[0] = 0xCB; dummymem[1] = op; break;
+            case PROF_GRP_DD:   dummymem[0] = 0xDD; dummymem[1] = op; break;
+            case PROF_GRP_ED:   dummymem[0] = 0xED; dummymem[1] = op; break;
+            case PROF_GRP_FD:   dummymem[0] = 0xFD; dummymem[1] = op; break;
+            case PROF_GRP_DDCB: dummymem[0] = 0xDD; dummymem[1] = 0xCB; dummymem[3] = op; break;
+            case PROF_GRP_FDCB: dummymem[0] = 0xFD; dummymem[1] = 0xCB; dummymem[3] = op; break;
+            }
+
           Serial.print(prof_opcode_count[maxIdx]);
-          Serial.print(F(" = "));
+          Serial.print(F(" x "));
+          Serial.print(prof_opcode_cycles[maxIdx]);
+          Serial.print(F(" cycles = "));
           Serial.print(pct * 100.0);
           Serial.print(F("% = "));
           Serial.print(totalpct * 100.0);
           Serial.print(F("% : "));
-          disassemble(dummymem, 0);
+          disassemble(dummymem, 0, false);
           Serial.print('\n');
-          prof_opcode_count[maxIdx] = 0;
+          prof_opcode_cycles[maxIdx] = 0;
+        }
+    }
+}
+
+#endif
+
+
+#if USE_PROFILING_PC>0
+MACHINE_STATE bool     prof_pc_active = false;
+MACHINE_STATE uint16_t prof_pc_prev = 0;
+MACHINE_STATE uint32_t prof_pc_prev_cycles = 0;
+MACHINE_STATE uint32_t prof_pc_count[0x10000], prof_pc_cycles[0x10000];
+
+#define PROF_PC_REPORT_MAX 64
+
+
+static void prof_print_padded(uint32_t v, byte width)
+{
+  byte digits = 1;
+  for(uint32_t x=v; x>=10; x/=10) digits++;
+  while( digits++<width ) Serial.print(' ');
+  Serial.print(v);
+}
+
+
+static void prof_print_pct(uint64_t v, uint64_t total)
+{
+  uint32_t pm = total>0 ? (uint32_t) ((1000*v)/total) : 0;
+  prof_print_padded(pm/10, 6);
+  Serial.print('.');
+  Serial.print(pm%10);
+  Serial.print('%');
+}
+
+
+static void prof_pc_reset()
+{
+  memset(prof_pc_count,  0, sizeof(prof_pc_count));
+  memset(prof_pc_cycles, 0, sizeof(prof_pc_cycles));
+  prof_pc_prev_cycles = timer_get_cycles();
+}
+
+
+void profile_pc_print(byte num)
+{
+  uint16_t top[PROF_PC_REPORT_MAX];
+  uint32_t n = 0, i, j;
+  uint64_t total_count = 0, total_cycles = 0, sum = 0;
+
+  if( num>PROF_PC_REPORT_MAX ) num = PROF_PC_REPORT_MAX;
+
+  // find the addresses with the most cycles (insertion into sorted list)
+  for(i=0; i<0x10000; i++)
+    if( prof_pc_count[i]>0 || prof_pc_cycles[i]>0 )
+      {
+        total_count  += prof_pc_count[i];
+        total_cycles += prof_pc_cycles[i];
+        if( n<num || prof_pc_cycles[i]>prof_pc_cycles[top[n-1]] )
+          {
+            if( n<num ) n++;
+            for(j=n-1; j>0 && prof_pc_cycles[i]>prof_pc_cycles[top[j-1]]; j--) top[j] = top[j-1];
+            top[j] = i;
+          }
+      }
+
+  Serial.print(F("\r\n"));
+  Serial.print((uint32_t) total_count);
+  Serial.print(F(" instructions, "));
+  Serial.print((uint32_t) total_cycles);
+  Serial.println(F(" cycles\r\n"));
+  Serial.println(F("Address  Instructions      Cycles   Cycle%   Total%  Instruction"));
+  for(i=0; i<n; i++)
+    {
+      uint16_t a = top[i];
+      sum += prof_pc_cycles[a];
+      numsys_print_word(a);
+      Serial.print(F("  "));
+      prof_print_padded(prof_pc_count[a], 13);
+      prof_print_padded(prof_pc_cycles[a], 12);
+      prof_print_pct(prof_pc_cycles[a], total_cycles);
+      prof_print_pct(sum, total_cycles);
+      Serial.print(F("  "));
+      disassemble(Mem, a, true);
+      Serial.println();
+    }
+}
+
+
+bool profile_pc_write(const char *filename)
+{
+#ifdef HOST_HAS_FILESYS
+  // raw histogram: 65536 instruction counters followed by
+  // 65536 cycle counters (32-bit each, host byte order)
+  host_filesys_file_remove(filename);
+  HOST_FILESYS_FILE_TYPE f = host_filesys_file_open(filename, true);
+  if( !f ) return false;
+
+  bool ok = 
+    host_filesys_file_write(f, sizeof(prof_pc_count),  prof_pc_count) ==sizeof(prof_pc_count) &&
+    host_filesys_file_write(f, sizeof(prof_pc_cycles), prof_pc_cycles)==sizeof(prof_pc_cycles);
+  host_filesys_file_close(f);
+  return ok;
+#else
+  return false;
+#endif
+}
+#endif
+
+
+#if USE_PROFILING_CALLS>0
+
+// instruction classes relevant for the shadow call stack
+#define PROF_CLS_NONE    0
+#define PROF_CLS_CALL    1  // CALL, conditional CALL, RST
+#define PROF_CLS_RET     2  // RET, conditional RET, RETI, RETN
+#define PROF_CLS_SPLOAD  3  // LXI SP, SPHL, LD SP,IX/IY, LD SP,(nn)
+#define PROF_CLS_XTHL    4  // XTHL, EX (SP),IX/IY
+
+#define PROF_CALLS_MAX_DEPTH  256
+#define PROF_CALLS_MAX_NODES  8192
+#define PROF_CALLS_HASH_SIZE  4096
+#define PROF_CALLS_SYM_LEN    16
+
+#define PROF_NODE_ROOT      0
+#define PROF_NODE_OVERFLOW  1
+#define PROF_NODE_NONE      0xFFFF
+
+struct ProfCallNode
+{
+  uint16_t parent, func, next;
+  bool     interrupt;
+  uint64_t cycles;
+};
+
+struct ProfCallFrame
+{
+  uint16_t func, sp, ret, node, segment;
+  bool     interrupt;
+};
+
+MACHINE_STATE bool prof_calls_active = false, prof_calls_interrupt = false;
+static MACHINE_STATE struct ProfCallNode  prof_calls_nodes[PROF_CALLS_MAX_NODES];
+static MACHINE_STATE struct ProfCallFrame prof_calls_stack[PROF_CALLS_MAX_DEPTH];
+static MACHINE_STATE uint16_t prof_calls_hash[PROF_CALLS_HASH_SIZE];
+static MACHINE_STATE uint16_t prof_calls_num_nodes = 0, prof_calls_depth = 0;
+static MACHINE_STATE uint16_t prof_calls_prev_sp = 0, prof_calls_segment = 0;
+static MACHINE_STATE uint32_t prof_calls_prev_cycles = 0;
+static MACHINE_STATE byte     prof_calls_prev_class = PROF_CLS_NONE;
+
+
+static uint16_t prof_calls_read_word(uint16_t addr)
+{
+  return MREAD_MEM(addr) | (MREAD_MEM((uint16_t) (addr+1)) << 8);
+}
+
+
+static byte prof_calls_classify(byte opcode)
+{
+  if( opcode==0xCD || (opcode & 0xC7)==0xC4 || (opcode & 0xC7)==0xC7 )
+    return PROF_CLS_CALL;
+  else if( opcode==0xC9 || (opcode & 0xC7)==0xC0 )
+    return PROF_CLS_RET;
+  else if( opcode==0x31 || opcode==0xF9 )
+    return PROF_CLS_SPLOAD;
+  else if( opcode==0xE3 )
+    return PROF_CLS_XTHL;
+
+#if USE_Z80>0
+  if( cpu_get_processor()==PROC_Z80 )
+    {
+      // regPC points to the byte following the opcode
+      byte op2 = MREAD_MEM(regPC);
+      if( opcode==0xDD || opcode==0xFD )
+        return (op2==0xCB || op2==0xDD || op2==0xED || op2==0xFD) ? PROF_CLS_NONE : prof_calls_classify(op2);
+      else if( opcode==0xED )
+        return (op2 & 0xC7)==0x45 ? PROF_CLS_RET : (op2==0x7B ? PROF_CLS_SPLOAD : PROF_CLS_NONE);
+      else
+        return PROF_CLS_NONE;
+    }
+#endif
+
+  // undocumented 8080 opcodes: 0xD9 is RET, 0xDD/0xED/0xFD are CALL
+  if( opcode==0xD9 )
+    return PROF_CLS_RET;
+  else if( opcode==0xDD || opcode==0xED || opcode==0xFD )
+    return PROF_CLS_CALL;
+
+  return PROF_CLS_NONE;
+}
+
+
+static uint16_t prof_calls_get_node(uint16_t parent, uint16_t func, bool interrupt)
+{
+  uint16_t h = (parent * 31 + func * 7 + (interrupt ? 1 : 0)) % PROF_CALLS_HASH_SIZE;
+  uint16_t n;
+
+  for(n=prof_calls_hash[h]; n!=PROF_NODE_NONE; n=prof_calls_nodes[n].next)
+    if( prof_calls_nodes[n].parent==parent && prof_calls_nodes[n].func==func && prof_calls_nodes[n].interrupt==interrupt )
+      return n;
+
+  // too many different call paths => attribute to overflow node
+  if( prof_calls_num_nodes>=PROF_CALLS_MAX_NODES )
+    return PROF_NODE_OVERFLOW;
+
+  n = prof_calls_num_nodes++;
+  prof_calls_nodes[n].parent    = parent;
+  prof_calls_nodes[n].func      = func;
+  prof_calls_nodes[n].interrupt = interrupt;
+  prof_calls_nodes[n].cycles    = 0;
+  prof_calls_nodes[n].next      = prof_calls_hash[h];
+  prof_calls_hash[h] = n;
+  return n;
+}
+
+
+static void prof_calls_reset()
+{
+  uint16_t i;
+
+  for(i=0; i<PROF_CALLS_HASH_SIZE; i++) prof_calls_hash[i] = PROF_NODE_NONE;
+  prof_calls_nodes[PROF_NODE_ROOT].parent = PROF_NODE_NONE;
+  prof_calls_nodes[PROF_NODE_ROOT].cycles = 0;
+  prof_calls_nodes[PROF_NODE_OVERFLOW].parent = PROF_NODE_ROOT;
+  prof_calls_nodes[PROF_NODE_OVERFLOW].cycles = 0;
+  prof_calls_num_nodes = 2;
+
+  // re-create the call path nodes for the frames currently on the shadow stack
+  for(i=0; i<prof_calls_depth; i++)
+    prof_calls_stack[i].node = prof_calls_get_node(i==0 ? PROF_NODE_ROOT : prof_calls_stack[i-1].node,
+                                                   prof_calls_stack[i].func, prof_calls_stack[i].interrupt);
+
+  prof_calls_prev_cycles = timer_get_cycles();
+}
+
+
+static void prof_calls_push(uint16_t func, bool interrupt)
+{
+  // frames pushed since the last stack pointer change at or below the
+  // new return address are stale (e.g. return address was popped by code)
+  while( prof_calls_depth>0 && 
+         prof_calls_stack[prof_calls_depth-1].segment==prof_calls_segment &&
+         prof_calls_stack[prof_calls_depth-1].sp<=regSP )
+    prof_calls_depth--;
+
+  if( prof_calls_depth<PROF_CALLS_MAX_DEPTH )
+    {
+      struct ProfCallFrame *f = &prof_calls_stack[prof_calls_depth];
+      f->func      = func;
+      f->sp        = regSP;
+      f->ret       = prof_calls_read_word(regSP);
+      f->segment   = prof_calls_segment;
+      f->interrupt = interrupt;
+      f->node      = prof_calls_get_node(prof_calls_depth==0 ? PROF_NODE_ROOT : prof_calls_stack[prof_calls_depth-1].node, 
+                                         func, interrupt);
+      prof_calls_depth++;
+    }
+}
+
+
+static void prof_calls_pop(uint16_t sp)
+{
+  // find the frame whose return address was just popped (frames above
+  // it were abandoned), ignore returns that do not match any frame
+  for(int i=prof_calls_depth-1; i>=0; i--)
+    if( prof_calls_stack[i].sp==sp )
+      {
+        prof_calls_depth = i;
+        break;
+      }
+}
+
+
+static void prof_calls_resync()
+{
+  // the stack pointer was loaded => start a new stack segment and drop
+  // frames whose return address is no longer on the stack
+  prof_calls_segment++;
+  while( prof_calls_depth>0 && 
+         prof_calls_read_word(prof_calls_stack[prof_calls_depth-1].sp)!=prof_calls_stack[prof_calls_depth-1].ret )
+    prof_calls_depth--;
+}
+
+
+void prof_count_calls(byte opcode)
+{
+  uint32_t c = timer_get_cycles();
+
+  // address of the instruction about to be executed (regPC was already
+  // advanced past the opcode unless it was supplied by an interrupt)
+  uint16_t pc = prof_calls_interrupt ? regPC : regPC-1;
+
+  // attribute the cycles of the previous instruction to its call path
+  prof_calls_nodes[prof_calls_depth==0 ? PROF_NODE_ROOT : prof_calls_stack[prof_calls_depth-1].node].cycles += c - prof_calls_prev_cycles;
+  prof_calls_prev_cycles = c;
+
+  // update the shadow stack according to the effect of the previous instruction
+  switch( prof_calls_prev_class )
+    {
+    case PROF_CLS_CALL:
+      if( regSP==(uint16_t) (prof_calls_prev_sp-2) ) prof_calls_push(pc, false);
+      break;
+
+    case PROF_CLS_CALL | 0x80:
+      if( regSP==(uint16_t) (prof_calls_prev_sp-2) ) prof_calls_push(pc, true);
+      break;
+
+    case PROF_CLS_RET:
+      if( regSP==(uint16_t) (prof_calls_prev_sp+2) ) prof_calls_pop(prof_calls_prev_sp);
+      break;
+
+    case PROF_CLS_SPLOAD:
+      if( regSP!=prof_calls_prev_sp ) prof_calls_resync();
+      break;
+
+    case PROF_CLS_XTHL:
+      {
+        // return address on top of stack was replaced
+        for(int i=prof_calls_depth-1; i>=0 && prof_calls_stack[i].sp<=regSP; i--)
+          if( prof_calls_stack[i].sp==regSP )
+            prof_calls_stack[i].ret = prof_calls_read_word(regSP);
+        break;
+      }
+    }
+
+  // classify the instruction about to be executed
+  if( prof_calls_interrupt )
+    {
+      // instruction (RST) supplied by interrupting device
+      prof_calls_prev_class = PROF_CLS_CALL | 0x80;
+      prof_calls_interrupt  = false;
+    }
+  else
+    prof_calls_prev_class = prof_calls_classify(opcode);
+
+  prof_calls_prev_sp = regSP;
+}
+
+
+
+
+bool profile_calls_write(const char *filename)
+{
+#ifdef HOST_HAS_FILESYS
+  // write call paths in "folded stacks" format (one line per call path:
+  // "func1;func2;func3 cycles"), as used by flame graph tools
+  host_filesys_file_remove(filename);
+  HOST_FILESYS_FILE_TYPE f = host_filesys_file_open(filename, true);
+  if( !f ) return false;
+
+  static MACHINE_STATE uint16_t path[PROF_CALLS_MAX_DEPTH+1];
+  char line[PROF_CALLS_SYM_LEN+30], name[PROF_CALLS_SYM_LEN+10];
+  bool ok = true;
+  for(uint16_t n=0; n<prof_calls_num_nodes && ok; n++)
+    if( prof_calls_nodes[n].cycles>0 )
+      {
+        int depth = 0, len;
+        for(uint16_t p=n; p!=PROF_NODE_ROOT && depth<=PROF_CALLS_MAX_DEPTH; p=prof_calls_nodes[p].parent)
+          path[depth++] = p;
+
+        // cycles spent outside of any (known) subroutine go to "[top]"
+        if( depth==0 ) 
+          ok = host_filesys_file_write(f, 5, "[top]")==5;
+
+        while( depth>0 && ok )
+          {
+            uint16_t p = path[--depth];
+            if( p==PROF_NODE_OVERFLOW )
+              strcpy(name, "[overflow]");
+            else
+              disassembler_get_name(prof_calls_nodes[p].func, name);
+            len = snprintf(line, sizeof(line), "%s%s", prof_calls_nodes[p].interrupt ? "[int]" : "", name);
+            if( depth>0 ) line[len++] = ';';
+            ok = host_filesys_file_write(f, len, line)==(uint32_t) len;
+          }
+
+        if( ok )
+          {
+            len = snprintf(line, sizeof(line), " %llu\n", (unsigned long long) prof_calls_nodes[n].cycles);
+            ok = host_filesys_file_write(f, len, line)==(uint32_t) len;
+          }
+      }
+
+  host_filesys_file_close(f);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+#endif
+
+
+#if USE_PROFILING_INTERRUPTS>0
+
+// device interrupt sources are bits 0-10 of the interrupt mask (except INT_VECTOR)
+#define PROF_INT_SOURCES  11
+#define PROF_INT_BUCKETS  24
+
+MACHINE_STATE bool prof_int_active = false;
+static MACHINE_STATE uint32_t prof_int_pending = 0;
+static MACHINE_STATE uint32_t prof_int_stamp[PROF_INT_SOURCES];
+static MACHINE_STATE uint32_t prof_int_raised[PROF_INT_SOURCES], prof_int_acked[PROF_INT_SOURCES];
+static MACHINE_STATE uint32_t prof_int_lost[PROF_INT_SOURCES], prof_int_coalesced[PROF_INT_SOURCES];
+static MACHINE_STATE uint32_t prof_int_max[PROF_INT_SOURCES];
+static MACHINE_STATE uint64_t prof_int_total[PROF_INT_SOURCES];
+static MACHINE_STATE uint32_t prof_int_hist[PROF_INT_SOURCES][PROF_INT_BUCKETS];
+
+
+void prof_int_raise(uint32_t i, uint32_t asserted)
+{
+  for(byte src=0; src<PROF_INT_SOURCES; src++)
+    if( i & (1ul<<src) )
+      {
+        prof_int_raised[src]++;
+        if( prof_int_pending & asserted & (1ul<<src) )
+          {
+            // line is already asserted and not yet acknowledged
+            prof_int_coalesced[src]++;
+          }
+        else
+          {
+            prof_int_stamp[src] = timer_get_cycles();
+            prof_int_pending |= (1ul<<src);
+          }
+      }
+}
+
+
+void prof_int_clear(uint32_t i, uint32_t asserted)
+{
+  // device cleared its interrupt line before the CPU acknowledged it
+  for(byte src=0; src<PROF_INT_SOURCES; src++)
+    if( i & prof_int_pending & asserted & (1ul<<src) )
+      prof_int_lost[src]++;
+
+  prof_int_pending &= ~i;
+}
+
+
+void prof_int_ack(uint32_t i)
+{
+  uint32_t now = timer_get_cycles();
+
+  for(byte src=0; src<PROF_INT_SOURCES; src++)
+    if( i & prof_int_pending & (1ul<<src) )
+      {
+        uint32_t latency = now - prof_int_stamp[src];
+        byte bucket = 0;
+        while( bucket<PROF_INT_BUCKETS-1 && (latency>>(bucket+1))>0 ) bucket++;
+        prof_int_hist[src][bucket]++;
+        prof_int_acked[src]++;
+        prof_int_total[src] += latency;
+        if( latency>prof_int_max[src] ) prof_int_max[src] = latency;
+      }
+
+  prof_int_pending &= ~i;
+}
+
+
+static void prof_int_reset()
+{
+  // (pending interrupts stay pending)
+  for(byte src=0; src<PROF_INT_SOURCES; src++)
+    {
+      prof_int_raised[src] = prof_int_acked[src] = 0;
+      prof_int_lost[src]   = prof_int_coalesced[src] = 0;
+      prof_int_max[src]    = 0;
+      prof_int_total[src]  = 0;
+      for(byte b=0; b<PROF_INT_BUCKETS; b++) prof_int_hist[src][b] = 0;
+    }
+}
+
+
+void profile_interrupts_print()
+{
+  static const char * const names[PROF_INT_SOURCES] = 
+    {"SIO", "ACR", "2SIO1", "2SIO2", "DRIVE", "RTC", "LPC", NULL, "HDSK", "2SIO3", "2SIO4"};
+
+  Serial.println(F("\r\nInterrupt latency in cycles (from assertion until acknowledge):"));
+  for(byte src=0; src<PROF_INT_SOURCES; src++)
+    if( names[src]!=NULL && prof_int_raised[src]>0 )
+      {
+        Serial.print(F("\r\n"));
+        Serial.print(names[src]);
+        Serial.print(F(": raised "));
+        Serial.print(prof_int_raised[src]);
+        Serial.print(F(", acknowledged "));
+        Serial.print(prof_int_acked[src]);
+        Serial.print(F(", lost "));
+        Serial.print(prof_int_lost[src]);
+        Serial.print(F(", coalesced "));
+        Serial.print(prof_int_coalesced[src]);
+        if( prof_int_acked[src]>0 )
+          {
+            Serial.print(F(", average "));
+            Serial.print((uint32_t) (prof_int_total[src] / prof_int_acked[src]));
+            Serial.print(F(", max "));
+            Serial.print(prof_int_max[src]);
+          }
+        Serial.println();
+
+        // histogram: number of interrupts with latency below 2, 4, 8, ... cycles
+        for(byte b=0; b<PROF_INT_BUCKETS; b++)
+          if( prof_int_hist[src][b]>0 )
+            {
+              Serial.print(b<PROF_INT_BUCKETS-1 ? F("  <") : F("  >="));
+              Serial.print(1ul << (b<PROF_INT_BUCKETS-1 ? b+1 : b));
+              Serial.print(F(": "));
+              Serial.println(prof_int_hist[src][b]);
+            }
+      }
+}
+
+#endif
+
+
+#if USE_PROFILING_COVERAGE>0
+
+MACHINE_STATE byte prof_cov_exec[0x2000], prof_cov_read[0x2000], prof_cov_write[0x2000];
+
+
+static void prof_cov_reset()
+{
+  memset(prof_cov_exec,  0, sizeof(prof_cov_exec));
+  memset(prof_cov_read,  0, sizeof(prof_cov_read));
+  memset(prof_cov_write, 0, sizeof(prof_cov_write));
+}
+
+
+static void prof_cov_print_map(const byte *map, uint32_t gap)
+{
+  // number of addresses with the bit set and number of ranges of such
+  // addresses that are at most "gap" bytes apart
+  uint32_t n = 0, ranges = 0, prev = 0;
+  for(uint32_t a=0; a<0x10000; a++)
+    if( map[a>>3] & (1<<(a&7)) )
+      {
+        if( n==0 || a-prev>gap ) ranges++;
+        prev = a;
+        n++;
+      }
+
+  Serial.print(n);
+  Serial.print(F(" addresses in "));
+  Serial.print(ranges);
+  Serial.println(F(" ranges"));
+}
+
+
+void profile_coverage_print()
+{
+  // only the first byte of each instruction is marked as executed
+  Serial.print(F("\r\nExecuted: ")); prof_cov_print_map(prof_cov_exec, 4);
+  Serial.print(F("Read:     "));     prof_cov_print_map(prof_cov_read, 1);
+  Serial.print(F("Written:  "));     prof_cov_print_map(prof_cov_write, 1);
+}
+
+
+bool profile_coverage_write(const char *filename)
+{
+#ifdef HOST_HAS_FILESYS
+  host_filesys_file_remove(filename);
+  HOST_FILESYS_FILE_TYPE f = host_filesys_file_open(filename, true);
+  if( !f ) return false;
+
+  bool ok = 
+    host_filesys_file_write(f, sizeof(prof_cov_exec),  prof_cov_exec) ==sizeof(prof_cov_exec) &&
+    host_filesys_file_write(f, sizeof(prof_cov_read),  prof_cov_read) ==sizeof(prof_cov_read) &&
+    host_filesys_file_write(f, sizeof(prof_cov_write), prof_cov_write)==sizeof(prof_cov_write);
+  host_filesys_file_close(f);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+#endif
+
+
+#if USE_PROFILING_TRACE>0
+
+#if USE_Z80!=0
+extern MACHINE_STATE union unionIXY
+{
+  struct { byte L, H; };
+  uint16_t HL;
+} regIX, regIY;
+#endif
+
+MACHINE_STATE bool prof_trace_active = false, prof_trace_interrupt = false;
+static MACHINE_STATE bool prof_trace_forced = false;
+MACHINE_STATE struct ProfileTraceRecord *prof_trace_cur = NULL;
+static MACHINE_STATE struct ProfileTraceRecord *prof_trace_buf = NULL;
+static MACHINE_STATE uint32_t prof_trace_num = 0;
+
+
+void prof_trace_record(byte opcode)
+{
+  struct ProfileTraceRecord *r = prof_trace_buf + (prof_trace_num & (PROF_TRACE_RECORDS-1));
+
+  // regPC has already been incremented, except for instructions supplied by an interrupt
+  uint16_t pc = prof_trace_interrupt ? regPC : regPC-1;
+  r->cycles    = timer_get_cycles();
+  r->pc        = pc;
+  r->af        = regAF.AF;
+  r->bc        = regBC.BC;
+  r->de        = regDE.DE;
+  r->hl        = regHL.HL;
+  r->sp        = regSP;
+#if USE_Z80!=0
+  r->ix        = regIX.HL;
+  r->iy        = regIY.HL;
+#else
+  r->ix        = 0;
+  r->iy        = 0;
+#endif
+  r->op[0]     = opcode;
+  r->op[1]     = Mem[(uint16_t) (pc+1)];
+  r->op[2]     = Mem[(uint16_t) (pc+2)];
+  r->op[3]     = Mem[(uint16_t) (pc+3)];
+  r->mem_count = 0;
+  r->flags     = prof_trace_interrupt ? PROF_TRACE_INT : 0;
+
+  prof_trace_interrupt = false;
+  prof_trace_cur = r;
+  prof_trace_num++;
+}
+
+
+static bool prof_trace_set_active(bool b)
+{
+  if( b && prof_trace_buf==NULL )
+    {
+      prof_trace_buf = (struct ProfileTraceRecord *) malloc(PROF_TRACE_RECORDS * sizeof(struct ProfileTraceRecord));
+      if( prof_trace_buf==NULL ) return false;
+      prof_trace_num = 0;
+    }
+
+  if( b && !prof_trace_active )
+    {
+      // memory writes and I/O before the first traced instruction go here
+      prof_trace_cur = prof_trace_buf + (prof_trace_num & (PROF_TRACE_RECORDS-1));
+      prof_trace_interrupt = false;
+    }
+
+  prof_trace_active = b;
+  return true;
+}
+
+
+bool profile_trace_enable(bool b)
+{
+  // enabled from the command line => stays enabled independent of the profiling setting
+  prof_trace_forced = b;
+  return prof_trace_set_active(b);
+}
+
+
+static void prof_trace_reset()
+{
+  prof_trace_num = 0;
+  if( prof_trace_buf ) prof_trace_cur = prof_trace_buf;
+}
+
+
+bool profile_trace_write(const char *filename)
+{
+#ifdef HOST_HAS_FILESYS
+  host_filesys_file_remove(filename);
+  HOST_FILESYS_FILE_TYPE f = host_filesys_file_open(filename, true);
+  if( !f ) return false;
+
+  bool ok = profile_trace_save(f);
+  host_filesys_file_close(f);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+
+#ifdef HOST_HAS_FILESYS
+bool profile_trace_save(HOST_FILESYS_FILE_TYPE f)
+{
+  struct ProfileTraceHeader h;
+  memcpy(h.magic, "ATRC", 4);
+  h.record_size = sizeof(struct ProfileTraceRecord);
+  h.processor   = cpu_get_processor();
+  h.reserved    = 0;
+  h.num_records = prof_trace_num < PROF_TRACE_RECORDS ? prof_trace_num : PROF_TRACE_RECORDS;
+  if( host_filesys_file_write(f, sizeof(h), &h)!=sizeof(h) ) return false;
+  if( prof_trace_buf==NULL ) return true;
+
+  // oldest records are at the current position (if the buffer has wrapped)
+  uint32_t pos = prof_trace_num & (PROF_TRACE_RECORDS-1);
+  uint32_t n1  = prof_trace_num < PROF_TRACE_RECORDS ? 0 : (PROF_TRACE_RECORDS-pos) * sizeof(struct ProfileTraceRecord);
+  uint32_t n2  = pos * sizeof(struct ProfileTraceRecord);
+  return host_filesys_file_write(f, n1, prof_trace_buf+pos)==n1 && host_filesys_file_write(f, n2, prof_trace_buf)==n2;
+}
+
+
+static void prof_trace_print_hex(uint16_t v, byte digits)
+{
+  while( digits-->0 ) Serial.print("0123456789ABCDEF"[(v >> (digits*4)) & 15]);
+}
+
+
+bool profile_trace_print(HOST_FILESYS_FILE_TYPE f)
+{
+  struct ProfileTraceHeader h;
+  struct ProfileTraceRecord r, next;
+  if( host_filesys_file_read(f, sizeof(h), &h)!=sizeof(h) || memcmp(h.magic, "ATRC", 4)!=0 || 
+      h.record_size!=sizeof(struct ProfileTraceRecord) )
+    return false;
+
+#if USE_Z80==2
+  cpu_set_processor(h.processor);
+#else
+  if( h.processor!=cpu_get_processor() )
+    Serial.println(F("Warning: trace was recorded with a different CPU, disassembly will be wrong"));
+#endif
+
+  // disassemble each record's opcode bytes at its original address
+  // (so relative jumps show the correct target)
+  static byte dummymem[0x10000];
+  uint32_t start = 0;
+  bool have_next = host_filesys_file_read(f, sizeof(next), &next)==sizeof(next);
+  if( have_next ) start = next.cycles;
+  while( have_next )
+    {
+      r = next;
+      have_next = host_filesys_file_read(f, sizeof(next), &next)==sizeof(next);
+
+      // cycle stamp relative to the first record and cycles taken by this instruction
+      Serial.print(r.cycles-start);
+      Serial.print(F(" +"));
+      if( have_next ) Serial.print(next.cycles-r.cycles); else Serial.print('?');
+      Serial.print(r.flags & PROF_TRACE_INT ? F(" INT ") : F(" "));
+      prof_trace_print_hex(r.pc, 4);
+      Serial.print(':');
+
+      for(byte i=0; i<4; i++) dummymem[(uint16_t) (r.pc+i)] = r.op[i];
+      disassemble(dummymem, r.pc, true);
+
+      Serial.print(F("  A=")); prof_trace_print_hex(r.af & 0xFF, 2);
+      Serial.print(F(" F="));  prof_trace_print_hex(r.af >> 8, 2);
+      Serial.print(F(" BC=")); prof_trace_print_hex(r.bc, 4);
+      Serial.print(F(" DE=")); prof_trace_print_hex(r.de, 4);
+      Serial.print(F(" HL=")); prof_trace_print_hex(r.hl, 4);
+      Serial.print(F(" SP=")); prof_trace_print_hex(r.sp, 4);
+      if( h.processor==PROC_Z80 )
+        {
+          Serial.print(F(" IX=")); prof_trace_print_hex(r.ix, 4);
+          Serial.print(F(" IY=")); prof_trace_print_hex(r.iy, 4);
         }
+
+      if( r.mem_count>0 )
+        {
+          Serial.print(F("  W "));
+          prof_trace_print_hex(r.mem_addr, 4);
+          Serial.print('=');
+          prof_trace_print_hex(r.mem_data, 2);
+          if( r.mem_count>1 ) { Serial.print(F(" (")); Serial.print(r.mem_count); Serial.print(F(" writes)")); }
+        }
+      if( r.flags & (PROF_TRACE_IN|PROF_TRACE_OUT) )
+        {
+          Serial.print(r.flags & PROF_TRACE_IN ? F("  IN ") : F("  OUT "));
+          prof_trace_print_hex(r.io_port, 2);
+          Serial.print('=');
+          prof_trace_print_hex(r.io_data, 2);
+        }
+      Serial.println();
+    }
+
+  return true;
+}
+#endif
+
+#endif
+
+
+#if USE_PROFILING_HOST>0
+MACHINE_STATE struct ProfileHostFrame prof_host_stack[PROF_HOST_DEPTH];
+MACHINE_STATE byte     prof_host_depth = 0;
+MACHINE_STATE uint64_t prof_host_total[PROF_HOST_NUM], prof_host_self[PROF_HOST_NUM], prof_host_calls[PROF_HOST_NUM];
+
+
+static void prof_host_reset()
+{
+  for(byte i=0; i<PROF_HOST_NUM; i++)
+    prof_host_total[i] = prof_host_self[i] = prof_host_calls[i] = 0;
+}
+
+
+static void prof_host_print_line(FILE *f, const char *line)
+{
+  if( f!=NULL )
+    fprintf(f, "%s\n", line);
+  else
+    Serial.println(line);
+}
+
+
+void profile_host_print(FILE *f)
+{
+  static const char *names[PROF_HOST_NUM] = {"loop/CPU core", "timers", "host interrupts", "I/O handlers", "serial output", "file access"};
+  double   tps = host_get_ticks_per_second();
+  uint64_t total = 0;
+  char     line[100];
+
+  // self times of all scopes add up to the time spent in the outermost scopes
+  for(byte i=0; i<PROF_HOST_NUM; i++) total += prof_host_self[i];
+
+  snprintf(line, sizeof(line), "Host time by subsystem, %.3f seconds total:", total/tps);
+  prof_host_print_line(f, line);
+  prof_host_print_line(f, "Subsystem                  Calls   Total [s]    Self [s]   Self%   ns/call");
+  for(byte i=0; i<PROF_HOST_NUM; i++)
+    {
+      snprintf(line, sizeof(line), "%-16s %15llu %11.3f %11.3f %6.1f%% %9.1f", names[i],
+               (unsigned long long) prof_host_calls[i], prof_host_total[i]/tps, prof_host_self[i]/tps,
+               total>0 ? (100.0*prof_host_self[i])/total : 0.0,
+               prof_host_calls[i]>0 ? (1e9*prof_host_total[i])/tps/prof_host_calls[i] : 0.0);
+      prof_host_print_line(f, line);
+    }
+}
+#endif
+
+
+#ifdef PROFILE_HAS_COUNTERS
+static MACHINE_STATE bool prof_debugger = false, prof_counters_active = false;
+
+static void prof_counters_set_active(bool b)
+{
+  // do not attribute cycles executed while inactive to the previous instruction
+#if USE_PROFILING_PC>0
+  if( b && !prof_pc_active ) prof_pc_prev_cycles = timer_get_cycles();
+  prof_pc_active = b;
+#endif
+#if USE_PROFILING_CALLS>0
+  if( b && !prof_calls_active ) 
+    {
+      prof_calls_prev_cycles = timer_get_cycles();
+      prof_calls_prev_class  = PROF_CLS_NONE;
+      if( prof_calls_num_nodes==0 ) prof_calls_reset();
     }
+  prof_calls_active = b;
+#endif
+#if USE_PROFILING_IO>0
+  io_profile_enable(b);
+#endif
+#if USE_PROFILING_INTERRUPTS>0
+  prof_int_active = b;
+#endif
+#if USE_PROFILING_TRACE>0
+  prof_trace_set_active(b || prof_trace_forced);
+#endif
+  prof_counters_active = b;
 }
 
+
+void profile_counters_enable(bool b)
+{
+  // enabled from the debugger => stays enabled independent of the
+  // profiling setting in the configuration
+  prof_debugger = b;
+  prof_counters_set_active(b || config_profiling_enabled());
+}
+
+
+bool profile_counters_enabled()
+{
+  return prof_counters_active;
+}
+
+
+void profile_counters_reset()
+{
+#if USE_PROFILING_PC>0
+  prof_pc_reset();
+#endif
+#if USE_PROFILING_CALLS>0
+  prof_calls_reset();
+#endif
+#if USE_PROFILING_IO>0
+  io_profile_reset();
+#endif
+#if USE_PROFILING_INTERRUPTS>0
+  prof_int_reset();
+#endif
+#if USE_PROFILING_COVERAGE>0
+  prof_cov_reset();
+#endif
+#if USE_PROFILING_TRACE>0
+  prof_trace_reset();
+#endif
+#if USE_PROFILING_HOST>0
+  prof_host_reset();
+#endif
+}
+
+
+#if USE_PROFILING_TRACE>0
+void profile_trace_breakpoint()
+{
+  // (a trace enabled by the "-w" batch mode option is written when the simulator stops)
+  if( prof_counters_active )
+    {
+      Serial.print(profile_trace_write("PROFILE.TRC") ? F("Trace written to ") : F("Unable to write "));
+      Serial.println(F("PROFILE.TRC"));
+    }
+}
+#endif
 #endif
 
 
-static uint32_t prof_time;
-static uint32_t prof_cycles;
-extern uint16_t throttle_delay;
+#ifdef HOST_HAS_BATCH_MODE
+MACHINE_STATE bool     prof_instruction_active = false;
+MACHINE_STATE uint64_t prof_instruction_count = 0;
+#endif
+
+static MACHINE_STATE uint32_t prof_time;
+static MACHINE_STATE uint32_t prof_cycles;
+#if USE_PROFILING_IO>0
+static MACHINE_STATE uint32_t prof_io_count, prof_io_usec;
+#endif
+extern MACHINE_STATE uint16_t throttle_delay;
 
 void prof_print()
 {
@@ -98,6 +1087,20 @@ void prof_print()
       Serial.print(F(" MHz = "));
       Serial.print(int(mhz/(float(cpu_clock_KHz())/100000.0)+.5));
       Serial.print('%');
+#if USE_PROFILING_IO>0
+      {
+        // I/O accesses and host time spent in device handlers during interval
+        uint32_t n, usec;
+        io_profile_get_totals(&n, &usec);
+        Serial.print(F(", I/O: "));
+        Serial.print((uint32_t) ((n-prof_io_count) * 1000000.0 / d));
+        Serial.print(F("/s ("));
+        Serial.print(((float) (usec-prof_io_usec)) * 100.0 / d);
+        Serial.print(F("%)"));
+        prof_io_count = n;
+        prof_io_usec  = usec;
+      }
+#endif
 #if USE_THROTTLE>0
       Serial.print(F(" (d="));
       Serial.print(throttle_delay);
@@ -126,6 +1129,9 @@ void profile_enable(bool b)
       prof_time   = micros();
       prof_cycles = timer_get_cycles();
       timer_start(TIMER_PROFILE, 0, true);
+#if USE_PROFILING_IO>0
+      io_profile_get_totals(&prof_io_count, &prof_io_usec);
+#endif
     }
   else
     timer_stop(TIMER_PROFILE);
@@ -133,6 +1139,10 @@ void profile_enable(bool b)
 #if USE_PROFILING_DETAIL>0
   prof_reset_details();
 #endif
+
+#ifdef PROFILE_HAS_COUNTERS
+  prof_counters_set_active(b || prof_debugger);
+#endif
 }
 
 
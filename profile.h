@@ -7,14 +7,290 @@
 #define PROFILE_H
 
 #include "config.h"
+#include "host.h"
+#include "timer.h"
 
 #if USE_PROFILING_DETAIL>0
-extern unsigned long prof_counter_detail, prof_opcode_count[256];
-#define PROFILE_COUNT_OPCODE(n) prof_opcode_count[n]++
+// counts the instruction starting with the given opcode (for the Z80 including
+// the opcode byte following a 0xCB/0xDD/0xED/0xFD prefix) and attributes the
+// cycles spent since the previous instruction started to the previous instruction
+void prof_count_opcode(byte opcode);
+#define PROFILE_COUNT_OPCODE(n) prof_count_opcode(n)
 #else
 #define PROFILE_COUNT_OPCODE(n) while(0)
 #endif
 
+#ifdef HOST_HAS_BATCH_MODE
+// number of executed instructions (reported in batch mode and by the host's
+// metrics endpoint), only counted while prof_instruction_active is set
+extern MACHINE_STATE bool     prof_instruction_active;
+extern MACHINE_STATE uint64_t prof_instruction_count;
+#define PROFILE_COUNT_INSTRUCTION() do { if( prof_instruction_active ) prof_instruction_count++; } while(0)
+#else
+#define PROFILE_COUNT_INSTRUCTION() while(0)
+#endif
+
+#ifdef HOST_HAS_METRICS
+// counters published via the host's metrics endpoint (see host_pc.cpp)
+#define PROF_DISK_DCDD     0
+#define PROF_DISK_CROMEMCO 1
+#define PROF_DISK_TARBELL  2
+#define PROF_DISK_HDSK     3
+struct ProfileMetrics
+{
+  uint64_t interrupts;
+#if USE_PROFILING_IO>0
+  uint64_t io_inp[256], io_out[256];
+#endif
+  uint64_t serial_in[HOST_NUM_SERIAL_PORTS], serial_out[HOST_NUM_SERIAL_PORTS];
+  uint32_t disk_read[4][16], disk_write[4][16];
+};
+extern MACHINE_STATE struct ProfileMetrics prof_metrics;
+#define PROFILE_COUNT_METRIC(x) prof_metrics.x++
+#define PROFILE_COUNT_DISK_READ(ctrl, drive)  prof_metrics.disk_read[ctrl][(drive) & 15]++
+#define PROFILE_COUNT_DISK_WRITE(ctrl, drive) prof_metrics.disk_write[ctrl][(drive) & 15]++
+#else
+#define PROFILE_COUNT_METRIC(x) while(0)
+#define PROFILE_COUNT_DISK_READ(ctrl, drive)  while(0)
+#define PROFILE_COUNT_DISK_WRITE(ctrl, drive) while(0)
+#endif
+
+#if defined(HOST_HAS_METRICS) && USE_PROFILING_IO>0
+// per-port I/O counters are in the I/O dispatch path, so they are
+// only published if USE_PROFILING_IO is enabled
+#define PROFILE_COUNT_IO_INP(port) prof_metrics.io_inp[port]++
+#define PROFILE_COUNT_IO_OUT(port) prof_metrics.io_out[port]++
+#else
+#define PROFILE_COUNT_IO_INP(port) while(0)
+#define PROFILE_COUNT_IO_OUT(port) while(0)
+#endif
+
+#if USE_PROFILING_PC>0
+// per-address instruction and cycle counters. The cycles spent since the
+// previous instruction started are attributed to the previous instruction.
+extern MACHINE_STATE bool     prof_pc_active;
+extern MACHINE_STATE uint16_t prof_pc_prev;
+extern MACHINE_STATE uint32_t prof_pc_prev_cycles;
+extern MACHINE_STATE uint32_t prof_pc_count[0x10000], prof_pc_cycles[0x10000];
+
+inline void prof_count_pc(uint16_t pc)
+{
+  uint32_t c = timer_get_cycles();
+  prof_pc_cycles[prof_pc_prev] += c - prof_pc_prev_cycles;
+  prof_pc_count[pc]++;
+  prof_pc_prev        = pc;
+  prof_pc_prev_cycles = c;
+}
+
+#define PROFILE_COUNT_PC(pc) do { if( prof_pc_active ) prof_count_pc(pc); } while(0)
+
+void profile_pc_print(byte num);
+bool profile_pc_write(const char *filename);
+#else
+#define PROFILE_COUNT_PC(pc) while(0)
+#endif
+
+#if USE_PROFILING_CALLS>0
+// shadow call stack, maintained from the effect of CALL/RST/RET instructions
+// and interrupts on the stack pointer. Cycles are attributed to call paths.
+extern MACHINE_STATE bool prof_calls_active, prof_calls_interrupt;
+void prof_count_calls(byte opcode);
+#define PROFILE_COUNT_CALLS(opcode) do { if( prof_calls_active ) prof_count_calls(opcode); } while(0)
+#define PROFILE_CALLS_INTERRUPT() prof_calls_interrupt = true
+
+bool profile_calls_write(const char *filename);
+#else
+#define PROFILE_COUNT_CALLS(opcode) while(0)
+#define PROFILE_CALLS_INTERRUPT() while(0)
+#endif
+
+#if USE_PROFILING_INTERRUPTS>0
+// interrupt latency (in cycles from assertion of a device interrupt
+// line until the CPU acknowledges the interrupt)
+extern MACHINE_STATE bool prof_int_active;
+void prof_int_raise(uint32_t i, uint32_t asserted);
+void prof_int_clear(uint32_t i, uint32_t asserted);
+void prof_int_ack(uint32_t i);
+#define PROFILE_INTERRUPT_RAISE(i, asserted) do { if( prof_int_active ) prof_int_raise(i, asserted); } while(0)
+#define PROFILE_INTERRUPT_CLEAR(i, asserted) do { if( prof_int_active ) prof_int_clear(i, asserted); } while(0)
+#define PROFILE_INTERRUPT_ACK(i)   do { if( prof_int_active ) prof_int_ack(i); } while(0)
+
+void profile_interrupts_print();
+#else
+#define PROFILE_INTERRUPT_RAISE(i, asserted) while(0)
+#define PROFILE_INTERRUPT_CLEAR(i, asserted) while(0)
+#define PROFILE_INTERRUPT_ACK(i)   while(0)
+#endif
+
+#if USE_PROFILING_COVERAGE>0
+// coverage bitmaps, bit (a&7) of byte (a>>3) is set if address a was executed
+// (first byte of an instruction), read or written. Written to a file as the
+// "executed" bitmap followed by the "read" and "write" bitmaps (8k each).
+extern MACHINE_STATE byte prof_cov_exec[0x2000], prof_cov_read[0x2000], prof_cov_write[0x2000];
+#define PROF_COV_SET(map, a)       map[((uint16_t) (a))>>3] |= 1<<((a)&7)
+#define PROFILE_COVER_EXEC(a)      PROF_COV_SET(prof_cov_exec, a)
+#define PROFILE_COVER_READ(a)      PROF_COV_SET(prof_cov_read, a)
+#define PROFILE_COVER_WRITE(a)     PROF_COV_SET(prof_cov_write, a)
+
+void profile_coverage_print();
+bool profile_coverage_write(const char *filename);
+#else
+#define PROFILE_COVER_EXEC(a)      while(0)
+#define PROFILE_COVER_READ(a)      while(0)
+#define PROFILE_COVER_WRITE(a)     while(0)
+#endif
+
+// instruction trace file (written by batch option "-w", read by "-y" and
+// the trcdump tool): header followed by the records (oldest first), one
+// record per executed instruction (registers as before executing it)
+#define PROF_TRACE_INT     0x01  // instruction was supplied by an interrupt
+#define PROF_TRACE_IN      0x02  // instruction read io_data from io_port
+#define PROF_TRACE_OUT     0x04  // instruction wrote io_data to io_port
+
+struct ProfileTraceHeader
+{
+  char     magic[4];     // "ATRC"
+  uint16_t record_size;
+  byte     processor;    // PROC_I8080 or PROC_Z80
+  byte     reserved;
+  uint32_t num_records;
+};
+
+struct ProfileTraceRecord
+{
+  uint32_t cycles;
+  uint16_t pc, af, bc, de, hl, sp, ix, iy;
+  byte     op[4];
+  uint16_t mem_addr;     // address of first memory write
+  byte     mem_data;     // data of first memory write
+  byte     mem_count;    // number of memory writes (saturates at 255)
+  byte     io_port, io_data, flags, reserved;
+};
+
+#if USE_PROFILING_TRACE>0
+// instruction trace ring buffer
+#define PROF_TRACE_RECORDS 0x100000
+
+extern MACHINE_STATE bool prof_trace_active, prof_trace_interrupt;
+extern MACHINE_STATE struct ProfileTraceRecord *prof_trace_cur;
+void prof_trace_record(byte opcode);
+
+inline void prof_trace_write(uint16_t a, byte v)
+{
+  struct ProfileTraceRecord *r = prof_trace_cur;
+  if( r->mem_count==0 ) { r->mem_addr = a; r->mem_data = v; }
+  if( r->mem_count<255 ) r->mem_count++;
+}
+
+inline void prof_trace_io(byte flag, byte port, byte data)
+{
+  prof_trace_cur->io_port = port;
+  prof_trace_cur->io_data = data;
+  prof_trace_cur->flags  |= flag;
+}
+
+#define PROFILE_TRACE(opcode)        do { if( prof_trace_active ) prof_trace_record(opcode); } while(0)
+#define PROFILE_TRACE_INTERRUPT()    prof_trace_interrupt = true
+#define PROFILE_TRACE_WRITE(a, v)    do { if( prof_trace_active ) prof_trace_write(a, v); } while(0)
+#define PROFILE_TRACE_IN(port, v)    do { if( prof_trace_active ) prof_trace_io(PROF_TRACE_IN, port, v); } while(0)
+#define PROFILE_TRACE_OUT(port, v)   do { if( prof_trace_active ) prof_trace_io(PROF_TRACE_OUT, port, v); } while(0)
+
+bool profile_trace_enable(bool b);
+void profile_trace_breakpoint();
+bool profile_trace_write(const char *filename);
+#ifdef HOST_HAS_FILESYS
+bool profile_trace_save(HOST_FILESYS_FILE_TYPE f);
+bool profile_trace_print(HOST_FILESYS_FILE_TYPE f);
+#endif
+#else
+#define PROFILE_TRACE(opcode)        while(0)
+#define PROFILE_TRACE_INTERRUPT()    while(0)
+#define PROFILE_TRACE_WRITE(a, v)    while(0)
+#define PROFILE_TRACE_IN(port, v)    while(0)
+#define PROFILE_TRACE_OUT(port, v)   while(0)
+#endif
+
+#if USE_PROFILING_HOST>0
+#ifndef HOST_HAS_TICKS
+#error USE_PROFILING_HOST requires a host with a time stamp counter (HOST_HAS_TICKS)
+#endif
+// host time spent in the simulator's subsystems. Scopes nest, the "self"
+// time of a scope excludes the time spent in scopes entered from within it.
+#define PROF_HOST_LOOP        0  // simulation loop (CPU core and everything below)
+#define PROF_HOST_TIMER       1  // timer_check()
+#define PROF_HOST_INTERRUPTS  2  // host_check_interrupts()
+#define PROF_HOST_IO          3  // I/O port handlers
+#define PROF_HOST_SERIAL      4  // serial output (console and sockets)
+#define PROF_HOST_FILE        5  // file access (disk images etc.)
+#define PROF_HOST_NUM         6
+#define PROF_HOST_DEPTH       8
+
+struct ProfileHostFrame
+{
+  byte     scope;
+  uint64_t start, child;
+};
+
+extern MACHINE_STATE struct ProfileHostFrame prof_host_stack[PROF_HOST_DEPTH];
+extern MACHINE_STATE byte     prof_host_depth;
+extern MACHINE_STATE uint64_t prof_host_total[PROF_HOST_NUM], prof_host_self[PROF_HOST_NUM], prof_host_calls[PROF_HOST_NUM];
+
+inline void prof_host_begin(byte scope)
+{
+  if( prof_host_depth<PROF_HOST_DEPTH )
+    {
+      struct ProfileHostFrame *f = prof_host_stack+prof_host_depth;
+      f->scope = scope;
+      f->child = 0;
+      f->start = host_get_ticks();
+    }
+  prof_host_depth++;
+}
+
+inline void prof_host_end()
+{
+  if( --prof_host_depth<PROF_HOST_DEPTH )
+    {
+      struct ProfileHostFrame *f = prof_host_stack+prof_host_depth;
+      uint64_t t = host_get_ticks()-f->start;
+      prof_host_total[f->scope] += t;
+      prof_host_self[f->scope]  += t-f->child;
+      prof_host_calls[f->scope]++;
+      if( prof_host_depth>0 ) f[-1].child += t;
+    }
+}
+
+// ends the scope when leaving the enclosing block
+class ProfileHostScope
+{
+ public:
+  ProfileHostScope(byte scope) { prof_host_begin(scope); }
+  ~ProfileHostScope() { prof_host_end(); }
+};
+
+#define PROFILE_HOST_BEGIN(scope)  prof_host_begin(scope)
+#define PROFILE_HOST_END()         prof_host_end()
+#define PROFILE_HOST_SCOPE(scope)  ProfileHostScope prof_host_scope(scope)
+
+// prints to the serial console if f is NULL
+void profile_host_print(FILE *f);
+#else
+#define PROFILE_HOST_BEGIN(scope)  while(0)
+#define PROFILE_HOST_END()         while(0)
+#define PROFILE_HOST_SCOPE(scope)  while(0)
+#endif
+
+#if USE_PROFILING_PC>0 || USE_PROFILING_CALLS>0 || USE_PROFILING_IO>0 || USE_PROFILING_INTERRUPTS>0 || USE_PROFILING_COVERAGE>0 || USE_PROFILING_TRACE>0 || USE_PROFILING_HOST>0
+#define PROFILE_HAS_COUNTERS
+#endif
+
+#ifdef PROFILE_HAS_COUNTERS
+// profiling counters (controlled by the 'O' serial debugger command)
+void profile_counters_enable(bool b);
+bool profile_counters_enabled();
+void profile_counters_reset();
+#endif
+
 void profile_setup();
 void profile_reset();
 void profile_enable(bool b);
@@ -39,9 +39,9 @@ byte read_asm_example(int n, int i) { return 0; }
 
 #endif
 
-static byte     prog_idx = 0;
-static uint16_t prog_ctr = 0;
-static byte     NULs     = 0;
+static MACHINE_STATE byte     prog_idx = 0;
+static MACHINE_STATE uint16_t prog_ctr = 0;
+static MACHINE_STATE byte     NULs     = 0;
 
 
 bool prog_examples_read_start(byte idx)
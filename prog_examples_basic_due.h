@@ -8552,8 +8552,8 @@ byte read_basic_example(int n, int i)
   if( n==0 )
     {
       // construct directory line-by-line
-      static int entry = 0, offset = 0;
-      static char line[50];
+      static MACHINE_STATE int entry = 0, offset = 0;
+      static MACHINE_STATE char line[50];
       if( i==0 || line[i-offset]==0 )
         {
           byte b;
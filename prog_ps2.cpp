@@ -841,7 +841,7 @@ uint16_t prog_ps2_copy_monitor()
 }
 
 
-static uint16_t ctr = 0;
+static MACHINE_STATE uint16_t ctr = 0;
 void prog_ps2_read_start()
 {
   ctr = 0;
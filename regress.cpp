@@ -0,0 +1,393 @@
+// -----------------------------------------------------------------------------
+// Altair 8800 Simulator
+// Copyright (C) 2017-2019 David Hansel
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+// -----------------------------------------------------------------------------
+
+// Regression test runner for the PC version of the simulator. Runs a list of
+// scenarios in parallel (one simulator process in batch mode per scenario)
+// and compares their console output against golden files.
+//
+// usage: regress [-j jobs] [-u] [-s simulator] [-d disks] manifest
+//   -j jobs       number of scenarios to run in parallel (default: number of cores)
+//   -u            update golden files with the current output instead of comparing
+//   -s simulator  simulator executable (default: ./Altair8800)
+//   -d disks      disk image directory (default: disks)
+//
+// Each non-empty line in the manifest that does not start with '#' is a scenario:
+//   name: simulator options
+// for example:
+//   cpudiag: -p "CPU Diagnostic" -s 0 -t 1000000
+//   basic4k: -p "4k Basic" -o "OK" -t 100000000
+// The options are passed to the simulator (in addition to "-b") via the shell.
+// If a file <name>.in exists in the manifest directory it is used as console
+// input. The console output is written to <name>.res in the manifest directory
+// and must match <name>.out. A scenario passes if the simulator stopped
+// with exit status 0 (see host_pc.cpp) and the output matches.
+//
+// The simulator keeps its configuration (AltairStorage.dat) and disk images
+// (disks/) relative to its working directory and may write to both, so each
+// scenario runs in its own scratch directory <name>.run in the manifest
+// directory, holding fresh copies of the disk images the scenario mounts
+// ("-d drive:image" and "-H platter:image" options). The scratch directory is removed when the
+// scenario passes and kept for inspection when it fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/time.h>
+#ifdef _WIN32
+#include <windows.h>
+#define popen  _popen
+#define pclose _pclose
+#define REMOVE_DIR_CMD "if exist \"%s\" rmdir /s /q \"%s\""
+#define MAKE_DIR_CMD   "mkdir \"%s\""
+#define COPY_FILE_CMD  "copy /y \"%s\" \"%s\" >NUL"
+#define CHANGE_DIR_CMD "cd /d \"%s\" && "
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#define REMOVE_DIR_CMD "rm -rf \"%s\"%.0s"
+#define MAKE_DIR_CMD   "mkdir \"%s\""
+#define COPY_FILE_CMD  "cp \"%s\" \"%s\""
+#define CHANGE_DIR_CMD "cd \"%s\" && "
+#endif
+
+using namespace std;
+
+
+struct Scenario
+{
+  string   name, options;
+  bool     pass;
+  int      status;
+  unsigned long long cycles;
+  double   seconds;
+  string   message;
+};
+
+
+static vector<Scenario> scenarios;
+static string   simulator = "./Altair8800", disksdir = "disks", basedir;
+static bool     update = false;
+static size_t   next_scenario = 0, num_passed = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static double get_time()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+
+static bool file_exists(const string &fname)
+{
+  FILE *f = fopen(fname.c_str(), "rb");
+  if( f ) fclose(f);
+  return f!=NULL;
+}
+
+
+static bool read_file(const string &fname, string &data)
+{
+  FILE *f = fopen(fname.c_str(), "rb");
+  if( f==NULL ) return false;
+
+  char buf[4096];
+  size_t n;
+  data.clear();
+  while( (n=fread(buf, 1, sizeof(buf), f))>0 ) data.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+
+static string get_full_path(const string &fname)
+{
+#ifdef _WIN32
+  char buf[MAX_PATH];
+  return _fullpath(buf, fname.c_str(), MAX_PATH) ? string(buf) : fname;
+#else
+  char buf[PATH_MAX];
+  return realpath(fname.c_str(), buf) ? string(buf) : fname;
+#endif
+}
+
+
+static bool shell(const char *fmt, const string &arg1, const string &arg2 = string())
+{
+  char cmd[3*PATH_MAX+100];
+  snprintf(cmd, sizeof(cmd), fmt, arg1.c_str(), arg2.c_str());
+  return system(cmd)==0;
+}
+
+
+static bool write_file(const string &fname, const string &data)
+{
+  FILE *f = fopen(fname.c_str(), "wb");
+  if( f==NULL ) return false;
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  return true;
+}
+
+
+static void get_mounted_images(const string &options, const char *name, const char *format, vector<string> &images)
+{
+  // file names of the images mounted with "<name> x:image" (see host_pc.cpp)
+  size_t p = 0;
+  while( (p=options.find(name, p))!=string::npos )
+    {
+      bool opt = (p==0 || options[p-1]==' ' || options[p-1]=='\t') && (options[p+2]==' ' || options[p+2]=='\t');
+      p = options.find_first_not_of(" \t\"", p+2);
+      if( p==string::npos ) break;
+      if( !opt ) continue;
+
+      char *c, fname[20];
+      strtol(options.c_str()+p, &c, 0);
+      if( *c!=':' ) continue;
+      snprintf(fname, sizeof(fname), format, (unsigned int) (strtol(c+1, NULL, 0) & 0xff));
+      images.push_back(fname);
+    }
+}
+
+
+static bool prepare_workdir(const string &workdir, const string &options)
+{
+  shell(REMOVE_DIR_CMD, workdir, workdir);
+  if( !shell(MAKE_DIR_CMD, workdir) || !shell(MAKE_DIR_CMD, workdir + "/disks") ) return false;
+
+  // only copy the images the scenario uses, not the whole directory
+  vector<string> images;
+  get_mounted_images(options, "-d", "DISK%02X.DSK", images);
+  get_mounted_images(options, "-H", "HDSK%02X.DSK", images);
+  for(size_t i=0; i<images.size(); i++)
+    {
+      string fname = disksdir + "/" + images[i];
+      if( file_exists(fname) && !shell(COPY_FILE_CMD, fname, workdir + "/disks/" + images[i]) )
+        return false;
+    }
+
+  return true;
+}
+
+
+static void run_scenario(Scenario &sc)
+{
+  // all paths are absolute since the simulator runs in the scratch directory
+  string prefix  = basedir + sc.name;
+  string workdir = prefix + ".run";
+  string cmd     = string("\"") + simulator + "\" -b " + sc.options;
+  if( file_exists(prefix + ".in") ) cmd += " -i \"" + prefix + ".in\"";
+  cmd += " 2>\"" + prefix + ".log\"";
+
+  char buf[PATH_MAX+20];
+  snprintf(buf, sizeof(buf), CHANGE_DIR_CMD, workdir.c_str());
+  cmd = buf + cmd;
+  if( !prepare_workdir(workdir, sc.options) )
+    {
+      sc.pass    = false;
+      sc.status  = -1;
+      sc.cycles  = 0;
+      sc.seconds = 0;
+      sc.message = "can not create scratch directory " + workdir;
+      return;
+    }
+
+  // run simulator and capture console output
+  string output;
+  double start = get_time();
+  FILE *f = popen(cmd.c_str(), "r");
+  if( f!=NULL )
+    {
+      char buf[4096];
+      size_t n;
+      while( (n=fread(buf, 1, sizeof(buf), f))>0 ) output.append(buf, n);
+      sc.status = pclose(f);
+#ifndef _WIN32
+      sc.status = WIFEXITED(sc.status) ? WEXITSTATUS(sc.status) : -1;
+#endif
+    }
+  else
+    sc.status = -1;
+  sc.seconds = get_time()-start;
+  write_file(prefix + ".res", output);
+
+  // the simulator prints a summary line to stderr: "<reason> at PC=xxxx after n cycles, ..."
+  string log;
+  sc.cycles = 0;
+  if( read_file(prefix + ".log", log) )
+    {
+      size_t p = log.rfind(" after ");
+      if( p!=string::npos ) sc.cycles = strtoull(log.c_str()+p+7, NULL, 10);
+      while( !log.empty() && (log[log.size()-1]=='\n' || log[log.size()-1]=='\r') ) log.erase(log.size()-1);
+    }
+
+  string golden;
+  sc.pass = false;
+  if( sc.status!=0 )
+    sc.message = log.empty() ? "simulator failed" : log;
+  else if( update )
+    {
+      sc.pass    = write_file(prefix + ".out", output);
+      sc.message = sc.pass ? "updated golden file" : "can not write golden file";
+    }
+  else if( !read_file(prefix + ".out", golden) )
+    sc.message = "no golden file";
+  else if( golden!=output )
+    {
+      size_t i = 0;
+      while( i<golden.size() && i<output.size() && golden[i]==output[i] ) i++;
+      char buf[100];
+      snprintf(buf, 100, "output differs at offset %lu", (unsigned long) i);
+      sc.message = buf;
+    }
+  else
+    sc.pass = true;
+
+  if( sc.pass ) shell(REMOVE_DIR_CMD, workdir, workdir);
+}
+
+
+static void *worker(void *data)
+{
+  while( true )
+    {
+      pthread_mutex_lock(&lock);
+      size_t i = next_scenario++;
+      pthread_mutex_unlock(&lock);
+      if( i>=scenarios.size() ) break;
+
+      Scenario &sc = scenarios[i];
+      run_scenario(sc);
+
+      pthread_mutex_lock(&lock);
+      if( sc.pass ) num_passed++;
+      printf("%s  %-24s %14llu cycles %9.3f s  %s\n", sc.pass ? "PASS" : "FAIL", sc.name.c_str(),
+             sc.cycles, sc.seconds, sc.message.c_str());
+      fflush(stdout);
+      pthread_mutex_unlock(&lock);
+    }
+
+  return NULL;
+}
+
+
+static bool read_manifest(const char *fname)
+{
+  FILE *f = fopen(fname, "r");
+  if( f==NULL ) { fprintf(stderr, "Can not open manifest: %s\n", fname); return false; }
+
+  // golden/input files are relative to the manifest
+  basedir = fname;
+  size_t p = basedir.find_last_of("/\\");
+  basedir = get_full_path(p==string::npos ? "." : basedir.substr(0, p+1)) + "/";
+
+  char line[1024];
+  int lineno = 0;
+  while( fgets(line, sizeof(line), f) )
+    {
+      lineno++;
+      char *s = line;
+      while( *s==' ' || *s=='\t' ) s++;
+      s[strcspn(s, "\r\n")] = 0;
+      if( *s==0 || *s=='#' ) continue;
+
+      char *c = strchr(s, ':');
+      if( c==NULL || c==s )
+        {
+          fprintf(stderr, "%s:%i: expected 'name: options'\n", fname, lineno);
+          fclose(f);
+          return false;
+        }
+
+      Scenario sc;
+      sc.name    = string(s, c-s);
+      sc.options = c+1;
+      sc.pass    = false;
+      scenarios.push_back(sc);
+    }
+
+  fclose(f);
+  return true;
+}
+
+
+static int get_num_cores()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n>0 ? n : 1;
+#endif
+}
+
+
+int main(int argc, char **argv)
+{
+  int jobs = get_num_cores();
+  const char *manifest = NULL;
+
+  for(int i=1; i<argc; i++)
+    {
+      if( strcmp(argv[i], "-j")==0 && i+1<argc )
+        jobs = atoi(argv[++i]);
+      else if( strcmp(argv[i], "-s")==0 && i+1<argc )
+        simulator = argv[++i];
+      else if( strcmp(argv[i], "-d")==0 && i+1<argc )
+        disksdir = argv[++i];
+      else if( strcmp(argv[i], "-u")==0 )
+        update = true;
+      else if( manifest==NULL && argv[i][0]!='-' )
+        manifest = argv[i];
+      else
+        { manifest = NULL; break; }
+    }
+
+  if( manifest==NULL )
+    {
+      fprintf(stderr, "usage: %s [-j jobs] [-u] [-s simulator] [-d disks] manifest\n", argv[0]);
+      return 1;
+    }
+
+  if( !read_manifest(manifest) ) return 1;
+  simulator = get_full_path(simulator);
+  disksdir  = get_full_path(disksdir);
+  if( jobs<1 ) jobs = 1;
+  if( (size_t) jobs>scenarios.size() ) jobs = scenarios.size();
+
+  double start = get_time();
+  vector<pthread_t> threads(jobs);
+  for(int i=0; i<jobs; i++) pthread_create(&threads[i], NULL, worker, NULL);
+  for(int i=0; i<jobs; i++) pthread_join(threads[i], NULL);
+
+  unsigned long long cycles = 0;
+  for(size_t i=0; i<scenarios.size(); i++) cycles += scenarios[i].cycles;
+  printf("%lu scenarios, %lu passed, %lu failed, %llu cycles, %.3f s using %i jobs\n",
+         (unsigned long) scenarios.size(), (unsigned long) num_passed,
+         (unsigned long) (scenarios.size()-num_passed), cycles, get_time()-start, jobs);
+
+  return num_passed==scenarios.size() ? 0 : 1;
+}
@@ -28,11 +28,14 @@
 
 #ifdef HOST_HAS_FILESYS
 
-HOST_FILESYS_FILE_TYPE datafile;
+MACHINE_STATE HOST_FILESYS_FILE_TYPE datafile;
 
 
 int recvChar(int msDelay) 
 { 
+  // the other side only replies once it has seen our (buffered) output
+  Serial.flush();
+
   unsigned long start = millis();
   while( (int) (millis()-start) < msDelay) 
     { 
@@ -56,47 +59,46 @@ static void consume_input()
 }
 
 
-bool dataHandlerSend(unsigned long no, char* data, int size)
+int recvData(char *data, int size, int msDelay)
 {
-  if( datafile )
-    {
-      unsigned long offset = (no-1)*128;
-      if( host_filesys_file_seek(datafile, offset) && host_filesys_file_pos(datafile)==offset )
-        {
-          int n = host_filesys_file_read(datafile, size, (void *) data);
+  // wait for the first byte, then take whatever else is already buffered
+  int c = recvChar(msDelay), n = 0;
+  if( c<0 ) return -1;
 
-          // if there was nothing more to read then signal end-of-file
-          if( n==0 ) return false;
+  data[n++] = c;
+  while( n<size && Serial.available() ) data[n++] = (uint8_t) Serial.read();
+  return n;
+}
 
-          // XMODEM sends blocks of 128 bytes so if we have less than that
-          // fill the rest of the buffer with EOF (ASCII 26) characters
-          while( n<size ) data[n++]=26;
 
-          return true;
-        }
+int dataHandlerSend(unsigned long offset, char* data, int size)
+{
+  if( datafile )
+    {
+      if( host_filesys_file_seek(datafile, offset) && host_filesys_file_pos(datafile)==offset )
+        return host_filesys_file_read(datafile, size, (void *) data);
     }
 
-  // either file was not open or we got past the end
-  return false;
+  // file was not open
+  return -1;
 }
 
 
-bool dataHandlerReceive(unsigned long no, char* data, int size)
+int dataHandlerReceive(unsigned long offset, char* data, int size)
 {
   if( datafile )
     {
-      unsigned long offset = (no-1)*128;
       if( host_filesys_file_seek(datafile, offset) && host_filesys_file_pos(datafile)==offset )
-        return host_filesys_file_write(datafile, size, (void *) data)==size;
+        return host_filesys_file_write(datafile, size, (void *) data);
     }
 
-  return false;
+  return -1;
 }
 
 
 static char *getFilename(const char *prompt)
 {
-  static char buf[16];
+  static MACHINE_STATE char buf[16];
   int l = 0, dot_pos = -1;
 
   Serial.print(prompt);
@@ -226,6 +228,7 @@ static void receiveFile()
       if( datafile )
         {
           XModem modem(recvChar, sendData, dataHandlerReceive);
+          modem.setBulkReceive(recvData);
           
           bool isempty = false;
           host_serial_interrupts_pause();
@@ -251,7 +254,7 @@ static void receiveFile()
 }
 
 
-static void sendFile()
+static void sendFile(bool use1k)
 {
   Serial.println();
   char *fname = getFilename("File name to send: ");
@@ -266,7 +269,7 @@ static void sendFile()
           host_serial_interrupts_pause();
           delay(100);
           Serial.println(F("\nInitiate XMODEM receive now."));
-          if( modem.transmit() )
+          if( modem.transmit(use1k) )
             Serial.println(F("Success!"));
           else
             Serial.println(F("ERROR!"));
@@ -281,6 +284,118 @@ static void sendFile()
 }
 
 
+static MACHINE_STATE char **batchNames;
+static MACHINE_STATE int batchNumNames, batchNext;
+
+
+static bool batchReceiveFile(char *name, unsigned long *size)
+{
+  if( datafile ) host_filesys_file_close(datafile);
+
+  // YMODEM file names may include a path and do not need to be 8.3
+  char *p = strrchr(name, '/'), fname[13];
+  int l = 0, dot_pos = -1;
+  for(p = p ? p+1 : name; *p && l<12; p++)
+    {
+      char c = *p;
+      if( c>='a' && c<='z' ) c -= 32;
+      if( c=='.' && dot_pos<0 && l>0 )
+        fname[dot_pos=l++] = c;
+      else if( ((c>='0' && c<='9') || (c>='A' && c<='Z') || c=='_' || c=='~') &&
+               ((dot_pos<0 && l<8) || (dot_pos>=0 && l-dot_pos<4)) )
+        fname[l++] = c;
+    }
+  if( l>0 && fname[l-1]=='.' ) l--;
+  fname[l] = 0;
+  if( l==0 ) return false;
+
+  host_filesys_file_remove(fname);
+  datafile = host_filesys_file_open(fname, true);
+  return datafile ? true : false;
+}
+
+
+static bool batchSendFile(char *name, unsigned long *size)
+{
+  if( datafile ) host_filesys_file_close(datafile);
+
+  while( batchNext<batchNumNames )
+    {
+      char *fname = batchNames[batchNext++];
+      datafile = host_filesys_file_open(fname, false);
+      if( datafile )
+        {
+          strcpy(name, fname);
+          *size = host_filesys_file_size(fname);
+          return true;
+        }
+    }
+
+  return false;
+}
+
+
+static void batchReceive()
+{
+  XModem modem(recvChar, sendData, dataHandlerReceive);
+  modem.setBulkReceive(recvData);
+
+  Serial.println();
+  host_serial_interrupts_pause();
+  delay(100);
+  Serial.println(F("\nInitiate YMODEM send now."));
+  if( modem.receiveBatch(batchReceiveFile) )
+    Serial.println(F("\r\nSuccess!"));
+  else
+    Serial.println(F("\r\nERROR!"));
+  host_serial_interrupts_resume();
+  consume_input();
+
+  if( datafile ) host_filesys_file_close(datafile);
+}
+
+
+static void batchSend()
+{
+  char *fname;
+  batchNames = NULL;
+  batchNumNames = 0;
+  batchNext = 0;
+
+  Serial.println(F("\nEnter file names to send, empty line to start."));
+  while( (fname=getFilename("File name to send: "))!=NULL && fname[0]!=0 )
+    {
+      if( host_filesys_file_exists(fname) )
+        {
+          batchNames = (char**) realloc(batchNames, (batchNumNames+1) * sizeof(char *));
+          batchNames[batchNumNames++] = strdup(fname);
+        }
+      else
+        { Serial.print(F("File does not exist: ")); Serial.println(fname); }
+    }
+
+  if( fname!=NULL && batchNumNames>0 )
+    {
+      XModem modem(recvChar, sendData, dataHandlerSend);
+
+      host_serial_interrupts_pause();
+      delay(100);
+      Serial.println(F("\nInitiate YMODEM receive now."));
+      if( modem.transmitBatch(batchSendFile) )
+        Serial.println(F("Success!"));
+      else
+        Serial.println(F("ERROR!"));
+      consume_input();
+      host_serial_interrupts_resume();
+
+      if( datafile ) host_filesys_file_close(datafile);
+    }
+
+  for(int i=0; i<batchNumNames; i++) free(batchNames[i]);
+  free(batchNames);
+}
+
+
 static void deleteFile()
 {
   Serial.println();
@@ -598,6 +713,9 @@ void sd_manager()
           Serial.println(F("(D)ump file"));
           Serial.println(F("(r)eceive file via XMODEM"));
           Serial.println(F("(s)end file via XMODEM"));
+          Serial.println(F("(S)end file via XMODEM-1K"));
+          Serial.println(F("(b)atch receive files via YMODEM"));
+          Serial.println(F("(B)atch send files via YMODEM"));
           Serial.println(F("(c)opy file"));
           Serial.println(F("(R)ename file"));
           Serial.println(F("(e)rase file"));
@@ -626,7 +744,16 @@ void sd_manager()
           break;
 
         case 's':
-          sendFile();
+        case 'S':
+          sendFile(c=='S');
+          break;
+
+        case 'b':
+          batchReceive();
+          break;
+
+        case 'B':
+          batchSend();
           break;
 
         case 'e':
@@ -38,14 +38,15 @@
 
 #define SSC_SIOTP0   0x01 // revision of SIO board, bit 0
 #define SSC_SIOTP1   0x02 // revision of SIO board, bit 1
+#define SSC_GUEST    0x10 // guest-paced input (next byte is delivered as soon as the previous one was read)
 #define SSC_INTTX    0x20 // transmit interrupt enabled
 #define SSC_REALTIME 0x40 // force real-(simulation-)time operation (always use baud rate)
 #define SSC_INTRX    0x80 // receive  interrupt enabled
 
 #define b2s numsys_byte2string
 
-byte     acr_cload_fid     = 0;
-uint32_t acr_cload_timeout = 0;
+MACHINE_STATE byte     acr_cload_fid     = 0;
+MACHINE_STATE uint32_t acr_cload_timeout = 0;
 
 
 #if USE_SECOND_2SIO>0
@@ -56,12 +57,46 @@ static const uint32_t serial_device_interrupts[6] = {INT_SIO, INT_ACR, INT_2SIO1
 static const uint32_t serial_device_interrupts[4] = {INT_SIO, INT_ACR, INT_2SIO1, INT_2SIO2};
 #endif
 
-volatile byte serial_ctrl[NUM_SERIAL_DEVICES], serial_data[NUM_SERIAL_DEVICES];
-volatile byte serial_status[NUM_SERIAL_DEVICES], serial_status_dev[NUM_SERIAL_DEVICES];
-byte serial_fid[NUM_SERIAL_DEVICES];
-static byte last_active_primary_device = CSM_SIO;
+MACHINE_STATE volatile byte serial_ctrl[NUM_SERIAL_DEVICES], serial_data[NUM_SERIAL_DEVICES];
+MACHINE_STATE volatile byte serial_status[NUM_SERIAL_DEVICES], serial_status_dev[NUM_SERIAL_DEVICES];
+MACHINE_STATE byte serial_fid[NUM_SERIAL_DEVICES];
+static MACHINE_STATE byte serial_cr_delay[NUM_SERIAL_DEVICES];
+static MACHINE_STATE byte last_active_primary_device = CSM_SIO;
+
+#ifdef HOST_HAS_FILESYS
+// Serial data can also be captured to (or replayed from) a host file with
+// any name. Data goes through a buffer so the file is only accessed once
+// per SERIAL_STREAM_BUFSIZE bytes (or when the capture timer expires).
+// Captures can prefix each line with the time since the capture started
+// and switch to a new file when the current one reaches a given size.
+#define SERIAL_FID_STREAM         0xfd
+#define SERIAL_STREAM_BUFSIZE     512
+#define SERIAL_STREAM_FLUSH_USEC  1000000
+
+struct SerialStream
+{
+  HOST_FILESYS_FILE_TYPE f;
+  char         *name;
+  bool          capture, timestamps, line_start;
+  uint32_t      rotate_size, file_size;
+  unsigned long start_millis;
+  uint16_t      len, pos;
+  byte          buf[SERIAL_STREAM_BUFSIZE];
+};
+
+static MACHINE_STATE struct SerialStream *serial_stream[NUM_SERIAL_DEVICES];
+#define SERIAL_STREAM_READ(dev)  (serial_fid[dev]==SERIAL_FID_STREAM && !serial_stream[dev]->capture)
+#define SERIAL_STREAM_WRITE(dev) (serial_fid[dev]==SERIAL_FID_STREAM &&  serial_stream[dev]->capture)
+static bool serial_stream_read(byte dev, byte *data);
+static void serial_stream_write(byte dev, byte data);
+static void serial_stream_close(byte dev);
+#else
+#define SERIAL_STREAM_READ(dev)  false
+#define SERIAL_STREAM_WRITE(dev) false
+#endif
 
 static void serial_replay(byte dev);
+static bool serial_replay_on_read(byte dev);
 static void acr_read_next_byte();
 static void serial_timer_interrupt_check_enable(byte dev = 0xff);
 
@@ -186,10 +221,10 @@ void serial_replay_start(byte dev, bool example, byte filenum)
     }
 
   // either start interrupt timer or prepare first byte for replay
-  if( serial_ctrl[dev] & (SSC_INTRX|SSC_REALTIME) )
-    serial_timer_interrupt_check_enable(dev);
-  else
+  if( serial_replay_on_read(dev) )
     serial_replay(dev);
+  else
+    serial_timer_interrupt_check_enable(dev);
   
   serial_update_hlda_led();
 }
@@ -209,15 +244,202 @@ void serial_capture_start(byte dev, byte filenum)
 }
     
 
+#ifdef HOST_HAS_FILESYS
+
+static void serial_stream_flush_all();
+
+
+static bool serial_stream_start(byte dev, const char *filename, bool capture)
+{
+  serial_acr_check_cload_timeout();
+  if( serial_fid[dev]>0 ) serial_stop(dev);
+
+  struct SerialStream *s = (struct SerialStream *) malloc(sizeof(struct SerialStream));
+  if( s==NULL ) return false;
+
+  if( capture && host_filesys_file_exists(filename) ) host_filesys_file_remove(filename);
+  s->f = host_filesys_file_open(filename, capture);
+  if( !s->f ) { free(s); return false; }
+
+  s->name = strdup(filename);
+  if( s->name==NULL ) { host_filesys_file_close(s->f); free(s); return false; }
+
+  s->capture      = capture;
+  s->timestamps   = false;
+  s->line_start   = true;
+  s->rotate_size  = 0;
+  s->file_size    = 0;
+  s->start_millis = millis();
+  s->len          = 0;
+  s->pos          = 0;
+
+  serial_stream[dev] = s;
+  serial_fid[dev]    = SERIAL_FID_STREAM;
+  timer_setup(TIMER_CAPTURE, SERIAL_STREAM_FLUSH_USEC, serial_stream_flush_all);
+  return true;
+}
+
+
+bool serial_replay_start_file(byte dev, const char *filename)
+{
+  if( !serial_stream_start(dev, filename, false) ) return false;
+
+  // either start interrupt timer or prepare first byte for replay
+  if( serial_replay_on_read(dev) )
+    serial_replay(dev);
+  else
+    serial_timer_interrupt_check_enable(dev);
+
+  serial_update_hlda_led();
+  return true;
+}
+
+
+bool serial_capture_start_file(byte dev, const char *filename, bool timestamps, uint32_t rotate_size)
+{
+  if( !serial_stream_start(dev, filename, true) ) return false;
+
+  serial_stream[dev]->timestamps  = timestamps;
+  serial_stream[dev]->rotate_size = rotate_size;
+  serial_update_hlda_led();
+  return true;
+}
+
+
+static bool serial_stream_flush(byte dev)
+{
+  struct SerialStream *s = serial_stream[dev];
+  bool ok = host_filesys_file_write(s->f, s->len, s->buf)==s->len;
+  host_filesys_file_flush(s->f);
+  s->len = 0;
+  return ok;
+}
+
+
+static void serial_stream_flush_all()
+{
+  for(byte dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+    if( SERIAL_STREAM_WRITE(dev) && serial_stream[dev]->len>0 && !serial_stream_flush(dev) )
+      {
+        DBG_FILEOPS(1, F("error writing capture file"));
+        serial_stop(dev);
+      }
+}
+
+
+static bool serial_stream_rotate(byte dev)
+{
+  // current file becomes <name>.1, <name>.2, ... (first unused number)
+  struct SerialStream *s = serial_stream[dev];
+  size_t rsize = strlen(s->name)+7;
+  char *rname = (char *) malloc(rsize);
+  if( rname==NULL ) return false;
+
+  bool ok = serial_stream_flush(dev);
+  host_filesys_file_close(s->f);
+
+  for(uint16_t n=1; ok && n<0xffff; n++)
+    {
+      snprintf(rname, rsize, "%s.%u", s->name, n);
+      if( !host_filesys_file_exists(rname) ) break;
+    }
+
+  ok = ok && host_filesys_file_rename(s->name, rname);
+  free(rname);
+
+  s->f = host_filesys_file_open(s->name, true);
+  s->file_size = 0;
+  return ok && s->f;
+}
+
+
+static bool serial_stream_put(byte dev, byte data)
+{
+  struct SerialStream *s = serial_stream[dev];
+  if( s->len==SERIAL_STREAM_BUFSIZE && !serial_stream_flush(dev) ) return false;
+
+  // start the flush timer with the first byte in the buffer
+  if( s->len==0 ) timer_start(TIMER_CAPTURE);
+
+  s->buf[s->len++] = data;
+  s->file_size++;
+  return true;
+}
+
+
+static void serial_stream_write(byte dev, byte data)
+{
+  struct SerialStream *s = serial_stream[dev];
+  bool ok = true;
+
+  if( s->line_start )
+    {
+      // start a new file at a line break once the size limit is
+      // reached (or in the middle of a line if there are no line breaks)
+      if( s->rotate_size>0 && s->file_size>=s->rotate_size && !serial_stream_rotate(dev) )
+        { DBG_FILEOPS(1, F("unable to start new capture file")); serial_stop(dev); return; }
+
+      if( s->timestamps )
+        {
+          // [hours:minutes:seconds.milliseconds] since capture was started
+          char buf[40];
+          unsigned long ms = millis()-s->start_millis;
+          int n = snprintf(buf, sizeof(buf), "[%02lu:%02lu:%02lu.%03lu] ", ms/3600000, (ms/60000)%60, (ms/1000)%60, ms%1000);
+          for(int i=0; i<n && ok; i++) ok = serial_stream_put(dev, buf[i]);
+        }
+
+      s->line_start = false;
+    }
+
+  if( !ok || !serial_stream_put(dev, data) )
+    { DBG_FILEOPS(1, F("error writing capture file")); serial_stop(dev); return; }
+
+  if( data==10 || (s->rotate_size>0 && s->file_size>=s->rotate_size+SERIAL_STREAM_BUFSIZE) )
+    s->line_start = true;
+}
+
+
+static bool serial_stream_read(byte dev, byte *data)
+{
+  struct SerialStream *s = serial_stream[dev];
+
+  // read ahead a buffer full of data
+  if( s->pos>=s->len )
+    {
+      s->len = host_filesys_file_read(s->f, SERIAL_STREAM_BUFSIZE, s->buf);
+      s->pos = 0;
+      if( s->len==0 ) return false;
+    }
+
+  *data = s->buf[s->pos++];
+  return true;
+}
+
+
+static void serial_stream_close(byte dev)
+{
+  struct SerialStream *s = serial_stream[dev];
+  if( s->capture && s->len>0 && !serial_stream_flush(dev) )
+    { DBG_FILEOPS(1, F("error writing capture file")); }
+
+  host_filesys_file_close(s->f);
+  free(s->name);
+  free(s);
+  serial_stream[dev] = NULL;
+}
+
+#endif
+
+
 bool serial_replay_running(byte dev)
 {
-  return serial_fid[dev]>=0xfe || serial_fid[dev]>0 && filesys_is_read(serial_fid[dev]);
+  return serial_fid[dev]>=0xfe || SERIAL_STREAM_READ(dev) || (serial_fid[dev]>0 && filesys_is_read(serial_fid[dev]));
 }
 
 
 bool serial_capture_running(byte dev)
 {
-  return serial_fid[dev]<0xfe && serial_fid[dev]>0 && filesys_is_write(serial_fid[dev]);
+  return SERIAL_STREAM_WRITE(dev) || (serial_fid[dev]<0xfd && serial_fid[dev]>0 && filesys_is_write(serial_fid[dev]));
 }
 
 
@@ -233,6 +455,13 @@ void serial_stop(byte dev)
       DBG_FILEOPS(3, F("stopping example load"));
       serial_fid[dev] = 0;
    }
+#ifdef HOST_HAS_FILESYS
+  else if( serial_fid[dev]==SERIAL_FID_STREAM )
+    {
+      serial_stream_close(dev);
+      serial_fid[dev] = 0;
+    }
+#endif
   else if( serial_fid[dev]>0 )
     {
       if( filesys_is_read(serial_fid[dev]) )
@@ -287,6 +516,11 @@ void serial_set_config(byte dev)
       else
         serial_ctrl[dev] &= ~SSC_REALTIME;
 
+      if( config_serial_guest_paced(dev) )
+        serial_ctrl[dev] |= SSC_GUEST;
+      else
+        serial_ctrl[dev] &= ~SSC_GUEST;
+
       if( dev==CSM_SIO ) serial_ctrl[dev] = (serial_ctrl[dev] & ~3) | (config_serial_siorev() & 3);
 
       switch( dev )
@@ -311,6 +545,7 @@ void serial_reset(byte dev)
   else
     {
       serial_ctrl[dev] = 0;
+      serial_cr_delay[dev] = 0;
       serial_set_config(dev);
       set_serial_status(dev, SST_TDRE);
     }
@@ -346,7 +581,7 @@ void serial_receive_data(byte dev, byte b)
 // called by the host if serial data received
 void serial_receive_host_data(byte host_interface, byte b)
 {
-  static unsigned long prevESC = 0;
+  static MACHINE_STATE unsigned long prevESC = 0;
   if( b==27 && config_serial_input_enabled() && !host_read_status_led_WAIT() && host_interface==config_host_serial_primary() )
     {
       if( millis()-prevESC>50 && millis()-prevESC<250 )
@@ -374,13 +609,78 @@ void serial_receive_host_data(byte host_interface, byte b)
 }
 
 
+// returns -1 if no guest-paced device is mapped to the host interface
+// (input is paced by the interface's baud rate), otherwise 1 if a
+// guest-paced device has read its last byte and 0 if not. Other devices
+// mapped to the same interface may never be read by the simulated
+// program and do not hold up the input.
+int serial_host_input_pace(byte host_interface)
+{
+  int res = -1;
+  for(byte dev=0; dev<NUM_SERIAL_DEVICES; dev++)
+    if( config_serial_map_sim_to_host(dev)==host_interface && (serial_ctrl[dev] & SSC_GUEST) )
+      {
+        if( serial_cr_delay[dev]>0 )
+          return 0;
+        else if( !(serial_status[dev] & SST_RDRF) )
+          res = 1;
+        else if( res<0 )
+          res = 0;
+      }
+
+  return res;
+}
+
+
+// true if the next byte of replayed data is prepared when the
+// simulated code reads the current one (as opposed to by the timer)
+static bool serial_replay_on_read(byte dev)
+{
+  return (serial_ctrl[dev] & SSC_GUEST) || !(serial_ctrl[dev] & (SSC_INTRX|SSC_REALTIME));
+}
+
+
+// in guest-paced mode, optionally give line-oriented programs some time
+// to process a line before sending more data. Returns true if waiting.
+static bool serial_cr_delay_start(byte dev, byte data)
+{
+  if( data==13 && (serial_ctrl[dev] & SSC_GUEST) )
+    {
+      serial_cr_delay[dev] = config_serial_guest_paced_cr_delay(dev);
+      if( serial_cr_delay[dev]>0 )
+        {
+          serial_timer_interrupt_check_enable(dev);
+          return true;
+        }
+    }
+
+  return false;
+}
+
+
 static void serial_replay(byte dev)
 {
   byte fid = serial_fid[dev];
 
-  if( fid>0 && (fid==0xff || filesys_is_read(fid)) )
+  if( fid>0 && (fid==0xff || SERIAL_STREAM_READ(dev) || filesys_is_read(fid)) )
     {
       byte data;
+#ifdef HOST_HAS_FILESYS
+      if( fid==SERIAL_FID_STREAM )
+        {
+          // play back data from host file
+          if( serial_stream_read(dev, &data) )
+            serial_receive_data(dev, data);
+          else
+            {
+              DBG_FILEOPS(4, F("no more data for replay"));
+              serial_stream_close(dev);
+              serial_fid[dev] = 0;
+              serial_update_hlda_led();
+            }
+        }
+      else
+#endif
       if( fid==0xff )
         {
           // 0xff is special fid for example replay
@@ -501,6 +801,11 @@ void serial_write(byte dev, byte data)
         last_active_primary_device = dev;
     }
 
+#ifdef HOST_HAS_FILESYS
+  if( !host_read_status_led_WAIT() && SERIAL_STREAM_WRITE(dev) )
+    serial_stream_write(dev, data);
+  else
+#endif
   if( !host_read_status_led_WAIT() && serial_fid[dev]>0 && filesys_is_write(serial_fid[dev]) )
     {
       if( !filesys_write_char(serial_fid[dev], data) )
@@ -520,9 +825,11 @@ void serial_timer_interrupt_check_enable(byte dev)
 {
   if( dev<0xff )
     {
-      bool enable  = ((serial_ctrl[dev] & (SSC_INTRX|SSC_REALTIME)) && serial_fid[dev]>0 && (serial_fid[dev]==0xff || filesys_is_read(serial_fid[dev]))
+      bool enable  = (!serial_replay_on_read(dev) && serial_fid[dev]>0 && (serial_fid[dev]==0xff || SERIAL_STREAM_READ(dev) || filesys_is_read(serial_fid[dev]))
+                      ||
+                      (serial_ctrl[dev] & (SSC_INTTX|SSC_REALTIME)) && !(serial_status[dev] & SST_TDRE)
                       ||
-                      (serial_ctrl[dev] & (SSC_INTTX|SSC_REALTIME)) && !(serial_status[dev] & SST_TDRE));
+                      serial_cr_delay[dev]>0);
       
       bool enabled = timer_running(dev);
 
@@ -548,8 +855,16 @@ static void serial_timer_interrupt(byte dev)
           serial_status[dev] |= SST_TDRE;
         }
 
-      // read serial playback data
-      serial_replay(dev);
+      // read serial playback data (in guest-paced mode only
+      // at the end of the delay after a carriage return)
+      if( serial_cr_delay[dev]>0 )
+        {
+          // the ACR may also be reading from the PS2 tape (see acr_read_next_byte)
+          if( --serial_cr_delay[dev]==0 )
+            { if( dev==CSM_ACR ) acr_read_next_byte(); else serial_replay(dev); }
+        }
+      else if( !(serial_ctrl[dev] & SSC_GUEST) )
+        serial_replay(dev);
 
       // this schedules additional interrupts as necessary
       set_serial_status(dev, serial_status[dev]);
@@ -595,6 +910,11 @@ void serial_timer_interrupt_setup(byte dev)
       else
         serial_ctrl[dev] &= ~SSC_REALTIME;
 
+      if( config_serial_guest_paced(dev) )
+        serial_ctrl[dev] |=  SSC_GUEST;
+      else
+        serial_ctrl[dev] &= ~SSC_GUEST;
+
       serial_timer_interrupt_check_enable(dev);
     }
   else
@@ -687,14 +1007,13 @@ byte serial_2sio_in_data(byte port)
   // get character
   data = serial_read(dev);
   
-  // map character (for BASIC etc)
-  data = serial_map_characters_in(dev, data);
-
-  // if interrupts are not enabled, prepare the next byte for replay now
-  if( !(serial_ctrl[dev] & (SSC_INTRX|SSC_REALTIME)) )
+  // if interrupts are not enabled (or input is guest-paced),
+  // prepare the next byte for replay now
+  if( serial_replay_on_read(dev) && !serial_cr_delay_start(dev, data) )
     serial_replay(dev);
 
-  return data;
+  // map character (for BASIC etc)
+  return serial_map_characters_in(dev, data);
 }
 
 
@@ -817,14 +1136,13 @@ byte serial_sio_in_data(byte port)
   // get character
   data = serial_read(CSM_SIO);
 
-  // map character (for BASIC etc)
-  data = serial_map_characters_in(CSM_SIO, data);
-      
-  // if interrupts are not enabled, prepare the next byte for replay now
-  if( !(serial_ctrl[CSM_SIO] & (SSC_INTRX|SSC_REALTIME)) )
+  // if interrupts are not enabled (or input is guest-paced),
+  // prepare the next byte for replay now
+  if( serial_replay_on_read(CSM_SIO) && !serial_cr_delay_start(CSM_SIO, data) )
     serial_replay(CSM_SIO);
 
-  return data;
+  // map character (for BASIC etc)
+  return serial_map_characters_in(CSM_SIO, data);
 }
 
 
@@ -942,7 +1260,7 @@ bool serial_acr_check_cload_timeout()
 // ALTAIR Extended BASIC loading from tape via CLOAD
 static void acr_read_next_cload_byte()
 {
-  static byte tape_fname = 0;
+  static MACHINE_STATE byte tape_fname = 0;
   bool go = true;
   byte data;
 
@@ -1002,7 +1320,7 @@ static void acr_read_next_cload_byte()
 // This is ALTAIR Extended BASIC saving to ACR via CSAVE
 static void acr_write_next_csave_byte(byte data)
 {
-  static byte leadchar = 0, leadcount = 0, endcount = 0;
+  static MACHINE_STATE byte leadchar = 0, leadcount = 0, endcount = 0;
 
   // if we were reading before, close the file now
   if( acr_cload_fid>0 && !filesys_is_write(acr_cload_fid) )
@@ -1062,7 +1380,7 @@ static void acr_read_next_byte()
           prog_ps2_read_next(&data);
           serial_receive_data(CSM_ACR, data);
         }
-      else if( !(serial_ctrl[CSM_ACR] & (SSC_INTRX|SSC_REALTIME)) )
+      else if( serial_replay_on_read(CSM_ACR) )
         serial_replay(CSM_ACR);
     }
   else if( regPC==0xE2A0 && config_serial_trap_CLOAD() )
@@ -1128,8 +1446,9 @@ byte serial_acr_in_data(byte port)
   // get character
   data = serial_read(CSM_ACR);
 
-  // if interrupts are not enabled, prepare the next byte for replay now
-  if( !(serial_ctrl[CSM_ACR] & (SSC_INTRX|SSC_REALTIME)) )
+  // if interrupts are not enabled (or input is guest-paced),
+  // prepare the next byte for replay now
+  if( serial_replay_on_read(CSM_ACR) && !serial_cr_delay_start(CSM_ACR, data) )
     acr_read_next_byte();
 
   DBG_FILEOPS2(5, F("ACR reading data: "), int(data));
@@ -29,6 +29,13 @@ void serial_setup();
 
 void serial_replay_start(byte device, bool example, byte filenum);
 void serial_capture_start(byte device, byte filenum);
+#ifdef HOST_HAS_FILESYS
+// replay/capture a host file with any name, captures optionally prefix
+// each line with a timestamp and start a new file (renaming the current
+// one to <name>.1, <name>.2, ...) when it reaches rotate_size bytes
+bool serial_replay_start_file(byte device, const char *filename);
+bool serial_capture_start_file(byte device, const char *filename, bool timestamps, uint32_t rotate_size = 0);
+#endif
 bool serial_replay_running(byte device);
 bool serial_capture_running(byte device);
 void serial_stop(byte devoce);
@@ -39,6 +46,7 @@ void serial_close_files();
 
 void serial_timer_interrupt_setup(byte dev = 0xff);
 void serial_receive_host_data(byte host_interface, byte b);
+int  serial_host_input_pace(byte host_interface);
 void serial_receive_data(byte dev, byte b);
 bool serial_available();
 int  serial_read();
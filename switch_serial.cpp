@@ -25,11 +25,11 @@
 
 
 SwitchSerialClass SwitchSerial;
+MACHINE_STATE uint8_t SwitchSerialClass::m_selected = 0;
 
 
 SwitchSerialClass::SwitchSerialClass() : Stream()
 {
-  m_selected = 0;
 }
 
 
@@ -90,6 +90,9 @@ size_t SwitchSerialClass::write(const uint8_t *buffer, size_t size)
       size_t n = host_serial_write(m_selected, (const char *) buffer, sz);
       buffer += n;
       sz -= n;
+
+      // output buffer full => give the client some time to catch up
+      if( n==0 ) { host_serial_flush(m_selected); delay(1); }
     }
 
   return size;
@@ -8,6 +8,7 @@
 #define SWITCH_SERIAL_H
 
 #include <Arduino.h>
+#include "config.h"
 
 class SwitchSerialClass : public Stream
 {
@@ -29,7 +30,8 @@ class SwitchSerialClass : public Stream
     uint8_t getSelected() { return m_selected; }
 
  private:
-    uint8_t m_selected;
+    // the selected interface belongs to the machine, not the object
+    static MACHINE_STATE uint8_t m_selected;
 };
 
 extern SwitchSerialClass SwitchSerial;
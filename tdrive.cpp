@@ -25,6 +25,7 @@
 #include "timer.h"
 #include "image.h"
 #include "io.h"
+#include "profile.h"
 
 #if NUM_TDRIVES == 0
 
@@ -61,17 +62,17 @@ void tdrive_reset() {}
 #define DRIVE_STATUS_BUSY           0x01
 
 
-static byte drive_selected = 0;
-static byte drive_mounted_disk[NUM_TDRIVES];
-static byte drive_current_track[NUM_TDRIVES];
-static HOST_FILESYS_FILE_TYPE drive_file[NUM_TDRIVES];
-static byte drive_current_sector;
+static MACHINE_STATE byte drive_selected = 0;
+static MACHINE_STATE byte drive_mounted_disk[NUM_TDRIVES];
+static MACHINE_STATE byte drive_current_track[NUM_TDRIVES];
+static MACHINE_STATE byte drive_file[NUM_TDRIVES];
+static MACHINE_STATE byte drive_current_sector;
 
-static bool drive_data_request;
-static byte drive_track, drive_sector, drive_data, drive_status;
-static byte drive_command, drive_aux;
-static byte drive_data_idx, drive_data_count;
-static byte drive_data_buffer[DRIVE_SECTOR_LENGTH];
+static MACHINE_STATE bool drive_data_request;
+static MACHINE_STATE byte drive_track, drive_sector, drive_data, drive_status;
+static MACHINE_STATE byte drive_command, drive_aux;
+static MACHINE_STATE byte drive_data_idx, drive_data_count;
+static MACHINE_STATE byte drive_data_buffer[DRIVE_SECTOR_LENGTH];
 
 static void tdrive_register_ports();
 
@@ -89,9 +90,10 @@ static void drive_read_sector(byte drive_num)
 #if DEBUGLVL>=1
       printf("read drive %i track %i sector %i\n", drive_num, drive_current_track[drive_num], drive_current_sector);
 #endif
-      host_filesys_file_seek(drive_file[drive_num], drive_get_file_pos(drive_num));
-      byte n = host_filesys_file_read(drive_file[drive_num], DRIVE_SECTOR_LENGTH, drive_data_buffer);
+      image_file_seek(drive_file[drive_num], drive_get_file_pos(drive_num));
+      byte n = image_file_read(drive_file[drive_num], DRIVE_SECTOR_LENGTH, drive_data_buffer);
       if( n<DRIVE_SECTOR_LENGTH ) memset(drive_data_buffer+n, 0, DRIVE_SECTOR_LENGTH-n);
+      PROFILE_COUNT_DISK_READ(PROF_DISK_TARBELL, drive_num);
     }
 }
 
@@ -103,9 +105,10 @@ static void drive_write_sector(byte drive_num)
 #if DEBUGLVL>=1
       printf("write drive %i track %i sector %i\n", drive_num, drive_current_track[drive_num], drive_current_sector);
 #endif
-      host_filesys_file_seek(drive_file[drive_num], drive_get_file_pos(drive_num));
-      host_filesys_file_write(drive_file[drive_num], drive_data_idx, drive_data_buffer);
-      host_filesys_file_flush(drive_file[drive_num]);
+      image_file_seek(drive_file[drive_num], drive_get_file_pos(drive_num));
+      image_file_write(drive_file[drive_num], drive_data_idx, drive_data_buffer);
+      image_file_flush(drive_file[drive_num]);
+      PROFILE_COUNT_DISK_WRITE(PROF_DISK_TARBELL, drive_num);
     }
 }
 
@@ -138,7 +141,7 @@ bool tdrive_unmount(byte drive_num)
     {
       if( (drive_command&0xE0)==0xA0 || (drive_command&0xF0)==0xF0 ) drive_write_sector(drive_selected);
       drive_mounted_disk[drive_num] = 0;
-      host_filesys_file_close(drive_file[drive_num]);
+      image_file_close(drive_file[drive_num]);
       tdrive_register_ports();
     }
 
@@ -171,10 +174,8 @@ bool tdrive_mount(byte drive_num, byte image_num)
       tdrive_unmount(drive_num);
       if( image_num>0 )
         {
-          char filename[13];
-          image_get_filename(IMAGE_TARBELL, image_num, filename, 13, false);
           drive_mounted_disk[drive_num] = image_num;
-          drive_file[drive_num] = host_filesys_file_open(filename, true);
+          drive_file[drive_num] = image_file_open(IMAGE_TARBELL, image_num, DRIVE_SECTOR_LENGTH);
           tdrive_register_ports();
           return true;
         }
@@ -311,7 +312,7 @@ static void tdrive_out_command(byte cmd)
   else if( (cmd&0xE0)<0x80 )
     {
       // step in/out/again (type 1)
-      static bool stepOut = false;
+      static MACHINE_STATE bool stepOut = false;
           
       if( (cmd&0xE0)==0x40 )
         stepOut = false;
@@ -550,7 +551,10 @@ void tdrive_register_ports()
 void tdrive_setup()
 {
   for(byte i=0; i<NUM_TDRIVES; i++)
-    drive_mounted_disk[i] = 0;
+    {
+      drive_mounted_disk[i] = 0;
+      drive_file[i] = IMAGE_FILE_NONE;
+    }
 
   tdrive_register_ports();
   tdrive_reset();
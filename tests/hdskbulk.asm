@@ -0,0 +1,150 @@
+; HDSK bulk transfer test for the regression scenarios in regress.txt
+;
+; Moves data into and out of the 88-HDSK sector buffers with loops of the
+; form that USE_HDSK_BULK_TRANSFER performs in one step, while 88-2SIO
+; transmit interrupts (timer driven) keep arriving. The interrupt routine
+; logs the loop counter (register B) of each interrupted loop iteration.
+; The log and a checksum of the data read back are printed at the end, so
+; the output only matches between runs with and without bulk transfers if
+; data, cycle counts and interrupt timing are the same.
+;
+; hdskbulk.hex was assembled from this file.
+
+SIOCTL  EQU     10H             ; 88-2SIO port 1 control/status
+SIODAT  EQU     11H             ; 88-2SIO port 1 data
+ACMD    EQU     0A3H            ; HDSK command (high byte)
+CDATA   EQU     0A5H            ; HDSK data from controller
+ADATA   EQU     0A7H            ; HDSK command (low byte) and data to controller
+SRC     EQU     2000H           ; source data
+DST     EQU     3000H           ; data read back
+LOG     EQU     4000H           ; interrupt log
+
+        ORG     0000H
+        JMP     START
+
+        ORG     0038H           ; RST 7 (2SIO interrupt)
+ISR:    PUSH    PSW
+        PUSH    H
+        LDA     LOGCNT          ; log register B of the interrupted loop
+        MOV     L,A
+        MVI     H,LOG/256
+        MOV     M,B
+        INR     A
+        STA     LOGCNT
+        MVI     A,'*'           ; next interrupt once this is sent
+        OUT     SIODAT
+        POP     H
+        POP     PSW
+        EI
+        RET
+
+        ORG     0100H
+START:  LXI     SP,1000H
+        LXI     H,SRC           ; fill source data
+FILL:   MOV     A,L
+        RLC
+        XRI     5AH
+        MOV     M,A
+        INR     L
+        JNZ     FILL
+        MVI     A,04H           ; select PIO data registers
+        OUT     0A0H
+        OUT     0A2H
+        OUT     0A4H
+        OUT     0A6H
+        MVI     A,03H           ; 2SIO master reset
+        OUT     SIOCTL
+        MVI     A,35H           ; 8N1, transmit interrupts on
+        OUT     SIOCTL
+        EI
+        MVI     A,'*'
+        OUT     SIODAT
+        MVI     A,8
+        STA     ROUNDS
+ROUND:  XRA     A               ; write 256 bytes into buffer 0
+        OUT     ADATA
+        MVI     A,40H
+        OUT     ACMD
+        LXI     H,SRC
+        MVI     B,0
+WLOOP:  MOV     A,M
+        OUT     ADATA
+        INX     H
+        DCR     B
+        JNZ     WLOOP
+        XRA     A               ; read buffer 0 back
+        OUT     ADATA
+        MVI     A,50H
+        OUT     ACMD
+        LXI     D,DST
+        MVI     B,0
+RLOOP:  IN      CDATA
+        STAX    D
+        INX     D
+        DCR     B
+        JNZ     RLOOP
+        LDA     ROUNDS
+        DCR     A
+        STA     ROUNDS
+        JNZ     ROUND
+        DI                      ; print interrupt log
+        CALL    CRLF
+        LXI     H,LOG
+        LDA     LOGCNT
+        MOV     C,A
+PLOG:   MOV     A,C
+        ORA     A
+        JZ      PSUM
+        MOV     A,M
+        CALL    PHEX
+        MVI     A,' '
+        CALL    PCHR
+        INX     H
+        DCR     C
+        JMP     PLOG
+PSUM:   CALL    CRLF            ; print checksum of data read back
+        LXI     H,DST
+        LXI     D,0
+SUM:    MOV     A,M
+        ADD     E
+        MOV     E,A
+        MVI     A,0
+        ADC     D
+        MOV     D,A
+        INR     L
+        JNZ     SUM
+        MOV     A,D
+        CALL    PHEX
+        MOV     A,E
+        CALL    PHEX
+        CALL    CRLF
+        HLT
+
+PHEX:   PUSH    PSW             ; print A in hex
+        RRC
+        RRC
+        RRC
+        RRC
+        CALL    PNIB
+        POP     PSW
+PNIB:   ANI     0FH
+        ADI     '0'
+        CPI     '9'+1
+        JC      PCHR
+        ADI     7
+PCHR:   PUSH    PSW             ; print character in A
+PWAIT:  IN      SIOCTL
+        ANI     02H
+        JZ      PWAIT
+        POP     PSW
+        OUT     SIODAT
+        RET
+CRLF:   MVI     A,13
+        CALL    PCHR
+        MVI     A,10
+        JMP     PCHR
+
+ROUNDS: DB      0
+LOGCNT: DB      0
+
+        END
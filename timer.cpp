@@ -19,20 +19,21 @@
 
 #include "timer.h"
 #include "config.h"
+#include "profile.h"
 
 #ifdef __AVR_ATmega2560__
 #define MAX_TIMERS 9
 #else
-#define MAX_TIMERS 13
+#define MAX_TIMERS 17
 #endif
 
 
 #define DEBUG 0
 
-uint32_t timer_cycle_counter        = 0;
-uint32_t timer_cycle_counter_offset = 0;
-uint32_t timer_next_expire_cycles   = 0xffffffff;
-byte     timer_next_expire_tid      = 0xff;
+MACHINE_STATE uint32_t timer_cycle_counter        = 0;
+MACHINE_STATE uint32_t timer_cycle_counter_offset = 0;
+MACHINE_STATE uint32_t timer_next_expire_cycles   = 0xffffffff;
+MACHINE_STATE byte     timer_next_expire_tid      = 0xff;
 
 
 struct TimerData {
@@ -43,9 +44,9 @@ struct TimerData {
   uint32_t  cycles_count;
 };
 
-struct TimerData timer_data[MAX_TIMERS];
-byte timer_queue[MAX_TIMERS];
-byte timer_queue_len = 0;
+MACHINE_STATE struct TimerData timer_data[MAX_TIMERS];
+MACHINE_STATE byte timer_queue[MAX_TIMERS];
+MACHINE_STATE byte timer_queue_len = 0;
 
 #if DEBUG>1
 static void print_queue()
@@ -197,6 +198,7 @@ void timer_check()
 {
   byte tid = timer_next_expire_tid;
   bool show = false;
+  PROFILE_HOST_SCOPE(PROF_HOST_TIMER);
 
   while( tid<0xff )
     {
@@ -23,9 +23,14 @@
 #define TIMER_DRIVE    10
 #define TIMER_HDSK     11
 #define TIMER_VDM1     12
+#define TIMER_BATCH    13
+#define TIMER_METRICS  14
+#define TIMER_CAPTURE  15
+#define TIMER_DSYNC    16
 
 
-extern uint32_t timer_cycle_counter, timer_cycle_counter_offset, timer_next_expire_cycles;
+extern MACHINE_STATE uint32_t timer_cycle_counter, timer_cycle_counter_offset, timer_next_expire_cycles;
+extern MACHINE_STATE byte timer_queue_len;
 
 typedef void (*TimerFnTp)();
 void timer_setup(byte tid, uint32_t microseconds, TimerFnTp timer_fn);
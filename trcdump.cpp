@@ -0,0 +1,189 @@
+// -----------------------------------------------------------------------------
+// Altair 8800 Simulator
+// Copyright (C) 2017-2019 David Hansel
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+// -----------------------------------------------------------------------------
+
+// Prints the instruction trace files written by the simulator (see
+// USE_PROFILING_TRACE in config.h, the "-w" option in batch mode or the 'O'
+// serial debugger command). Same output as the "-y" batch option but does not
+// require a simulator built with USE_PROFILING_TRACE and always disassembles
+// for the CPU the trace was recorded with.
+//
+// usage: trcdump [-s symbols] [-o] file
+//   -s symbols  show names from the symbol file (see disassembler.h)
+//   -o          show numbers in octal instead of hexadecimal
+//
+// Each line shows the cycle stamp relative to the first record, the cycles
+// taken by the instruction, "INT" if the instruction was supplied by an
+// interrupt, the address, the disassembled instruction, the registers before
+// executing it and the first memory write and I/O transfer it made.
+//
+// Built from the simulator's disassembler sources (with USE_Z80=2), this file
+// supplies the few host functions they need.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "disassembler.h"
+#include "cpucore.h"
+#include "numsys.h"
+#include "profile.h"
+#include "serial.h"
+#include "mem.h"
+
+
+MACHINE_STATE byte Mem[MEMSIZE];
+static int processor = PROC_I8080;
+
+
+int cpu_get_processor()
+{
+  return processor;
+}
+
+
+void cpu_set_processor(int p)
+{
+  processor = p;
+}
+
+
+int serial_read()
+{
+  return -1;
+}
+
+
+FILE *host_filesys_file_open(const char *filename, bool write)
+{
+  return fopen(filename, write ? "wb" : "rb");
+}
+
+
+uint32_t host_filesys_file_read(FILE *&f, uint32_t len, void *buffer)
+{
+  return fread(buffer, 1, len, f);
+}
+
+
+void host_filesys_file_close(FILE *&f)
+{
+  fclose(f);
+  f = NULL;
+}
+
+
+// the disassembler prints through the simulator's serial
+// interface (only used by disassemble(), not by this tool)
+MACHINE_STATE uint8_t SwitchSerialClass::m_selected = 0;
+SwitchSerialClass::SwitchSerialClass() {}
+void   SwitchSerialClass::begin(unsigned long) {}
+void   SwitchSerialClass::end() {}
+int    SwitchSerialClass::available() { return 0; }
+int    SwitchSerialClass::availableForWrite() { return 1; }
+int    SwitchSerialClass::peek() { return -1; }
+int    SwitchSerialClass::read() { return -1; }
+void   SwitchSerialClass::flush() { fflush(stdout); }
+size_t SwitchSerialClass::write(uint8_t c) { return fputc(c, stdout)==EOF ? 0 : 1; }
+size_t SwitchSerialClass::write(const uint8_t *buf, size_t n) { return fwrite(buf, 1, n, stdout); }
+SwitchSerialClass::operator bool() { return true; }
+SwitchSerialClass SwitchSerial;
+
+
+static bool dump(const char *fname)
+{
+  FILE *f = fopen(fname, "rb");
+  if( f==NULL ) { fprintf(stderr, "Can not open trace file: %s\n", fname); return false; }
+
+  struct ProfileTraceHeader h;
+  struct ProfileTraceRecord r, next;
+  if( fread(&h, sizeof(h), 1, f)!=1 || memcmp(h.magic, "ATRC", 4)!=0 || h.record_size!=sizeof(struct ProfileTraceRecord) )
+    {
+      fprintf(stderr, "Not a trace file: %s\n", fname);
+      fclose(f);
+      return false;
+    }
+
+  cpu_set_processor(h.processor);
+
+  // disassemble each record's opcode bytes at its original address
+  // (so relative jumps show the correct target)
+  static byte mem[0x10000];
+  char buf[80];
+  uint32_t start = 0;
+  bool have_next = fread(&next, sizeof(next), 1, f)==1;
+  if( have_next ) start = next.cycles;
+  while( have_next )
+    {
+      r = next;
+      have_next = fread(&next, sizeof(next), 1, f)==1;
+
+      printf("%u +", r.cycles-start);
+      if( have_next ) printf("%u", next.cycles-r.cycles); else putchar('?');
+      printf(r.flags & PROF_TRACE_INT ? " INT %04X:" : " %04X:", r.pc);
+
+      for(byte i=0; i<4; i++) mem[(uint16_t) (r.pc+i)] = r.op[i];
+      disassemble_text(mem, r.pc, buf, sizeof(buf), true);
+      fputs(buf, stdout);
+
+      printf("  A=%02X F=%02X BC=%04X DE=%04X HL=%04X SP=%04X", r.af & 0xFF, r.af >> 8, r.bc, r.de, r.hl, r.sp);
+      if( h.processor==PROC_Z80 ) printf(" IX=%04X IY=%04X", r.ix, r.iy);
+
+      if( r.mem_count>0 )
+        {
+          printf("  W %04X=%02X", r.mem_addr, r.mem_data);
+          if( r.mem_count>1 ) printf(" (%u writes)", r.mem_count);
+        }
+      if( r.flags & (PROF_TRACE_IN|PROF_TRACE_OUT) )
+        printf(r.flags & PROF_TRACE_IN ? "  IN %02X=%02X" : "  OUT %02X=%02X", r.io_port, r.io_data);
+
+      // same line ending as the simulator's serial output
+      printf("\r\n");
+    }
+
+  fclose(f);
+  return true;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *fname = NULL;
+
+  for(int i=1; i<argc; i++)
+    {
+      if( strcmp(argv[i], "-s")==0 && i+1<argc )
+        {
+          if( !disassembler_load_symbols(argv[++i]) )
+            { fprintf(stderr, "Can not read symbol file: %s\n", argv[i]); return 1; }
+        }
+      else if( strcmp(argv[i], "-o")==0 )
+        numsys_set(NUMSYS_OCT);
+      else if( fname==NULL && argv[i][0]!='-' )
+        fname = argv[i];
+      else
+        { fname = NULL; break; }
+    }
+
+  if( fname==NULL )
+    {
+      fprintf(stderr, "usage: %s [-s symbols] [-o] file\n", argv[0]);
+      return 1;
+    }
+
+  return dump(fname) ? 0 : 1;
+}
@@ -46,13 +46,14 @@ byte vdm1_get_iface() { return 0xff; }
 
 #define DEBUGLVL 0
 
-static byte vdm_iface = 0xff;
-static int  vdm_connected = 0;
-static byte vdm_ctrl = 0x00;
-static byte vdm_dip = 0;
-static byte vdm_keyboard_ctrl = 0xFF;
-static byte vdm_keyboard_data = 0xFF;
-uint16_t vdm1_mem_start, vdm1_mem_end;
+static MACHINE_STATE byte vdm_iface = 0xff;
+static MACHINE_STATE int  vdm_connected = 0;
+static MACHINE_STATE byte vdm_ctrl = 0x00;
+static MACHINE_STATE byte vdm_dip = 0;
+static MACHINE_STATE byte vdm_keyboard_ctrl = 0xFF;
+static MACHINE_STATE byte vdm_keyboard_data = 0xFF;
+static MACHINE_STATE bool vdm_resync = false;
+MACHINE_STATE uint16_t vdm1_mem_start, vdm1_mem_end;
 
 static void vdm1_send_dip();
 static void vdm1_send_ctrl();
@@ -62,6 +63,7 @@ static void vdm1_send_fullframe();
 static void vdm1_connect()
 {
   vdm_connected = 1;
+  vdm_resync = false;
   vdm_keyboard_ctrl = 1;
   vdm1_send_dip();
   vdm1_send_ctrl();
@@ -69,16 +71,21 @@ static void vdm1_connect()
 }
 
 
-static void vdm1_send(const byte *data, uint16_t size)
+#ifdef HOST_HAS_NONBLOCKING_SERIAL_WRITE
+static void vdm1_resync()
 {
-  if( vdm_iface<0xff && vdm_connected!=0 )
-    {
-#if DEBUGLVL>1
-      printf("VDM sending: ");
-      for(int i=0; i<size; i++) printf("%02X ", data[i]);
-      printf("\n");
+  // the client missed data => re-send the full state (from the
+  // timer function) once the client has caught up
+  vdm_resync = true;
+  if( !timer_running(TIMER_VDM1) ) timer_start(TIMER_VDM1, 10000);
+}
 #endif
 
+
+static bool vdm1_send_ok(uint16_t size)
+{
+  if( vdm_iface<0xff && vdm_connected!=0 )
+    {
       if( vdm_connected<0 )
         {
           // if the VDM-1 client has connected but has not been initialized
@@ -86,15 +93,52 @@ static void vdm1_send(const byte *data, uint16_t size)
           vdm1_connect();
           delay(100);
         }
-      
-      size_t n, ptr = 0;
-      while( size>0 )
+
+#ifdef HOST_HAS_NONBLOCKING_SERIAL_WRITE
+      // never wait for the client here, if the data does not fit into the
+      // output buffer as a whole then drop it (memory writes are included
+      // in the full frame that is re-sent)
+      if( vdm_resync || host_serial_available_for_write(vdm_iface) < size )
         {
-          n = host_serial_write(vdm_iface, ((const char *) data)+ptr, size);
-          ptr  += n;
-          size -= (uint16_t) n;
+          vdm1_resync();
+          return false;
         }
+#endif
+
+      return true;
+    }
+
+  return false;
+}
+
+
+static void vdm1_write(const byte *data, uint16_t size)
+{
+#if DEBUGLVL>1
+  printf("VDM sending: ");
+  for(int i=0; i<size; i++) printf("%02X ", data[i]);
+  printf("\n");
+#endif
+
+#ifdef HOST_HAS_NONBLOCKING_SERIAL_WRITE
+  // vdm1_send_ok() made sure that everything fits
+  host_serial_write(vdm_iface, (const char *) data, size);
+#else
+  // the serial transmit buffer may be smaller than the data
+  size_t n, ptr = 0;
+  while( size>0 )
+    {
+      n = host_serial_write(vdm_iface, ((const char *) data)+ptr, size);
+      ptr  += n;
+      size -= (uint16_t) n;
     }
+#endif
+}
+
+
+static void vdm1_send(const byte *data, uint16_t size)
+{
+  if( vdm1_send_ok(size) ) vdm1_write(data, size);
 }
 
 
@@ -120,8 +164,11 @@ static void vdm1_send_fullframe()
 {
   // send full picture memory
   byte b = VDM_FULLFRAME;
-  host_serial_write(vdm_iface, b);
-  vdm1_send(Mem+vdm1_mem_start, 1024);
+  if( vdm1_send_ok(1+1024) )
+    {
+      vdm1_write(&b, 1);
+      vdm1_write(Mem+vdm1_mem_start, 1024);
+    }
 }
 
 
@@ -180,7 +227,7 @@ void vdm1_set_address(uint16_t a)
 
 void vdm1_receive(byte iface, byte data)
 {
-  static byte state=0;
+  static MACHINE_STATE byte state=0;
 
 #if DEBUGLVL>0
   Serial.print("vdm1_receive: "); Serial.println(data, HEX);
@@ -278,7 +325,7 @@ void vdm1_register_ports()
 
 void vdm1_set_iface(byte iface)
 {
-  static host_serial_receive_callback_tp fprev = NULL;
+  static MACHINE_STATE host_serial_receive_callback_tp fprev = NULL;
 
   if( iface != vdm_iface )
     {
@@ -310,7 +357,21 @@ byte vdm1_get_iface()
 
 static void vdm1_timer()
 {
-  if( vdm_connected<0 ) vdm1_connect();
+  if( vdm_connected<0 )
+    vdm1_connect();
+  else if( vdm_resync && vdm_connected>0 && vdm_iface<0xff )
+    {
+      // only re-send the state if all of it (DIP, CTRL and full frame) fits
+      if( host_serial_available_for_write(vdm_iface) < 2+2+1+1024 )
+        timer_start(TIMER_VDM1, 10000);
+      else
+        {
+          vdm_resync = false;
+          vdm1_send_dip();
+          vdm1_send_ctrl();
+          vdm1_send_fullframe();
+        }
+    }
 }
 
 
@@ -321,6 +382,7 @@ void vdm1_setup()
   vdm1_set_iface(config_vdm1_interface());
   timer_setup(TIMER_VDM1, 0, vdm1_timer);
   vdm_connected = 0;
+  vdm_resync = false;
   vdm_keyboard_ctrl = 0xFF;
   vdm_keyboard_data = 0xFF;
 }
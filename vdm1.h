@@ -8,7 +8,7 @@
 
 #include <Arduino.h>
 
-extern uint16_t vdm1_mem_start, vdm1_mem_end;
+extern MACHINE_STATE uint16_t vdm1_mem_start, vdm1_mem_end;
 
 #define vdm1_write_mem(a, v) { if( (a)<vdm1_mem_end && (a)>=vdm1_mem_start ) vdm1_write_mem_(a, v); }
 